@@ -140,8 +140,8 @@ void BoundaryScalars(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm
        }
    }
   // Need to communicate the cell data for type 3 boundaries
-  ISendRecvCellData3D(phys->T,grid,myproc,comm);
-  ISendRecvCellData3D(phys->s,grid,myproc,comm);
+  ISendRecvStoredData3D(phys->T,grid,myproc,comm);
+  ISendRecvStoredData3D(phys->s,grid,myproc,comm);
 
    // Set the edge array to the value in the boundary array
   /* ii=-1;
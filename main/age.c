@@ -31,16 +31,16 @@ static void AllocateAgeVariables(gridT *grid, ageT **age, propT *prop){
   // allocate  structure
   *age = (ageT *)SunMalloc(sizeof(ageT),"AllocateAgeVariables");
 
-  (*age)->agec = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAgeVariables");
-  (*age)->agealpha = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAgeVariables");
+  (*age)->agec = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAgeVariables");
+  (*age)->agealpha = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAgeVariables");
   (*age)->agesource = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAgeVariables");
   (*age)->Cn_Ac = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAgeVariables");
   (*age)->Cn_Aa = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAgeVariables");
 
   // for each cell allocate memory for the number of layers at that location
   for(i=0;i<Nc;i++) {
-      (*age)->agec[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAgeVariables");
-      (*age)->agealpha[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAgeVariables");
+      (*age)->agec[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAgeVariables");
+      (*age)->agealpha[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAgeVariables");
       (*age)->agesource[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAgeVariables");
       (*age)->Cn_Ac[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAgeVariables");
       (*age)->Cn_Aa[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAgeVariables");
@@ -154,7 +154,7 @@ void UpdateAge(gridT *grid, physT *phys, propT *prop, MPI_Comm comm, int myproc)
       }
     }
 
-    ISendRecvCellData3D(age->agec,grid,myproc,comm);
+    ISendRecvStoredData3D(age->agec,grid,myproc,comm);
 
     for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
         j = grid->edgep[jptr];
@@ -198,7 +198,7 @@ void UpdateAge(gridT *grid, physT *phys, propT *prop, MPI_Comm comm, int myproc)
       }
     }
 
-    ISendRecvCellData3D(age->agealpha,grid,myproc,comm);
+    ISendRecvStoredData3D(age->agealpha,grid,myproc,comm);
     
     
 }
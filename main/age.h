@@ -9,8 +9,8 @@
 
 // Age structure
 typedef struct _ageT {
-  REAL **agec;
-  REAL **agealpha;
+  SREAL **agec;
+  SREAL **agealpha;
   REAL **agesource;
   REAL **Cn_Ac;
   REAL **Cn_Aa;
@@ -6,6 +6,7 @@
 */ 
 #include "averages.h"
 #include "sendrecv.h"
+#include "util.h"
 
 /***********************************************
 * Private functions
@@ -18,7 +19,7 @@
  */
 void AllocateAverageVariables(gridT *grid, averageT **average, propT *prop)
 {
-  int flag=0, i, j, jptr, ib, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf, k;
+  int flag=0, i, j, jptr, ib, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf, k, n;
 
 
   prop->avgctr=0;
@@ -32,14 +33,14 @@ void AllocateAverageVariables(gridT *grid, averageT **average, propT *prop)
   (*average)->initialavgfilectr=1*prop->ncfilectr;
 
   // Allocate 3D arrays
-  (*average)->uc = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->vc = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
+  (*average)->uc = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+  (*average)->vc = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
   (*average)->w = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->nu_v = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->kappa_tv = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->s = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->T = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-  (*average)->rho = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
+  (*average)->nu_v = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+  (*average)->kappa_tv = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+  (*average)->s = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+  (*average)->T = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+  (*average)->rho = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
   (*average)->counter = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
 
   // Edge variables
@@ -48,8 +49,20 @@ void AllocateAverageVariables(gridT *grid, averageT **average, propT *prop)
   (*average)->T_F = (REAL **)SunMalloc(Ne*sizeof(REAL *),"AllocateAverageVariables");
 
   if(prop->calcage)
-      (*average)->agec = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
-      (*average)->agealpha = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateAverageVariables");
+      (*average)->agec = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+      (*average)->agealpha = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+
+  if(prop->Ntracers>0) {
+    (*average)->tracers = (SREAL ***)SunMalloc(tracers->N*sizeof(SREAL **),"AllocateAverageVariables");
+    for(n=0;n<tracers->N;n++) {
+      (*average)->tracers[n] = NULL;
+      if(tracers->tracer[n].average) {
+        (*average)->tracers[n] = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateAverageVariables");
+        for(i=0;i<Nc;i++)
+          (*average)->tracers[n][i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+      }
+    }
+  }
 
   // cell-centered averageical variables in plan (no vertical direction)
   (*average)->h = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateAverageVariables");
@@ -77,18 +90,18 @@ void AllocateAverageVariables(gridT *grid, averageT **average, propT *prop)
   
   // for each cell allocate memory for the number of layers at that location
   for(i=0;i<Nc;i++) {
-      (*average)->uc[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
-      (*average)->vc[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
+      (*average)->uc[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+      (*average)->vc[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
       (*average)->w[i] = (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL),"AllocateAverageVariables");
-      (*average)->s[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
-      (*average)->T[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
-      (*average)->rho[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
-      (*average)->nu_v[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
-     (*average)->kappa_tv[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
+      (*average)->s[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+      (*average)->T[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+      (*average)->rho[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+      (*average)->nu_v[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
+     (*average)->kappa_tv[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");
      (*average)->counter[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");
       if(prop->calcage)
-         (*average)->agec[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");     	
-         (*average)->agealpha[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocateAverageVariables");     	
+         (*average)->agec[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");     	
+         (*average)->agealpha[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocateAverageVariables");     	
 
   }
   
@@ -113,7 +126,7 @@ void AllocateAverageVariables(gridT *grid, averageT **average, propT *prop)
  */
 void ZeroAverageVariables(gridT *grid, averageT *average, propT *prop){
 
-    int i,j,k,Nc=grid->Nc,Ne=grid->Ne;
+    int i,j,k,n,Nc=grid->Nc,Ne=grid->Ne;
 
   for(i=0;i<Nc;i++) {
     average->w[i][grid->Nk[i]]=0;
@@ -132,6 +145,11 @@ void ZeroAverageVariables(gridT *grid, averageT *average, propT *prop){
       	average->agec[i][k]=0;
       	average->agealpha[i][k]=0;
       }
+
+      if(prop->Ntracers>0)
+        for(n=0;n<tracers->N;n++)
+          if(average->tracers[n])
+            average->tracers[n][i][k]=0;
     }
     // 2D cell-centred variables
     average->h[i]=0;
@@ -174,7 +192,7 @@ void ZeroAverageVariables(gridT *grid, averageT *average, propT *prop){
  */
 void UpdateAverageVariables(gridT *grid, averageT *average, physT *phys, metT *met, propT *prop,MPI_Comm comm, int myproc){
 
-    int i,iptr,j,jptr,k,Nc=grid->Nc,Ne=grid->Ne;
+    int i,iptr,j,jptr,k,n,Nc=grid->Nc,Ne=grid->Ne;
     int nc1, nc2;
     REAL flx,dz, sdz,Tdz,theta=prop->theta;
     const REAL V0 = 1e6;
@@ -210,6 +228,11 @@ void UpdateAverageVariables(gridT *grid, averageT *average, physT *phys, metT *m
         }
 	*/
       }
+
+      if(prop->Ntracers>0)
+        for(n=0;n<tracers->N;n++)
+          if(average->tracers[n])
+            average->tracers[n][i][k]+=tracers->c[n][i][k];
       //sdz+=phys->s[i][k]*grid->dzzold[i][k];
       //Tdz+=phys->T[i][k]*grid->dzzold[i][k];
     }
@@ -292,7 +315,7 @@ void UpdateAverageScalars(gridT *grid, averageT *average, physT *phys, metT *met
     //Salt
     if(prop->beta>0){
 	// Compute the scalar on the vertical faces (for horiz. advection)
-	HorizontalFaceScalars(grid,phys,prop,phys->s,phys->boundary_s,prop->TVDsalt,comm,myproc); 
+	HorizontalFaceScalars(grid,phys,prop,StoredToREAL(phys->s,phys->stmp,grid),phys->boundary_s,prop->TVDsalt,comm,myproc); 
   	for(jptr=grid->edgedist[0];jptr<grid->edgedist[4];jptr++) {
 	  j = grid->edgep[jptr]; 
 	  for(k=grid->etop[j];k<grid->Nke[j];k++){
@@ -309,7 +332,7 @@ void UpdateAverageScalars(gridT *grid, averageT *average, physT *phys, metT *met
 
      //Temperature
      if(prop->gamma>0){
-	HorizontalFaceScalars(grid,phys,prop,phys->T,phys->boundary_T,prop->TVDtemp,comm,myproc); 
+	HorizontalFaceScalars(grid,phys,prop,StoredToREAL(phys->T,phys->stmp,grid),phys->boundary_T,prop->TVDtemp,comm,myproc); 
   	for(jptr=grid->edgedist[0];jptr<grid->edgedist[4];jptr++) {
 	  j = grid->edgep[jptr]; 
 	  for(k=grid->etop[j];k<grid->Nke[j];k++){
@@ -361,7 +384,7 @@ void UpdateAverageScalars(gridT *grid, averageT *average, physT *phys, metT *met
  */
 void ComputeAverageVariables(gridT *grid, averageT *average, physT *phys, metT *met, int ntaverage, propT *prop){
 
-    int i,j,k,Nc=grid->Nc,Ne=grid->Ne;
+    int i,j,k,n,Nc=grid->Nc,Ne=grid->Ne;
     const REAL nt = 1.0/((REAL)ntaverage);
     REAL nt3d;
     const REAL V0 = 1e-6;
@@ -388,6 +411,11 @@ void ComputeAverageVariables(gridT *grid, averageT *average, physT *phys, metT *
 	    average->agec[i][k] *= nt3d;
 	    average->agealpha[i][k] *= nt3d;
       }
+
+      if(prop->Ntracers>0)
+        for(n=0;n<tracers->N;n++)
+          if(average->tracers[n])
+            average->tracers[n][i][k] *= nt3d;
     }
     // 2D cell-centred variables
     average->h_avg[i] *= nt;
@@ -429,6 +457,8 @@ void ComputeAverageVariables(gridT *grid, averageT *average, physT *phys, metT *
  *
  */
 void SendRecvAverages(propT *prop, gridT *grid, averageT *average, MPI_Comm comm, int myproc){
+    int n;
+
     // Communicate 2D variables
     ISendRecvCellData2D(average->h,grid,myproc,comm);
     ISendRecvCellData2D(average->s_dz,grid,myproc,comm);
@@ -451,16 +481,20 @@ void SendRecvAverages(propT *prop, gridT *grid, averageT *average, MPI_Comm comm
     }
 
     // Communicate the 3D cell data
-    ISendRecvCellData3D(average->uc,grid,myproc,comm);
-    ISendRecvCellData3D(average->vc,grid,myproc,comm);
-    ISendRecvCellData3D(average->s,grid,myproc,comm);
-    ISendRecvCellData3D(average->T,grid,myproc,comm);
-    ISendRecvCellData3D(average->rho,grid,myproc,comm);
-    ISendRecvCellData3D(average->nu_v,grid,myproc,comm);
-    ISendRecvCellData3D(average->kappa_tv,grid,myproc,comm);
+    ISendRecvStoredData3D(average->uc,grid,myproc,comm);
+    ISendRecvStoredData3D(average->vc,grid,myproc,comm);
+    ISendRecvStoredData3D(average->s,grid,myproc,comm);
+    ISendRecvStoredData3D(average->T,grid,myproc,comm);
+    ISendRecvStoredData3D(average->rho,grid,myproc,comm);
+    ISendRecvStoredData3D(average->nu_v,grid,myproc,comm);
+    ISendRecvStoredData3D(average->kappa_tv,grid,myproc,comm);
     if(prop->calcage)
-	ISendRecvCellData3D(average->agec,grid,myproc,comm);
-	ISendRecvCellData3D(average->agealpha,grid,myproc,comm);
+	ISendRecvStoredData3D(average->agec,grid,myproc,comm);
+	ISendRecvStoredData3D(average->agealpha,grid,myproc,comm);
+    if(prop->Ntracers>0)
+      for(n=0;n<tracers->N;n++)
+        if(average->tracers[n])
+          ISendRecvStoredData3D(average->tracers[n],grid,myproc,comm);
 
     ISendRecvWData(average->w,grid,myproc,comm);
 
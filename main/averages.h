@@ -12,20 +12,21 @@
 #include "met.h"
 #include "tvd.h"
 #include "age.h"
+#include "tracers.h"
 
 /*
  * Main averages variable struct.
  */
 typedef struct _averageT {
   
-  REAL **uc;
-  REAL **vc;
+  SREAL **uc;
+  SREAL **vc;
   REAL **w;
-  REAL **s;
-  REAL **T;
-  REAL **rho;
-  REAL **nu_v;
-  REAL **kappa_tv;
+  SREAL **s;
+  SREAL **T;
+  SREAL **rho;
+  SREAL **nu_v;
+  SREAL **kappa_tv;
 
   REAL **counter;
 
@@ -42,8 +43,11 @@ typedef struct _averageT {
   REAL *T_dz;
 
   // Age variables
-  REAL **agec;
-  REAL **agealpha;
+  SREAL **agec;
+  SREAL **agealpha;
+
+  // Passive tracers, only allocated for the tracers that are averaged
+  SREAL ***tracers;
 
   // Atmospheric flux variables
   REAL *Uwind;
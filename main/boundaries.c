@@ -137,8 +137,8 @@ void BoundaryScalars(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm
        }
    }
   // Need to communicate the cell data for type 3 boundaries
-  ISendRecvCellData3D(phys->T,grid,myproc,comm);
-  ISendRecvCellData3D(phys->s,grid,myproc,comm);
+  ISendRecvStoredData3D(phys->T,grid,myproc,comm);
+  ISendRecvStoredData3D(phys->s,grid,myproc,comm);
 
    // Set the edge array to the value in the boundary array
   /* ii=-1;
@@ -398,9 +398,9 @@ void InitBoundaryData(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
   */     
  void UpdateBdyNC(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
      int n, j, k, t0, t1, t2; 
-     REAL dt, r1, r2, mu;
+     REAL dt, r1, r2, mu, *w;
    
-     t1 = getTimeRecBnd(prop->nctime,bound->time,bound->Nt);
+     t1 = TimeCursorSearch(&(bound->cursor),prop->nctime,bound->time,(int)bound->Nt);
      t0=t1-1;
      t2=t1+1;
 
@@ -435,42 +435,38 @@ void InitBoundaryData(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
     //r1 = 1.0-r2;
 
 //    if (myproc==0) printf("t1: %f, %t2: %f, tnow:%f, ,mu %f, r2: %f, r1: %f\n",bound->time[bound->t0],bound->time[bound->t1], prop->nctime, mu, r2, r1);
-    if(bound->hasType2>0){
-	//printf("Updating type-2 boundaries on proc %d\n",myproc);
-	for (j=0;j<bound->Ntype2;j++){
-	  for (k=0;k<bound->Nk;k++){
-	    //Quadratic temporal interpolation
-	    bound->boundary_u[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_u_t[0][k][j],bound->boundary_u_t[1][k][j],bound->boundary_u_t[2][k][j] );
-	    bound->boundary_v[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_v_t[0][k][j],bound->boundary_v_t[1][k][j],bound->boundary_v_t[2][k][j] );
-	    bound->boundary_w[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_w_t[0][k][j],bound->boundary_w_t[1][k][j],bound->boundary_w_t[2][k][j] );
-	    bound->boundary_T[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_T_t[0][k][j],bound->boundary_T_t[1][k][j],bound->boundary_T_t[2][k][j] );
-	    bound->boundary_S[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_S_t[0][k][j],bound->boundary_S_t[1][k][j],bound->boundary_S_t[2][k][j] );
-	  }
+
+    // Quadratic temporal interpolation weights (the same for every point)
+    TimeCursorWeights(&(bound->cursor),prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2]);
+    w = bound->cursor.w;
+
+    if(bound->hasType2>0 && bound->j2end>=bound->j2start){
+	j=bound->j2start;
+	n=bound->j2end-bound->j2start+1;
+	for (k=0;k<bound->Nk;k++){
+	  TimeInterp(bound->boundary_u[k]+j,bound->boundary_u_t[0][k]+j,bound->boundary_u_t[1][k]+j,bound->boundary_u_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->boundary_v[k]+j,bound->boundary_v_t[0][k]+j,bound->boundary_v_t[1][k]+j,bound->boundary_v_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->boundary_w[k]+j,bound->boundary_w_t[0][k]+j,bound->boundary_w_t[1][k]+j,bound->boundary_w_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->boundary_T[k]+j,bound->boundary_T_t[0][k]+j,bound->boundary_T_t[1][k]+j,bound->boundary_T_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->boundary_S[k]+j,bound->boundary_S_t[0][k]+j,bound->boundary_S_t[1][k]+j,bound->boundary_S_t[2][k]+j,w,n,-INFTY,INFTY);
 	}
     }
-    if(bound->hasType3>0){
-	//printf("Updating type-3 boundaries on proc %d\n",myproc);
-	for (j=0;j<bound->Ntype3;j++){
-	  for (k=0;k<bound->Nk;k++){
-	    // Quadratic temporal interpolation
-	    //printf("bound->S[0][0] = %f\n",bound->S[0][0]);
-	    //printf("bound->S_t[1][0][0] = %f, bound->S[0][0] = %f\n",bound->S_t[1][0][0],bound->S[0][0]);
-	    bound->uc[k][j] = bound->uc_t[1][k][j];
-	    bound->uc[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->uc_t[0][k][j],bound->uc_t[1][k][j],bound->uc_t[2][k][j]);
-	    bound->vc[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->vc_t[0][k][j],bound->vc_t[1][k][j],bound->vc_t[2][k][j]);
-	    bound->wc[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->wc_t[0][k][j],bound->wc_t[1][k][j],bound->wc_t[2][k][j]);
-	    bound->T[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->T_t[0][k][j],bound->T_t[1][k][j],bound->T_t[2][k][j]);
-	    bound->S[k][j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->S_t[0][k][j],bound->S_t[1][k][j],bound->S_t[2][k][j]);
-	  }
-	  bound->h[j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->h_t[0][j],bound->h_t[1][j],bound->h_t[2][j]);
+    if(bound->hasType3>0 && bound->j3end>=bound->j3start){
+	j=bound->j3start;
+	n=bound->j3end-bound->j3start+1;
+	for (k=0;k<bound->Nk;k++){
+	  TimeInterp(bound->uc[k]+j,bound->uc_t[0][k]+j,bound->uc_t[1][k]+j,bound->uc_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->vc[k]+j,bound->vc_t[0][k]+j,bound->vc_t[1][k]+j,bound->vc_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->wc[k]+j,bound->wc_t[0][k]+j,bound->wc_t[1][k]+j,bound->wc_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->T[k]+j,bound->T_t[0][k]+j,bound->T_t[1][k]+j,bound->T_t[2][k]+j,w,n,-INFTY,INFTY);
+	  TimeInterp(bound->S[k]+j,bound->S_t[0][k]+j,bound->S_t[1][k]+j,bound->S_t[2][k]+j,w,n,-INFTY,INFTY);
 	}
+	TimeInterp(bound->h+j,bound->h_t[0]+j,bound->h_t[1]+j,bound->h_t[2]+j,w,n,-INFTY,INFTY);
     }
    // printf("Updating flux (Q) boundaries on proc %d\n",myproc);
     // Interpolate Q and find the velocities based on the (dynamic) segment area
     if(bound->hasType2 && bound->hasSeg>0){
-	for (j=0;j<bound->Nseg;j++){
-	  bound->boundary_Q[j] = QuadInterp(prop->nctime,bound->time[t0],bound->time[t1],bound->time[t2],bound->boundary_Q_t[0][j],bound->boundary_Q_t[1][j],bound->boundary_Q_t[2][j]);
-	}
+	TimeInterp(bound->boundary_Q,bound->boundary_Q_t[0],bound->boundary_Q_t[1],bound->boundary_Q_t[2],w,(int)bound->Nseg,-INFTY,INFTY);
 	// This function does the actual conversion
 	FluxtoUV(prop,grid,myproc,comm);
     }
@@ -501,11 +497,7 @@ static void FluxtoUV(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
 	//Only calculate if the segment flag >0 
 	if(bound->segedgep[j]>0 && jind!=-1 && !isGhostEdge(jind,grid,myproc) ){
 	    //Find the segment index
-	    ss = -1;
-	    for (n=0;n<bound->Nseg;n++){
-		if( bound->segp[n] == bound->segedgep[j]) 
-		    ss=n;
-	    }
+	    ss = HashLookup(bound->segmap,bound->segedgep[j]);
 
 	    //printf("Processor: %d, j: %d, jind: %d, mark: %d, segment #: %d, segment ID: %d, segment area: %10.6f [m2]\n",myproc,j,jind,grid->mark[jind],ss,bound->segp[ss],bound->segarea[ss]); 
 	    //isGhostEdge(jind,grid,myproc);
@@ -539,11 +531,7 @@ static void SegmentArea(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
 	//Only calculate if the segment flag >0 
 	if(bound->segedgep[j]>0 && jind != -1 && !isGhostEdge(jind,grid,myproc) ){
 	    //Find the segment index
-	    ss = -1;
-	    for (n=0;n<bound->Nseg;n++){
-		if(bound->segp[n] ==bound->segedgep[j]) 
-		    ss=n;
-	    }
+	    ss = HashLookup(bound->segmap,bound->segedgep[j]);
 
 	    //Loop through all vertical cells and sum the area
 	    for(k=grid->etop[jind];k<grid->Nke[jind];k++) {
@@ -595,30 +583,56 @@ int isGhostEdge(int j, gridT *grid, int myproc){
 /*
  * Function: MatchBndPoints()
  * -------------------------
- * Checks that the boundary arrays match the grid sizes
+ * Matches the local boundary edges and cells with the points in the boundary file
+ * and checks that the boundary arrays match the grid sizes.
+ *
+ * The file points are hashed by their global index so that each local point is
+ * found in constant time.  The maps are kept in the boundary structure for use
+ * by the other boundary routines.
  */
  static void MatchBndPoints(propT *prop, gridT *grid, int myproc){
- int iptr, jptr, jj, ii, ne, nc1, nc2, nc, j, ib;
-
-
+ int iptr, jptr, jj, ii, j, ib, nomatch;
 
     if(myproc==0) printf("Boundary NetCDF file grid # type 2 points = %d\n",(int)bound->Ntype2);
     if(myproc==0) printf("Boundary NetCDF file grid # type 3 points = %d\n",(int)bound->Ntype3);
 
+    // Build the global index -> file index maps
+    bound->edgemap=NULL;
+    bound->cellmap=NULL;
+    bound->segmap=NULL;
+    if(bound->hasType2) {
+      bound->edgemap = HashCreate((int)bound->Ntype2,"MatchBndPoints");
+      for(jj=0;jj<bound->Ntype2;jj++)
+	HashInsert(bound->edgemap,bound->edgep[jj],jj);
+    }
+    if(bound->hasType3) {
+      bound->cellmap = HashCreate((int)bound->Ntype3,"MatchBndPoints");
+      for(jj=0;jj<bound->Ntype3;jj++)
+	HashInsert(bound->cellmap,bound->cellp[jj],jj);
+    }
+    if(bound->hasSeg) {
+      bound->segmap = HashCreate((int)bound->Nseg,"MatchBndPoints");
+      for(jj=0;jj<bound->Nseg;jj++)
+	HashInsert(bound->segmap,bound->segp[jj],jj);
+    }
+
     if(myproc==0) printf("Matching type-2 points...\n");
      //Type-2
+     nomatch=0;
      ii=-1;
      for(jptr=grid->edgedist[2];jptr<grid->edgedist[3];jptr++) {
 	 ii+=1;
 
 	 // Match suntans edge cell with the type-2 boundary file point
-	 for(jj=0;jj<bound->Ntype2;jj++){
-	     if(grid->eptr[grid->edgep[jptr]]==bound->edgep[jj]){
-		bound->ind2[ii]=jj;
-		bound->localedgep[jj]=grid->edgep[jptr]; 
-	        //printf("grid->eptr:%d, bound->edgep[jj]: %d, jj: %d, jptr: %d, grid->edgep[jptr]: %d, localedgep[jj]: %d\n",grid->eptr[grid->edgep[jptr]],bound->edgep[jj],jj,jptr,grid->edgep[jptr],bound->localedgep[jj]); 
-	     }
-	 }	 
+	 jj = bound->hasType2 ? HashLookup(bound->edgemap,grid->eptr[grid->edgep[jptr]]) : -1;
+	 if(jj!=-1) {
+	   bound->ind2[ii]=jj;
+	   bound->localedgep[jj]=grid->edgep[jptr]; 
+	 } else {
+	   if(!nomatch) printf("Error! Type-2 edge %d on processor %d not found in open boundary file.\n",
+			       grid->eptr[grid->edgep[jptr]],myproc);
+	   nomatch++;
+	 }
      }
     if(myproc==0) printf("Matching type-3 points...\n");
      // Type-3
@@ -626,14 +640,16 @@ int isGhostEdge(int j, gridT *grid, int myproc){
      for(iptr=grid->celldist[1];iptr<grid->celldist[2];iptr++) {
          ii+=1;
 	 // Match suntans grid cell with the type-3 boundary file point
-	 for(jj=0;jj<bound->Ntype3;jj++){
-	     if(grid->mnptr[grid->cellp[iptr]]==bound->cellp[jj]){
-		bound->ind3[ii]=jj;
-	     }
+	 jj = bound->hasType3 ? HashLookup(bound->cellmap,grid->mnptr[grid->cellp[iptr]]) : -1;
+	 if(jj!=-1)
+	   bound->ind3[ii]=jj;
+	 else {
+	   if(!nomatch) printf("Error! Type-3 cell %d on processor %d not found in open boundary file.\n",
+			       grid->mnptr[grid->cellp[iptr]],myproc);
+	   nomatch++;
 	 }
-	 //printf("Type 3 : Processor = %d, jptr = %d, cellp[jptr]=%d, bound->ind3[ii]=%d\n",myproc,jptr,grid->cellp[jptr],bound->ind3[ii]);
      }
-    if(myproc==0) printf("Matching type-2 edges...\n");
+    if(myproc==0) printf("Matching type-3 edges...\n");
      //Type-3 edges
      ii=-1;
      for(jptr=grid->edgedist[3];jptr<grid->edgedist[4];jptr++) {
@@ -641,13 +657,28 @@ int isGhostEdge(int j, gridT *grid, int myproc){
 	 j = grid->edgep[jptr];
 	 ib=grid->mnptr[grid->grad[2*j]];
 	 // Match suntans edge cell with the type-3 boundary file point
-	 for(jj=0;jj<bound->Ntype3;jj++){
-	     if(ib==bound->cellp[jj]){
-		bound->ind3edge[ii]=jj;
-	     }
-	 }	 
+	 if(bound->hasType3)
+	   bound->ind3edge[ii]=HashLookup(bound->cellmap,ib);
      }
+
+     // Check that each flux boundary edge belongs to a segment in the file
+     if(bound->hasSeg) {
+       for(jj=0;jj<bound->Ntype2;jj++)
+	 if(bound->segedgep[jj]>0 && bound->localedgep[jj]!=-1 &&
+	    HashLookup(bound->segmap,bound->segedgep[jj])==-1) {
+	   if(!nomatch) printf("Error! Segment %d on processor %d not found in open boundary file.\n",
+			       bound->segedgep[jj],myproc);
+	   nomatch++;
+	 }
+     }
+
      // Check that ind2 and ind3 do not contain any -1 (non-matching points)
+     if(nomatch) {
+       printf("Error! %d boundary points on processor %d could not be matched with the open boundary file.\n",
+	      nomatch,myproc);
+       MPI_Finalize();
+       exit(EXIT_FAILURE);
+     }
 
      // Check that the number of vertical grid points match
     if(bound->Nk != grid->Nkmax){
@@ -52,6 +52,11 @@ typedef struct _boundT{
   int *ind3;
   int *ind3edge;
 
+  // Maps from global edge/cell index and segment id to the point in the file
+  hashT *edgemap;
+  hashT *cellmap;
+  hashT *segmap;
+
   // Boundary coordinates
   REAL *xe;
   REAL *ye;
@@ -66,6 +71,14 @@ typedef struct _boundT{
   int t0;
   int t1;
   int t2; 
+  int tread; // first record currently held in the _t arrays (-1 if none)
+  timecursorT cursor;
+
+  // Range of file points referenced by this processor's grid (subset read)
+  int j2start;
+  int j2end;
+  int j3start;
+  int j3end;
 
   // Data arrays at forward (_f) and backward (_b) timestep
   // Type-2 (edge centred) boundaries
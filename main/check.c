@@ -18,98 +18,80 @@
 
 #define DASHES "----------------------------------------------------------------------\n"
 #define CMAXSUGGEST 0.5
+#define NOTFINITE(x) ((x)!=(x) || fabs(x)>INFTY)
+
+static int CheckFreeSurface(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm comm);
 
 /*
  * Function: Check
  * Usage: Check(grid,phys,prop,myproc,numprocs,comm);
  * --------------------------------------------------
- * Check to make sure the run isn't blowing up.
+ * Check to make sure the run isn't blowing up.  Every ntcheck steps and on
+ * the progress steps h, s, u and w are checked for NaN/Inf and the Courant
+ * numbers are computed in a single pass over the cells and one over the edges,
+ * followed by one reduction.  On the other steps only the free surface is
+ * checked (see CheckFreeSurface).
  *
  */    
 int Check(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm)
 {
   int i, k, icu, kcu, icw, kcw, Nc=grid->Nc, Ne=grid->Ne, ih, is, ks, iu, ku, iw, kw, nc1, nc2;
-  int uflag=1, wflag=1, sflag=1, hflag=1, myalldone, alldone, progout;
-  REAL C, CmaxU, CmaxW, allCmaxU, allCmaxW, dtsuggestU, dtsuggestW;
+  int uflag=1, wflag=1, sflag=1, hflag=1, myalldone, progout;
+  REAL C, CmaxU, CmaxW, dtsuggestU, dtsuggestW, local[3], global[3];
+
+  progout = (int)(prop->nsteps*(double)prop->ntprog/100);
+  if(!(prop->ntcheck>0 && !(prop->n%prop->ntcheck)) && !(progout>0 && !(prop->n%progout)))
+    return CheckFreeSurface(grid,phys,prop,myproc,comm);
 
   icu=kcu=icw=kcw=ih=is=ks=iu=ku=iw=kw=0;
 
-  for(i=0;i<Nc;i++) 
-    if(phys->h[i]!=phys->h[i]) {
+  CmaxW=0;
+  for(i=0;i<Nc;i++) {
+    if(hflag && NOTFINITE(phys->h[i])) {
       hflag=0;
       ih=i;
-      break;
     }
 
-  for(i=0;i<Nc;i++) {
-    for(k=0;k<grid->Nk[i];k++)
-      if(phys->s[i][k]!=phys->s[i][k]) {
+    for(k=0;k<grid->Nk[i];k++) {
+      if(sflag && NOTFINITE(phys->s[i][k])) {
         sflag=0;
         is=i;
         ks=k;
-        break;
-      }
-    if(!sflag)
-      break;
-  }
-
-  for(i=0;i<Ne;i++) {
-    for(k=0;k<grid->Nke[i];k++)
-      if(phys->u[i][k]!=phys->u[i][k]) {
-        uflag=0;
-        iu=i;
-        ku=k;
-        break;
       }
-    if(!uflag)
-      break;
-  }
-
-  for(i=0;i<Nc;i++) {
-    for(k=0;k<grid->Nk[i];k++)
-      if(phys->w[i][k]!=phys->w[i][k]) {
+      if(wflag && NOTFINITE(phys->w[i][k])) {
         wflag=0;
         iw=i;
         kw=k;
-        break;
       }
-    if(!wflag)
-      break;
+      if(k>=grid->ctop[i]) {
+        C = 0.5*fabs(phys->w[i][k]+phys->w[i][k+1])*prop->dt/grid->dzz[i][k];
+        if(C>CmaxW) {
+          icw = i;
+          kcw = k;
+          CmaxW = C;
+        }
+      }
+    }
   }
 
   CmaxU=0;
   for(i=0;i<Ne;i++) 
-    for(k=grid->etop[i];k<grid->Nke[i];k++) {
-      C = fabs(phys->u[i][k])*prop->dt/grid->dg[i];
-      if(C>CmaxU) {
-        icu = i;
-        kcu = k;
-        CmaxU = C;
+    for(k=0;k<grid->Nke[i];k++) {
+      if(uflag && NOTFINITE(phys->u[i][k])) {
+        uflag=0;
+        iu=i;
+        ku=k;
       }
-    }
-
-  CmaxW=0;
-  for(i=0;i<Nc;i++) 
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
-      C = 0.5*fabs(phys->w[i][k]+phys->w[i][k+1])*prop->dt/grid->dzz[i][k];
-      if(C>CmaxW) {
-	icw = i;
-	kcw = k;
-	CmaxW = C;
+      if(k>=grid->etop[i]) {
+        C = fabs(phys->u[i][k])*prop->dt/grid->dg[i];
+        if(C>CmaxU) {
+          icu = i;
+          kcu = k;
+          CmaxU = C;
+        }
       }
     }
 
-  progout = (int)(prop->nsteps*(double)prop->ntprog/100);
-  if(progout>0 && !(prop->n%progout)) {
-    MPI_Reduce(&CmaxU,&allCmaxU,1,MPI_DOUBLE,MPI_MAX,0,comm);
-    MPI_Reduce(&CmaxW,&allCmaxW,1,MPI_DOUBLE,MPI_MAX,0,comm);
-  }
-
-  if(myproc==0) {
-    prop->CmaxU = allCmaxU;
-    prop->CmaxW = allCmaxW;
-  }
-
   myalldone=0;
   if(!uflag || !wflag || !sflag || !hflag || CmaxU>prop->Cmax || (prop->thetaM<0.5 && CmaxW>prop->Cmax)) {
     printf(DASHES);
@@ -140,7 +122,7 @@ int Check(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_C
     }
 
     if(!uflag) {
-      printf("Problem with U (U=NaN):\n");
+      printf("Problem with U (U=NaN or Inf):\n");
       printf("  Grid indices: j=%d k=%d (Nke=%d)\n", iu, ku, grid->Nke[iu]);
       printf("  Location: x=%.3e, y=%.3e, z=%.3e\n",grid->xe[iu],grid->ye[iu],
           0.5*(DepthFromDZ(grid,phys,grid->grad[2*iu],ku)+
@@ -164,19 +146,19 @@ int Check(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_C
     }
 
     if(!wflag) {
-      printf("Problem with W (W=NaN):\n");
+      printf("Problem with W (W=NaN or Inf):\n");
       printf("  Grid indices: i=%d k=%d (Nkc=%d)\n", iw, kw, grid->Nkc[iw]);
       printf("  Location: x=%.3e, y=%.3e, z=%.3e\n",grid->xv[iw],grid->yv[iw],DepthFromDZ(grid,phys,iw,kw));
     }
 
     if(!sflag) {
-      printf("Problem with the scalar s (s=NaN):\n");
+      printf("Problem with the scalar s (s=NaN or Inf):\n");
       printf("  Grid indices: i=%d k=%d (Nkc=%d)\n", is, ks, grid->Nkc[is]);
       printf("  Location: x=%.3e, y=%.3e, z=%.3e\n",grid->xv[is],grid->yv[is],DepthFromDZ(grid,phys,is,ks));
     }
 
     if(!hflag) {
-      printf("Problem with the free surface (h=NaN):\n");
+      printf("Problem with the free surface (h=NaN or Inf):\n");
       printf("  Grid index: i=%d\n", ih);
       printf("  Location: x=%.3e, y=%.3e\n",grid->xv[ih],grid->yv[ih]);
     }
@@ -185,8 +167,44 @@ int Check(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_C
     myalldone=1;
   }
 
-  MPI_Reduce(&myalldone,&alldone,1,MPI_INT,MPI_SUM,0,comm);
-  MPI_Bcast(&alldone,1,MPI_INT,0,comm);
+  // One reduction for the Courant numbers and the blowup flag
+  local[0]=CmaxU;
+  local[1]=CmaxW;
+  local[2]=myalldone;
+  MPI_Allreduce(local,global,3,MPI_DOUBLE,MPI_MAX,comm);
+
+  prop->CmaxU = global[0];
+  prop->CmaxW = global[1];
+
+  return (int)global[2];
+}
+
+/*
+ * Function: CheckFreeSurface
+ * Usage: blowup = CheckFreeSurface(grid,phys,prop,myproc,comm);
+ * -------------------------------------------------------------
+ * Cheap check used by Check on the steps without the full check.  Only the
+ * free surface is checked for NaN/Inf since a blowup in u, w or the scalars
+ * reaches it within a step or two through the free-surface solve.
+ *
+ */
+static int CheckFreeSurface(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm comm)
+{
+  int i, myalldone=0, alldone;
+
+  for(i=0;i<grid->Nc;i++) 
+    if(NOTFINITE(phys->h[i])) {
+      printf(DASHES);
+      printf("Time step %d: Processor %d, Run is blowing up!\n",prop->n,myproc);
+      printf("Problem with the free surface (h=NaN or Inf):\n");
+      printf("  Grid index: i=%d\n", i);
+      printf("  Location: x=%.3e, y=%.3e\n",grid->xv[i],grid->yv[i]);
+      printf(DASHES);
+      myalldone=1;
+      break;
+    }
+
+  MPI_Allreduce(&myalldone,&alldone,1,MPI_INT,MPI_MAX,comm);
 
   return alldone;
 }
@@ -338,28 +356,42 @@ void Progress(propT *prop, int myproc, int numprocs)
  * Function: MemoryStats
  * Usage: MemoryStats(myproc,numprocs,comm);
  * -----------------------------------------
- * Print out statistics on total memory and grid points.
+ * Print out statistics on total memory and grid points, followed on
+ * processor 0 by the current and high-water memory of each subsystem summed
+ * over the processors and the largest high-water mark of one processor.
  *
  */
 void MemoryStats(gridT *grid, int myproc, int numprocs, MPI_Comm comm) {
   int i, ncells, allncells;
-  unsigned AllSpace, TotSpacekb = TotSpace>>10;
+  unsigned long long local[2*MEMTAGS+2], allsum[2*MEMTAGS+2], allmax[2*MEMTAGS+2];
 
   ncells=0;
   for(i=0;i<grid->Nc;i++)
     ncells+=grid->Nk[i];
 
-  MPI_Reduce(&TotSpacekb,&(AllSpace),1,MPI_UNSIGNED,MPI_SUM,0,comm);
-  MPI_Bcast(&AllSpace,1,MPI_UNSIGNED,0,comm);
+  for(i=0;i<MEMTAGS;i++) {
+    local[i]=TagSpace[i];
+    local[MEMTAGS+i]=TagPeak[i];
+  }
+  local[2*MEMTAGS]=TotSpace;
+  local[2*MEMTAGS+1]=PeakSpace;
+
+  MPI_Reduce(local,allsum,2*MEMTAGS+2,MPI_UNSIGNED_LONG_LONG,MPI_SUM,0,comm);
+  MPI_Reduce(local,allmax,2*MEMTAGS+2,MPI_UNSIGNED_LONG_LONG,MPI_MAX,0,comm);
   MPI_Reduce(&ncells,&(allncells),1,MPI_INT,MPI_SUM,0,comm);
-  MPI_Bcast(&allncells,1,MPI_INT,0,comm);
 
   if(numprocs>0)
-    printf("Processor %d,  Total memory: %u Mb, %d cells\n",
-        myproc,TotSpacekb>>10,ncells);
-  if(myproc==0) 
-    printf("All processors: %u Mb, %d cells (%d bytes/cell)\n",
-        AllSpace>>10,allncells,
-        (int)(1024.0*(REAL)AllSpace/(REAL)allncells));
+    printf("Processor %d,  Total memory: %.2f Mb (peak %.2f Mb), %d cells\n",
+        myproc,TotSpace/1048576.0,PeakSpace/1048576.0,ncells);
+  if(myproc==0) {
+    printf("All processors: %.2f Mb (peak %.2f Mb), %d cells (%d bytes/cell)\n",
+        allsum[2*MEMTAGS]/1048576.0,allsum[2*MEMTAGS+1]/1048576.0,allncells,
+        (int)((REAL)allsum[2*MEMTAGS]/(REAL)allncells));
+    printf("  %-10s %12s %12s %16s\n","Subsystem","Total (Mb)","Peak (Mb)","Max peak/proc");
+    for(i=0;i<MEMTAGS;i++)
+      if(allsum[MEMTAGS+i])
+        printf("  %-10s %12.2f %12.2f %16.2f\n",MemoryTagName(i),allsum[i]/1048576.0,
+            allsum[MEMTAGS+i]/1048576.0,allmax[MEMTAGS+i]/1048576.0);
+  }
 }
 
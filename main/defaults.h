@@ -48,18 +48,28 @@ const REAL minimum_depth_DEFAULT=0;
 */
 const int fixdzz_DEFAULT=1;   
 
-/* TVDsalt, TVDturb, TVDtemp:
+/* reordergrid:
+   0: Number the local cells and edges in the order of the input grid.
+   1: Use a reverse Cuthill-McKee ordering of the cells (and edges) for better cache locality.
+      Per-processor input files that follow the local boundary ordering (e.g. tidecomponents.dat.*)
+      must then be regenerated from the reordered grid.
+*/
+const int reordergrid_DEFAULT=0;
+
+/* TVDsalt, TVDturb, TVDtemp, TVDtracers:
    0: No TVD scheme
    1: First-order upwind (Psi(r)=0)
    2: Lax-Wendroff (Psi(r)=1)
    3: Superbee
    4: Van Leer
 
-   Defaults for salt and temperature are Van Leer, for turbulence model use first-order upwind.
+   Defaults for salt and temperature are Van Leer, for turbulence model and the passive
+   tracers use first-order upwind.
 */
 const int TVDsalt_DEFAULT=4;
 const int TVDtemp_DEFAULT=4;
 const int TVDturb_DEFAULT=0;
+const int TVDtracers_DEFAULT=0;
 
 /* laxWendroff:
    0: Nothing
@@ -77,9 +87,24 @@ const REAL laxWendroff_Vertical_DEFAULT = 0;
 /* hprecond:
    0: No preconditioner for free-surface solver
    1: Jacobi preconditioner
+   2: Sparse Cholesky factorization of the operator (direct solve on one processor)
 */
 const int hprecond_DEFAULT = 1;
 
+/* hfactortol:
+   With hprecond=2, refactorize the free-surface operator only when one of its
+   coefficients has changed by more than this relative amount.
+*/
+const REAL hfactortol_DEFAULT = 0.01;
+
+/* nprojection:
+   Number of previous solutions onto which the right-hand sides of the free-surface
+   and nonhydrostatic pressure solvers are projected to obtain the initial guess.
+   0 starts the free-surface solver from zero and the pressure solver from the
+   previous pressure correction.
+*/
+const int nprojection_DEFAULT = 0;
+
 /* ntoutStore:
    How often to save restart data.  If 0 then just save at the last time step.
 */
@@ -129,6 +154,49 @@ const int mergeArrays_DEFAULT = 1;
 */
 const int computeSediments_DEFAULT = 0;
 
+/* baroclinic
+   Vertical integration of the baroclinic pressure gradient.
+   0: Piecewise-constant density in each layer.
+   1: Trapezoidal rule between layer centers (second order on stretched grids).
+*/
+const int baroclinic_DEFAULT = 0;
+
+/* ntscalar
+   Advance the scalars (T, s, age, sediments) every ntscalar time steps with the
+   time-averaged fluxes over the subcycle.  1 updates them every step.
+*/
+const int ntscalar_DEFAULT = 1;
+
+/* ntcheck
+   Full stability check (NaN/Inf in h, s, u, w and the Courant numbers) every ntcheck
+   time steps and on the progress steps.  The free surface is checked on every step.
+   1 checks everything every step, 0 only on the progress steps.
+*/
+const int ntcheck_DEFAULT = 1;
+
+/* adaptdt, Cadapt, dtmin, dtmax
+   With adaptdt=1 the time step is adjusted every ntcheck steps so that the largest
+   Courant number approaches Cadapt, within dtmin<=dt<=dtmax (dtmax=0 for no upper
+   bound).  dt in suntans.dat is the initial time step and nsteps is still the
+   number of steps taken.  0 keeps dt fixed.
+*/
+const int adaptdt_DEFAULT = 0;
+const REAL Cadapt_DEFAULT = 0.5;
+const REAL dtmin_DEFAULT = 0;
+const REAL dtmax_DEFAULT = 0;
+
+/* eos, eostol, eosSref, eosTref
+   Equation of state used by SetDensity.
+   0: StateEquation in state.c.
+   1: UNESCO EOS-80 with s in psu, T in deg C.
+   2: EOS-80 from a lookup table with interpolation error below eostol (kg m^-3).
+   3: EOS-80 linearized about s=eosSref, T=eosTref.
+*/
+const int eos_DEFAULT = 0;
+const REAL eostol_DEFAULT = 1e-3;
+const REAL eosSref_DEFAULT = 35;
+const REAL eosTref_DEFAULT = 10;
+
 /* 
  *  Heat flux model and meteorological IO netcdf Parameters
  */
@@ -168,6 +236,12 @@ const int ncfilectr_DEFAULT = 0;
 //Light extinction depth [m]
 const REAL Lsw_DEFAULT = 2.0;
 
+//Jerlov water type of the two-band shortwave extinction (0 uses Lsw)
+const int jerlov_DEFAULT = 0;
+
+//Memory layout of the sediment fractions (0 per fraction, 1 per column)
+const int SediLayout_DEFAULT = 0;
+
 //Drag and heat flux coefficients
 const REAL Cda_DEFAULT = 1.1e3;
 const REAL Ch_DEFAULT = 1.4e3;
@@ -189,6 +263,9 @@ const int calcage_DEFAULT = 0;
 // Age calculation method: 1 use river boundaries, 2 - internal source
 const int agemethod_DEFAULT = 1;
 
+// Number of user-defined passive tracers (see tracers.c)
+const int Ntracers_DEFAULT = 0;
+
 // Calculate average quantities
 const int calcaverage_DEFAULT = 0;
 
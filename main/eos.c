@@ -0,0 +1,261 @@
+/*
+ * File: eos.c
+ * --------------------------------
+ * Column-batched equation of state.  SetDensity passes whole columns of
+ * salinity, temperature and pressure to EquationOfState, which evaluates the
+ * density with the method set by eos in suntans.dat:
+ *
+ *   0: StateEquation in state.c, one call per cell (default).
+ *   1: UNESCO EOS-80 (same as unesco-state.c) evaluated over the column.
+ *   2: UNESCO EOS-80 interpolated trilinearly from a table whose spacing is
+ *      chosen so that the interpolation error is below eostol (kg m^-3).
+ *      Values outside of the table are evaluated directly.
+ *   3: UNESCO EOS-80 linearized about (eosSref, eosTref) at the surface,
+ *      with a linear pressure correction.
+ *
+ */
+#include "eos.h"
+#include "state.h"
+#include "memory.h"
+
+// Salinity (psu) and temperature (deg C) ranges of the lookup table
+#define EOSSMIN 0.0
+#define EOSSMAX 42.0
+#define EOSTMIN -2.0
+#define EOSTMAX 40.0
+// Pressure range (dbar) over which the pressure spacing of the table is chosen
+#define EOSPMAX 11000.0
+// Number of samples along the other two dimensions when checking the spacing
+#define EOSSAMPLES 5
+// Largest number of table intervals in one dimension
+#define EOSNMAX 4096
+
+typedef struct _eostableT {
+  int Ns, NT, Np;
+  REAL ds, dT, dp;
+  REAL *sigma;
+} eostableT;
+
+static eostableT *eostable = NULL;
+static REAL eoslin[4];
+
+static inline REAL SWSigma(REAL S, REAL T, REAL P0);
+static int EOSIntervals(int dim, const REAL *lo, const REAL *hi, REAL tol, REAL *err);
+static void EOSTableColumn(REAL *rho, const REAL *s, const REAL *T, const REAL *p, int N);
+
+/*
+ * Function: InitializeEOS
+ * Usage: InitializeEOS(grid,prop,myproc);
+ * ---------------------------------------
+ * For eos=2 the number of table intervals in s, T and p is doubled until the
+ * trilinear interpolation error at the midpoints of the intervals is below
+ * eostol/3 in each direction.  The spacing does not depend on the processor,
+ * so all processors interpolate the same values.  A warning is printed if a
+ * direction reaches EOSNMAX intervals before the error is below eostol/3.  The
+ * pressure extent covers the deepest cell on this processor with a 10% margin.
+ * For eos=3 the reference density and its derivatives are computed at
+ * (eosSref,eosTref).
+ *
+ */
+void InitializeEOS(gridT *grid, propT *prop, int myproc) {
+  int i, is, iT, ip, Nint[3];
+  REAL lo[3] = {EOSSMIN, EOSTMIN, 0}, hi[3] = {EOSSMAX, EOSTMAX, EOSPMAX}, dmax, err;
+
+  if(prop->eos==3) {
+    eoslin[0] = SWSigma(prop->eosSref,prop->eosTref,0);
+    eoslin[1] = SWSigma(prop->eosSref+0.5,prop->eosTref,0)-SWSigma(prop->eosSref-0.5,prop->eosTref,0);
+    eoslin[2] = SWSigma(prop->eosSref,prop->eosTref+0.5,0)-SWSigma(prop->eosSref,prop->eosTref-0.5,0);
+    eoslin[3] = (SWSigma(prop->eosSref,prop->eosTref,100)-eoslin[0])/100;
+  } else if(prop->eos==2) {
+    for(i=0;i<3;i++) {
+      Nint[i] = EOSIntervals(i,lo,hi,prop->eostol/3,&err);
+      if(err>=prop->eostol/3 && myproc==0)
+        printf("Warning in InitializeEOS...%c spacing of the eos table capped at %d intervals (error %.2e > eostol/3=%.2e).\n",
+            "sTp"[i],EOSNMAX,err,prop->eostol/3);
+    }
+
+    dmax=0;
+    for(i=0;i<grid->Nc;i++)
+      if(grid->dv[i]>dmax)
+        dmax=grid->dv[i];
+
+    eostable = (eostableT *)SunMalloc(sizeof(eostableT),"InitializeEOS");
+    eostable->ds = (EOSSMAX-EOSSMIN)/Nint[0];
+    eostable->dT = (EOSTMAX-EOSTMIN)/Nint[1];
+    eostable->dp = EOSPMAX/Nint[2];
+    eostable->Ns = Nint[0]+1;
+    eostable->NT = Nint[1]+1;
+    eostable->Np = (int)ceil(1.1*RHO0*prop->grav*dmax*1e-4/eostable->dp)+2;
+    eostable->sigma = (REAL *)SunMalloc(eostable->Ns*eostable->NT*eostable->Np*sizeof(REAL),
+        "InitializeEOS");
+
+    for(is=0;is<eostable->Ns;is++)
+      for(iT=0;iT<eostable->NT;iT++)
+        for(ip=0;ip<eostable->Np;ip++)
+          eostable->sigma[(is*eostable->NT+iT)*eostable->Np+ip] =
+            SWSigma(EOSSMIN+is*eostable->ds,EOSTMIN+iT*eostable->dT,ip*eostable->dp);
+
+    if(VERBOSE>2)
+      printf("Processor %d: EOS table with %d x %d x %d points (ds=%.3f, dT=%.3f, dp=%.1f dbar).\n",
+          myproc,eostable->Ns,eostable->NT,eostable->Np,eostable->ds,eostable->dT,eostable->dp);
+  }
+}
+
+/*
+ * Function: EquationOfState
+ * Usage: EquationOfState(prop,rho,s,T,p,N);
+ * -----------------------------------------
+ * Returns the density normalized by RHO0 of N cells in rho, where p is the
+ * hydrostatic pressure RHO0*prop->grav*z as in StateEquation.  Apart from
+ * eos=0 the loops contain no function calls so that they can be vectorized.
+ *
+ */
+void EquationOfState(const propT *prop, REAL *rho, const REAL *s, const REAL *T,
+    const REAL *p, int N) {
+  int k;
+
+  switch(prop->eos) {
+    case 1:
+      for(k=0;k<N;k++)
+        rho[k] = SWSigma(s[k],T[k],p[k]*1e-4)/RHO0;
+      break;
+    case 2:
+      EOSTableColumn(rho,s,T,p,N);
+      break;
+    case 3:
+      for(k=0;k<N;k++)
+        rho[k] = (eoslin[0]+eoslin[1]*(s[k]-prop->eosSref)+eoslin[2]*(T[k]-prop->eosTref)
+            +eoslin[3]*p[k]*1e-4)/RHO0;
+      break;
+    default:
+      for(k=0;k<N;k++)
+        rho[k] = StateEquation(prop,s[k],T[k],p[k]);
+      break;
+  }
+}
+
+/*
+ * Function: EOSTableColumn
+ * Usage: EOSTableColumn(rho,s,T,p,N);
+ * -----------------------------------
+ * Trilinear interpolation of the density from the table built by
+ * InitializeEOS.  Values outside of the table are evaluated directly.
+ *
+ */
+static void EOSTableColumn(REAL *rho, const REAL *s, const REAL *T, const REAL *p, int N) {
+  int k, is, iT, ip, NT=eostable->NT, Np=eostable->Np;
+  REAL xs, xT, xp, c00, c01, c10, c11, *c;
+
+  for(k=0;k<N;k++) {
+    xs = (s[k]-EOSSMIN)/eostable->ds;
+    xT = (T[k]-EOSTMIN)/eostable->dT;
+    xp = p[k]*1e-4/eostable->dp;
+    if(xs<0 || xT<0 || xp<0 || xs>=eostable->Ns-1 || xT>=NT-1 || xp>=Np-1) {
+      rho[k] = SWSigma(s[k],T[k],p[k]*1e-4)/RHO0;
+      continue;
+    }
+    is = (int)xs;
+    iT = (int)xT;
+    ip = (int)xp;
+    xs -= is;
+    xT -= iT;
+    xp -= ip;
+
+    // Interpolate in p along the four (s,T) corners, then in T, then in s
+    c = eostable->sigma+(is*NT+iT)*Np+ip;
+    c00 = c[0]+xp*(c[1]-c[0]);
+    c01 = c[Np]+xp*(c[Np+1]-c[Np]);
+    c10 = c[NT*Np]+xp*(c[NT*Np+1]-c[NT*Np]);
+    c11 = c[NT*Np+Np]+xp*(c[NT*Np+Np+1]-c[NT*Np+Np]);
+    c00 += xT*(c01-c00);
+    c10 += xT*(c11-c10);
+    rho[k] = (c00+xs*(c10-c00))/RHO0;
+  }
+}
+
+/*
+ * Function: EOSIntervals
+ * Usage: N = EOSIntervals(dim,lo,hi,tol,&err);
+ * ---------------------------------------
+ * Returns the number of intervals (a power of two) between lo[dim] and hi[dim]
+ * for which linear interpolation in direction dim is within tol of SWSigma
+ * at the midpoints, sampled at EOSSAMPLES points in each of the other two
+ * directions.  N is at most EOSNMAX, and the largest error at N is returned
+ * in err so that the caller can tell when the cap was reached.
+ *
+ */
+static int EOSIntervals(int dim, const REAL *lo, const REAL *hi, REAL tol, REAL *err) {
+  int N, m, a, b, d1=(dim+1)%3, d2=(dim+2)%3;
+  REAL h, f0, f1, fm, x[3];
+
+  for(N=2;;N*=2) {
+    h = (hi[dim]-lo[dim])/N;
+    *err = 0;
+    for(a=0;a<EOSSAMPLES;a++)
+      for(b=0;b<EOSSAMPLES;b++) {
+        x[d1] = lo[d1]+a*(hi[d1]-lo[d1])/(EOSSAMPLES-1);
+        x[d2] = lo[d2]+b*(hi[d2]-lo[d2])/(EOSSAMPLES-1);
+        for(m=0;m<N;m++) {
+          x[dim] = lo[dim]+m*h;
+          f0 = SWSigma(x[0],x[1],x[2]);
+          x[dim] += h;
+          f1 = SWSigma(x[0],x[1],x[2]);
+          x[dim] -= 0.5*h;
+          fm = SWSigma(x[0],x[1],x[2]);
+          if(fabs(fm-0.5*(f0+f1))>*err)
+            *err = fabs(fm-0.5*(f0+f1));
+        }
+      }
+    if(*err<tol || N>=EOSNMAX)
+      break;
+  }
+  return N;
+}
+
+/*
+ * Function: SWSigma
+ * Usage: sigma = SWSigma(S,T,P0);
+ * -------------------------------
+ * Density anomaly (kg m^-3) with respect to 1000 kg m^-3 from the UNESCO 1980
+ * equation of state (Millero et al. 1980) for salinity S (psu), temperature T
+ * (deg C) and pressure P0 (dbar).  This is SWState in unesco-state.c without
+ * the unused specific volume terms.
+ * Check value: SIGMA = 59.82037 kg m^-3 for S=40, T=40, P0=10000.
+ *
+ */
+static inline REAL SWSigma(REAL S, REAL T, REAL P0) {
+  REAL R3500=1028.1063, R4=4.8314E-4, DR350=28.106331, D=1.91075E-4;
+  REAL P, SR, R1, R2, R3, SIG, V350P, SVA, E, BW, B, C, AW, A, B1, A1, KW, K0, DK, K35, GAM, PK;
+
+  P = P0/10.;
+  SR = sqrt(fabs(S));
+
+  // Pure water and one-atmosphere seawater density
+  R1 = ((((6.536332E-9*T-1.120083E-6)*T+1.001685E-4)*T
+	 -9.095290E-3)*T+6.793952E-2)*T-28.263737;
+  R2 = (((5.3875E-9*T-8.2467E-7)*T+7.6438E-5)*T-4.0899E-3)*T+8.24493E-1;
+  R3 = (-1.6546E-6*T+1.0227E-4)*T-5.72466E-3;
+  SIG = (R4*S + R3*SR + R2)*S + R1;
+  V350P = 1.0/R3500;
+  SVA = -SIG*V350P/(R3500+SIG);
+
+  // Compression terms and the secant bulk modulus
+  E = (9.1697E-10*T+2.0816E-8)*T-9.9348E-7;
+  BW = (5.2787E-8*T-6.12293E-6)*T+3.47718E-5;
+  B = BW + E*S;
+  C = (-1.6078E-6*T-1.0981E-5)*T+2.2838E-3;
+  AW = ((-5.77905E-7*T+1.16092E-4)*T+1.43713E-3)*T-0.1194975;
+  A = (D*SR + C)*S + AW;
+  B1 = (-5.3009E-4*T+1.6483E-2)*T+7.944E-2;
+  A1 = ((-6.1670E-5*T+1.09987E-2)*T-0.603459)*T+54.6746;
+  KW = (((-5.155288E-5*T+1.360477E-2)*T-2.327105)*T+148.4206)*T-1930.06;
+  K0 = (B1*SR + A1)*S + KW;
+  DK = (B*P + A)*P + K0;
+  K35  = (5.03217E-5*P+3.359406)*P+21582.27;
+  GAM = P/K35;
+  PK = 1.0 - GAM;
+  SVA = SVA*PK + (V350P+SVA)*P*DK/(K35*(K35+DK));
+  V350P = V350P*PK;
+
+  return DR350 + GAM/V350P - SVA/(V350P*(V350P+SVA));
+}
@@ -0,0 +1,32 @@
+/*
+ * File: eos.h
+ * --------------------------------
+ * Header file for eos.c.
+ *
+ */
+#ifndef _eos_h
+#define _eos_h
+
+#include "grid.h"
+#include "phys.h"
+
+/*
+ * Function: InitializeEOS
+ * Usage: InitializeEOS(grid,prop,myproc);
+ * ---------------------------------------
+ * Builds the lookup table (eos=2) or the linearized coefficients (eos=3).
+ *
+ */
+void InitializeEOS(gridT *grid, propT *prop, int myproc);
+
+/*
+ * Function: EquationOfState
+ * Usage: EquationOfState(prop,rho,s,T,p,N);
+ * -----------------------------------------
+ * Returns the density of N cells in a column in rho from s, T, and p.
+ *
+ */
+void EquationOfState(const propT *prop, REAL *rho, const REAL *s, const REAL *T,
+    const REAL *p, int N);
+
+#endif
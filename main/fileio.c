@@ -302,6 +302,10 @@ double GetDefaultValue(char *str, int *status) {
 
     return fixdzz_DEFAULT;
 
+  } else if(!strcmp(str,"reordergrid")) {
+
+    return reordergrid_DEFAULT;
+
   } else if(!strcmp(str,"TVDsalt")) {
 
     return TVDsalt_DEFAULT;
@@ -314,6 +318,10 @@ double GetDefaultValue(char *str, int *status) {
 
     return TVDturb_DEFAULT;
 
+  } else if(!strcmp(str,"TVDtracers")) {
+
+    return TVDtracers_DEFAULT;
+
   } else if(!strcmp(str,"laxWendroff")) {
 
     return laxWendroff_DEFAULT;
@@ -326,6 +334,14 @@ double GetDefaultValue(char *str, int *status) {
 
     return hprecond_DEFAULT;
 
+  } else if(!strcmp(str,"hfactortol")) {
+
+    return hfactortol_DEFAULT;
+
+  } else if(!strcmp(str,"nprojection")) {
+
+    return nprojection_DEFAULT;
+
   } else if(!strcmp(str,"ntoutStore")) {
 
     return ntoutStore_DEFAULT;
@@ -361,6 +377,50 @@ double GetDefaultValue(char *str, int *status) {
  } else if(!strcmp(str,"computeSediments")) {
 
     return computeSediments_DEFAULT;
+
+ } else if(!strcmp(str,"baroclinic")) {
+
+    return baroclinic_DEFAULT;
+
+ } else if(!strcmp(str,"ntscalar")) {
+
+    return ntscalar_DEFAULT;
+
+ } else if(!strcmp(str,"ntcheck")) {
+
+    return ntcheck_DEFAULT;
+
+ } else if(!strcmp(str,"adaptdt")) {
+
+    return adaptdt_DEFAULT;
+
+ } else if(!strcmp(str,"Cadapt")) {
+
+    return Cadapt_DEFAULT;
+
+ } else if(!strcmp(str,"dtmin")) {
+
+    return dtmin_DEFAULT;
+
+ } else if(!strcmp(str,"dtmax")) {
+
+    return dtmax_DEFAULT;
+
+ } else if(!strcmp(str,"eos")) {
+
+    return eos_DEFAULT;
+
+ } else if(!strcmp(str,"eostol")) {
+
+    return eostol_DEFAULT;
+
+ } else if(!strcmp(str,"eosSref")) {
+
+    return eosSref_DEFAULT;
+
+ } else if(!strcmp(str,"eosTref")) {
+
+    return eosTref_DEFAULT;
   
  } else if(!strcmp(str,"latitude")) {
     
@@ -406,6 +466,14 @@ double GetDefaultValue(char *str, int *status) {
     
    return Lsw_DEFAULT;
  
+} else if(!strcmp(str,"jerlov")) {
+    
+   return jerlov_DEFAULT;
+ 
+} else if(!strcmp(str,"SediLayout")) {
+    
+   return SediLayout_DEFAULT;
+ 
 } else if(!strcmp(str,"Cda")) {
     
    return Cda_DEFAULT;    
@@ -434,6 +502,10 @@ double GetDefaultValue(char *str, int *status) {
     
    return agemethod_DEFAULT;   
 
+} else if(!strcmp(str,"Ntracers")) {
+    
+   return Ntracers_DEFAULT;   
+
 } else if(!strcmp(str,"calcaverage")) {
     
    return calcaverage_DEFAULT;   
@@ -37,14 +37,15 @@ const int g_halolistsize = 1;
 static void VertGrid(gridT *maingrid, gridT **localgrid, MPI_Comm comm);
 static void Topology(gridT **maingrid, gridT **localgrid, int myproc, int numprocs);
 static int GetNumCells(gridT *grid, int proc);
-static void TransferData(gridT *maingrid, gridT **localgrid, int myproc);
+static void TransferData(gridT *maingrid, gridT **localgrid, int *order, int myproc);
 static int GetNumEdges(gridT *grid);
 static int GetNumPoints(gridT *localgrid, gridT *maingrid);
 static void GetProcPoints(gridT *localgrid, gridT *maingrid);
 static void Geometry(gridT *maingrid, gridT **grid, int myproc);
 static REAL GetCircumcircleRadius(REAL *xt, REAL *yt, int Nf);
 static void EdgeMarkers(gridT *maingrid, gridT **localgrid, int myproc);
-static void ReOrder(gridT *grid);
+static void ReOrder(gridT *grid, int *order);
+static int PeripheralCell(gridT *grid, int start, int *level, int *queue);
 static int IsCellNeighborProc(int nc, gridT *maingrid, gridT *localgrid, 
     int myproc, int neighproc);
 static int IsEdgeNeighborProc(int ne, gridT *maingrid, gridT *localgrid, 
@@ -230,7 +231,7 @@ void GetGrid(gridT **localgrid, int myproc, int numprocs, MPI_Comm comm)
  */
 void Partition(gridT *maingrid, gridT **localgrid, MPI_Comm comm)
 {
-  int j;
+  int j, *order;
   int myproc, numprocs;
 
   // allocate memory for the local grid structures
@@ -290,11 +291,27 @@ void Partition(gridT *maingrid, gridT **localgrid, MPI_Comm comm)
   if(myproc==0 && VERBOSE>1) printf("\tComputing Topology...\n");
   Topology(&maingrid,localgrid,myproc,numprocs);
 
+  // order in which the main grid cells are numbered on the local grids.  With
+  // reordergrid=1 this is a reverse Cuthill-McKee ordering of the cell graph so
+  // that neighboring cells (and hence their faces) are close in memory.
+  order = (int *)SunMalloc(maingrid->Nc*sizeof(int),"Partition");
+  if((int)MPI_GetValue(DATAFILE,"reordergrid","Partition",myproc)) {
+    if(myproc==0 && VERBOSE>1) printf("\tReordering...\n");
+    ReOrder(maingrid,order);
+  } else
+    for(j=0;j<maingrid->Nc;j++)
+      order[j]=j;
+
+  // the cell graph is owned by maingrid and is no longer needed
+  SunFree(maingrid->adjncy,2*maingrid->Nge*sizeof(int),"Partition");
+  maingrid->adjncy=NULL;
+
   if(myproc==0 && VERBOSE>1) printf("\tTransferring data...\n");
   // function to move data between main and local grid where boundary points were
   // defined with convention of shared edge with number and list of neighbors 
   // described in Topology
-  TransferData(maingrid,localgrid,myproc);
+  TransferData(maingrid,localgrid,order,myproc);
+  SunFree(order,maingrid->Nc*sizeof(int),"Partition");
 
   if(myproc==0 && VERBOSE>1) printf("\tCreating edge markers...\n");
   // get edge marker information where we designate mark=5 and mark=6 for interproc
@@ -311,11 +328,6 @@ void Partition(gridT *maingrid, gridT **localgrid, MPI_Comm comm)
     printf("\tComputing edge and voronoi distances and areas...\n");
   Geometry(maingrid,localgrid,myproc);
 
-  //if(myproc==0 && VERBOSE>2) printf("\tReordering...\n");
-  // function to reorder the grid for increased computational efficiency, this 
-  // is not currently known to work
-  //  ReOrder(*localgrid);
-
   if(myproc==0 && VERBOSE>1) printf("\tMaking pointers...\n");
   // compute cellp, edgep, lcptr, leptrs and also get the reference for local cell processor
   // interprocessor send-receives
@@ -1929,133 +1941,116 @@ static void MakePointers(gridT *maingrid, gridT **localgrid, int myproc, MPI_Com
 
 /*
  * Function: ReOrder
- * Usage:  ReOrder(grid)
- * -------------------------
- * Functon to reorder grid 
+ * Usage:  ReOrder(maingrid,order);
+ * --------------------------------
+ * Compute a reverse Cuthill-McKee ordering of the cells in the main grid from
+ * its cell graph (xadj/adjncy) and place it in order, so that order[n] is the
+ * main grid cell that is numbered n-th.  TransferData numbers the local cells in
+ * this order and the local edges in the order they are first met on those cells,
+ * so that the face, neigh and grad stencils of neighboring cells and edges are
+ * close together in memory.  Each connected component is started from a
+ * pseudo-peripheral cell and neighbors are visited in increasing degree.
+ *
  */
-static void ReOrder(gridT *grid) 
+static void ReOrder(gridT *grid, int *order) 
 {
-  int n, nf, numflag, options[8], Nc = grid->Nc, Ne=grid->Ne, grad1, grad2, enei;
-  int *corder, *corderp, *eorder, *eorderp;
-  REAL *tmp;
+  int i, j, k, n, nn, m, head, root, start, Nc=grid->Nc, *level, *queue;
 
-  corder = (int *)SunMalloc(Nc*sizeof(int),"ReOrder");
-  corderp = (int *)SunMalloc(Nc*sizeof(int),"ReOrder");
-  eorder = (int *)SunMalloc(Ne*sizeof(int),"ReOrder");
-  eorderp = (int *)SunMalloc(Ne*sizeof(int),"ReOrder");
-  tmp = (REAL *)SunMalloc(2*(grid->maxfaces-1)*Ne*sizeof(REAL),"ReOrder");
+  level = (int *)SunMalloc(Nc*sizeof(int),"ReOrder");
+  queue = (int *)SunMalloc(Nc*sizeof(int),"ReOrder");
+  for(n=0;n<Nc;n++)
+    level[n]=-1;
 
-  for(n=0;n<Nc;n++) {
-    corder[n]=n;
-    corderp[n]=n;
-  }
-  for(n=0;n<Ne;n++) {
-    eorder[n]=n;
-    eorderp[n]=n;
+  // level doubles as the visited flag for the Cuthill-McKee sweep
+  k=0;
+  for(start=0;start<Nc;start++) {
+    if(level[start]>=0)
+      continue;
+
+    root=PeripheralCell(grid,start,level,queue);
+
+    head=k;
+    order[k++]=root;
+    level[root]=0;
+    while(head<k) {
+      n=order[head++];
+      m=k;
+      for(j=grid->xadj[n];j<grid->xadj[n+1];j++) {
+        nn=grid->adjncy[j];
+        if(level[nn]<0) {
+          level[nn]=0;
+          order[k++]=nn;
+        }
+      }
+      // at most maxfaces new cells, so insertion sort them by degree
+      for(i=m+1;i<k;i++) {
+        nn=order[i];
+        for(j=i;j>m && grid->xadj[order[j-1]+1]-grid->xadj[order[j-1]]>
+              grid->xadj[nn+1]-grid->xadj[nn];j--)
+          order[j]=order[j-1];
+        order[j]=nn;
+      }
+    }
   }
 
-  numflag=0;
-  options[0]=0;
-
-  /*
-  grid->xadj = (int *)SunMalloc((Nc+1)*sizeof(int),"ReOrder");
-  CreateCellGraph(grid);
-  METIS_NodeND(&Nc,grid->xadj,grid->adjncy,&numflag,options,corder,corderp);
-  free(grid->xadj);
-  free(grid->adjncy);
-  */
-
-  /*
-  grid->xadj = (int *)SunMalloc((Ne+1)*sizeof(int),"ReOrder");
-  CreateEdgeGraph(grid);
-  METIS_NodeND(&Ne,grid->xadj,grid->adjncy,&numflag,options,eorder,eorderp);
-  free(grid->xadj);
-  free(grid->adjncy);
-  */
+  // reverse it
+  for(n=0;n<Nc/2;n++) {
+    i=order[n];
+    order[n]=order[Nc-1-n];
+    order[Nc-1-n]=i;
+  }
 
-  // Reorder the data corresponding to cells with the corder array
-  ReOrderRealArray(grid->Ac,corder,tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->xv,corder,tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->yv,corder,tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->dv,corder,tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->cells,corder,(int *)tmp,grid->Nc,grid->maxfaces,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->face,corder,(int *)tmp,grid->Nc,grid->maxfaces,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->normal,corder,(int *)tmp,grid->Nc,grid->maxfaces,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->neigh,corder,(int *)tmp,grid->Nc,grid->maxfaces,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->vwgt,corder,(int *)tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->mnptr,corder,(int *)tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->Nk,corder,(int *)tmp,grid->Nc,1,grid->nfaces,grid->grad,grid->maxfaces);
-
-  //Reorder the data corresponding to edges with the eorder array
-  ReOrderRealArray(grid->df,eorder,tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->dg,eorder,tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->n1,eorder,tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->n2,eorder,tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderRealArray(grid->xi,eorder,tmp,grid->Ne,2*(grid->maxfaces-1),grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->grad,eorder,(int *)tmp,grid->Ne,2,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->eneigh,eorder,(int *)tmp,grid->Ne,2*(grid->maxfaces-1),grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->edges,eorder,(int *)tmp,grid->Ne,NUMEDGECOLUMNS,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->mark,eorder,(int *)tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->edge_id,eorder,(int *)tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->eptr,eorder,(int *)tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->Nke,eorder,(int *)tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-  ReOrderIntArray(grid->Nkc,eorder,(int *)tmp,grid->Ne,1,grid->nfaces,grid->grad,grid->maxfaces);
-
-  // Now adjust the pointers to point to the new locations
-  // Face and eneigh arrays point to edges.  We need to use the createfacearray
-  // again because it guarantees consistency for the CG solver.  This is
-  // because reordering does not necessarily guarantee that the ordering of
-  // the faces in the face array are in the same as the corresponding neighbors
-  // in the neigh array.
-  for(n=0;n<Nc;n++) 
-    for(nf=0;nf<grid->nfaces[n];nf++) 
-      tmp[n*grid->maxfaces+nf]=grid->face[n*grid->maxfaces+nf];
-  for(n=0;n<Nc;n++) 
-    for(nf=0;nf<grid->nfaces[n];nf++) 
-      grid->face[n*grid->maxfaces+nf]=eorderp[(int)(tmp[n*grid->maxfaces+nf])];
+  SunFree(level,Nc*sizeof(int),"ReOrder");
+  SunFree(queue,Nc*sizeof(int),"ReOrder");
+}
 
-  for(n=0;n<Ne;n++)
-    grad1=grid->grad[2*n];
-    grad2=grid->grad[2*n+1];
-    enei=grad1+grad2-2;
-    for(nf=0;nf<enei;nf++) 
-      tmp[2*(grid->maxfaces-1)*n+nf]=grid->eneigh[2*(grid->maxfaces-1)*n+nf];
-  for(n=0;n<Ne;n++)
-    grad1=grid->grad[2*n];
-    grad2=grid->grad[2*n+1];
-    enei=grad1+grad2-2;
-    for(nf=0;nf<enei;nf++)
-      if((int)(tmp[n*2*(grid->maxfaces-1)+nf])!=-1)
-	grid->eneigh[n*2*(grid->maxfaces-1)+nf]=eorderp[(int)(tmp[n*2*(grid->maxfaces-1)+nf])];
-      else
-	grid->eneigh[n*2*(grid->maxfaces-1)+nf]=-1;
+/*
+ * Function: PeripheralCell
+ * Usage: root = PeripheralCell(grid,start,level,queue);
+ * -----------------------------------------------------
+ * Return a pseudo-peripheral cell in the connected component containing start
+ * by repeated breadth-first searches, each started from the lowest-degree cell
+ * in the last level of the previous one, until the number of levels stops
+ * growing.  level must be -1 on the component and is left that way; queue is
+ * workspace of size Nc.
+ *
+ */
+static int PeripheralCell(gridT *grid, int start, int *level, int *queue) {
+  int j, n, nn, head, tail, first, root=start, nlevels=-1, maxlevel, iter;
+
+  for(iter=0;iter<8;iter++) {
+    head=0;
+    tail=0;
+    queue[tail++]=root;
+    level[root]=0;
+    while(head<tail) {
+      n=queue[head++];
+      for(j=grid->xadj[n];j<grid->xadj[n+1];j++) {
+        nn=grid->adjncy[j];
+        if(level[nn]<0) {
+          level[nn]=level[n]+1;
+          queue[tail++]=nn;
+        }
+      }
+    }
+    maxlevel=level[queue[tail-1]];
 
-  // Grad and neigh arrays point to cells
-  for(n=0;n<Ne;n++)
-    for(nf=0;nf<2;nf++)
-      tmp[2*n+nf]=grid->grad[2*n+nf];
-  for(n=0;n<Ne;n++)
-    for(nf=0;nf<2;nf++)
-      if((int)(tmp[2*n+nf])!=-1)
-	grid->grad[2*n+nf]=corderp[(int)(tmp[2*n+nf])];
-      else
-	grid->grad[2*n+nf]=-1;
+    // lowest-degree cell in the last level
+    for(first=tail-1;first>0 && level[queue[first-1]]==maxlevel;first--);
+    n=queue[first];
+    for(j=first+1;j<tail;j++)
+      if(grid->xadj[queue[j]+1]-grid->xadj[queue[j]]<grid->xadj[n+1]-grid->xadj[n])
+        n=queue[j];
 
-  for(n=0;n<Nc;n++)
-    for(nf=0;nf<grid->nfaces[n];nf++)
-      tmp[n*grid->maxfaces+nf]=grid->neigh[n*grid->maxfaces+nf];
-  for(n=0;n<Nc;n++)
-    for(nf=0;nf<grid->nfaces[n];nf++)
-      if((int)(tmp[n*grid->maxfaces+nf])!=-1)
-	grid->neigh[n*grid->maxfaces+nf]=corderp[(int)(tmp[n*grid->maxfaces+nf])];
-      else
-  	grid->neigh[n*grid->maxfaces+nf]=-1;
+    for(j=0;j<tail;j++)
+      level[queue[j]]=-1;
 
-  free(corder);
-  free(corderp);
-  free(eorder);
-  free(eorderp);
-  free(tmp);
+    if(maxlevel<=nlevels)
+      break;
+    nlevels=maxlevel;
+    root=n;
+  }
+  return root;
 }
 
 /*
@@ -2635,14 +2630,15 @@ static void  BoundaryTopologyByNode(int cellbase, int cell, gridT *maingrid,
 
 /*
  * Function: TransferData
- * Usage: TransferData(maingrid,localgrid,myproc);
- * -----------------------------------------------
+ * Usage: TransferData(maingrid,localgrid,order,myproc);
+ * -----------------------------------------------------
  *
  * This function transfers cell data from the main grid onto the local 
  * grid and creates the global pointer that allows the identification of
  * the global cell index given a local index.  Because the main grid 
  * is stored on every processor, no communcation is needed. The computational
- * cells are printed first, followed by the boundary cells.
+ * cells are printed first, followed by the boundary cells.  Within each
+ * type the main grid cells are taken in the sequence given by order (see ReOrder).
  *
  * If only edge neighbors are considered:
  * The local grid will have new ghost cells due to the cut edges.
@@ -2667,10 +2663,10 @@ static void  BoundaryTopologyByNode(int cellbase, int cell, gridT *maingrid,
 // as these are loaded in ReadData and stored with node data, so the global
 // index is no longer needed and a local index will suffice.  Since it is only
 // used in nodal calculations it should be easily changed.
-static void TransferData(gridT *maingrid, gridT **localgrid, int myproc)
+static void TransferData(gridT *maingrid, gridT **localgrid, int *order, int myproc)
 {
   // allocate memory for all referential pointers and localgrid memory
-  int i, j, k, n, nc, nf, ne, ng, flag, mgptr, *lcptr, *leptr, bctype, iface, grad1, grad2, enei;
+  int i, j, jj, k, n, nc, nf, ne, ng, flag, mgptr, *lcptr, *leptr, bctype, iface, grad1, grad2, enei;
   unsigned short *flagged = 
     (unsigned short *)SunMalloc(maingrid->Ne*sizeof(unsigned short),"TransferData");
 
@@ -2730,7 +2726,8 @@ static void TransferData(gridT *maingrid, gridT **localgrid, int myproc)
   // (Spell out in line IsBoundaryCell...)
   for(bctype=0;bctype<MAXBCTYPES;bctype++) {
     // loop over all the main grid cells
-    for(j=0;j<maingrid->Nc;j++) {
+    for(jj=0;jj<maingrid->Nc;jj++) {
+      j=order[jj];
       // check to see if the cell on the main grid and processor has
       // a consistent boundary condition type (cell BC like type 3,
       // not edge like type 2 or 4)
@@ -8,7 +8,9 @@
  * program with the global variable TotSpace, which contains the
  * total space used in bytes.  If the global varialbe VerboseMemory
  * is set to 1, then memory statistics will be printed as memory
- * is allocated and freed.
+ * is allocated and freed.  The memory is also counted by subsystem
+ * in TagSpace, and the high-water marks are kept in PeakSpace and TagPeak.
+ * All counters are 64-bit.
  *
  * Copyright (C) 2005-2006 The Board of Trustees of the Leland Stanford Junior 
  * University. All Rights Reserved.
@@ -20,30 +22,62 @@
 #include<string.h>
 #include "mympi.h"
 
+static int MemoryTag(const char *file);
+
+/*
+ * Source files whose allocations are counted in each subsystem.  Files that
+ * are not listed are counted in MEMOTHER.
+ *
+ */
+static const char *memtagnames[MEMTAGS] = {
+  "grid", "phys", "met", "boundary", "average", "merge", "sediment", "other"
+};
+static const char *memtagfiles[MEMTAGS] = {
+  "grid.c gridio.c partition.c triangulate.c sendrecv.c",
+  "phys.c physio.c turbulence.c eos.c scalars.c age.c tracers.c sources.c initialization.c",
+  "met.c kriging.c",
+  "boundaries.c tides.c",
+  "averages.c",
+  "merge.c",
+  "sediments.c",
+  ""
+};
+
 /*
  * Function: SunMalloc
  * Usage: ptr=(int *)SunMalloc(N*sizeof(int),"Function");
  * ------------------------------------------------------
  * Same as the malloc function in stdlib.h, but this
  * one keeps track of the total memory with the global
- * variable TotSpace.
+ * variable TotSpace, of the memory of the subsystem
+ * of the calling file in TagSpace, and of their high-water
+ * marks in PeakSpace and TagPeak.  SunMalloc is a macro
+ * that passes __FILE__ to SunMallocTagged.
  *
  */
-void *SunMalloc(const unsigned bytes, const char *function) {
+void *SunMallocTagged(const size_t bytes, const char *function, const char *file) {
+  int tag;
   void *ptr = malloc(bytes);
 
     //VerboseMemory=1;
 
   if(ptr==NULL) {
     printf("Error.  Out of memory!\n");
-    printf("Total memory: %u, attempted to allocate: %u in function %s\n",
-	   TotSpace,bytes,function);
+    printf("Total memory: %llu, attempted to allocate: %llu in function %s\n",
+	   TotSpace,(unsigned long long)bytes,function);
     exit(1);
   } else {
+    tag=MemoryTag(file);
     TotSpace+=bytes;
+    TagSpace[tag]+=bytes;
+    if(TotSpace>PeakSpace)
+      PeakSpace=TotSpace;
+    if(TagSpace[tag]>TagPeak[tag])
+      TagPeak[tag]=TagSpace[tag];
     if(VerboseMemory) {
       if(strcmp(function,oldAllocFunction)) 
-	printf("Allocated %u, Total: %u (%s)\n",bytes,TotSpace,function);
+	printf("Allocated %llu, Total: %llu (%s, %s)\n",(unsigned long long)bytes,TotSpace,
+	       function,memtagnames[tag]);
       strcpy(oldAllocFunction,function);
     }
     return ptr;
@@ -56,10 +90,15 @@ void *SunMalloc(const unsigned bytes, const char *function) {
  * ------------------------------------------
  * Same as the free function in stdlib.h, but this
  * one keeps track of the total memory with the global
- * variable TotSpace.
+ * variable TotSpace and of the memory of the subsystem
+ * of the calling file in TagSpace.  Memory that is freed
+ * from a different subsystem than the one that allocated it
+ * is taken from the subsystem of the caller down to zero.
  *
  */
-void SunFree(void *ptr, const unsigned bytes, const char *function) {
+void SunFreeTagged(void *ptr, const size_t bytes, const char *function, const char *file) {
+  int tag;
+
   if(ptr==NULL) {
     printf("Error!  Attempting to free a NULL pointer in funciton %s\n",function);
 
@@ -68,17 +107,91 @@ void SunFree(void *ptr, const unsigned bytes, const char *function) {
   } else {
     free(ptr);
     if(bytes<=TotSpace) {
+      tag=MemoryTag(file);
       TotSpace-=bytes;
+      TagSpace[tag]-=(bytes<=TagSpace[tag])?bytes:TagSpace[tag];
       if(VerboseMemory && strcmp(function,oldFreeFunction))
-	printf("Freed %u, Total: %u (%s)\n",
-	       bytes,TotSpace,function);
+	printf("Freed %llu, Total: %llu (%s, %s)\n",
+	       (unsigned long long)bytes,TotSpace,function,memtagnames[tag]);
       strcpy(oldFreeFunction,function);
     } else {
-      printf("Error! Attempting to free %d bytes when only %d have been allocated (%s)!\n",
-      	     bytes,TotSpace,function);
+      printf("Error! Attempting to free %llu bytes when only %llu have been allocated (%s)!\n",
+      	     (unsigned long long)bytes,TotSpace,function);
 
       MPI_Finalize();
       exit(EXIT_FAILURE);
     }
   }
 }
+
+/*
+ * Function: SunMalloc
+ * Usage: ptr=(int *)(SunMalloc)(N*sizeof(int),"Function");
+ * --------------------------------------------------------
+ * Function version of the SunMalloc macro for code that does not include
+ * memory.h.  The memory is counted in MEMOTHER.
+ *
+ */
+void *(SunMalloc)(const size_t bytes, const char *function) {
+  return SunMallocTagged(bytes,function,NULL);
+}
+
+/*
+ * Function: SunFree
+ * Usage: (SunFree)(ptr,bytes,"Function");
+ * ---------------------------------------
+ * Function version of the SunFree macro for code that does not include
+ * memory.h.
+ *
+ */
+void (SunFree)(void *ptr, const size_t bytes, const char *function) {
+  SunFreeTagged(ptr,bytes,function,NULL);
+}
+
+/*
+ * Function: MemoryTagName
+ * Usage: printf("%s",MemoryTagName(tag));
+ * ---------------------------------------
+ * Returns the name of the subsystem with the given memory tag.
+ *
+ */
+const char *MemoryTagName(int tag) {
+  return memtagnames[(tag>=0 && tag<MEMTAGS)?tag:MEMOTHER];
+}
+
+/*
+ * Function: MemoryTag
+ * Usage: tag = MemoryTag(__FILE__);
+ * ---------------------------------
+ * Returns the subsystem of the source file by looking up its name without
+ * the directory in memtagfiles.  The tag of the last file is cached since
+ * consecutive calls usually come from the same file.
+ *
+ */
+static int MemoryTag(const char *file) {
+  static const char *lastfile=NULL;
+  static int lasttag=MEMOTHER;
+  int tag;
+  size_t len;
+  const char *name, *p;
+
+  if(file==NULL)
+    return MEMOTHER;
+  if(file==lastfile)
+    return lasttag;
+
+  name = strrchr(file,'/');
+  name = name ? name+1 : file;
+  len = strlen(name);
+
+  lasttag=MEMOTHER;
+  for(tag=0;tag<MEMOTHER && lasttag==MEMOTHER;tag++)
+    for(p=strstr(memtagfiles[tag],name);p!=NULL;p=strstr(p+1,name))
+      if((p==memtagfiles[tag] || p[-1]==' ') && (p[len]==' ' || p[len]=='\0')) {
+        lasttag=tag;
+        break;
+      }
+  lastfile=file;
+
+  return lasttag;
+}
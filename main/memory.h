@@ -12,9 +12,21 @@
 #ifndef _memory_h
 #define _memory_h
 
+#include <stddef.h>
 #include "suntans.h"
 
-unsigned TotSpace;
+/*
+ * Memory is accounted for by subsystem with a tag that is chosen from the name
+ * of the source file that calls SunMalloc or SunFree (see MemoryTag in memory.c).
+ *
+ */
+enum memtagT {
+  MEMGRID, MEMPHYS, MEMMET, MEMBOUNDARY, MEMAVERAGE, MEMMERGE, MEMSEDIMENT, MEMOTHER,
+  MEMTAGS
+};
+
+unsigned long long TotSpace, PeakSpace;
+unsigned long long TagSpace[MEMTAGS], TagPeak[MEMTAGS];
 int VerboseMemory;
 char oldAllocFunction[BUFFERLENGTH], oldFreeFunction[BUFFERLENGTH];
 
@@ -24,10 +36,16 @@ char oldAllocFunction[BUFFERLENGTH], oldFreeFunction[BUFFERLENGTH];
  * ------------------------------------------------------
  * Same as the malloc function in stdlib.h, but this
  * one keeps track of the total memory with the global
- * variable TotSpace.
+ * variable TotSpace, of the memory of the subsystem
+ * of the calling file in TagSpace, and of their high-water
+ * marks in PeakSpace and TagPeak.  Code that does not
+ * include this file calls the function SunMalloc, which
+ * counts the memory in MEMOTHER.
  *
  */
-void *SunMalloc(const unsigned bytes, const char *function);
+void *(SunMalloc)(const size_t bytes, const char *function);
+#define SunMalloc(bytes,function) SunMallocTagged((bytes),(function),__FILE__)
+void *SunMallocTagged(const size_t bytes, const char *function, const char *file);
 
 /*
  * Function: SunFree
@@ -35,9 +53,21 @@ void *SunMalloc(const unsigned bytes, const char *function);
  * ------------------------------------------
  * Same as the free function in stdlib.h, but this
  * one keeps track of the total memory with the global
- * variable TotSpace.
+ * variable TotSpace and of the memory of the subsystem
+ * of the calling file in TagSpace.
+ *
+ */
+void (SunFree)(void *ptr, const size_t bytes, const char *function);
+#define SunFree(ptr,bytes,function) SunFreeTagged((ptr),(bytes),(function),__FILE__)
+void SunFreeTagged(void *ptr, const size_t bytes, const char *function, const char *file);
+
+/*
+ * Function: MemoryTagName
+ * Usage: printf("%s",MemoryTagName(tag));
+ * ---------------------------------------
+ * Returns the name of the subsystem with the given memory tag.
  *
  */
-void SunFree(void *ptr, const unsigned bytes, const char *function);
+const char *MemoryTagName(int tag);
 
 #endif
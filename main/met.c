@@ -20,9 +20,14 @@ static REAL satvap(REAL Ta, REAL Pair);
 static REAL vappres(REAL Ta, REAL RH, REAL Pair);
 static REAL longwave_berliand(REAL Ta, REAL Tw, REAL C_cloud, REAL RH, REAL Pair);
 static REAL longwave(REAL Ta, REAL Tw, REAL C_cloud);
-static void cor30a(REAL *y);
-static REAL psiu_30(REAL zet);
-static REAL psit_30(REAL zet);
+static void COAREFluxes(metT *met, int N, const int *cell);
+static inline REAL psiu_30(REAL zet);
+static inline REAL psit_30(REAL zet);
+
+// Relative change in the friction and gustiness velocities at which the
+// COARE3.0 iteration of a cell stops, and the largest number of iterations
+#define COARETOL 1e-4
+#define COAREMAXITS 3
 
 /* Start of functions */
 
@@ -94,20 +99,22 @@ void InitialiseMetFields(propT *prop, gridT *grid, metinT *metin, metT *met, int
 */
 void updateMetData(propT *prop, gridT *grid, metinT *metin, metT *met, int myproc, MPI_Comm comm){
   
-  int j,i,iptr, t0, t1, t2; 
-  REAL dt, r1, r2;
+  int t0, t1, t2; 
+  REAL *w;
    
-  t1 = getTimeRec(prop->nctime,metin->time,metin->nt);
+  // Last record preceding nctime (same convention as getTimeRec)
+  t1 = TimeCursorSearch(&(metin->cursor),prop->nctime,metin->time,(int)metin->nt);
+  if(t1<metin->nt) t1--;
     
     /* Only interpolate the data onto the grid if need to*/
     if (metin->t1!=t1){
       if(VERBOSE>3 && myproc==0) printf("Updating netcdf variable at nc timestep: %d\n",t1);
-      /* Read in the data two time steps*/
-      ReadMetNC(prop, grid, metin, myproc);
-
       metin->t1=t1;
       metin->t0=t1-1;
       metin->t2=t1+1;
+
+      /* Read in the data two time steps*/
+      ReadMetNC(prop, grid, metin, myproc);
       
       /* Interpolate the two time steps onto the grid*/
       weightInterpArray(metin->Uwind, metin->WUwind, grid,
@@ -126,49 +133,26 @@ void updateMetData(propT *prop, gridT *grid, metinT *metin, metT *met, int mypro
 	  metin->max_nearest_cloud, metin->nearest_cloud, NTmet, met->cloud_t);
     }
     
-    /* Do a linear temporal interpolation */
-    //dt = metin->time[metin->t1]-metin->time[metin->t0];
-    //r2 = (prop->nctime - metin->time[metin->t0])/dt;
-    //r1 = 1.0-r2;
-    
     t0=metin->t0;
     t1=metin->t1;
     t2=metin->t2;
-     //printf("tmod = %f, tlow = %f (r1=%f), thigh = %f (r2=%f)\n",prop->nctime, metin->time[metin->t0],r1,metin->time[metin->t1],r2);
-    
-//    for (j=0;j<grid->Nc;j++){
- for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
-    i = grid->cellp[iptr];  
-    /*
-      met->Uwind[j] = met->Uwind_t[0][j]*r1 + met->Uwind_t[1][j]*r2;
-      met->Vwind[j] = met->Vwind_t[0][j]*r1 + met->Vwind_t[1][j]*r2;
-      met->Tair[j] = met->Tair_t[0][j]*r1 + met->Tair_t[1][j]*r2;
-      met->Pair[j] = met->Pair_t[0][j]*r1 + met->Pair_t[1][j]*r2;
-      met->rain[j] = met->rain_t[0][j]*r1 + met->rain_t[1][j]*r2;
-      met->RH[j] = met->RH_t[0][j]*r1 + met->RH_t[1][j]*r2;
-      met->cloud[j] = met->cloud_t[0][j]*r1 + met->cloud_t[1][j]*r2;
-    */
-       //Quadratic temporal interpolation
-       met->Uwind[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->Uwind_t[0][i],met->Uwind_t[1][i],met->Uwind_t[2][i]);
-       met->Vwind[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->Vwind_t[0][i],met->Vwind_t[1][i],met->Vwind_t[2][i]);
-       met->Tair[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->Tair_t[0][i],met->Tair_t[1][i],met->Tair_t[2][i]);
-       met->Pair[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->Pair_t[0][i],met->Pair_t[1][i],met->Pair_t[2][i]);
-       met->rain[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->rain_t[0][i],met->rain_t[1][i],met->rain_t[2][i]);
-       met->RH[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->RH_t[0][i],met->RH_t[1][i],met->RH_t[2][i]);
-       met->cloud[i] = QuadInterp(prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2],met->cloud_t[0][i],met->cloud_t[1][i],met->cloud_t[2][i]);
-
-      /* Place bounds on rain, humidity and cloud variables */
-       if (met->cloud[i]<0.0) 
-	 met->cloud[i]=0.0;
-       if (met->cloud[i]>1.0)
-	 met->cloud[i]=1.0;
-       if (met->rain[i]<0.0) 
-	 met->rain[i]=0.0;
-       if (met->RH[i]<0.0)
-	 met->RH[i]=0.0;
-       if (met->RH[i]>100.0)
-	 met->RH[i]=100.0;
-    }
+
+    // The quadratic interpolation weights are the same for every cell so
+    // interpolate each field over the whole (contiguous) array at once.
+    // Cells that are not computational cells have zero forcing records and
+    // the ghost cells are overwritten by the communication below.
+    TimeCursorWeights(&(metin->cursor),prop->nctime,metin->time[t0],metin->time[t1],metin->time[t2]);
+    w = metin->cursor.w;
+
+    TimeInterp(met->Uwind,met->Uwind_t[0],met->Uwind_t[1],met->Uwind_t[2],w,grid->Nc,-INFTY,INFTY);
+    TimeInterp(met->Vwind,met->Vwind_t[0],met->Vwind_t[1],met->Vwind_t[2],w,grid->Nc,-INFTY,INFTY);
+    TimeInterp(met->Tair,met->Tair_t[0],met->Tair_t[1],met->Tair_t[2],w,grid->Nc,-INFTY,INFTY);
+    TimeInterp(met->Pair,met->Pair_t[0],met->Pair_t[1],met->Pair_t[2],w,grid->Nc,-INFTY,INFTY);
+
+    /* Place bounds on rain, humidity and cloud variables */
+    TimeInterp(met->rain,met->rain_t[0],met->rain_t[1],met->rain_t[2],w,grid->Nc,0.0,INFTY);
+    TimeInterp(met->RH,met->RH_t[0],met->RH_t[1],met->RH_t[2],w,grid->Nc,0.0,100.0);
+    TimeInterp(met->cloud,met->cloud_t[0],met->cloud_t[1],met->cloud_t[2],w,grid->Nc,0.0,1.0);
 
     //Communicate the arrays
     ISendRecvCellData2D(met->Uwind,grid,myproc,comm);
@@ -187,7 +171,7 @@ void updateMetData(propT *prop, gridT *grid, metinT *metin, metT *met, int mypro
 *
 */
 void AllocateMet(propT *prop, gridT *grid, metT **met , int myproc){
-  int j, k, n;
+  int k, n;
   int Nc = grid->Nc;
   
   if(VERBOSE>3 && myproc==0) printf("Allocating met structure...\n");
@@ -217,7 +201,11 @@ void AllocateMet(propT *prop, gridT *grid, metT **met , int myproc){
   (*met)->qstar = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateMet");
   (*met)->EP = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateMet");
   (*met)->Htmp = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateMet");
-  (*met)->xtmp = (REAL *)SunMalloc(19*sizeof(REAL),"AllocateMet"); 
+  (*met)->ugust = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateMet");
+  (*met)->coare = (REAL **)SunMalloc(NCOAREWORK*sizeof(REAL *),"AllocateMet");
+  for(n=0;n<NCOAREWORK;n++)
+    (*met)->coare[n] = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocateMet");
+  (*met)->coareactive = (int *)SunMalloc(Nc*sizeof(int),"AllocateMet");
 
   (*met)->Uwind_t = (REAL **)SunMalloc(NTmet*sizeof(REAL *),"AllocateMet");
   (*met)->Vwind_t = (REAL **)SunMalloc(NTmet*sizeof(REAL *),"AllocateMet");
@@ -261,6 +249,7 @@ void AllocateMet(propT *prop, gridT *grid, metT **met , int myproc){
       (*met)->qstar[k] = 0.0;
       (*met)->EP[k] = 0.0;
       (*met)->Htmp[k] = 0.0;
+      (*met)->ugust[k] = 0.0;
       
       for(n=0;n<NTmet;n++){
 	  (*met)->Uwind_t[n][k] = 0.0;
@@ -272,9 +261,6 @@ void AllocateMet(propT *prop, gridT *grid, metT **met , int myproc){
 	  (*met)->cloud_t[n][k] = 0.0;
       }  
   }
-  for(j=0;j<19;j++){
-    (*met)->xtmp[j]=0.0;
-  }
 } // End of function
   
 /*
@@ -312,6 +298,7 @@ void AllocateMetIn(propT *prop, gridT *grid, metinT **metin, int myproc){
   (*metin)->t0 = -1;
   (*metin)->t1 = -1;
   (*metin)->t2 = -1;
+  InitTimeCursor(&((*metin)->cursor));
  
   
   NUwind = (*metin)->NUwind;
@@ -730,12 +717,16 @@ void FindNearestMetStations(propT *prop, gridT *grid, metinT **metin, int myproc
 * Computed terms are stored in the met structure array
 *
 * These routines are activated when "metmodel" = 2 or 3 in suntans.dat
+*
+* The inputs of the computational cells are gathered into the work arrays
+* met->coare so that COAREFluxes (metmodel=2) can operate on all of the
+* surface cells at once.
 */ 
 void updateAirSeaFluxes(propT *prop, gridT *grid, physT *phys, metT *met,REAL **T){
   
-  int i, ktop, iptr, n;
-  int Nc = grid->Nc;
-  REAL *x=met->xtmp; // pointer to vector passed to cor30
+  int i, ktop, n, N;
+  int *cell = grid->cellp+grid->celldist[0];
+  REAL **w = met->coare;
   REAL Umag; // Wind Speed magnitude
   // Constant flux coefficients
   REAL Cd = prop->Cda; // Drag coefficient
@@ -746,168 +737,79 @@ void updateAirSeaFluxes(propT *prop, gridT *grid, physT *phys, metT *met,REAL **
   REAL Lv = 2.50e6; // Latent heat of vaporization
   REAL rhoa = 1.20; // Density of air	
   
-
-  /* Terms in the COARE3.0 input vector
-   REAL u=x[0]; //wind speed (m/s]  at height zu [m]
-   REAL us=x[1]; //surface current speed in the wind direction [m/s]
-   REAL ts=x[2]; //bulk water temperature [C] if jcool=1, interface water T if jcool=0  
-   REAL t=x[3]; //bulk air temperature [C], height zt
-   REAL Qs=x[4]; //bulk water spec hum [kg/kg] if jcool=1, ...
-   REAL Q=x[5]; //bulk air spec hum [kg/kg], height zq
-   REAL Rs=x[6]; //downward solar flux [W/m^2]
-   REAL Rl=x[7]; //downard IR flux [W/m^2]
-   REAL rain=x[8]; //rain rate [mm/hr]
-   REAL zi=x[9]; //PBL depth [m]
-   REAL P=x[10]; //Atmos surface pressure [mb]
-   REAL zu=x[11]; //wind speed measurement height [m]
-   REAL zt=x[12]; //air T measurement height [m]
-   REAL zq=x[13]; //air q measurement height [m]
-   REAL lat=x[14]; //latitude [deg, N=+]
-   REAL jcool=x[15]; //implement cool calculation skin switch, 0=no, 1=yes
-   REAL jwave=x[16]; //implement wave dependent roughness model
-   REAL twave=x[17]; //wave period [s]
-   REAL hwave=x[18]; //wave height [m]
-  */
-  
-  /* The goal is fill up vector x   */ 
-  //x = (REAL *)SunMalloc(19*sizeof(REAL),"updateAirSeaFluxes");
-
-  
-  //if(myproc==0) printf(" j, Hs, Hl, tau, Hlw, Hsw\n"); 
- // for(j=0;j<Nc;j++){
- for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
-    i = grid->cellp[iptr];  
+  N = grid->celldist[1]-grid->celldist[0];
+  for(n=0;n<N;n++) {
+    i = cell[n];
     ktop = grid->ctop[i];
     // Wind speed
-    //Umag = sqrt( pow( (met->Uwind[i]-phys->uc[i][ktop]) ,2) + pow( (met->Vwind[i]-phys->vc[i][ktop]),2) );
-    Umag = sqrt( pow(met->Uwind[i],2) + pow(met->Vwind[i],2) );
-    x[0] = Umag;
+    Umag = sqrt(met->Uwind[i]*met->Uwind[i] + met->Vwind[i]*met->Vwind[i]);
+    w[COARE_U][n] = Umag;
 
     // Surface current speed in wind direction
     // This is the projection of the water velocity vector onto the wind velocity vector
-    //x[1] = 0.0; 
-    x[1] = fabs(phys->uc[i][ktop]*met->Uwind[i]/Umag + phys->vc[i][ktop]*met->Vwind[i]/Umag); 
+    w[COARE_US][n] = fabs(phys->uc[i][ktop]*met->Uwind[i]/Umag + phys->vc[i][ktop]*met->Vwind[i]/Umag); 
 
     // Water temperature
-    x[2] = T[i][ktop];
+    w[COARE_TS][n] = T[i][ktop];
     
-    // Air temperature
-    x[3] = met->Tair[i];
-    
-    // Water specific humidty
-    x[4] = qsat(T[i][ktop], met->Pair[i]);
-    
-    // Air specific humidity
-    x[5] = specifichumidity(met->RH[i],met->Tair[i],met->Pair[i]);
+    // Water and air specific humidity
+    w[COARE_QS][n] = qsat(T[i][ktop], met->Pair[i]);
+    w[COARE_Q][n] = specifichumidity(met->RH[i],met->Tair[i],met->Pair[i]);
     
     // Longwave radiation
     met->Hlw[i] = longwave(met->Tair[i],T[i][ktop],met->cloud[i]);
     //met->Hlw[i] = longwave_berliand(met->Tair[i],T[i][ktop],met->cloud[i],met->RH[i],met->Pair[i]);
-    x[6] = met->Hlw[i];
     
     // Shortwave radiation
     met->Hsw[i] = shortwave(prop->nctime/86400.0,prop->latitude,met->cloud[i],prop->gmtoffset/24.0);
-    x[7] = met->Hsw[i];
-    
-    //rain [mm/hr] (rain heat flux is not included at the moment)
-    x[8] = met->rain[i]*3600;
-    
-    //Air pressure [mb]
-    x[10] = met->Pair[i];
-    
-    //wind speed height
-    x[11] = met->z_Uwind[i];
-    
-    //air temp height
-    x[12] = met->z_Tair[i];
-    
-    //humidity measurement height
-    x[13] = met->z_RH[i];
-    
-     //Set some constant values
-     x[9] = 600.0; 
-     x[14] = prop->latitude;
-     x[15] = 0.0;
-     x[16] = 0.0;
-     x[17] = 0.0;
-     x[18] = 0.0;
-    //printf(" %d, x[0]:%6.6f, x[1]:%6.6f, x[2]:%6.6f, x[3]:%6.6f, x[4]:%6.6f, x[5]:%6.6f\n",j,x[0],x[1],x[2],x[3],x[4],x[5]);
-    if (prop->metmodel==2){
-      /* Calculate the actual fluxes */
-      cor30a(x);
-      /* Output variable back into the input array 
-      x[0] = hsb;
-      x[1] = hlb;
-      x[2] = tau;
-      x[3] = zo;
-      x[4] = zot;
-      x[5] = zoq;
-      x[6] = rhoa;
-      x[7] = usr;
-      x[8] = tsr;
-      x[9] = qsr;
-      x[10] = dter;
-      x[11] = dqer;
-      x[12] = tkt;
-      x[13] = RF;
-      x[14] = ut; // Speed including gustiness
-      x[15] = Cd;
-      x[16] = Ch;
-      x[17] = Ce;
-      x[18] = ug;
-      */
-      // Output the fluxes to the met structure array
-      met->Hs[i] = -x[0];//Note the change of sign
-      met->Hl[i] = -x[1];
-      met->ustar[i] = x[7];//These are not used at present
-      met->Tstar[i] = x[8];
-      met->qstar[i] = x[9];
-    
-      /* Calculate the wind stress components
-      * tau_x = rhoa * Cd * S * (Ucurrent - Uwind) : Fairall et al, 1996
-      */
-      // *** I think this is double counting if the surface currents have already been accounted for above***
-      //met->tau_x[j] = x[6] * x[15] * x[14] * (phys->uc[j][ktop] - met->Uwind[j]);
-      //met->tau_y[j] = x[6] * x[15] * x[14] * (phys->vc[j][ktop] - met->Vwind[j]);
-      //met->tau_x[j] = x[6] * x[15] * x[14] * (met->Uwind[j] - phys->uc[j][ktop]);
-      //met->tau_y[j] = x[6] * x[15] * x[14] * (met->Vwind[j] - phys->vc[j][ktop]);
-      // No gust speed in stress term
-      met->tau_x[i] = x[6] * x[10] * Umag * (met->Uwind[i] - phys->uc[i][ktop]);
-      met->tau_y[i] = x[6] * x[10] * Umag * (met->Vwind[i] - phys->vc[i][ktop]);
-
-      //No surface current dependence 
-      //met->tau_x[j] = x[6] * x[15] * x[14] * met->Uwind[j];
-      //met->tau_y[j] = x[6] * x[15] * x[14] * met->Vwind[j];
-      //met->tau_x[j] = 1.2 * 0.0011 * x[14] * met->Uwind[j];
-      //met->tau_y[j] = 1.2 * 0.0011 * x[14] * met->Vwind[j];
-      //printf("%10.6f, %10.6f, %10.6f, %10.6f\n",x[6],x[15],x[14],met->Vwind[j]);
-
-    }else if(prop->metmodel>=3){// Compute fluxes with constant parameters
-      met->Hs[i] = - rhoa * cpa * Ch * Umag * (x[2] - x[3]);//T_w > T_a -> Hs is negative
-      met->Hl[i] = - rhoa * Lv * Ce * Umag * (x[4] - x[5]);
+  }
+
+  if(prop->metmodel==2) {
+    /* Calculate the actual fluxes */
+    COAREFluxes(met,N,cell);
+
+    /* Calculate the wind stress components
+    * tau_x = rhoa * Cd * S * (Ucurrent - Uwind) : Fairall et al, 1996
+    * No gust speed in the stress term, and the surface currents have
+    * already been accounted for in the transfer coefficient.
+    */
+    for(n=0;n<N;n++) {
+      i = cell[n];
+      ktop = grid->ctop[i];
+      met->tau_x[i] = w[COARE_RHOACD][n] * w[COARE_U][n] * (met->Uwind[i] - phys->uc[i][ktop]);
+      met->tau_y[i] = w[COARE_RHOACD][n] * w[COARE_U][n] * (met->Vwind[i] - phys->vc[i][ktop]);
+    }
+  } else if(prop->metmodel>=3) {// Compute fluxes with constant parameters
+    for(n=0;n<N;n++) {
+      i = cell[n];
+      ktop = grid->ctop[i];
+      Umag = w[COARE_U][n];
+      met->Hs[i] = - rhoa * cpa * Ch * Umag * (w[COARE_TS][n] - met->Tair[i]);//T_w > T_a -> Hs is negative
+      met->Hl[i] = - rhoa * Lv * Ce * Umag * (w[COARE_QS][n] - w[COARE_Q][n]);
       met->tau_x[i] = rhoa * Cd * Umag * (met->Uwind[i] - phys->uc[i][ktop]); 
       met->tau_y[i] = rhoa * Cd * Umag * (met->Vwind[i] - phys->vc[i][ktop]);
     }
+  }
 
-
-    // Check for nans and dump the inputs
-    for(n=0;n<8;n++){
-    	if(x[n]!=x[n]){
-	   printf("Error in COARE3.0 Algorithm at i = %d, x[%d] = nan.\n",i,n);
-	   printf("Uwind[%d] = %6.10f, z_Uwind = %6.10f m\n",i,met->Uwind[i],met->z_Uwind[i]);
-	   printf("Vwind[%d] = %6.10f, z_Vwind = %6.10f m\n",i,met->Vwind[i],met->z_Vwind[i]);
-	   printf("Tair[%d] = %6.10f, z_Tair = %6.10f m\n",i,met->Tair[i],met->z_Tair[i]);
-	   printf("Pair[%d] = %6.10f\n",i,met->Pair[i]);
-	   printf("rain[%d] = %6.10f\n",i,met->rain[i]);
-	   printf("RH[%d] = %6.10f, z_RH = %6.10f m\n",i,met->RH[i],met->z_RH[i]);
-	   printf("cloud[%d] = %6.10f\n",i,met->cloud[i]);
-	   printf("T[%d][%d] = %6.10f\n",i,ktop,T[i][ktop]);
-	   MPI_Finalize();
-	   exit(EXIT_FAILURE);
-	}
+  // Check for nans in the fluxes and dump the inputs
+  for(n=0;n<N;n++) {
+    i = cell[n];
+    if(met->Hs[i]!=met->Hs[i] || met->Hl[i]!=met->Hl[i] || met->Hlw[i]!=met->Hlw[i] ||
+       met->Hsw[i]!=met->Hsw[i] || met->tau_x[i]!=met->tau_x[i] || met->tau_y[i]!=met->tau_y[i]) {
+      ktop = grid->ctop[i];
+      printf("Error in COARE3.0 Algorithm at i = %d, flux = nan.\n",i);
+      printf("Uwind[%d] = %6.10f, z_Uwind = %6.10f m\n",i,met->Uwind[i],met->z_Uwind[i]);
+      printf("Vwind[%d] = %6.10f, z_Vwind = %6.10f m\n",i,met->Vwind[i],met->z_Vwind[i]);
+      printf("Tair[%d] = %6.10f, z_Tair = %6.10f m\n",i,met->Tair[i],met->z_Tair[i]);
+      printf("Pair[%d] = %6.10f\n",i,met->Pair[i]);
+      printf("rain[%d] = %6.10f\n",i,met->rain[i]);
+      printf("RH[%d] = %6.10f, z_RH = %6.10f m\n",i,met->RH[i],met->z_RH[i]);
+      printf("cloud[%d] = %6.10f\n",i,met->cloud[i]);
+      printf("T[%d][%d] = %6.10f\n",i,ktop,T[i][ktop]);
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
     }
   }
-  //SunFree(x,19,"updateAirSeaFluxes");
 } // End updateAirFluxes
 
 
@@ -1104,9 +1006,10 @@ REAL shortwave(REAL time, REAL Lat,REAL C_cloud, REAL toffset){
 //}
 
 /* 
-* Function:  cor30a()
-* -------------------
-* Calculates air-sea fluxes using bulk flux formulation
+* Function:  COAREFluxes()
+* ------------------------
+* Calculates air-sea fluxes using bulk flux formulation for the N cells
+* cell[0..N-1] from the inputs in met->coare
 *
 * References:
 *	Fairall et al, 1996, JGR
@@ -1115,281 +1018,200 @@ REAL shortwave(REAL time, REAL Lat,REAL C_cloud, REAL toffset){
 * See:
 *	http://coaps.fsu.edu/COARE/flux_algor/
 *
-* This code is adapted from cor30.m matlab function
+* This code is adapted from cor30.m matlab function without the cool skin,
+* wave roughness, rain and Webb corrections, with a PBL depth of 600 m.
+*
+* Each pass over the cells computes one step of the stability iteration, and
+* cells leave the iteration once the friction and gustiness velocities change
+* by less than COARETOL (or after the first step when the first guess is very stable,
+* zetu>50), after at most COAREMAXITS steps as in cor30.m.  Cells that
+* converged in the previous call start from its friction and gustiness
+* velocities (met->ustar and met->ugust) and usually need a single step.
+* The others start from the first guess, since the iteration does not converge
+* for strongly stable conditions and more steps would drive the friction
+* velocity to zero.  The first guess of the stability from the bulk Richardson
+* number, which sets the temperature and humidity scales, does not depend on
+* the previous call.
 */
-static void cor30a(REAL *y){
-  
-  /* Get variables from the input vector */
-  REAL u=y[0]; //wind speed (m/s]  at height zu [m]
-  REAL us=y[1]; //surface current speed in the wind direction [m/s]
-  REAL ts=y[2]; //bulk water temperature [C] if jcool=1, interface water T if jcool=0  
-  REAL t=y[3]; //bulk air temperature [C], height zt
-  REAL Qs=y[4]; //bulk water spec hum [kg/kg] if jcool=1, ...
-  REAL Q=y[5]; //bulk air spec hum [kg/kg], height zq
-  REAL Rs=y[6]; //downward solar flux [W/m^2]
-  REAL Rl=y[7]; //downard IR flux [W/m^2]
-  REAL rain=y[8]; //rain rate [mm/hr]
-  REAL zi=y[9]; //PBL depth [m]
-  REAL P=y[10]; //Atmos surface pressure [mb]
-  REAL zu=y[11]; //wind speed measurement height [m]
-  REAL zt=y[12]; //air T measurement height [m]
-  REAL zq=y[13]; //air q measurement height [m]
-  REAL lat=y[14]; //latitude [deg, N=+]
-  REAL jcool=y[15]; //implement cool calculation skin switch, 0=no, 1=yes
-  REAL jwave=y[16]; //implement wave dependent roughness model
-  REAL twave=y[17]; //wave period [s]
-  REAL hwave=y[18]; //wave height [m]
+static void COAREFluxes(metT *met, int N, const int *cell){
   
-  int nits =3;
-  int i;
-  
-  REAL Beta, von, fdg, tdk, grav;
-  REAL Rgas, Le, cpa, cpv, rhoa, visa;
-  REAL Al, be, cpw, rhow, visw, tcw, bigc, wetc;
-  REAL lwave, cwave, Rns, Rnl;
-  REAL dt, du, dq, ta, ug, dter, dqer;
-  REAL u10, usr, zo10, Cd10, Ch10, Ct10, zot10;
-  REAL Cd, Ct, CC, Ribcu, Ribu, zetu, L10, tsr, qsr, tkt, charn, rr, Bf;
-  REAL hsb, hlb, qout, dels, qcol, alq;
-  REAL xlamx, dwat, dtmp, alfac, RF, wbar, hl_webb, zet;
-  REAL zo, zot, zoq, L, ut, tau, Ch, Ce, Chn_10, Cdn_10, Cen_10;
-  
-  //printf("y[13]:%6.6f, y[14]:%6.6f, y[15]:%6.6f, y[16]:%6.6f, y[17]:%6.6f, y[18]:%6.6f\n",y[13],y[14],y[15],y[16],y[17],y[18]);
+  int i, j, m, n, it, nactive, *active=met->coareactive;
+  REAL **w = met->coare;
+  REAL zu, zt, zq, t, du, dt, dq, ta, ut, ug, u10, usr, usrnew, zo10, Cd10, Ct10, zot10;
+  REAL Cd, Ct, CC, Ribcu, Ribu, zetu, L10, zet, zo, Bf, Le, tau;
   
 /**********   set constants *************/
-  Beta=1.2;
-  von=0.4;
-  fdg=1.00;
-  tdk=273.16;
-  grav=9.81;
+  const REAL Beta=1.2;
+  const REAL von=0.4;
+  const REAL fdg=1.00;
+  const REAL tdk=273.16;
+  const REAL grav=9.81;
+  const REAL zi=600.0; // PBL depth [m]
+  const REAL Ch10=0.00115;
   /*************  air constants ************/
-  Rgas=287.1;
-  Le=(2.501-.00237*ts)*1e6;
-  cpa=1004.67;
-  cpv=cpa*(1+0.84*Q);
-  rhoa=P*100/(Rgas*(t+tdk)*(1+0.61*Q));
-  visa=1.326e-5*(1+6.542e-3*t+8.301e-6*t*t-4.84e-9*t*t*t);
-   /************  cool skin constants  *******/
-   Al=2.1e-5*pow(ts+3.2,0.79);
-   be=0.026;
-   cpw=4000;
-   rhow=1022;
-   visw=1e-6;
-   tcw=0.6;
-   bigc=16*grav*cpw*pow(rhow*visw,3.0)/(tcw*tcw*rhoa*rhoa);
-   wetc=0.622*Le*Qs/(Rgas*pow(ts+tdk,2.0));
-   
-   zo = 0.0;
-   zot=0.0;
-   zoq=0.0;
-   L=0.0;
-   /***************   wave parameters  *********/
-   //lwave=grav/2/PI*pow(twave,2);
-   //cwave=grav/2/PI*twave;
-   
-   /**************  compute aux stuff *******/
-   //Rns=Rs*.945;
-   //Rnl=0.97*(5.67e-8*pow(ts-0.3*jcool+tdk,4)-Rl);
-   
-   /***************   Begin bulk loop *******/
-   
-   /***************  first guess ************/
-   du=u-us;
-   dt=ts-t-.0098*zt;
-   dq=Qs-Q;
-   ta=t+tdk;
-   ug=.5;
-   dter=0.3; 
-   dqer=wetc*dter;
-   ut=sqrt(du*du+ug*ug);
-   u10=ut*log(10/1e-4)/log(zu/1e-4);
-   usr=.035*u10;
-   zo10=0.011*usr*usr/grav+0.11*visa/usr;
-   Cd10=pow(von/log(10/zo10),2);
-   Ch10=0.00115;
-   Ct10=Ch10/sqrt(Cd10);
-   zot10=10/exp(von/Ct10);
-   Cd=pow(von/log(zu/zo10),2);
-   Ct=von/log(zt/zot10);
-   CC=von*Ct/Cd;
-   Ribcu=-zu/zi/.004/pow(Beta,3);
-   Ribu=-grav*zu/ta*((dt-dter*jcool)+.61*ta*dq)/pow(ut,2);
-
-   if(Ribu<0){
-     zetu=CC*Ribu/(1+Ribu/Ribcu);
-   }else{
-     zetu=CC*Ribu*(1+27/9*Ribu/CC);
-   }
-   
-   L10=zu/zetu;
-   if (zetu>50){
-    nits=1;
-   }
-   usr=ut*von/(log(zu/zo10) - psiu_30(zu/L10));
-   tsr=-dt*von*fdg/(log(zt/zot10)-psit_30(zt/L10));
-   qsr=-dq*von*fdg/(log(zq/zot10)-psit_30(zq/L10));
-   //tsr=-(dt-dter*jcool)*von*fdg/(log(zt/zot10)-psit_30(zt/L10));
-   //qsr=-(dq-wetc*dter*jcool)*von*fdg/(log(zq/zot10)-psit_30(zq/L10));
-   
-   tkt=.001;
-   
-   charn=0.011;
-   if (ut>10.0){
-     charn=0.011+(ut-10)/(18-10)*(0.018-0.011);
-   }
-   if(ut>18.0){
-     charn=0.018;
-   }
+  const REAL Rgas=287.1;
+  const REAL cpa=1004.67;
+  
+  /***************  first guess ************/
+  for(n=0;n<N;n++) {
+    i = cell[n];
+    zu = met->z_Uwind[i];
+    zt = met->z_Tair[i];
+    zq = met->z_RH[i];
+    t = met->Tair[i];
+
+    du=w[COARE_U][n]-w[COARE_US][n];
+    dt=w[COARE_TS][n]-t-.0098*zt;
+    dq=w[COARE_QS][n]-w[COARE_Q][n];
+    ta=t+tdk;
+    w[COARE_DU][n]=du;
+    w[COARE_DT][n]=dt;
+    w[COARE_DQ][n]=dq;
+    w[COARE_TA][n]=ta;
+    w[COARE_RHOA][n]=met->Pair[i]*100/(Rgas*ta*(1+0.61*w[COARE_Q][n]));
+    w[COARE_VISA][n]=1.326e-5*(1+6.542e-3*t+8.301e-6*t*t-4.84e-9*t*t*t);
+
+    ug=.5;
+    ut=sqrt(du*du+ug*ug);
+    u10=ut*log(10/1e-4)/log(zu/1e-4);
+    usr=.035*u10;
+    zo10=0.011*usr*usr/grav+0.11*w[COARE_VISA][n]/usr;
+    Cd10=von/log(10/zo10);
+    Cd10*=Cd10;
+    Ct10=Ch10/sqrt(Cd10);
+    zot10=10/exp(von/Ct10);
+    Cd=von/log(zu/zo10);
+    Cd*=Cd;
+    Ct=von/log(zt/zot10);
+    CC=von*Ct/Cd;
+    Ribcu=-zu/zi/.004/(Beta*Beta*Beta);
+    Ribu=-grav*zu/ta*(dt+.61*ta*dq)/(ut*ut);
+
+    if(Ribu<0){
+      zetu=CC*Ribu/(1+Ribu/Ribcu);
+    }else{
+      zetu=CC*Ribu*(1+27/9*Ribu/CC);
+    }
+    L10=zu/zetu;
+    w[COARE_ZETU][n]=zetu;
+
+    // The temperature and humidity scales stay at the first-guess stability
+    w[COARE_TSR][n]=-dt*von*fdg/(log(zt/zot10)-psit_30(zt/L10));
+    w[COARE_QSR][n]=-dq*von*fdg/(log(zq/zot10)-psit_30(zq/L10));
+
+    if(ut>18.0){
+      w[COARE_CHARN][n]=0.018;
+    }else if(ut>10.0){
+      w[COARE_CHARN][n]=0.011+(ut-10)/(18-10)*(0.018-0.011);
+    }else{
+      w[COARE_CHARN][n]=0.011;
+    }
+
+    // Warm start from the previous call if it converged
+    if(met->ugust[i]>0 && zetu<=50) {
+      w[COARE_USR][n]=met->ustar[i];
+      w[COARE_UG][n]=met->ugust[i];
+    } else {
+      w[COARE_USR][n]=ut*von/(log(zu/zo10) - psiu_30(zu/L10));
+      w[COARE_UG][n]=ug;
+    }
+  }
    
-   /***************  bulk loop ************/
-  for(i=0;i<nits;i++){
-     zet=von*grav*zu/ta*(tsr*(1+0.61*Q)+.61*ta*qsr)/(usr*usr)/(1+0.61*Q);
-     //Hard-wire it without waves
-     zo=charn*usr*usr/grav+0.11*visa/usr; // Eq. 6
-
-     //if((int)jwave==0){
-     //    zo=charn*usr*usr/grav+0.11*visa/usr;
-     //}
-     //if((int)jwave==1){
-     //    zo=50.0/2.0/PI*lwave*pow(usr/cwave,4.5)+0.11*visa/usr;
-     //} // Oost et al
-     //if((int)jwave==2){
-     //    zo=1200.0*hwave*pow(hwave/lwave,4.5)+0.11*visa/usr;
-     //} // Taylor and Yelland
-      
-      rr=zo*usr/visa; // Roughness reynolds number (see Eq. 7)
-      L=zu/zet;
-      zoq=Min(1.15e-4,5.5e-5/pow(rr,-0.6));// Eq. 28
-      zot=zoq;
-      usr=ut*von/(log(zu/zo)-psiu_30(zu/L));
-      tsr=-dt*von*fdg/(log(zt/zot10)-psit_30(zt/L10));
-      qsr=-dq*von*fdg/(log(zq/zot10)-psit_30(zq/L10));
-      //tsr=-(dt-dter*jcool)*von*fdg/(log(zt/zot)-psit_30(zt/L));
-      //qsr=-(dq-wetc*dter*jcool)*von*fdg/(log(zq/zoq)-psit_30(zq/L));
-      Bf=-grav/ta*usr*(tsr+.61*ta*qsr);
+  /***************  bulk loop ************/
+  nactive=N;
+  for(n=0;n<N;n++)
+    active[n]=n;
+
+  for(it=0;it<COAREMAXITS && nactive>0;it++) {
+    m=0;
+    for(j=0;j<nactive;j++) {
+      n = active[j];
+      zu = met->z_Uwind[cell[n]];
+      ta = w[COARE_TA][n];
+      usr = w[COARE_USR][n];
+      ut=sqrt(w[COARE_DU][n]*w[COARE_DU][n]+w[COARE_UG][n]*w[COARE_UG][n]);
+
+      zet=von*grav*zu/ta*(w[COARE_TSR][n]*(1+0.61*w[COARE_Q][n])+.61*ta*w[COARE_QSR][n])
+        /(usr*usr)/(1+0.61*w[COARE_Q][n]);
+      zo=w[COARE_CHARN][n]*usr*usr/grav+0.11*w[COARE_VISA][n]/usr; // Eq. 6
+      usrnew=ut*von/(log(zu/zo)-psiu_30(zet));
+      Bf=-grav/ta*usrnew*(w[COARE_TSR][n]+.61*ta*w[COARE_QSR][n]);
       
       if (Bf>0){
 	ug=Beta*pow(Bf*zi,0.333);
       }else{
 	ug=.2;
       }
-      
-      ut=sqrt(du*du+ug*ug);
-      //Rnl=0.97*(5.67e-8*pow(ts-dter*jcool+tdk,4)-Rl);
-      hsb=-rhoa*cpa*usr*tsr;
-      hlb=-rhoa*Le*usr*qsr;
-      /*
-      qout=Rnl+hsb+hlb;
-      dels=Rns*(.065+11*tkt-6.6e-5/tkt*(1-exp(-tkt/8.0e-4))); 	// Eq.16 Shortwave
-      qcol=qout-dels;
-      alq=Al*qcol+be*hlb*cpw/Le;					// Eq. 7 Buoy flux water
-
-     if (alq>0){
-     	xlamx=6/pow(1+pow(bigc*alq/pow(usr,4),0.75),0.333);				// Eq 13 Saunders
-        tkt=xlamx*visw/(sqrt(rhoa/rhow)*usr);			//Eq.11 Sub. thk
-
-     }else{
-       xlamx=6.0;
-       tkt=Min(.01,xlamx*visw/(sqrt(rhoa/rhow)*usr));			// Eq.11 Sub. thk
-     }
-     
-      dter=qcol*tkt/tcw; //  Eq.12 Cool skin
-      dqer=wetc*dter;
-      */
-     
+
+      // Keep the cells that have not converged
+      if((fabs(usrnew-usr)>COARETOL*usrnew || fabs(ug-w[COARE_UG][n])>COARETOL*ug)
+          && w[COARE_ZETU][n]<=50)
+        active[m++]=n;
+      w[COARE_USR][n]=usrnew;
+      w[COARE_UG][n]=ug;
+    }
+    nactive=m;
   }//bulk iter loop
   
-  tau=rhoa*usr*usr*du/ut;  //stress
-  hsb=-rhoa*cpa*usr*tsr;
-  hlb=-rhoa*Le*usr*qsr;
-  
-  
-  ///****************   rain heat flux ********/
-  //dwat=2.11e-5*pow((t+tdk)/tdk,1.94); // water vapour diffusivity
-  //dtmp=(1.+3.309e-3*t-1.44e-6*t*t)*0.02411/(rhoa*cpa); 	//heat diffusivity
-  //alfac= 1/(1+(wetc*Le*dwat)/(cpa*dtmp));      	// wet bulb factor
-  //RF= rain*alfac*cpw*((ts-t-dter*jcool)+(Qs-Q-dqer*jcool)*Le/cpa)/3600;
-  //
-  ///****************   Webb et al. correection  ************/
-  //wbar=1.61*hlb/Le/(1+1.61*Q)/rhoa+hsb/rhoa/cpa/ta;//formulation in hlb already includes webb
-  //hl_webb=rhoa*wbar*Q*Le;
-  //
-  ///**************   compute transfer coeffs relative to ut @meas. ht **********/
-  Cd=tau/rhoa/ut/Max(.1,du);
-  Ch=-usr*tsr/ut/(dt);
-  Ce=-usr*qsr/(dq)/ut;
-  //Ch=-usr*tsr/ut/(dt-dter*jcool);
-  //Ce=-usr*qsr/(dq-dqer*jcool)/ut;
-  //
-  ///************  10-m neutral coeff realtive to ut ********/
-  //Cdn_10=von*von/log(10/zo)/log(10/zo);
-  //Chn_10=von*von*fdg/log(10/zo)/log(10/zot);
-  //Cen_10=von*von*fdg/log(10/zo)/log(10/zoq);
-  
-  /* Output variable back into the input array */
-  y[0] = hsb;
-  y[1] = hlb;
-  y[2] = tau;
-  y[3] = zo;
-  y[4] = zot;
-  y[5] = zoq;
-  y[6] = rhoa;
-  y[7] = usr;
-  y[8] = tsr;
-  y[9] = qsr;
-  y[10] = Cd;
-  //y[11] = Ch;
-  //y[12] = Ce;
-  //y[10] = dter;
-  //y[11] = dqer;
-  //y[12] = tkt;
-  //y[13] = RF;
-  //y[14] = ut;
-  //y[15] = Cd;
-  //y[16] = Ch;
-  //y[17] = Ce;
-  //y[18] = ug;
-  
-  //printf("y[13]:%6.6f, y[14]:%6.6f, y[15]:%6.6f, y[16]:%6.6f, y[17]:%6.6f, y[18]:%6.6f\n",y[13],y[14],y[15],y[16],y[17],y[18]);
-  //y=[hsb hlb tau zo zot zoq L usr tsr qsr dter dqer tkt RF wbar Cd Ch Ce Cdn_10 Chn_10 Cen_10 ug ];
-  //   1   2   3   4  5   6  7  8   9  10   11   12  13  14  15  16 17 18    19      20    21  22
-} // End cor30a
+  /****************  fluxes and stress *****/
+  for(n=0;n<N;n++) {
+    i = cell[n];
+    du = w[COARE_DU][n];
+    usr = w[COARE_USR][n];
+    ut=sqrt(du*du+w[COARE_UG][n]*w[COARE_UG][n]);
+    Le=(2.501-.00237*w[COARE_TS][n])*1e6;
+    tau=w[COARE_RHOA][n]*usr*usr*du/ut;
+
+    // Note the change of sign of the sensible and latent heat fluxes
+    met->Hs[i]=w[COARE_RHOA][n]*cpa*usr*w[COARE_TSR][n];
+    met->Hl[i]=w[COARE_RHOA][n]*Le*usr*w[COARE_QSR][n];
+    met->ustar[i]=usr;
+    met->Tstar[i]=w[COARE_TSR][n];
+    met->qstar[i]=w[COARE_QSR][n];
+    met->ugust[i]=w[COARE_UG][n];
+
+    // Density times the drag coefficient relative to ut
+    w[COARE_RHOACD][n]=tau/ut/Max(.1,du);
+  }
+
+  // Cells that did not converge start from the first guess in the next call
+  for(j=0;j<nactive;j++)
+    met->ugust[cell[active[j]]]=0;
+} // End COAREFluxes
 
 /* Velocity stability function */
-static REAL psiu_30(REAL zet){
+static inline REAL psiu_30(REAL zet){
   
-  REAL x, psik, psic, f, c,  psi;
+  REAL x, psik, psic, f, c;
+
+  if(zet>0){
+    c=Min(50.0,0.35*zet);
+    return -(1.0+zet+.667*(zet-14.28)/exp(c)+8.525);
+  }
 
-  x=pow(1.0-15.0*zet,0.25);
+  x=sqrt(sqrt(1.0-15.0*zet));
   psik=2.0*log((1.0+x)/2.0)+log((1+x*x)/2.0)-2*atan(x)+2.0*atan(1.0);
   x=pow(1-10.15*zet,0.3333);
   psic=1.5*log((1.0+x+x*x)/3.0)-sqrt(3.0)*atan((1.0+2.0*x)/sqrt(3.0))+4.0*atan(1.0)/sqrt(3.0);
   f=zet*zet/(1.0+zet*zet);
-  psi=(1.0-f)*psik+f*psic;                                               
-  
-  if(zet>0){
-    c=Min(50.0,0.35*zet);
-    psi=-(pow(1.0+1.0*zet,1.0)+.667*(zet-14.28)/exp(c)+8.525);
-  }
-  return psi;
+  return (1.0-f)*psik+f*psic;
   
 } // End psiu_30
 
 /* Temperature stability function */
-static REAL psit_30(REAL zet){
+static inline REAL psit_30(REAL zet){
  
-  REAL x, psik, psic, f, c,  psi;
+  REAL x, psik, psic, f, c;
   
-  x=pow(1.0-15.0*zet,0.5);
+  if(zet>0){
+    c=Min(50,0.35*zet);
+    return -(pow(1+2/3*zet,1.5)+0.6667*(zet-14.28)/exp(c)+8.525);
+  }
+
+  x=sqrt(1.0-15.0*zet);
   psik=2.0*log((1+x)/2.0);
   x=pow(1-34.15*zet,0.3333);
   psic=1.5*log((1.0+x+x*x)/3.0)-sqrt(3.0)*atan((1.0+2.0*x)/sqrt(3.0))+4.0*atan(1.0)/sqrt(3.0);
   f=zet*zet/(1+zet*zet);
-  psi=(1.0-f)*psik+f*psic;  
-  
-  if(zet>0){
-    c=Min(50,0.35*zet);
-    psi=-(pow(1+2/3*zet,1.5)+0.6667*(zet-14.28)/exp(c)+8.525);
-  }
-  return psi;
+  return (1.0-f)*psik+f*psic;  
 } // End psit_30
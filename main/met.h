@@ -16,6 +16,13 @@
 #define NTmet 3
 #define MAXNEAR 12
 
+/* Per-cell work arrays of the batched COARE3.0 flux calculation in met.c */
+enum coareworkT {
+  COARE_U, COARE_US, COARE_TS, COARE_QS, COARE_Q, COARE_DU, COARE_DT, COARE_DQ, COARE_TA,
+  COARE_RHOA, COARE_VISA, COARE_TSR, COARE_QSR, COARE_USR, COARE_UG, COARE_CHARN,
+  COARE_ZETU, COARE_RHOACD, NCOAREWORK
+};
+
 /* Structure array for meteorological input data*/
 typedef struct _metinT {
   
@@ -59,6 +66,7 @@ typedef struct _metinT {
   int t0;
   int t1;
   int t2;
+  timecursorT cursor;
   
   // Interpolation Weights
   REAL **WUwind;
@@ -129,7 +137,13 @@ typedef struct _metT {
   REAL *qstar;
   REAL *EP;
   REAL *Htmp;
-  REAL *xtmp;  
+
+  // Converged gustiness velocity of the COARE3.0 iteration (ustar holds the
+  // friction velocity) used to warm start the next step
+  REAL *ugust;
+  // Work arrays for the surface cells and the cells that are still iterating
+  REAL **coare;
+  int *coareactive;
 
   // Data on suntans grid centres (two time steps)
   REAL **Uwind_t;
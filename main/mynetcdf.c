@@ -7,6 +7,7 @@
 
 #include "mynetcdf.h"
 #include "merge.h"
+#include "tracers.h"
 
 /***********************************************
 * Private functions
@@ -22,6 +23,10 @@ static void nc_addattr_real(int ncid, int varid, char *attname, REAL *attvalue);
 
 void nc_read_3D(int ncid, char *vname, size_t *start, size_t *count, REAL ***tmparray);
 void nc_read_2D(int ncid, char *vname, size_t *start, size_t *count, REAL **tmparray, int myproc);
+static void nc_read_3D_sub(int ncid, char *vname, size_t start[3], size_t count[3], int n0, REAL ***tmparray);
+static void nc_read_2D_sub(int ncid, char *vname, size_t start[2], size_t count[2], int n0, REAL **tmparray);
+static void ShiftBdyRecords(void);
+static void BdySlabRange(gridT *grid, int myproc);
 void nc_write_double(int ncid, char *vname, REAL *tmparray, int myproc);
 void nc_write_int(int ncid, char *vname, int *tmparray, int myproc);
 void nc_write_intvar(int ncid, char *vname, gridT *grid, int *tmparray, int myproc);
@@ -168,6 +173,59 @@ void nc_read_2D(int ncid, char *vname, size_t start[2], size_t count[2], REAL **
     //printf(" Done\n");
 }// End function
 
+/*
+* Function: nc_read_3D_sub()
+* --------------------------
+* Reads a [time][k][j] hyperslab from a netcdf file into a full-sized array so that
+* tmparray[n0+n][k][start[2]+j] = var[start[0]+n][start[1]+k][start[2]+j].
+* The read is buffered on the heap since boundary slabs can be large.
+*/
+static void nc_read_3D_sub(int ncid, char *vname, size_t start[3], size_t count[3], int n0, REAL ***tmparray){
+
+    int j, k, n;
+    int varid, retval;
+    size_t ii, size = count[0]*count[1]*count[2];
+    REAL *outdata = (REAL *)SunMalloc(size*sizeof(REAL),"nc_read_3D_sub");
+
+    if ((retval = nc_inq_varid(ncid, vname, &varid)))
+	ERR(retval);
+    if ((retval = nc_get_vara_double(ncid, varid, start, count, outdata))) 
+	ERR(retval); 
+
+    ii=0;
+    for(n=0;n<(int)count[0];n++)
+	for(k=0;k<(int)count[1];k++)
+	    for(j=0;j<(int)count[2];j++)
+		tmparray[n0+n][start[1]+k][start[2]+j]=outdata[ii++];
+
+    SunFree(outdata,size*sizeof(REAL),"nc_read_3D_sub");
+}// End function
+
+/*
+* Function: nc_read_2D_sub()
+* --------------------------
+* Reads a [time][j] hyperslab into a full-sized array as in nc_read_3D_sub.
+*/
+static void nc_read_2D_sub(int ncid, char *vname, size_t start[2], size_t count[2], int n0, REAL **tmparray){
+
+    int j, n;
+    int varid, retval;
+    size_t ii, size = count[0]*count[1];
+    REAL *outdata = (REAL *)SunMalloc(size*sizeof(REAL),"nc_read_2D_sub");
+
+    if ((retval = nc_inq_varid(ncid, vname, &varid)))
+	ERR(retval);
+    if ((retval = nc_get_vara_double(ncid, varid, start, count, outdata))) 
+	ERR(retval); 
+
+    ii=0;
+    for(n=0;n<(int)count[0];n++)
+	for(j=0;j<(int)count[1];j++)
+	    tmparray[n0+n][start[1]+j]=outdata[ii++];
+
+    SunFree(outdata,size*sizeof(REAL),"nc_read_2D_sub");
+}// End function
+
 /*
  * Function: nc_write_double()
  * --------------------------
@@ -264,14 +322,13 @@ void nc_write_doublevar(int ncid, char *vname, gridT *grid, REAL *tmparray, int
 * Function: getTimeRec()
 * -----------------------------
 *  Retuns the index of the first preceding time step in the vector time
+*  (found by bisection, so time must be increasing)
 */
 int getTimeRec(REAL nctime, REAL *time, int nt){
-   int j;
+   int j = SearchTime(nctime,time,0,nt);
    
-   for(j=0;j<nt;j++){
-      if (time[j]>=nctime)
-	return j-1;
-   }
+   if(j<nt)
+     return j-1;
    return nt;
 }
 
@@ -378,7 +435,7 @@ static void nc_write_3Dedge_merge(int ncid, int tstep, REAL **array, propT *prop
 */
 void WriteOutputNCmerge(propT *prop, gridT *grid, physT *phys, metT *met, int blowup, int numprocs, int myproc, MPI_Comm comm){
    int ncid;
-   int varid, retval, k;
+   int varid, retval, k, n;
    // Start and count vectors for one, two and three dimensional arrays
    size_t startone[] = {prop->nctimectr};
    size_t countone[] = {1};
@@ -477,22 +534,27 @@ void WriteOutputNCmerge(propT *prop, gridT *grid, physT *phys, metT *met, int bl
     // 3D cell-centered variables
     nc_write_3D_merge(ncid,prop->nctimectr,  phys->uc, prop, grid, "uc",0, numprocs, myproc, comm);
     nc_write_3D_merge(ncid,prop->nctimectr,  phys->vc, prop, grid, "vc",0, numprocs, myproc, comm);
-    nc_write_3D_merge(ncid,prop->nctimectr,  phys->nu_tv, prop, grid, "nu_v",0, numprocs, myproc, comm);
+    nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(phys->nu_tv,phys->stmp,grid), prop, grid, "nu_v",0, numprocs, myproc, comm);
 
 
     if(prop->beta>0)
-	nc_write_3D_merge(ncid,prop->nctimectr,  phys->s, prop, grid, "salt",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(phys->s,phys->stmp,grid), prop, grid, "salt",0, numprocs, myproc, comm);
 
     if(prop->gamma>0)
-	nc_write_3D_merge(ncid,prop->nctimectr,  phys->T, prop, grid, "temp",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(phys->T,phys->stmp,grid), prop, grid, "temp",0, numprocs, myproc, comm);
 
     if( (prop->gamma>0) || (prop->beta>0) ) 
 	nc_write_3D_merge(ncid,prop->nctimectr,  phys->rho, prop, grid, "rho",0, numprocs, myproc, comm);
 
     if(prop->calcage){
-	nc_write_3D_merge(ncid,prop->nctimectr,  age->agec, prop, grid, "agec",0, numprocs, myproc, comm);
-	nc_write_3D_merge(ncid,prop->nctimectr,  age->agealpha, prop, grid, "agealpha",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(age->agec,phys->stmp,grid), prop, grid, "agec",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(age->agealpha,phys->stmp,grid), prop, grid, "agealpha",0, numprocs, myproc, comm);
     }
+
+    if(prop->Ntracers>0)
+      for(n=0;n<tracers->N;n++)
+        if(tracers->tracer[n].output)
+          nc_write_3D_merge(ncid,prop->nctimectr,  StoredToREAL(tracers->c[n],phys->stmp,grid), prop, grid, tracers->tracer[n].name,0, numprocs, myproc, comm);
   
     // Vertical velocity 
     nc_write_3D_merge(ncid,prop->nctimectr,  phys->w, prop, grid, "w",1, numprocs, myproc, comm);
@@ -517,7 +579,7 @@ void WriteOutputNCmerge(propT *prop, gridT *grid, physT *phys, metT *met, int bl
 */
 void WriteOutputNC(propT *prop, gridT *grid, physT *phys, metT *met, int blowup, int myproc){
    int ncid = prop->outputNetcdfFileID;
-   int varid, retval, k;
+   int varid, retval, k, n;
    // Start and count vectors for one, two and three dimensional arrays
    const size_t startone[] = {prop->nctimectr};
    const size_t countone[] = {1};
@@ -577,7 +639,7 @@ void WriteOutputNC(propT *prop, gridT *grid, physT *phys, metT *met, int blowup,
 
     if ((retval = nc_inq_varid(ncid, "nu_v", &varid)))
 	ERR(retval);
-    ravel(phys->nu_tv, phys->tmpvar, grid);
+    ravel(StoredToREAL(phys->nu_tv,phys->stmp,grid), phys->tmpvar, grid);
     if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
 	ERR(retval);
     
@@ -585,7 +647,7 @@ void WriteOutputNC(propT *prop, gridT *grid, physT *phys, metT *met, int blowup,
      if(prop->beta>0){
        if ((retval = nc_inq_varid(ncid, "salt", &varid)))
 	  ERR(retval);
-      ravel(phys->s, phys->tmpvar, grid);
+      ravel(StoredToREAL(phys->s,phys->stmp,grid), phys->tmpvar, grid);
       if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
 	  ERR(retval);
      }
@@ -593,7 +655,7 @@ void WriteOutputNC(propT *prop, gridT *grid, physT *phys, metT *met, int blowup,
      if(prop->gamma>0){
 	if ((retval = nc_inq_varid(ncid, "temp", &varid)))
 	  ERR(retval);
-	ravel(phys->T, phys->tmpvar, grid);
+	ravel(StoredToREAL(phys->T,phys->stmp,grid), phys->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
 	  ERR(retval);
      }
@@ -609,17 +671,29 @@ void WriteOutputNC(propT *prop, gridT *grid, physT *phys, metT *met, int blowup,
      if(prop->calcage>0){ 
 	if ((retval = nc_inq_varid(ncid, "agec", &varid)))
 	  ERR(retval);
-	ravel(age->agec, phys->tmpvar, grid);
+	ravel(StoredToREAL(age->agec,phys->stmp,grid), phys->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
 	  ERR(retval);
 
 	if ((retval = nc_inq_varid(ncid, "agealpha", &varid)))
 	  ERR(retval);
-	ravel(age->agealpha, phys->tmpvar, grid);
+	ravel(StoredToREAL(age->agealpha,phys->stmp,grid), phys->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
 	  ERR(retval);
      }
 
+     if(prop->Ntracers>0){
+       for(n=0;n<tracers->N;n++){
+	 if(!tracers->tracer[n].output)
+	   continue;
+	 if ((retval = nc_inq_varid(ncid, tracers->tracer[n].name, &varid)))
+	   ERR(retval);
+	 ravel(StoredToREAL(tracers->c[n],phys->stmp,grid), phys->tmpvar, grid);
+	 if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, phys->tmpvar )))
+	   ERR(retval);
+       }
+     }
+
      // Vertical grid spacing
      if ((retval = nc_inq_varid(ncid, "dzz", &varid)))
        ERR(retval);
@@ -1230,6 +1304,25 @@ static void InitialiseOutputNCugridMerge(propT *prop, physT *phys, gridT *grid,
     nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
    }
    
+   //passive tracers
+   if(prop->Ntracers>0){
+     for(n=0;n<tracers->N;n++){
+       if(!tracers->tracer[n].output)
+         continue;
+       if ((retval = nc_def_var(ncid,tracers->tracer[n].name,NC_DOUBLE,3,dimidthree,&varid)))
+         ERR(retval);
+       if ((retval = nc_def_var_fill(ncid,varid,nofill,&FILLVALUE))) // Sets a _FillValue attribute
+         ERR(retval);
+       if ((retval = nc_def_var_deflate(ncid,varid,0,DEFLATE,DEFLATELEVEL))) // Compresses the variable
+         ERR(retval);
+       nc_addattr(ncid, varid,"long_name","Passive tracer concentration");
+       nc_addattr(ncid, varid,"units","");
+       nc_addattr(ncid, varid,"mesh","suntans_mesh");
+       nc_addattr(ncid, varid,"location","face");
+       nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
+     }
+   }
+
    //age
    if(prop->calcage>0){
      if ((retval = nc_def_var(ncid,"agec",NC_DOUBLE,3,dimidthree,&varid)))
@@ -2042,6 +2135,25 @@ void InitialiseOutputNCugrid(propT *prop, gridT *grid, physT *phys, metT *met, i
     nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
    }
    
+   //passive tracers
+   if(prop->Ntracers>0){
+     for(n=0;n<tracers->N;n++){
+       if(!tracers->tracer[n].output)
+         continue;
+       if ((retval = nc_def_var(ncid,tracers->tracer[n].name,NC_DOUBLE,3,dimidthree,&varid)))
+         ERR(retval);
+       if ((retval = nc_def_var_fill(ncid,varid,nofill,&FILLVALUE))) // Sets a _FillValue attribute
+         ERR(retval);
+       if ((retval = nc_def_var_deflate(ncid,varid,0,DEFLATE,DEFLATELEVEL))) // Compresses the variable
+         ERR(retval);
+       nc_addattr(ncid, varid,"long_name","Passive tracer concentration");
+       nc_addattr(ncid, varid,"units","");
+       nc_addattr(ncid, varid,"mesh","suntans_mesh");
+       nc_addattr(ncid, varid,"location","face");
+       nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
+     }
+   }
+
    //age
    if(prop->calcage>0){
      if ((retval = nc_def_var(ncid,"agec",NC_DOUBLE,3,dimidthree,&varid)))
@@ -2314,7 +2426,7 @@ void InitialiseOutputNCugrid(propT *prop, gridT *grid, physT *phys, metT *met, i
 */
 void InitialiseAverageNCugridMerge(propT *prop, gridT *grid, averageT *average, int myproc){
    int ncid = prop->averageNetcdfFileID;
-   int retval, k;
+   int retval, k, n;
    int varid;
    int dimid_Nc, dimid_Ne , dimid_Np, dimid_time, dimid_numsides, dimid_Two, dimid_Nkw, dimid_Nk; 
    int dimidone[1];
@@ -2845,6 +2957,25 @@ void InitialiseAverageNCugridMerge(propT *prop, gridT *grid, averageT *average,
     nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
    }
    
+   //passive tracers
+   if(prop->Ntracers>0){
+     for(n=0;n<tracers->N;n++){
+       if(!tracers->tracer[n].average)
+         continue;
+       if ((retval = nc_def_var(ncid,tracers->tracer[n].name,NC_DOUBLE,3,dimidthree,&varid)))
+         ERR(retval);
+       if ((retval = nc_def_var_fill(ncid,varid,nofill,&FILLVALUE))) // Sets a _FillValue attribute
+         ERR(retval);
+       if ((retval = nc_def_var_deflate(ncid,varid,0,DEFLATE,DEFLATELEVEL))) // Compresses the variable
+         ERR(retval);
+       nc_addattr(ncid, varid,"long_name","Passive tracer concentration");
+       nc_addattr(ncid, varid,"units","");
+       nc_addattr(ncid, varid,"mesh","suntans_mesh");
+       nc_addattr(ncid, varid,"location","face");
+       nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
+     }
+   }
+
    //age
    if(prop->calcage>0){
      if ((retval = nc_def_var(ncid,"agec",NC_DOUBLE,3,dimidthree,&varid)))
@@ -3113,7 +3244,7 @@ void InitialiseAverageNCugridMerge(propT *prop, gridT *grid, averageT *average,
 */
 void InitialiseAverageNCugrid(propT *prop, gridT *grid, averageT *average, int myproc){
    int ncid = prop->averageNetcdfFileID;
-   int retval, k;
+   int retval, k, n;
    int varid;
    int dimid_Nc, dimid_Ne , dimid_Np, dimid_time, dimid_numsides, dimid_Two, dimid_Nkw, dimid_Nk; 
    int dimidone[1];
@@ -3649,6 +3780,25 @@ void InitialiseAverageNCugrid(propT *prop, gridT *grid, averageT *average, int m
     nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
    }
    
+   //passive tracers
+   if(prop->Ntracers>0){
+     for(n=0;n<tracers->N;n++){
+       if(!tracers->tracer[n].average)
+         continue;
+       if ((retval = nc_def_var(ncid,tracers->tracer[n].name,NC_DOUBLE,3,dimidthree,&varid)))
+         ERR(retval);
+       if ((retval = nc_def_var_fill(ncid,varid,nofill,&FILLVALUE))) // Sets a _FillValue attribute
+         ERR(retval);
+       if ((retval = nc_def_var_deflate(ncid,varid,0,DEFLATE,DEFLATELEVEL))) // Compresses the variable
+         ERR(retval);
+       nc_addattr(ncid, varid,"long_name","Passive tracer concentration");
+       nc_addattr(ncid, varid,"units","");
+       nc_addattr(ncid, varid,"mesh","suntans_mesh");
+       nc_addattr(ncid, varid,"location","face");
+       nc_addattr(ncid, varid,"coordinates","time z_r yv xv");
+     }
+   }
+
    //age
    if(prop->calcage>0){
      if ((retval = nc_def_var(ncid,"agec",NC_DOUBLE,3,dimidthree,&varid)))
@@ -3910,7 +4060,7 @@ void InitialiseAverageNCugrid(propT *prop, gridT *grid, averageT *average, int m
 */
 void WriteAverageNCmerge(propT *prop, gridT *grid, averageT *average, physT *phys, metT *met, int blowup, int numprocs, MPI_Comm comm, int myproc){
    int ncid;// = prop->averageNetcdfFileID;
-   int varid, retval, k;
+   int varid, retval, k, n;
    // Start and count vectors for one, two and three dimensional arrays
    size_t startone[] = {prop->avgtimectr};
    size_t countone[] = {1};
@@ -4018,25 +4168,30 @@ void WriteAverageNCmerge(propT *prop, gridT *grid, averageT *average, physT *phy
     }
 
     // 3D cell-centered variables
-    nc_write_3D_merge(ncid,prop->avgtimectr,  average->uc, prop, grid, "uc",0, numprocs, myproc, comm);
-    nc_write_3D_merge(ncid,prop->avgtimectr,  average->vc, prop, grid, "vc",0, numprocs, myproc, comm);
-    nc_write_3D_merge(ncid,prop->avgtimectr,  average->nu_v, prop, grid, "nu_v",0, numprocs, myproc, comm);
-    nc_write_3D_merge(ncid,prop->avgtimectr,  average->kappa_tv, prop, grid, "kappa_tv",0, numprocs, myproc, comm);
+    nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->uc,phys->stmp,grid), prop, grid, "uc",0, numprocs, myproc, comm);
+    nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->vc,phys->stmp,grid), prop, grid, "vc",0, numprocs, myproc, comm);
+    nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->nu_v,phys->stmp,grid), prop, grid, "nu_v",0, numprocs, myproc, comm);
+    nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->kappa_tv,phys->stmp,grid), prop, grid, "kappa_tv",0, numprocs, myproc, comm);
 
 
     if(prop->beta>0)
-	nc_write_3D_merge(ncid,prop->avgtimectr,  average->s, prop, grid, "salt",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->s,phys->stmp,grid), prop, grid, "salt",0, numprocs, myproc, comm);
 
     if(prop->gamma>0)
-	nc_write_3D_merge(ncid,prop->avgtimectr,  average->T, prop, grid, "temp",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->T,phys->stmp,grid), prop, grid, "temp",0, numprocs, myproc, comm);
 
     if( (prop->gamma>0) || (prop->beta>0) ) 
-	nc_write_3D_merge(ncid,prop->avgtimectr,  average->rho, prop, grid, "rho",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->rho,phys->stmp,grid), prop, grid, "rho",0, numprocs, myproc, comm);
 
     if(prop->calcage){
-	nc_write_3D_merge(ncid,prop->avgtimectr,  average->agec, prop, grid, "agec",0, numprocs, myproc, comm);
-	nc_write_3D_merge(ncid,prop->avgtimectr,  average->agealpha, prop, grid, "agealpha",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->agec,phys->stmp,grid), prop, grid, "agec",0, numprocs, myproc, comm);
+	nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->agealpha,phys->stmp,grid), prop, grid, "agealpha",0, numprocs, myproc, comm);
     }
+
+    if(prop->Ntracers>0)
+      for(n=0;n<tracers->N;n++)
+        if(average->tracers[n])
+          nc_write_3D_merge(ncid,prop->avgtimectr,  StoredToREAL(average->tracers[n],phys->stmp,grid), prop, grid, tracers->tracer[n].name,0, numprocs, myproc, comm);
   
     // Vertical velocity 
     nc_write_3D_merge(ncid,prop->avgtimectr,  average->w, prop, grid, "w",1, numprocs, myproc, comm);
@@ -4069,7 +4224,7 @@ void WriteAverageNCmerge(propT *prop, gridT *grid, averageT *average, physT *phy
 */
 void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, metT *met, int blowup, MPI_Comm comm, int myproc){
    int ncid = prop->averageNetcdfFileID;
-   int varid, retval, k;
+   int varid, retval, k, n;
    // Start and count vectors for one, two and three dimensional arrays
    const size_t startone[] = {prop->avgtimectr};
    const size_t countone[] = {1};
@@ -4129,13 +4284,13 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
     
     if ((retval = nc_inq_varid(ncid, "uc", &varid)))
 	ERR(retval);
-    ravel(average->uc, average->tmpvar, grid);
+    ravel(StoredToREAL(average->uc,phys->stmp,grid), average->tmpvar, grid);
     if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	ERR(retval);
     
     if ((retval = nc_inq_varid(ncid, "vc", &varid)))
 	ERR(retval);
-    ravel(average->vc, average->tmpvar, grid);
+    ravel(StoredToREAL(average->vc,phys->stmp,grid), average->tmpvar, grid);
     if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	ERR(retval);
       
@@ -4148,13 +4303,13 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
 
     if ((retval = nc_inq_varid(ncid, "nu_v", &varid)))
 	ERR(retval);
-    ravel(average->nu_v, average->tmpvar, grid);
+    ravel(StoredToREAL(average->nu_v,phys->stmp,grid), average->tmpvar, grid);
     if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	ERR(retval);
 
     if ((retval = nc_inq_varid(ncid, "kappa_tv", &varid)))
 	ERR(retval);
-    ravel(average->kappa_tv, average->tmpvar, grid);
+    ravel(StoredToREAL(average->kappa_tv,phys->stmp,grid), average->tmpvar, grid);
     if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	ERR(retval);
     
@@ -4162,7 +4317,7 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
      if(prop->beta>0){
        if ((retval = nc_inq_varid(ncid, "salt", &varid)))
 	  ERR(retval);
-      ravel(average->s, average->tmpvar, grid);
+      ravel(StoredToREAL(average->s,phys->stmp,grid), average->tmpvar, grid);
       if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	  ERR(retval);
 
@@ -4175,7 +4330,7 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
      if(prop->gamma>0){
 	if ((retval = nc_inq_varid(ncid, "temp", &varid)))
 	  ERR(retval);
-	ravel(average->T, average->tmpvar, grid);
+	ravel(StoredToREAL(average->T,phys->stmp,grid), average->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	  ERR(retval);
 
@@ -4188,7 +4343,7 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
      if( (prop->gamma>0) || (prop->beta>0) ){ 
 	if ((retval = nc_inq_varid(ncid, "rho", &varid)))
 	  ERR(retval);
-	ravel(average->rho, average->tmpvar, grid);
+	ravel(StoredToREAL(average->rho,phys->stmp,grid), average->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	  ERR(retval);
      }
@@ -4196,18 +4351,30 @@ void WriteAverageNC(propT *prop, gridT *grid, averageT *average, physT *phys, me
      if(prop->calcage>0){ 
 	if ((retval = nc_inq_varid(ncid, "agec", &varid)))
 	  ERR(retval);
-	ravel(average->agec, average->tmpvar, grid);
+	ravel(StoredToREAL(average->agec,phys->stmp,grid), average->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	  ERR(retval);
 
 	if ((retval = nc_inq_varid(ncid, "agealpha", &varid)))
 	  ERR(retval);
-	ravel(average->agealpha, average->tmpvar, grid);
+	ravel(StoredToREAL(average->agealpha,phys->stmp,grid), average->tmpvar, grid);
 	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
 	  ERR(retval);
 
     }
 
+    if(prop->Ntracers>0){
+      for(n=0;n<tracers->N;n++){
+	if(!average->tracers[n])
+	  continue;
+	if ((retval = nc_inq_varid(ncid, tracers->tracer[n].name, &varid)))
+	  ERR(retval);
+	ravel(StoredToREAL(average->tracers[n],phys->stmp,grid), average->tmpvar, grid);
+	if ((retval = nc_put_vara_double(ncid, varid, startthree, countthree, average->tmpvar )))
+	  ERR(retval);
+      }
+    }
+
      // Edge fluxes
      countthree[2] = grid->Ne;
      if ((retval = nc_inq_varid(ncid, "U_F", &varid)))
@@ -4667,11 +4834,16 @@ size_t returndimlen(int ncid, char *dimname){
  * -----------------------------
  * Reads in boundary netcdf data into the forward and back time steps 
  *
+ * Each processor only reads the slab of boundary points spanned by its own
+ * grid (bound->j2start..j2end and j3start..j3end, found by BdySlabRange on the
+ * first call so that every boundaries.c which matches the points can use it), and
+ * processors without any boundary points do not touch the file. When the time
+ * window has advanced by a single record the records already in memory are
+ * shifted down and only the new record is read.
+ *
  */     
 void ReadBdyNC(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
-    int retval, j, k, n, p, sendSize;
-    int t0, t1;
-    int varid;
+    int t0, n0, nrec;
     char *vname;
     size_t start[]={0,0,0};
     size_t start2[]={0,0};
@@ -4679,141 +4851,215 @@ void ReadBdyNC(propT *prop, gridT *grid, int myproc, MPI_Comm comm){
     size_t count2[]={0,0};
     int ncid = prop->netcdfBdyFileID;  
     size_t Nk = bound->Nk;
-    size_t Ntype3 = bound->Ntype3;
-    size_t Ntype2 = bound->Ntype2;
     size_t Nseg = bound->Nseg;
 
-    //Find the time index of the middle time step (t1) 
+    //Find the time index of the middle time step (t1) and, on the first call,
+    //the slab of boundary points needed by this processor
     if(bound->t0==-1){
-       bound->t1 = getTimeRecBnd(prop->nctime,bound->time,(int)bound->Nt); //this is in met.c
+       InitTimeCursor(&(bound->cursor));
+       bound->tread=-1;
+       BdySlabRange(grid,myproc);
+       bound->t1 = TimeCursorSearch(&(bound->cursor),prop->nctime,bound->time,(int)bound->Nt);
        bound->t0=bound->t1-1;
        bound->t2=bound->t1+1;
        printf("myproc: %d, bound->t0: %d, nctime: %f\n",myproc,bound->t0, prop->nctime);
     }
     t0 = bound->t0;
 
-    count[0]=NT;
+    // Work out which records need to be read
+    if(bound->tread!=-1 && t0==bound->tread)
+      return;
+    else if(bound->tread!=-1 && t0==bound->tread+1) {
+      ShiftBdyRecords();
+      n0=NT-1;
+      nrec=1;
+    } else {
+      n0=0;
+      nrec=NT;
+    }
+    bound->tread=t0;
+
+    count[0]=nrec;
     count[1]=Nk;
 
-    count2[0]=NT;
+    count2[0]=nrec;
 
-    start[0]=t0;
+    start[0]=t0+n0;
     start[1]=0;
-    start[2]=0;
 
-    start2[0]=t0;
-    start2[1]=0;
+    start2[0]=t0+n0;
 
     //if(myproc==0) printf("t0 = %d [Nt = %d]\n",t0,bound->Nt);    
-    if(bound->hasType2){
+    if(bound->hasType2 && bound->j2end>=bound->j2start){
 
-	count[2]=Ntype2;
+	start[2]=bound->j2start;
+	count[2]=bound->j2end-bound->j2start+1;
 
-	//Only read the data on the first processor
-	//if(myproc==0){
-	    vname = "boundary_u";
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_3D(ncid, vname, start, count, bound->boundary_u_t );
+	vname = "boundary_u";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->boundary_u_t );
 
-	    vname = "boundary_v";
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_3D(ncid, vname, start, count, bound->boundary_v_t );
+	vname = "boundary_v";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->boundary_v_t );
 
-	    vname = "boundary_w";
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_3D(ncid, vname, start, count, bound->boundary_w_t );
+	vname = "boundary_w";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->boundary_w_t );
 
-	    vname = "boundary_T";
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_3D(ncid, vname, start, count, bound->boundary_T_t );
-
-	    vname = "boundary_S";
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_3D(ncid, vname, start, count, bound->boundary_S_t );
-	//}
-	
-	/*
-  	// Distribute the data to the other processors
-	sendSize = count[0]*count[1]*count[2];
-	MPI_Bcast(&(bound->boundary_u_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->boundary_v_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->boundary_w_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->boundary_T_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->boundary_S_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	*/
+	vname = "boundary_T";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->boundary_T_t );
 
+	vname = "boundary_S";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->boundary_S_t );
     }
 
-    if(bound->hasType3){
-	count[0]=NT;
-	count[1]=Nk;
-	count[2]=Ntype3;
-	count2[1]=Ntype3;
-
-        sendSize = count[0]*count[1]*count[2];
-
-	//Only read the data on the first processor
-	//if(myproc==0){
-	  vname = "uc";
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-          nc_read_3D(ncid, vname, start, count, bound->uc_t );
-
-	  vname = "vc";
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	  nc_read_3D(ncid, vname, start, count, bound->vc_t );
-
-	  vname = "wc";
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	  nc_read_3D(ncid, vname, start, count, bound->wc_t );
-
-	  vname = "T";
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	  nc_read_3D(ncid, vname, start, count, bound->T_t );
-
-	  vname = "S";
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	  nc_read_3D(ncid, vname, start, count, bound->S_t);
-
-	  vname = "h";//2D array
-	  if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	  nc_read_2D(ncid, vname, start2, count2, bound->h_t, myproc );
-
-	//}
-
-	/*
-  	// Distribute the data to the other processors
-	sendSize = count[0]*count[1]*count[2];
-	MPI_Bcast(&(bound->uc_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->vc_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->wc_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->T_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	MPI_Bcast(&(bound->S_t[0][0][0]),sendSize,MPI_DOUBLE,0,comm);
-	sendSize = count2[0]*count2[1];
-	MPI_Bcast(&(bound->h_t[0][0]),sendSize,MPI_DOUBLE,0,comm);
-	*/
+    if(bound->hasType3 && bound->j3end>=bound->j3start){
+
+	start[2]=bound->j3start;
+	count[2]=bound->j3end-bound->j3start+1;
+	start2[1]=bound->j3start;
+	count2[1]=count[2];
+
+	vname = "uc";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->uc_t );
+
+	vname = "vc";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->vc_t );
 
+	vname = "wc";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->wc_t );
+
+	vname = "T";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->T_t );
+
+	vname = "S";
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_3D_sub(ncid, vname, start, count, n0, bound->S_t);
+
+	vname = "h";//2D array
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_2D_sub(ncid, vname, start2, count2, n0, bound->h_t);
 
      }// End read type-3
 
-     //Flux boundary data
+     //Flux boundary data (segment areas are summed across processors so all
+     //processors need every segment)
      if(bound->hasType2 && bound->hasSeg){
 
+	start2[1]=0;
 	count2[1]=Nseg;
-	//if(myproc==0){
-	    vname = "boundary_Q";//2D array
-	    if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
-	    nc_read_2D(ncid, vname, start2, count2, bound->boundary_Q_t, myproc);
-	//}
-	//sendSize = count2[0]*count2[1];
-	//MPI_Bcast(&(bound->boundary_Q_t[0][0]),sendSize,MPI_DOUBLE,0,comm);
+	vname = "boundary_Q";//2D array
+	if(VERBOSE>2 && myproc==0) printf("Reading variable: %s from boundry netcdf file...\n",vname);
+	nc_read_2D_sub(ncid, vname, start2, count2, n0, bound->boundary_Q_t);
 
      }//End flux read
 
-   // Wait for all processors
-   //MPI_Barrier(comm);
-
  }//End function
 
+/*
+ * Function: ShiftBdyRecords()
+ * ---------------------------
+ * Shifts the boundary time records down by one so that the record
+ * in slot n+1 is now in slot n.  The oldest record is recycled into
+ * the last slot and is overwritten by the next read.
+ *
+ */
+static void ShiftBdyRecords(void){
+    int n;
+    REAL **tmp2, *tmp1;
+
+    if(bound->hasType2){
+      tmp2=bound->boundary_u_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_u_t[n]=bound->boundary_u_t[n+1];
+      bound->boundary_u_t[NT-1]=tmp2;
+      tmp2=bound->boundary_v_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_v_t[n]=bound->boundary_v_t[n+1];
+      bound->boundary_v_t[NT-1]=tmp2;
+      tmp2=bound->boundary_w_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_w_t[n]=bound->boundary_w_t[n+1];
+      bound->boundary_w_t[NT-1]=tmp2;
+      tmp2=bound->boundary_T_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_T_t[n]=bound->boundary_T_t[n+1];
+      bound->boundary_T_t[NT-1]=tmp2;
+      tmp2=bound->boundary_S_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_S_t[n]=bound->boundary_S_t[n+1];
+      bound->boundary_S_t[NT-1]=tmp2;
+    }
+    if(bound->hasType2 && bound->hasSeg){
+      tmp1=bound->boundary_Q_t[0];
+      for(n=0;n<NT-1;n++) bound->boundary_Q_t[n]=bound->boundary_Q_t[n+1];
+      bound->boundary_Q_t[NT-1]=tmp1;
+    }
+    if(bound->hasType3){
+      tmp2=bound->uc_t[0];
+      for(n=0;n<NT-1;n++) bound->uc_t[n]=bound->uc_t[n+1];
+      bound->uc_t[NT-1]=tmp2;
+      tmp2=bound->vc_t[0];
+      for(n=0;n<NT-1;n++) bound->vc_t[n]=bound->vc_t[n+1];
+      bound->vc_t[NT-1]=tmp2;
+      tmp2=bound->wc_t[0];
+      for(n=0;n<NT-1;n++) bound->wc_t[n]=bound->wc_t[n+1];
+      bound->wc_t[NT-1]=tmp2;
+      tmp2=bound->T_t[0];
+      for(n=0;n<NT-1;n++) bound->T_t[n]=bound->T_t[n+1];
+      bound->T_t[NT-1]=tmp2;
+      tmp2=bound->S_t[0];
+      for(n=0;n<NT-1;n++) bound->S_t[n]=bound->S_t[n+1];
+      bound->S_t[NT-1]=tmp2;
+      tmp1=bound->h_t[0];
+      for(n=0;n<NT-1;n++) bound->h_t[n]=bound->h_t[n+1];
+      bound->h_t[NT-1]=tmp1;
+    }
+}
+/*
+ * Function: BdySlabRange()
+ * -----------------------------
+ * Find the range of type-2 and type-3 file points referenced by this
+ * processor's grid so that ReadBdyNC only reads that slab rather than the
+ * whole boundary.  Requires localedgep, ind3 and ind3edge from MatchBndPoints.
+ * An empty range has end<start.
+ *
+ */
+static void BdySlabRange(gridT *grid, int myproc){
+    int ii, jj;
+
+    bound->j2start=bound->Ntype2;
+    bound->j2end=-1;
+    if(bound->hasType2)
+      for(jj=0;jj<bound->Ntype2;jj++)
+	if(bound->localedgep[jj]!=-1) {
+	  if(jj<bound->j2start) bound->j2start=jj;
+	  if(jj>bound->j2end) bound->j2end=jj;
+	}
+    if(bound->j2end<0) bound->j2start=0;
+
+    bound->j3start=bound->Ntype3;
+    bound->j3end=-1;
+    if(bound->hasType3) {
+      for(ii=0;ii<grid->celldist[2]-grid->celldist[1];ii++)
+	if(bound->ind3[ii]!=-1) {
+	  if(bound->ind3[ii]<bound->j3start) bound->j3start=bound->ind3[ii];
+	  if(bound->ind3[ii]>bound->j3end) bound->j3end=bound->ind3[ii];
+	}
+      for(ii=0;ii<grid->edgedist[4]-grid->edgedist[3];ii++)
+	if(bound->ind3edge[ii]!=-1) {
+	  if(bound->ind3edge[ii]<bound->j3start) bound->j3start=bound->ind3edge[ii];
+	  if(bound->ind3edge[ii]>bound->j3end) bound->j3end=bound->ind3edge[ii];
+	}
+    }
+    if(bound->j3end<0) bound->j3start=0;
+    if(VERBOSE>2) printf("Processor %d reading type-2 points %d-%d, type-3 points %d-%d\n",
+			 myproc,bound->j2start,bound->j2end,bound->j3start,bound->j3end);
+}
+//End function
+
 /*
  * Function: ReadBndNCcoord()
  * --------------------------
@@ -4999,7 +5245,7 @@ return dimlen;
  */
 int getICtime(propT *prop, int Nt, int myproc){
 
-   int retval, varid;
+   int retval, varid, T0;
    int ncid = prop->initialNCfileID;
    //REAL time[Nt]; 
    REAL *ictime;
@@ -5015,7 +5261,9 @@ int getICtime(propT *prop, int Nt, int myproc){
       ERR(retval); 
     if(VERBOSE>2 && myproc==0) printf("done.\n");
 
-    return getTimeRecBnd(prop->nctime, ictime, (int)Nt);
+    T0 = getTimeRecBnd(prop->nctime, ictime, (int)Nt);
+    SunFree(ictime,Nt*sizeof(REAL),"getICtime");
+    return T0;
 
 } // End function
 
@@ -5178,16 +5426,10 @@ void ReturnAgeNC(propT *prop, gridT *grid, REAL *htmp, int Nci, int Nki, int T0,
 /*
 * Function: GetTimeRecBnd()
 * ------------------
-* Retuns the index of the first preceding time step in the vector time
+* Retuns the index of the first time step in the vector time at or after nctime
+* (found by bisection, so time must be increasing)
 */
 int getTimeRecBnd(REAL nctime, REAL *time, int nt){
-    int j;
-
-    for(j=0;j<nt;j++){
-       if (time[j]>=nctime)
-	 //return j-1;
-	 return j;
-    }
-    return nt;
+    return SearchTime(nctime,time,0,nt);
 }
 
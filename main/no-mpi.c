@@ -62,7 +62,15 @@ int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_
 
 int MPI_Reduce (void *sendbuf, void *recvbuf, int count, 
 		MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm ) {
-  memcpy(recvbuf,sendbuf,datatype);
+  memcpy(recvbuf,sendbuf,count*datatype);
+
+  return 0;
+}
+
+int MPI_Allreduce (void *sendbuf, void *recvbuf, int count, 
+		   MPI_Datatype datatype, MPI_Op op, MPI_Comm comm ) {
+  if(sendbuf!=MPI_IN_PLACE)
+    memcpy(recvbuf,sendbuf,count*datatype);
 
   return 0;
 }
@@ -15,6 +15,7 @@
 #define MPI_DOUBLE 8
 #define MPI_INT 4
 #define MPI_UNSIGNED 4
+#define MPI_UNSIGNED_LONG_LONG 8
 #define MPI_COMM_WORLD 0
 #define MPI_SUM 3
 #define MPI_STATUS_IGNORE NULL
@@ -48,6 +49,8 @@ int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag,
 int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]);
 int MPI_Reduce (void *sendbuf, void *recvbuf, int count, 
 		MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm );
+int MPI_Allreduce (void *sendbuf, void *recvbuf, int count, 
+		   MPI_Datatype datatype, MPI_Op op, MPI_Comm comm );
 int MPI_Gather (void *sendbuf, int sendcnt, MPI_Datatype sendtype, 
 		void *recvbuf, int recvcount, MPI_Datatype recvtype, 
 		int root, MPI_Comm comm );
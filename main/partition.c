@@ -75,7 +75,8 @@ void GetPartitioning(gridT *maingrid, gridT **localgrid, int myproc, int numproc
  * Usage GetGraph(graph,grid,comm);
  * --------------------------------
  * This code was adapted from the ParMetis-2.0 code in the ParMetis
- * distribution.
+ * distribution.  The xadj and adjncy arrays of grid are only read and
+ * remain owned by grid, since ReOrder uses them after the partitioning.
  *
  */
 static void GetGraph(GraphType *graph, gridT *grid, MPI_Comm comm)
@@ -171,9 +172,6 @@ static void GetGraph(GraphType *graph, gridT *grid, MPI_Comm comm)
   else 
     MPI_Recv((void *)graph->adjncy, graph->nedges, IDX_DATATYPE, 0, 1, comm, &status);
 
-  if (myproc == 0) 
-    GKfree(&gxadj, &gadjncy, LTERM);
-
   MALLOC_CHECK(NULL);
 }
 
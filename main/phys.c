@@ -23,15 +23,24 @@
 #include "timer.h"
 #include "profiles.h"
 #include "state.h"
+#include "eos.h"
 #include "diffusion.h"
 #include "sources.h"
 #include "mynetcdf.h"
 #include "met.h"
 #include "age.h"
+#include "tracers.h"
 #include "physio.h"
 #include "merge.h"
 #include "sediments.h"
 
+// Largest factor by which AdaptTimeStep increases dt in one adjustment
+#define DTGROWTH 1.1
+// Changes of dt smaller than this fraction are not made (keeps the AB coefficients fixed)
+#define DTDEADBAND 0.05
+// Number of memory categories reported by PlanPhysicalMemory
+#define PHYSMEMCATEGORIES 10
+
 /*
  * Private Function declarations.
  *
@@ -47,6 +56,12 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop,
 static void HPreconditioner(REAL *x, REAL *y, gridT *grid, physT *phys, propT *prop);
 static void HCoefficients(REAL *coef, REAL *fcoef, gridT *grid, physT *phys, 
     propT *prop);
+static void AssembleHOperator(gridT *grid, physT *phys);
+static void HFactor(gridT *grid, physT *phys, propT *prop, int myproc);
+static void HProjectGuess(REAL *x, REAL *b, REAL *r, REAL bnorm, gridT *grid, 
+    physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm);
+static void HProjectUpdate(REAL *x, REAL *r, int niters, gridT *grid, physT *phys, 
+    propT *prop, int myproc, int numprocs, MPI_Comm comm);
 static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, 
     propT *prop, 
     int myproc, int numprocs, MPI_Comm comm);
@@ -56,6 +71,12 @@ static void Preconditioner(REAL **x, REAL **xc, REAL **coef, gridT *grid, physT
     propT *prop);
 static void GuessQ(REAL **q, REAL **wold, REAL **w, gridT *grid, physT *phys, 
     propT *prop, int myproc, int numprocs, MPI_Comm comm);
+static void QProjectGuess(REAL **x, REAL **b, gridT *grid, physT *phys, 
+    propT *prop, int myproc, int numprocs, MPI_Comm comm);
+static void QProjectResidual(REAL **x, REAL **r, REAL **b, REAL bnorm, gridT *grid, physT *phys, 
+    propT *prop, int myproc, int numprocs, MPI_Comm comm);
+static void QProjectUpdate(REAL **x, REAL **r, REAL **c, int niters, gridT *grid, 
+    physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm);
 static void GSSolve(gridT *grid, physT *phys, propT *prop, 
     int myproc, int numprocs, MPI_Comm comm);
 static REAL InnerProduct(REAL *x, REAL *y, gridT *grid, int myproc, int numprocs, 
@@ -76,21 +97,28 @@ static void EddyViscosity(gridT *grid, physT *phys, propT *prop, REAL **wnew,
     MPI_Comm comm, int myproc);
 static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
     int myproc, int numprocs, MPI_Comm comm);
+static void ABCoefficients(propT *prop, REAL *fab1, REAL *fab2, REAL *fab3);
+static void AdaptTimeStep(physT *phys, propT *prop, int myproc);
 static void StoreVariables(gridT *grid, physT *phys);
+static void AccumulateScalarFluxes(gridT *grid, physT *phys, propT *prop);
+static void SetScalarFluxes(gridT *grid, physT *phys);
+static void SwapScalarFluxes(gridT *grid, physT *phys);
 static void NewCells(gridT *grid, physT *phys, propT *prop);
+static void UpdateWetCells(gridT *grid, physT *phys, int option);
 static void WPredictor(gridT *grid, physT *phys, propT *prop,
     int myproc, int numprocs, MPI_Comm comm);
 void ComputeUC(REAL **ui, REAL **vi, physT *phys, gridT *grid, int myproc, interpolation interp);
-static void ComputeUCPerot(REAL **u, REAL **uc, REAL **vc, gridT *grid);
+static int NeedRTInterpolation(propT *prop);
+static void ComputeUCWeights(gridT *grid, physT *phys, propT *prop);
+static void UCFaceSum(REAL **u, REAL *uc, REAL *vc, int n, int kstart, int kend, 
+    REAL **dzf, REAL *weights, gridT *grid);
+static void ComputeUCPerot(REAL **u, REAL **uc, REAL **vc, gridT *grid, physT *phys);
 static void ComputeUCLSQ(REAL **u, REAL **uc, REAL **vc, gridT *grid, physT *phys);
 static void ComputeUCRT(REAL **ui, REAL **vi, physT *phys, gridT *grid, int myproc);
 static void ComputeNodalVelocity(physT *phys, gridT *grid, interpolation interp, int myproc);
 static void  ComputeTangentialVelocity(physT *phys, gridT *grid, interpolation ninterp, interpolation tinterp,int myproc);
-static void  ComputeQuadraticInterp(REAL x, REAL y, int ic, int ik, REAL **uc, 
-    REAL **vc, physT *phys, gridT *grid, interpolation ninterp, 
-    interpolation tinterp, int myproc);
-static void ComputeRT0Velocity(REAL* tempu, REAL* tempv, REAL e1n1, REAL e1n2, 
-    REAL e2n1, REAL e2n2, REAL Uj1, REAL Uj2);
+static void  ComputeQuadraticInterp(int ic, REAL **uc, REAL **vc, physT *phys, gridT *grid, 
+    interpolation tinterp);
 static void BarycentricCoordsFromCartesian(gridT *grid, int cell, 
     REAL x, REAL y, REAL* lambda);
 static void BarycentricCoordsFromCartesianEdge(gridT *grid, int cell, 
@@ -104,6 +132,100 @@ void SetFluxHeight(gridT *grid, physT *phys, propT *prop);
 static void GetMomentumFaceValues(REAL **uface, REAL **ui, REAL **boundary_ui, REAL **U, gridT *grid, physT *phys, propT *prop, MPI_Comm comm, int myproc, int nonlinear);
 static void getTsurf(gridT *grid, physT *phys);
 static void getchangeT(gridT *grid, physT *phys);
+/*
+ * Function: PlanPhysicalMemory
+ * Usage: PlanPhysicalMemory(grid,prop,myproc,comm);
+ * -------------------------------------------------
+ * Estimates the memory that will be allocated on each processor for the
+ * physical variables and for the optional modules, by category, given the
+ * features selected in suntans.dat.  Only the fields needed by the selected
+ * features are allocated by AllocatePhysicalVariables, AllocateAverageVariables,
+ * AllocateAgeVariables, AllocateMet, and InitializeTracers, where the averages
+ * of all of the tracers are counted.  The largest footprint of any processor
+ * in each category is printed by processor 0 when VERBOSE>1.  Pointer tables
+ * and the meteorological input data are not included.
+ *
+ */
+void PlanPhysicalMemory(gridT *grid, propT *prop, int myproc, MPI_Comm comm)
+{
+  int i, j, jptr, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, Nb=0;
+  REAL N3c=0, N3e=0, N3ke=0, N3p=0, N3pc=0, N3f=0, Npc=0, Nbk=0, Nf=0, N2d;
+  REAL R=sizeof(REAL), S=sizeof(SREAL), P=sizeof(REAL *);
+  REAL Fc, Fs, Fw, Fe, Fb, bytes[PHYSMEMCATEGORIES], maxbytes[PHYSMEMCATEGORIES], total=0;
+  char *names[PHYSMEMCATEGORIES] = {"core","interpolation","nonhydrostatic","turbulence",
+    "subcycling","projection","averages","age","met","tracers"};
+
+  for(i=0;i<Nc;i++) {
+    N3c+=grid->Nk[i];
+    N3f+=grid->nfaces[i]*grid->Nk[i];
+    Nf+=grid->nfaces[i];
+  }
+  for(j=0;j<Ne;j++) {
+    N3e+=grid->Nkc[j];
+    N3ke+=grid->Nke[j];
+  }
+  for(i=0;i<Np;i++) {
+    N3p+=grid->Nkp[i];
+    N3pc+=grid->Nkp[i]*grid->numpcneighs[i];
+    Npc+=grid->numpcneighs[i];
+  }
+  for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
+    Nb++;
+    Nbk+=grid->Nke[grid->edgep[jptr]];
+  }
+
+  // Size of one depth-varying field at the cells (REAL, SREAL, and at the w points),
+  // the edges, and the boundary edges, including its table of pointers
+  Fc = R*N3c+P*Nc;
+  Fs = S*N3c+P*Nc;
+  Fw = R*(N3c+Nc)+P*Nc;
+  Fe = R*N3e+P*Ne;
+  Fb = R*Nbk+P*Nb;
+  // Arrays of size Nc*Nkmax, Ne*Nkmax, and Nc*(Nkmax+1) used for output
+  N2d = R*(Nc*grid->Nkmax+Ne*grid->Nkmax+Nc*(grid->Nkmax+1));
+
+  for(i=0;i<PHYSMEMCATEGORIES;i++)
+    bytes[i]=0;
+
+  // Includes the free-surface operator of AssembleHOperator
+  bytes[0] = 8*Fe+18*Fc+4*Fs+6*Fw+7*Fb+R*(4*Nb+5*Ne+18*Nc+2*Nc*grid->maxfaces+14*(grid->Nkmax+1))
+    + N2d + (sizeof(char)+2*sizeof(int))*Nc + (3*sizeof(int)+R)*(Nc+Nf);
+  if(NeedRTInterpolation(prop))
+    bytes[1] = R*(2*N3pc+2*N3p+2*N3e+6*Nc+4*Npc+2*(prop->interp==LSQ)*Nc*grid->maxfaces) + P*(2*N3p+6*Np+2*Ne);
+  if(prop->nonhydrostatic)
+    bytes[2] = R*N3f + P*grid->maxfaces*Nc;
+  if(prop->turbmodel>=1)
+    bytes[3] = 2*Fs + 4*Fc;
+  if(prop->ntscalar>1)
+    bytes[4] = 3*Fe + 2*Fw + Fc + sizeof(int)*Nc;
+  if(prop->nprojection>0)
+    bytes[5] = (prop->nprojection+1)*(R*(2*Nc+1)+(prop->nonhydrostatic ? 2*Fc+R : 0));
+  if(prop->calcaverage)
+    bytes[6] = (7+2*(prop->calcage>0)+prop->Ntracers)*Fs + Fw + Fc + 3*(R*N3ke+P*Ne) + R*(4+14*(prop->metmodel>0))*Nc + N2d;
+  if(prop->calcage)
+    bytes[7] = 2*Fs + 3*Fc + 2*Fb;
+  if(prop->metmodel>0)
+    bytes[8] = R*(30+NCOAREWORK)*Nc + sizeof(int)*Nc;
+  // Shortwave attenuation cache in sources.c
+  if(prop->metmodel>=1 && prop->metmodel<=3)
+    bytes[8] += (1+(prop->jerlov>0))*Fc + (R+sizeof(int))*Nc;
+  // Concentrations, old copies, boundary values and TVD limiter sums of the tracers and the
+  // work space of UpdateScalarsBatch
+  if(prop->Ntracers>0)
+    bytes[9] = prop->Ntracers*((S+R)*N3c+2*P*Nc+Fb+(prop->TVDtracers>0)*Fs)
+      + R*(grid->maxfaces*grid->Nkmax+4*(grid->Nkmax+1)) + sizeof(int)*Ne;
+
+  MPI_Reduce(bytes,maxbytes,PHYSMEMCATEGORIES,MPI_DOUBLE,MPI_MAX,0,comm);
+  if(myproc==0 && VERBOSE>1) {
+    printf("Planned memory per processor (largest over all processors):\n");
+    for(i=0;i<PHYSMEMCATEGORIES;i++) {
+      printf("  %-16s %10.2f MB\n",names[i],maxbytes[i]/1048576.0);
+      total+=maxbytes[i];
+    }
+    printf("  %-16s %10.2f MB\n","total",total/1048576.0);
+  }
+}
+
 /*
  * Function: AllocatePhysicalVariables
  * Usage: AllocatePhysicalVariables(grid,phys,prop);
@@ -114,7 +236,7 @@ static void getchangeT(gridT *grid, physT *phys);
  */
 void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
 {
-  int flag=0, i, j, jptr, ib, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf, k;
+  int flag=0, i, iptr, j, jptr, ib, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf, k, n;
 
   // allocate physical structure
   *phys = (physT *)SunMalloc(sizeof(physT),"AllocatePhysicalVariables");
@@ -125,13 +247,18 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
   (*phys)->vc = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->wc = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
 
-  // new variables for higher-order interpolation following Wang et al 2011
-  (*phys)->nRT1u = (REAL ***)SunMalloc(Np*sizeof(REAL **),"AllocatePhysicalVariables");
-  (*phys)->nRT1v = (REAL ***)SunMalloc(Np*sizeof(REAL **),"AllocatePhysicalVariables");
-  (*phys)->nRT2u = (REAL **)SunMalloc(Np*sizeof(REAL*),"AllocatePhysicalVariables");
-  (*phys)->nRT2v = (REAL **)SunMalloc(Np*sizeof(REAL*),"AllocatePhysicalVariables");
-  (*phys)->tRT1 = (REAL **)SunMalloc(Ne*sizeof(REAL*),"AllocatePhysicalVariables");
-  (*phys)->tRT2 = (REAL **)SunMalloc(Ne*sizeof(REAL*),"AllocatePhysicalVariables");
+  // new variables for higher-order interpolation following Wang et al 2011,
+  // which are only needed for quadratic interpolation
+  (*phys)->nRT1u = (*phys)->nRT1v = NULL;
+  (*phys)->nRT2u = (*phys)->nRT2v = (*phys)->tRT1 = (*phys)->tRT2 = NULL;
+  if(NeedRTInterpolation(prop)) {
+    (*phys)->nRT1u = (REAL ***)SunMalloc(Np*sizeof(REAL **),"AllocatePhysicalVariables");
+    (*phys)->nRT1v = (REAL ***)SunMalloc(Np*sizeof(REAL **),"AllocatePhysicalVariables");
+    (*phys)->nRT2u = (REAL **)SunMalloc(Np*sizeof(REAL*),"AllocatePhysicalVariables");
+    (*phys)->nRT2v = (REAL **)SunMalloc(Np*sizeof(REAL*),"AllocatePhysicalVariables");
+    (*phys)->tRT1 = (REAL **)SunMalloc(Ne*sizeof(REAL*),"AllocatePhysicalVariables");
+    (*phys)->tRT2 = (REAL **)SunMalloc(Ne*sizeof(REAL*),"AllocatePhysicalVariables");
+  }
 
   // allocate rest of variables in plan
   (*phys)->uold = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
@@ -161,8 +288,10 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
     /* new interpolation variables */
     // loop over the edges (Nkc vs Nke since for cells Nkc < ik < Nke there should be 0 velocity
     // on face to prevent mass from leaving the system)
-    (*phys)->tRT1[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
-    (*phys)->tRT2[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+    if(NeedRTInterpolation(prop)) {
+      (*phys)->tRT1[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->tRT2[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+    }
   }
   // if we have an error quit MPI
   if(flag) {
@@ -173,12 +302,19 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
   (*phys)->h = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->hcorr = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->active = (unsigned char *)SunMalloc(Nc*sizeof(char),"AllocatePhysicalVariables");
+  (*phys)->wetcellp = (int *)SunMalloc(Nc*sizeof(int),"AllocatePhysicalVariables");
+  for(i=0;i<Nc;i++)
+    (*phys)->active[i]=1;
+  (*phys)->Nwetcells=0;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++)
+    (*phys)->wetcellp[(*phys)->Nwetcells++]=grid->cellp[iptr];
+  (*phys)->wetchanged=0;
   (*phys)->hold = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->htmp = (REAL *)SunMalloc(10*Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->htmp2 = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->htmp3 = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->hcoef = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
-  (*phys)->hfcoef = (REAL *)SunMalloc(grid->maxfaces*Nc*sizeof(REAL),"AllocatePhysicalVariables");
+  AssembleHOperator(grid,*phys);
   (*phys)->Tsurf = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->dT = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
 
@@ -191,9 +327,12 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
   (*phys)->Cn_W2 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables"); //AB3
   (*phys)->q = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->qc = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->qtmp = (REAL **)SunMalloc(grid->maxfaces*Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->s = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->T = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+  // Coefficients of the nonhydrostatic pressure operator
+  (*phys)->qtmp = NULL;
+  if(prop->nonhydrostatic)
+    (*phys)->qtmp = (REAL **)SunMalloc(grid->maxfaces*Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+  (*phys)->s = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
+  (*phys)->T = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
   (*phys)->Ttmp = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->s0 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->rho = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
@@ -202,23 +341,29 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
   (*phys)->stmp = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->stmp2 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   (*phys)->stmp3 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->nu_tv = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->kappa_tv = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+  (*phys)->nu_tv = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
+  (*phys)->kappa_tv = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
   (*phys)->nu_lax = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   if(prop->turbmodel>=1) {
-    (*phys)->qT = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
-    (*phys)->lT = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->qT = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
+    (*phys)->lT = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocatePhysicalVariables");
     (*phys)->Cn_q = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
     (*phys)->Cn_l = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->lsrc1 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->lsrc2 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
   }
   (*phys)->tau_T = (REAL *)SunMalloc(Ne*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->tau_B = (REAL *)SunMalloc(Ne*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->CdT = (REAL *)SunMalloc(Ne*sizeof(REAL),"AllocatePhysicalVariables");
   (*phys)->CdB = (REAL *)SunMalloc(Ne*sizeof(REAL),"AllocatePhysicalVariables");
 
+  // Tracer budgets are allocated by ComputeConservatives
+  (*phys)->tracermass = NULL;
+  (*phys)->Ntracermass = 0;
+
   /* new interpolation variables */
   // loop over the nodes
-  for(i=0; i < Np; i++) {
+  for(i=0; i < Np && NeedRTInterpolation(prop); i++) {
     // most complex one...
     (*phys)->nRT1u[i] = (REAL **)SunMalloc(grid->Nkp[i]*sizeof(REAL *),
         "AllocatePhysicalVariables");
@@ -258,10 +403,10 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
     (*phys)->Cn_W2[i] = (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL),"AllocatePhysicalVariables"); //AB3
     (*phys)->q[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     (*phys)->qc[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-    for(nf=0;nf<grid->nfaces[i];nf++)
+    for(nf=0;nf<grid->nfaces[i] && prop->nonhydrostatic;nf++)
       (*phys)->qtmp[i*grid->maxfaces+nf] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-    (*phys)->s[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-    (*phys)->T[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+    (*phys)->s[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
+    (*phys)->T[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
     (*phys)->Ttmp[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     (*phys)->s0[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     (*phys)->rho[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
@@ -270,14 +415,16 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
     if(prop->turbmodel>=1) {
       (*phys)->Cn_q[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
       (*phys)->Cn_l[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-      (*phys)->qT[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-      (*phys)->lT[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->qT[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
+      (*phys)->lT[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
+      (*phys)->lsrc1[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->lsrc2[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     }
     (*phys)->stmp[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     (*phys)->stmp2[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
     (*phys)->stmp3[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-    (*phys)->nu_tv[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
-    (*phys)->kappa_tv[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+    (*phys)->nu_tv[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
+    (*phys)->kappa_tv[i] = (SREAL *)SunMalloc(grid->Nk[i]*sizeof(SREAL),"AllocatePhysicalVariables");
     (*phys)->nu_lax[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
   }
  
@@ -338,19 +485,71 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
     (*phys)->gradSy[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
   }
 
-  // Allocate for least squares velocity fitting
-  (*phys)->A = (REAL **)SunMalloc(grid->maxfaces*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->AT = (REAL **)SunMalloc(2*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->Apr = (REAL **)SunMalloc(2*sizeof(REAL *),"AllocatePhysicalVariables");
-  (*phys)->bpr = (REAL *)SunMalloc(2*sizeof(REAL),"AllocatePhysicalVariables");
-  for(i=0;i<grid->maxfaces;i++){
-      (*phys)->A[i] = (REAL *)SunMalloc(2*sizeof(REAL),"AllocatePhysicalVariables");  
-  }
-  for(i=0;i<2;i++){
-      (*phys)->AT[i] = (REAL *)SunMalloc(grid->maxfaces*sizeof(REAL),"AllocatePhysicalVariables");  
-      (*phys)->Apr[i] = (REAL *)SunMalloc(2*sizeof(REAL),"AllocatePhysicalVariables");  
+  // Weights for the reconstruction of the cell-centered velocity.  The quadratic
+  // interpolation is also used for output when prettyplot is set.
+  (*phys)->ucweights = (REAL *)SunMalloc(2*Nc*grid->maxfaces*sizeof(REAL),"AllocatePhysicalVariables");
+  (*phys)->perotweights = (*phys)->ucweights;
+  (*phys)->quadweights = NULL;
+  (*phys)->rt0weights = NULL;
+  if(NeedRTInterpolation(prop)) {
+    if(prop->interp==LSQ)
+      (*phys)->perotweights = (REAL *)SunMalloc(2*Nc*grid->maxfaces*sizeof(REAL),"AllocatePhysicalVariables");
+    (*phys)->quadweights = (REAL *)SunMalloc(6*Nc*sizeof(REAL),"AllocatePhysicalVariables");
+    (*phys)->rt0weights = (REAL **)SunMalloc(Np*sizeof(REAL *),"AllocatePhysicalVariables");
+    for(i=0;i<Np;i++)
+      (*phys)->rt0weights[i] = (REAL *)SunMalloc(4*grid->numpcneighs[i]*sizeof(REAL),"AllocatePhysicalVariables");
+  }
+  ComputeUCWeights(grid,*phys,prop);
+
+  // Allocate the time-averaged transport fluxes when the scalars are subcycled
+  (*phys)->nsubcycle=0;
+  (*phys)->hiters=(*phys)->qiters=0;
+  if(prop->ntscalar>1) {
+    (*phys)->ubar = (REAL **)SunMalloc(Ne*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->ubar2 = (REAL **)SunMalloc(Ne*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->dzfbar = (REAL **)SunMalloc(Ne*sizeof(REAL *),"AllocatePhysicalVariables");
+    for(j=0;j<Ne;j++) {
+      (*phys)->ubar[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->ubar2[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->dzfbar[j] = (REAL *)SunMalloc(grid->Nkc[j]*sizeof(REAL),"AllocatePhysicalVariables");
+    }
+    (*phys)->wbar = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->wbar2 = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->dzzbar = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->ctopbar = (int *)SunMalloc(Nc*sizeof(int),"AllocatePhysicalVariables");
+    for(i=0;i<Nc;i++) {
+      (*phys)->wbar[i] = (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->wbar2[i] = (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->dzzbar[i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+    }
   }
 
+  // Allocate the solution history for the projected initial guesses, with one
+  // extra slot for the guess itself
+  (*phys)->nhproj=0;
+  (*phys)->nqproj=0;
+  if(prop->nprojection>0) {
+    (*phys)->hproj = (REAL **)SunMalloc((prop->nprojection+1)*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->hprojA = (REAL **)SunMalloc((prop->nprojection+1)*sizeof(REAL *),"AllocatePhysicalVariables");
+    (*phys)->hprojd = (REAL *)SunMalloc((prop->nprojection+1)*sizeof(REAL),"AllocatePhysicalVariables");
+    for(n=0;n<=prop->nprojection;n++) {
+      (*phys)->hproj[n] = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
+      (*phys)->hprojA[n] = (REAL *)SunMalloc(Nc*sizeof(REAL),"AllocatePhysicalVariables");
+    }
+    if(prop->nonhydrostatic) {
+      (*phys)->qproj = (REAL ***)SunMalloc((prop->nprojection+1)*sizeof(REAL **),"AllocatePhysicalVariables");
+      (*phys)->qprojA = (REAL ***)SunMalloc((prop->nprojection+1)*sizeof(REAL **),"AllocatePhysicalVariables");
+      (*phys)->qprojd = (REAL *)SunMalloc((prop->nprojection+1)*sizeof(REAL),"AllocatePhysicalVariables");
+      for(n=0;n<=prop->nprojection;n++) {
+        (*phys)->qproj[n] = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+        (*phys)->qprojA[n] = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocatePhysicalVariables");
+        for(i=0;i<Nc;i++) {
+          (*phys)->qproj[n][i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+          (*phys)->qprojA[n][i] = (REAL *)SunMalloc(grid->Nk[i]*sizeof(REAL),"AllocatePhysicalVariables");
+        }
+      }
+    }
+  }
 
 }
 
@@ -363,12 +562,12 @@ void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop)
  */
 void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
 {
-  int i, j, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf;
+  int i, j, Nc=grid->Nc, Ne=grid->Ne, Np=grid->Np, nf, n;
 
   /* free variables for higher-order interpolation */
   // note that this isn't even currently called!
   // over each node
-  for(i=0; i < Np; i++) {
+  for(i=0; i < Np && NeedRTInterpolation(prop); i++) {
     free(phys->nRT2u[i]);
     free(phys->nRT2v[i]);
     // over each layer
@@ -379,10 +578,19 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
     }
   }
   // over each edge
-  for(i=0; i < Ne; i++) {
+  for(i=0; i < Ne && NeedRTInterpolation(prop); i++) {
     free(phys->tRT1[i]);
     free(phys->tRT2[i]);
   }
+  if(phys->perotweights!=phys->ucweights)
+    free(phys->perotweights);
+  free(phys->ucweights);
+  if(phys->quadweights) {
+    free(phys->quadweights);
+    for(i=0; i < Np; i++)
+      free(phys->rt0weights[i]);
+    free(phys->rt0weights);
+  }
 
   // free all the arrays over depth for edge-oriented
   for(j=0;j<Ne;j++) {
@@ -409,7 +617,7 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
     free(phys->Cn_W2[i]); //AB3
     free(phys->q[i]);
     free(phys->qc[i]);
-    for(nf=0;nf<grid->maxfaces;nf++)
+    for(nf=0;nf<grid->nfaces[i] && prop->nonhydrostatic;nf++)
       free(phys->qtmp[i*grid->maxfaces+nf]);
     free(phys->s[i]);
     free(phys->T[i]);
@@ -422,6 +630,8 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
       free(phys->Cn_l[i]);
       free(phys->qT[i]);
       free(phys->lT[i]);
+      free(phys->lsrc1[i]);
+      free(phys->lsrc2[i]);
     }
     free(phys->stmp[i]);
     free(phys->stmp2[i]);
@@ -433,11 +643,21 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
 
   free(phys->h);
   free(phys->hcorr);
+  free(phys->active);
+  free(phys->wetcellp);
   free(phys->htmp);
   free(phys->htmp2);
   free(phys->htmp3);
   free(phys->hcoef);
   free(phys->hfcoef);
+  free(phys->hrow);
+  free(phys->hcol);
+  free(phys->hedge);
+  free(phys->hcolrow);
+  if(phys->hchol) {
+    EnvelopeFree(phys->hchol,"FreePhysicalVariables");
+    free(phys->hchol0);
+  }
   free(phys->uc);
   free(phys->vc);
   free(phys->wc);
@@ -461,6 +681,8 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
     free(phys->Cn_l);
     free(phys->qT);
     free(phys->lT);
+    free(phys->lsrc1);
+    free(phys->lsrc2);
   }  
   free(phys->stmp);
   free(phys->stmp2);
@@ -472,6 +694,8 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
   free(phys->tau_B);
   free(phys->CdT);
   free(phys->CdB);
+  if(phys->Ntracermass)
+    SunFree(phys->tracermass,phys->Ntracermass*sizeof(REAL),"FreePhysicalVariables");
   free(phys->u);
   free(phys->D);
   free(phys->utmp);
@@ -507,6 +731,49 @@ void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop)
   free(phys->gradSx);
   free(phys->gradSy);
 
+  if(prop->ntscalar>1) {
+    for(j=0;j<Ne;j++) {
+      free(phys->ubar[j]);
+      free(phys->ubar2[j]);
+      free(phys->dzfbar[j]);
+    }
+    for(i=0;i<Nc;i++) {
+      free(phys->wbar[i]);
+      free(phys->wbar2[i]);
+      free(phys->dzzbar[i]);
+    }
+    free(phys->ubar);
+    free(phys->ubar2);
+    free(phys->dzfbar);
+    free(phys->wbar);
+    free(phys->wbar2);
+    free(phys->dzzbar);
+    free(phys->ctopbar);
+  }
+
+  if(prop->nprojection>0) {
+    for(n=0;n<=prop->nprojection;n++) {
+      free(phys->hproj[n]);
+      free(phys->hprojA[n]);
+      if(prop->nonhydrostatic) {
+        for(i=0;i<Nc;i++) {
+          free(phys->qproj[n][i]);
+          free(phys->qprojA[n][i]);
+        }
+        free(phys->qproj[n]);
+        free(phys->qprojA[n]);
+      }
+    }
+    free(phys->hproj);
+    free(phys->hprojA);
+    free(phys->hprojd);
+    if(prop->nonhydrostatic) {
+      free(phys->qproj);
+      free(phys->qprojA);
+      free(phys->qprojd);
+    }
+  }
+
   free(phys);
 }
 
@@ -820,6 +1087,8 @@ void UpdateDZ(gridT *grid, physT *phys, propT *prop, int option)
 
   // don't need to recompute for linearized FS
   if(prop->linearFS) {
+    if(prop->wetdry)
+      UpdateWetCells(grid,phys,option);
     return;
   }
 
@@ -965,6 +1234,47 @@ void UpdateDZ(gridT *grid, physT *phys, propT *prop, int option)
       grid->dzfB[j] = Min(dzz1,dzz2);
     }
   }
+
+  if(prop->wetdry)
+    UpdateWetCells(grid,phys,option);
+}
+
+/*
+ * Function: UpdateWetCells
+ * Usage: UpdateWetCells(grid,phys,option);
+ * ----------------------------------------
+ * Partition the computational cells into wet and dry ones so that the column
+ * kernels can loop over phys->wetcellp[0..Nwetcells-1] instead of testing every
+ * cell.  The list only changes when a cell wets or dries, so it is rebuilt only
+ * if UpdateFreeSurface flipped an active flag or a top index moved into or out of
+ * the bottom layer.  Initial calls (option!=0) always rebuild.
+ *
+ */
+static void UpdateWetCells(gridT *grid, physT *phys, int option) {
+  int i, iptr, nwet, ndry, changed=(option || phys->wetchanged);
+
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1] && !changed;iptr++) {
+    i = grid->cellp[iptr];
+    if((grid->ctop[i]==grid->Nk[i]-1)!=(grid->ctopold[i]==grid->Nk[i]-1))
+      changed=1;
+  }
+  if(!changed)
+    return;
+
+  nwet=0;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+    if(!DRYCELL(grid,phys,i))
+      phys->wetcellp[nwet++]=i;
+  }
+  ndry=nwet;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+    if(DRYCELL(grid,phys,i))
+      phys->wetcellp[ndry++]=i;
+  }
+  phys->Nwetcells=nwet;
+  phys->wetchanged=0;
 }
 
 /*
@@ -1005,8 +1315,8 @@ REAL DepthFromDZ(gridT *grid, physT *phys, int i, int kind) {
  */
 void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm)
 {
-  int i, k, n, blowup=0;
-  REAL t0;
+  int i, k, n, blowup=0, transport;
+  REAL t0, dt=prop->dt;
   metinT *metin;
   metT *met;
   averageT *average;
@@ -1030,7 +1340,15 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
   // Set all boundary values at time t=nstart*dt;
   prop->n=prop->nstart;
   // initialize the time (often used for boundary/initial conditions)
-  prop->rtime=prop->nstart*prop->dt;
+  // rtime is rtime0+(n-nrtime0)*dt so that it stays the sum of the time steps
+  // when dt is changed by AdaptTimeStep.  With adaptdt a restart has already
+  // read the time and the time steps in ReadPhysicalVariables.
+  if(!(RESTART && prop->adaptdt)) {
+    prop->rtime=prop->nstart*prop->dt;
+    prop->rtime0=0;
+    prop->nrtime0=0;
+    prop->dtold=prop->dtold2=prop->dt;
+  }
  
   // Initialise the netcdf time (moved to InitializePhysicalVariables)
   // Get the toffSet property
@@ -1077,7 +1395,7 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
       // Initialise the heat flux variables
       updateMetData(prop, grid, metin, met, myproc, comm); 
      if(prop->metmodel>=2) {      
-	updateAirSeaFluxes(prop, grid, phys, met, phys->T);
+	updateAirSeaFluxes(prop, grid, phys, met, StoredToREAL(phys->T,phys->stmp,grid));
 
 	//Communicate across processors
 	ISendRecvCellData2D(met->Hs,grid,myproc,comm);
@@ -1089,6 +1407,11 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
     }
   }
 
+  // Set up the passive tracers before their output is initialised (on a restart
+  // this is done when they are read in ReadPhysicalVariables)
+  if(prop->Ntracers>0 && !RESTART)
+    InitializeTracers(grid,phys,prop,myproc);
+
   // Initialise the output netcdf file metadata
     if(prop->outputNetcdf==1 &&prop->mergeArrays==0){
       InitialiseOutputNCugrid(prop, grid, phys, met, myproc);
@@ -1116,10 +1439,10 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
 
     prop->n = n;
     // compute the runtime 
-    prop->rtime = n*prop->dt;
+    prop->rtime = prop->rtime0 + (n-prop->nrtime0)*prop->dt;
     
     // netcdf file time
-    prop->nctime = prop->toffSet*86400.0 + n*prop->dt;
+    prop->nctime = prop->toffSet*86400.0 + prop->rtime;
     //prop->nctime +=  n*prop->dt;
     //prop->nctime += prop->rtime;
 
@@ -1192,13 +1515,36 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
         //}
       }
       
+      // With ntscalar>1 the scalars are only advanced every ntscalar steps (and on
+      // the first, output and last steps) using the fluxes averaged over the subcycle
+      transport=1;
+      if(prop->ntscalar>1) {
+        t0=Timer();
+        AccumulateScalarFluxes(grid,phys,prop);
+        transport=(phys->nsubcycle==prop->ntscalar || prop->n==prop->nstart+1 ||
+            prop->n==prop->nstart+prop->nsteps || !(prop->n%prop->ntout));
+        if(transport) {
+          dt=prop->dt;
+          prop->dt*=phys->nsubcycle;
+          SetScalarFluxes(grid,phys);
+        }
+        t_transport+=Timer()-t0;
+      }
+
      // Update the age (passive) tracers
-      if(prop->calcage>0){
+      if(prop->calcage>0 && transport){
         UpdateAge(grid,phys,prop,comm,myproc);
       }
+
+      // Update the user-defined passive tracers
+      if(prop->Ntracers>0 && transport){
+        t0=Timer();
+        UpdateTracers(grid,phys,prop,comm,myproc);
+        t_transport+=Timer()-t0;
+      }
      
       // Update the temperature only if gamma is nonzero in suntans.dat
-      if(prop->gamma) {
+      if(prop->gamma && transport) {
         t0=Timer();
 	
 	getTsurf(grid,phys); // Find the surface temperature
@@ -1209,7 +1555,7 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
             phys->uold,phys->wtmp,NULL,NULL,0,0,comm,myproc,0,prop->TVDtemp);
 	
 	getchangeT(grid,phys); // Get the change in surface temp
-        ISendRecvCellData3D(phys->T,grid,myproc,comm);
+        ISendRecvStoredData3D(phys->T,grid,myproc,comm);
 	
 	ISendRecvCellData3D(phys->Ttmp,grid,myproc,comm);
         ISendRecvCellData2D(phys->dT,grid,myproc,comm);
@@ -1220,7 +1566,7 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
 
       // Update the air-sea fluxes --> these are used for the previous time step source term and for the salt flux implicit term (salt tracer solver therefore needs to go next)
       if(prop->metmodel>=2){
-	updateAirSeaFluxes(prop, grid, phys, met, phys->T);
+	updateAirSeaFluxes(prop, grid, phys, met, StoredToREAL(phys->T,phys->stmp,grid));
 
 	//Communicate across processors
 	
@@ -1234,7 +1580,7 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
       }
       
       // Update the salinity only if beta is nonzero in suntans.dat
-      if(prop->beta) {
+      if(prop->beta && transport) {
         t0=Timer();
 	if(prop->metmodel>0){
 	    SaltSource(phys->wtmp,phys->uold,grid,phys,prop,met);
@@ -1246,7 +1592,7 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
 		prop->kappa_s,prop->kappa_sH,phys->kappa_tv,prop->theta,
 		NULL,NULL,NULL,NULL,0,0,comm,myproc,1,prop->TVDsalt);
 	}
-	ISendRecvCellData3D(phys->s,grid,myproc,comm);
+	ISendRecvStoredData3D(phys->s,grid,myproc,comm);
 
 	if(prop->metmodel>0){
 	  //Communicate across processors
@@ -1257,11 +1603,17 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
       }
 
       // Compute sediment transport when prop->computeSediments=1
-      if(prop->computeSediments){
+      if(prop->computeSediments && transport){
         t0=Timer(); 
         ComputeSediments(grid,phys,prop,myproc,numprocs,blowup,comm);
         t_transport+=Timer()-t0;
       }
+
+      // Restore the instantaneous fluxes and time step after a subcycled update
+      if(prop->ntscalar>1 && transport) {
+        SwapScalarFluxes(grid,phys);
+        prop->dt=dt;
+      }
       
       // Compute vertical momentum and the nonhydrostatic pressure
       t0=Timer();
@@ -1376,6 +1728,13 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
     if(blowup)
       break;
 
+    // Keep the previous time steps for the Adams-Bashforth coefficients and
+    // choose the time step for the next step
+    prop->dtold2=prop->dtold;
+    prop->dtold=prop->dt;
+    if(prop->adaptdt)
+      AdaptTimeStep(phys,prop,myproc);
+
     //Close all open netcdf file
     /* 
     if(prop->n==prop->nsteps+prop->nstart) {
@@ -1400,6 +1759,9 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
     */
   }
 
+  // Print out the memory of each subsystem and the high-water marks at the end of the run
+  if(VERBOSE>1) MemoryStats(grid,myproc,numprocs,comm);
+
   // not sure if this is really necessary
   //if(prop->mergeArrays) {
   //  if(VERBOSE>2 && myproc==0) printf("Freeing merging arrays...\n");
@@ -1407,6 +1769,64 @@ void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_
   //}
 }
 
+/*
+ * Function: AdaptTimeStep
+ * Usage: AdaptTimeStep(phys,prop,myproc);
+ * ---------------------------------------
+ * Choose the time step for the next step when adaptdt=1.  dt is scaled so that
+ * the global Courant number from Check becomes Cadapt, but it grows by at most
+ * DTGROWTH at a time and not at all if the free-surface or pressure solver needed
+ * more than half of its iterations.  It is halved if either solver did not
+ * converge.  The result is bounded by dtmin and dtmax (if nonzero).
+ *
+ * dt is only changed on the steps with the full check (every ntcheck steps)
+ * and not in the middle of a scalar subcycle.  rtime0 and nrtime0 record the
+ * time and step of the change so that rtime and nctime remain the sum of the
+ * time steps taken.
+ *
+ */
+static void AdaptTimeStep(physT *phys, propT *prop, int myproc) {
+  REAL C, dt;
+
+  if(prop->n%prop->ntcheck || phys->nsubcycle)
+    return;
+
+  C = prop->CmaxU;
+  if(prop->thetaM<0.5 && prop->CmaxW>C)
+    C = prop->CmaxW;
+
+  if(phys->hiters>=prop->maxiters || (prop->nonhydrostatic && phys->qiters>=prop->qmaxiters))
+    dt = 0.5*prop->dt;
+  else {
+    if(C>0)
+      dt = prop->dt*prop->Cadapt/C;
+    else
+      dt = DTGROWTH*prop->dt;
+    if(dt>DTGROWTH*prop->dt)
+      dt = DTGROWTH*prop->dt;
+    if(dt>prop->dt && (2*phys->hiters>prop->maxiters || 
+          (prop->nonhydrostatic && 2*phys->qiters>prop->qmaxiters)))
+      dt = prop->dt;
+  }
+
+  if(prop->dtmax>0 && dt>prop->dtmax)
+    dt = prop->dtmax;
+  if(dt<prop->dtmin)
+    dt = prop->dtmin;
+
+  // Small changes are not worth changing the AB coefficients for
+  if(fabs(dt-prop->dt)<DTDEADBAND*prop->dt)
+    return;
+
+  if(myproc==0 && VERBOSE>1) 
+    printf("Time step %d: Changing dt from %.3e to %.3e (Courant number %.3f).\n",
+        prop->n,prop->dt,dt,C);
+
+  prop->rtime0 = prop->rtime;
+  prop->nrtime0 = prop->n;
+  prop->dt = dt;
+}
+
 /*
  * Function: StoreVariables
  * Usage: StoreVariables(grid,phys);
@@ -1431,6 +1851,140 @@ static void StoreVariables(gridT *grid, physT *phys) {
   }
 }
 
+/*
+ * Function: AccumulateScalarFluxes
+ * Usage: AccumulateScalarFluxes(grid,phys,prop);
+ * ----------------------------------------------
+ * Add the theta-weighted horizontal volume fluxes and vertical velocities that
+ * UpdateScalars would use at this time step to the subcycle sums.  The depths
+ * and ctop at the start of the subcycle are stored on its first step so that
+ * the volume change over the subcycle balances the accumulated fluxes.
+ *
+ */
+static void AccumulateScalarFluxes(gridT *grid, physT *phys, propT *prop) {
+  int i, j, k;
+  REAL theta=prop->theta;
+
+  if(phys->nsubcycle==0) {
+    for(i=0;i<grid->Nc;i++) {
+      phys->ctopbar[i]=grid->ctopold[i];
+      for(k=0;k<grid->Nk[i];k++)
+        phys->dzzbar[i][k]=grid->dzzold[i][k];
+      for(k=0;k<grid->Nk[i]+1;k++)
+        phys->wbar[i][k]=0;
+    }
+    for(j=0;j<grid->Ne;j++)
+      for(k=0;k<grid->Nkc[j];k++)
+        phys->ubar[j][k]=phys->dzfbar[j][k]=0;
+  }
+
+  for(i=0;i<grid->Nc;i++)
+    for(k=0;k<grid->Nk[i]+1;k++)
+      phys->wbar[i][k]+=theta*phys->wnew[i][k]+(1-theta)*phys->wtmp2[i][k];
+
+  for(j=0;j<grid->Ne;j++)
+    for(k=0;k<grid->Nke[j];k++) {
+      phys->ubar[j][k]+=(theta*phys->u[j][k]+(1-theta)*phys->utmp2[j][k])*grid->dzf[j][k];
+      phys->dzfbar[j][k]+=grid->dzf[j][k];
+    }
+
+  phys->nsubcycle++;
+}
+
+/*
+ * Function: SetScalarFluxes
+ * Usage: SetScalarFluxes(grid,phys);
+ * ----------------------------------
+ * Convert the subcycle sums into a mean flux height and a velocity such that
+ * ubar*dzfbar is the mean volume flux, copy them into the old/new slots used
+ * by UpdateScalars, and swap them into phys and grid.  The caller must scale
+ * prop->dt by phys->nsubcycle before calling this, and call SwapScalarFluxes
+ * again once the scalars have been advanced.
+ *
+ */
+static void SetScalarFluxes(gridT *grid, physT *phys) {
+  int i, j, k, N=phys->nsubcycle;
+
+  for(j=0;j<grid->Ne;j++)
+    for(k=0;k<grid->Nkc[j];k++) {
+      if(phys->dzfbar[j][k]>0)
+        phys->ubar[j][k]/=phys->dzfbar[j][k];
+      else
+        phys->ubar[j][k]=0;
+      phys->dzfbar[j][k]/=N;
+      phys->ubar2[j][k]=phys->ubar[j][k];
+    }
+
+  for(i=0;i<grid->Nc;i++)
+    for(k=0;k<grid->Nk[i]+1;k++) {
+      phys->wbar[i][k]/=N;
+      phys->wbar2[i][k]=phys->wbar[i][k];
+    }
+
+  phys->nsubcycle=0;
+  SwapScalarFluxes(grid,phys);
+}
+
+/*
+ * Function: SwapScalarFluxes
+ * Usage: SwapScalarFluxes(grid,phys);
+ * -----------------------------------
+ * Exchange the velocities, flux heights, old depths and old ctop with
+ * the subcycle-averaged ones.  Calling it twice restores the original state.
+ *
+ */
+static void SwapScalarFluxes(gridT *grid, physT *phys) {
+  REAL **tmp;
+  int *itmp;
+
+  tmp=phys->u; phys->u=phys->ubar; phys->ubar=tmp;
+  tmp=phys->utmp2; phys->utmp2=phys->ubar2; phys->ubar2=tmp;
+  tmp=phys->wnew; phys->wnew=phys->wbar; phys->wbar=tmp;
+  tmp=phys->wtmp2; phys->wtmp2=phys->wbar2; phys->wbar2=tmp;
+  tmp=grid->dzf; grid->dzf=phys->dzfbar; phys->dzfbar=tmp;
+  tmp=grid->dzzold; grid->dzzold=phys->dzzbar; phys->dzzbar=tmp;
+  itmp=grid->ctopold; grid->ctopold=phys->ctopbar; phys->ctopbar=itmp;
+}
+
+/*
+ * Function: ABCoefficients
+ * Usage: ABCoefficients(prop,&fab1,&fab2,&fab3);
+ * ----------------------------------------------
+ * Adams-Bashforth coefficients multiplying the explicit terms at time steps
+ * n, n-1 and n-2.  These terms already contain the time step they were computed
+ * with (prop->dt, prop->dtold and prop->dtold2).  Forward Euler is used on the
+ * first step, AB2 on the second and then AB2 or AB3 depending on prop->AB.
+ * When the time step has changed the coefficients come from integrating the
+ * polynomial through the unequally spaced previous steps.
+ *
+ */
+static void ABCoefficients(propT *prop, REAL *fab1, REAL *fab2, REAL *fab3) {
+  REAL h=prop->dt, h1=prop->dtold, h2=prop->dtold2, r;
+
+  if(prop->n==1) {
+    *fab1=1;
+    *fab2=*fab3=0;
+  } else if(prop->n==2 || prop->AB==2) {
+    if(h==h1) {
+      *fab1=3.0/2.0;
+      *fab2=-1.0/2.0;
+    } else {
+      r=h/h1;
+      *fab1=1+0.5*r;
+      *fab2=-0.5*r*r;
+    }
+    *fab3=0;
+  } else if(h==h1 && h1==h2) {
+    *fab1=23.0/12.0;
+    *fab2=-4.0/3.0;
+    *fab3=5.0/12.0;
+  } else {
+    *fab1=(h*h/3+(2*h1+h2)*h/2+h1*(h1+h2))/(h1*(h1+h2));
+    *fab2=-h*h*(h/3+(h1+h2)/2)/(h1*h1*h2);
+    *fab3=h*h*(h/3+h1/2)/((h1+h2)*h2*h2);
+  }
+}
+
 /*
  * Function: HorizontalSource
  * Usage: HorizontalSource(grid,phys,prop,myproc,numprocs);
@@ -1455,6 +2009,7 @@ static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
   int i, ib, iptr, boundary_index, nf, j, jptr, k, nc, nc1, nc2, ne, 
   k0, kmin, kmax;
   REAL *a, *b, *c, fab1, fab2, fab3, sum, def1, def2, dgf, Cz, tempu; //AB3
+  REAL drho, drho0=0, dzh, dzh0=0;
   // additions to test divergence averaging for w in momentum calc
   REAL wedge[3], lambda[3], wik;
   int aneigh;
@@ -1469,6 +2024,7 @@ static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
   // Adams-Bashforth terms at time step n-1
 
  // Adams Bashforth coefficients
+  ABCoefficients(prop,&fab1,&fab2,&fab3);
   if(prop->n==1 || prop->wetdry) {
 //  if(prop->n==1){
     fab1=1;
@@ -1477,21 +2033,6 @@ static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
     for(j=0;j<grid->Ne;j++)
       for(k=0;k<grid->Nke[j];k++)
         phys->Cn_U[j][k]=phys->Cn_U2[j][k]=0;
-  } else if(prop->n==2) {
-    fab1=3.0/2.0;
-    fab2=-1.0/2.0;
-    fab3=0;
-  } else {
-    if(prop->AB==2) {
-      fab1=3.0/2.0;
-      fab2=-1.0/2.0;
-      fab3=0;
-    } else {
-      // AB3:
-      fab1=23.0/12.0;
-      fab2=-4.0/3.0;
-      fab3=5.0/12.0;
-    }
   }
 
   // Set utmp and ut to zero since utmp will store the source term of the
@@ -1567,6 +2108,12 @@ static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
   }
 
   // Baroclinic term
+  // Integrate the density difference across each edge from the top of the
+  // water column in one downward sweep.  With baroclinic=0 the running sum of
+  // the layers above is kept in sum and half of the current layer is added,
+  // which assumes piecewise-constant density.  With baroclinic=1 the pressure
+  // difference is carried from one layer center to the next with the
+  // trapezoidal rule, which remains second order when dzz is stretched.
   // over computational cells
   for(jptr=grid->edgedist[0];jptr<grid->edgedist[1];jptr++) {
     j = grid->edgep[jptr];
@@ -1574,23 +2121,30 @@ static void HorizontalSource(gridT *grid, physT *phys, propT *prop,
     nc1 = grid->grad[2*j];
     nc2 = grid->grad[2*j+1];
 
-    if(grid->etop[j]<grid->Nke[j]-1) 
+    if(grid->etop[j]<grid->Nke[j]-1) {
+      k0=grid->ctop[nc1]>grid->ctop[nc2] ? grid->ctop[nc1] : grid->ctop[nc2];
+      sum=0;
       for(k=grid->etop[j];k<grid->Nke[j];k++) {
-        // this next line seems completely unncessary and computationally wasteful
-        k0=grid->etop[j];
-        // from the top of the water surface to the bottom edge layer for the given step
-        for(k0=Max(grid->ctop[nc1],grid->ctop[nc2]);k0<k;k0++) {
-          // for the Cn_U at the particular layer, integrate density gradient over the depth
-          // using standard integration to the half cell (extra factor of 1/2 in last term)
-          // this is probably only 1st order accurate for the integration
-          phys->Cn_U[j][k]-=0.5*prop->grav*prop->dt*
-            (phys->rho[nc1][k0]-phys->rho[nc2][k0])*
-            (grid->dzz[nc1][k0]+grid->dzz[nc2][k0])/grid->dg[j];
+        if(prop->baroclinic==1) {
+          drho=phys->rho[nc1][k]-phys->rho[nc2][k];
+          dzh=0.5*(grid->dzz[nc1][k]+grid->dzz[nc2][k]);
+          if(k>k0)
+            sum+=0.25*(drho0+drho)*(dzh0+dzh);
+          else
+            sum=0.5*drho*dzh;
+          drho0=drho;
+          dzh0=dzh;
+          phys->Cn_U[j][k]-=prop->grav*prop->dt*sum/grid->dg[j];
+        } else {
+          tempu=0.5*prop->grav*prop->dt*
+            (phys->rho[nc1][k]-phys->rho[nc2][k])*
+            (grid->dzz[nc1][k]+grid->dzz[nc2][k])/grid->dg[j];
+          phys->Cn_U[j][k]-=sum+0.5*tempu;
+          if(k>=k0)
+            sum+=tempu;
         }
-        phys->Cn_U[j][k]-=0.25*prop->grav*prop->dt*
-          (phys->rho[nc1][k]-phys->rho[nc2][k])*
-          (grid->dzz[nc1][k]+grid->dzz[nc2][k])/grid->dg[j];
       }
+    }
   }
 
   // Set stmp and stmp2 to zero since these are used as temporary variables for advection and
@@ -2041,28 +2595,11 @@ static void WPredictor(gridT *grid, physT *phys, propT *prop,
   */
 
  // AB3
+  ABCoefficients(prop,&fab1,&fab2,&fab3);
   if(prop->n==1) {
-    fab1=1;
-    fab2=fab3=0;
-
     for(i=0;i<grid->Nc;i++)
       for(k=0;k<grid->Nk[i];k++)
 	phys->Cn_W[i][k]=phys->Cn_W2[i][k]=0;
-  } else if(prop->n==2) {
-    fab1=3.0/2.0;
-    fab2=-1.0/2.0;
-    fab3=0;
-  } else {
-    if(prop->AB==2) {
-      fab1=3.0/2.0;
-      fab2=-1.0/2.0;
-      fab3=0;
-    } 
-    else {
-      fab1=23.0/12.0;
-      fab2=-4.0/3.0;
-      fab3=5.0/12.0;
-    }
   }
 
   // Add on the nonhydrostatic pressure gradient from the previous time
@@ -2412,7 +2949,7 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
 
   int i, iptr, k, n, niters;
 
-  REAL **x, **r, **rtmp, **p, **z, mu, nu, alpha, alpha0, eps, eps0;
+  REAL **x, **r, **rtmp, **p, **z, mu, nu, alpha, alpha0, eps, eps0, bnorm=0;
 
   z = phys->stmp2;
   x = q;
@@ -2433,6 +2970,12 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
       }
     }
   }
+
+  // Start from the projection of the source onto the previous solutions
+  if(prop->nprojection) {
+    bnorm = InnerProduct3(p,p,grid,myproc,numprocs,comm);
+    QProjectGuess(x,p,grid,phys,prop,myproc,numprocs,comm);
+  }
   ISendRecvCellData3D(x,grid,myproc,comm);
 
   niters = prop->qmaxiters;
@@ -2449,6 +2992,8 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
     for(k=grid->ctop[i];k<grid->Nk[i];k++) 
       r[i][k] = p[i][k]-z[i][k];
   }    
+  if(prop->nprojection)
+    QProjectResidual(x,r,p,bnorm,grid,phys,prop,myproc,numprocs,comm);
   if(prop->qprecond==2) {
     Preconditioner(r,rtmp,phys->wtmp,grid,phys,prop);
     for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
@@ -2474,6 +3019,10 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
   else
     eps=eps0=alpha0;
 
+  // The relative residual is measured against the source and not the projected residual
+  if(prop->nprojection && (prop->qprecond==2 || prop->resnorm))
+    eps0=bnorm;
+
   // Iterate until residual is less than prop->qepsilon
   for(n=0;n<niters && eps!=0;n++) {
 
@@ -2535,6 +3084,11 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
     }
   }
 
+  phys->qiters=n;
+
+  if(prop->nprojection)
+    QProjectUpdate(x,r,c,n,grid,phys,prop,myproc,numprocs,comm);
+
   // Rescale the preconditioned solution 
   if(prop->qprecond==1) {
     for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
@@ -2549,6 +3103,147 @@ static void CGSolveQ(REAL **q, REAL **src, REAL **c, gridT *grid, physT *phys, p
   ISendRecvCellData3D(x,grid,myproc,comm);
 }
 
+/*
+ * Function: QProjectGuess
+ * Usage: QProjectGuess(x,b,grid,phys,prop,myproc,numprocs,comm);
+ * --------------------------------------------------------------
+ * Initial guess for CGSolveQ from the last nprojection nonhydrostatic pressure
+ * corrections, as in HProjectGuess.  x0 replaces the previous correction in
+ * the computational cells of x and is kept in the next free slot.  Its
+ * residual is stored by QProjectResidual once CGSolveQ has computed it with
+ * the current operator.
+ *
+ */
+static void QProjectGuess(REAL **x, REAL **b, gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
+
+  int i, iptr, k, m, nq=phys->nqproj;
+  REAL alpha, **x0=phys->qproj[nq];
+
+  for(i=0;i<grid->Nc;i++)
+    for(k=0;k<grid->Nk[i];k++)
+      x0[i][k]=0;
+  for(m=0;m<nq;m++) {
+    alpha = InnerProduct3(phys->qproj[m],b,grid,myproc,numprocs,comm)/phys->qprojd[m];
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      for(k=grid->ctop[i];k<grid->Nk[i];k++)
+        x0[i][k]+=alpha*phys->qproj[m][i][k];
+    }
+  }
+
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+
+    for(k=grid->ctop[i];k<grid->Nk[i];k++)
+      x[i][k]=x0[i][k];
+  }
+}
+
+/*
+ * Function: QProjectResidual
+ * Usage: QProjectResidual(x,r,b,bnorm,grid,phys,prop,myproc,numprocs,comm);
+ * -------------------------------------------------------------------------
+ * Store the residual r=b-Ax0 of the projected guess next to x0.  If it is
+ * larger than b the history no longer represents the operator, so it is
+ * discarded and CG starts from x=0 and r=b, as in HProjectGuess.
+ *
+ */
+static void QProjectResidual(REAL **x, REAL **r, REAL **b, REAL bnorm, gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
+
+  int i, iptr, k, nq=phys->nqproj;
+
+  if(nq && InnerProduct3(r,r,grid,myproc,numprocs,comm)>bnorm) {
+    for(i=0;i<grid->Nc;i++)
+      for(k=0;k<grid->Nk[i];k++)
+        phys->qproj[0][i][k]=0;
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+        x[i][k] = 0;
+        r[i][k] = b[i][k];
+      }
+    }
+    ISendRecvCellData3D(x,grid,myproc,comm);
+    phys->nqproj=nq=0;
+  }
+
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+
+    for(k=grid->ctop[i];k<grid->Nk[i];k++) 
+      phys->qprojA[nq][i][k] = r[i][k];
+  }
+}
+
+/*
+ * Function: QProjectUpdate
+ * Usage: QProjectUpdate(x,r,c,niters,grid,phys,prop,myproc,numprocs,comm);
+ * -------------------------------------------------------------------------
+ * Add the correction found by CGSolveQ to the nonhydrostatic pressure
+ * solution history, as in HProjectUpdate.  The operator is negative definite,
+ * so x'Ax<0 for the stored solutions.
+ *
+ */
+static void QProjectUpdate(REAL **x, REAL **r, REAL **c, int niters, gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
+
+  int i, iptr, k, m, nq=phys->nqproj;
+  REAL beta, d, d0=0, **dx, **Adx;
+
+  if(nq==prop->nprojection) {
+    dx=phys->qproj[0];
+    Adx=phys->qprojA[0];
+    for(i=0;i<grid->Nc;i++)
+      for(k=0;k<grid->Nk[i];k++)
+        dx[i][k]=0;
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      for(k=grid->ctop[i];k<grid->Nk[i];k++)
+        dx[i][k]=x[i][k];
+    }
+    ISendRecvCellData3D(dx,grid,myproc,comm);
+    if(prop->qprecond==1) OperatorQC(phys->wtmp,phys->qtmp,dx,Adx,c,grid,phys,prop);
+    else OperatorQ(phys->wtmp,dx,Adx,c,grid,phys,prop);
+    nq=0;
+  } else {
+    // No new information when CG did not iterate
+    if(!niters)
+      return;
+
+    dx=phys->qproj[nq];
+    Adx=phys->qprojA[nq];
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+        dx[i][k]=x[i][k]-dx[i][k];
+        Adx[i][k]-=r[i][k];
+      }
+    }
+    d0 = InnerProduct3(dx,Adx,grid,myproc,numprocs,comm);
+    for(m=0;m<nq;m++) {
+      beta = InnerProduct3(phys->qproj[m],Adx,grid,myproc,numprocs,comm)/phys->qprojd[m];
+      for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+        i = grid->cellp[iptr];
+
+        for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+          dx[i][k]-=beta*phys->qproj[m][i][k];
+          Adx[i][k]-=beta*phys->qprojA[m][i][k];
+        }
+      }
+    }
+  }
+
+  d = InnerProduct3(dx,Adx,grid,myproc,numprocs,comm);
+  if(d<1e-6*d0) {
+    phys->qprojd[nq]=d;
+    nq++;
+  }
+  phys->nqproj=nq;
+}
+
 /*
  * Function: EddyViscosity
  * Usage: EddyViscosity(grid,phys,prop,w,comm,myproc);
@@ -2562,6 +3257,8 @@ static void EddyViscosity(gridT *grid, physT *phys, propT *prop, REAL **wnew, MP
 {
   if(prop->turbmodel==1) 
     my25(grid,phys,prop,wnew,phys->qT,phys->lT,phys->Cn_q,phys->Cn_l,phys->nu_tv,phys->kappa_tv,comm,myproc);
+  else if(prop->turbmodel==2)
+    keps(grid,phys,prop,wnew,phys->qT,phys->lT,phys->Cn_q,phys->Cn_l,phys->nu_tv,phys->kappa_tv,comm,myproc);
 }
 
 /*
@@ -2994,10 +3691,12 @@ static void UPredictor(gridT *grid, physT *phys,
     if(phys->h[i]<=-grid->dv[i]+DRYCELLHEIGHT) {
       //phys->hcorr[i]=-grid->dv[i]+DRYCELLHEIGHT-phys->h[i];
       phys->h[i]=-grid->dv[i]+DRYCELLHEIGHT;
+      if(phys->active[i]) phys->wetchanged=1;
       phys->active[i]=0;
       phys->s[i][grid->Nk[i]-1]=0;
     } else {
       phys->hcorr[i]=0;
+      if(!phys->active[i]) phys->wetchanged=1;
       phys->active[i]=1;
     }
 
@@ -3086,7 +3785,7 @@ static void UPredictor(gridT *grid, physT *phys,
 static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
 
   int i, iptr, n, niters;
-  REAL *x, *r, *rtmp, *p, *z, mu, nu, eps, eps0, alpha, alpha0;
+  REAL *x, *r, *rtmp, *p, *z, mu, nu, eps, eps0, alpha, alpha0, bnorm=0;
 
   x = phys->h;
   r = phys->hold;
@@ -3098,6 +3797,8 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
 
   // Create the coefficients for the operator
   HCoefficients(phys->hcoef,phys->hfcoef,grid,phys,prop);
+  if(prop->hprecond==2)
+    HFactor(grid,phys,prop,myproc);
 
   // For the boundary term (marker of type 3):
   // 1) Need to set x to zero in the interior points, but
@@ -3133,8 +3834,14 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
     p[i] = 0; 
   }     
 
+  // Start from the projection of b onto the previous solutions
+  if(prop->nprojection) {
+    bnorm = InnerProduct(p,p,grid,myproc,numprocs,comm);
+    HProjectGuess(x,p,r,bnorm,grid,phys,prop,myproc,numprocs,comm);
+  }
+
   // continue with CG as expected now that boundaries are handled
-  if(prop->hprecond==1) {
+  if(prop->hprecond) {
     HPreconditioner(r,rtmp,grid,phys,prop);
     for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
       i = grid->cellp[iptr];
@@ -3152,11 +3859,15 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
   }
   if(!prop->resnorm) alpha0 = 1;
 
-  if(prop->hprecond==1)
+  if(prop->hprecond)
     eps=eps0=InnerProduct(r,r,grid,myproc,numprocs,comm);
   else
     eps=eps0=alpha0;
 
+  // The relative residual is measured against b and not the projected residual
+  if(prop->nprojection && (prop->hprecond || prop->resnorm))
+    eps0=bnorm;
+
   // Iterate until residual is less than prop->epsilon
   for(n=0;n<niters && eps!=0 && alpha!=0;n++) {
 
@@ -3173,7 +3884,7 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
       x[i] += nu*p[i];
       r[i] -= nu*z[i];
     }
-    if(prop->hprecond==1) {
+    if(prop->hprecond) {
       HPreconditioner(r,rtmp,grid,phys,prop);
       alpha = InnerProduct(r,rtmp,grid,myproc,numprocs,comm);
       mu*=alpha;
@@ -3192,7 +3903,7 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
       }
     }
 
-    if(prop->hprecond==1)
+    if(prop->hprecond)
       eps=InnerProduct(r,r,grid,myproc,numprocs,comm);
     else
       eps=alpha;
@@ -3212,21 +3923,154 @@ static void CGSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
     }
   }
 
+  phys->hiters=n;
+
+  if(prop->nprojection)
+    HProjectUpdate(x,r,n,grid,phys,prop,myproc,numprocs,comm);
+
   // Send the solution to the neighboring processors
   ISendRecvCellData2D(x,grid,myproc,comm);
 }
 
+/*
+ * Function: HProjectGuess
+ * Usage: HProjectGuess(x,b,r,bnorm,grid,phys,prop,myproc,numprocs,comm);
+ * ----------------------------------------------------------------------
+ * Initial guess for CGSolve from the last nprojection free-surface solutions
+ * (Fischer, 1998).  The stored solutions x_m are orthogonal in the operator
+ * norm, so that x0 = sum_m (x_m'b/x_m'Ax_m) x_m is the best approximation to
+ * the solution in their span.  x0 is placed in the computational cells of x
+ * and r=b-Ax0 is computed with the current operator, since the stored images
+ * Ax_m were computed with the coefficients of earlier time steps.  x0 and r
+ * are kept in the next free slot so that HProjectUpdate can recover the
+ * correction that is found by CG.  If the guess is worse than x0=0 because
+ * the operator has drifted too far from the one the history was built with,
+ * the history is discarded and CG starts from zero.
+ *
+ */
+static void HProjectGuess(REAL *x, REAL *b, REAL *r, REAL bnorm, gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
+
+  int i, iptr, m, nh=phys->nhproj;
+  REAL alpha, *x0=phys->hproj[nh], *r0=phys->hprojA[nh], *z=phys->htmp3;
+
+  for(i=0;i<grid->Nc;i++)
+    x0[i]=0;
+  for(m=0;m<nh;m++) {
+    alpha = InnerProduct(phys->hproj[m],b,grid,myproc,numprocs,comm)/phys->hprojd[m];
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      x0[i]+=alpha*phys->hproj[m][i];
+    }
+  }
+
+  // x0 is zero on the boundary cells since their values are already in b
+  if(nh) {
+    ISendRecvCellData2D(x0,grid,myproc,comm);
+    OperatorH(x0,z,phys->hcoef,phys->hfcoef,grid,phys,prop);
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      z[i] = b[i]-z[i];
+    }
+    if(InnerProduct(z,z,grid,myproc,numprocs,comm)>bnorm) {
+      for(i=0;i<grid->Nc;i++)
+        phys->hproj[0][i]=0;
+      x0=phys->hproj[0];
+      r0=phys->hprojA[0];
+      phys->nhproj=nh=0;
+    }
+  }
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+
+    x[i] = x0[i];
+    if(nh)
+      r[i] = z[i];
+    r0[i] = r[i];
+  }
+}
+
+/*
+ * Function: HProjectUpdate
+ * Usage: HProjectUpdate(x,r,niters,grid,phys,prop,myproc,numprocs,comm);
+ * -----------------------------------------------------------------------
+ * Add the correction dx=x-x0 found by CG to the free-surface solution history
+ * after orthogonalizing it against the stored solutions in the operator norm.
+ * Its image is A dx=r0-r, so no operator evaluation is needed.  A correction
+ * that is nearly in the span of the history is dropped since it would amplify
+ * roundoff in the next guess.  When the history already holds nprojection
+ * solutions it is restarted with x alone.
+ *
+ */
+static void HProjectUpdate(REAL *x, REAL *r, int niters, gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm) {
+
+  int i, iptr, m, nh=phys->nhproj;
+  REAL beta, d, d0=0, *dx, *Adx;
+
+  if(nh==prop->nprojection) {
+    dx=phys->hproj[0];
+    Adx=phys->hprojA[0];
+    for(i=0;i<grid->Nc;i++)
+      dx[i]=0;
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      dx[i]=x[i];
+    }
+    ISendRecvCellData2D(dx,grid,myproc,comm);
+    OperatorH(dx,Adx,phys->hcoef,phys->hfcoef,grid,phys,prop);
+    nh=0;
+  } else {
+    // No new information when CG did not iterate
+    if(!niters)
+      return;
+
+    dx=phys->hproj[nh];
+    Adx=phys->hprojA[nh];
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+      i = grid->cellp[iptr];
+
+      dx[i]=x[i]-dx[i];
+      Adx[i]-=r[i];
+    }
+    d0 = InnerProduct(dx,Adx,grid,myproc,numprocs,comm);
+    for(m=0;m<nh;m++) {
+      beta = InnerProduct(phys->hproj[m],Adx,grid,myproc,numprocs,comm)/phys->hprojd[m];
+      for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+        i = grid->cellp[iptr];
+
+        dx[i]-=beta*phys->hproj[m][i];
+        Adx[i]-=beta*phys->hprojA[m][i];
+      }
+    }
+  }
+
+  d = InnerProduct(dx,Adx,grid,myproc,numprocs,comm);
+  if(d>1e-6*d0) {
+    phys->hprojd[nh]=d;
+    nh++;
+  }
+  phys->nhproj=nh;
+}
+
 /*
  * Function: HPreconditioner
  * Usage: HPreconditioner(r,rtmp,grid,phys,prop);
  * ----------------------------------------------
  * Multiply the vector x by the inverse of the preconditioner M with
- * xc = M^{-1} x
+ * xc = M^{-1} x, where M is the diagonal of the operator (hprecond=1) or
+ * its Cholesky factorization from HFactor (hprecond=2).
  *
  */
 static void HPreconditioner(REAL *x, REAL *y, gridT *grid, physT *phys, propT *prop) {
   int i, iptr;
 
+  if(prop->hprecond==2) {
+    EnvelopeSolve(phys->hchol,x,y,grid->cellp+grid->celldist[0]);
+    return;
+  }
+
   for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
     i = grid->cellp[iptr];
 
@@ -3234,13 +4078,120 @@ static void HPreconditioner(REAL *x, REAL *y, gridT *grid, physT *phys, propT *p
   }
 }
 
+/*
+ * Function: AssembleHOperator
+ * Usage: AssembleHOperator(grid,phys);
+ * ------------------------------------
+ * Build the compressed-row structure of the free-surface operator once, since
+ * the connectivity of the computational cells does not change.  The
+ * off-diagonal values are stored in phys->hfcoef and are updated in place by
+ * HCoefficients each time step.
+ *
+ */
+static void AssembleHOperator(gridT *grid, physT *phys) {
+  int i, iptr, nf, nnz, Nrows=grid->celldist[1]-grid->celldist[0], *row;
+
+  phys->hrow = (int *)SunMalloc((Nrows+1)*sizeof(int),"AssembleHOperator");
+  row = (int *)SunMalloc(grid->Nc*sizeof(int),"AssembleHOperator");
+  for(i=0;i<grid->Nc;i++)
+    row[i]=-1;
+
+  nnz=0;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+
+    phys->hrow[iptr-grid->celldist[0]]=nnz;
+    row[i]=iptr-grid->celldist[0];
+    for(nf=0;nf<grid->nfaces[i];nf++) 
+      if(grid->neigh[i*grid->maxfaces+nf]!=-1)
+        nnz++;
+  }
+  phys->hrow[Nrows]=nnz;
+
+  phys->hcol = (int *)SunMalloc((nnz+1)*sizeof(int),"AssembleHOperator");
+  phys->hedge = (int *)SunMalloc((nnz+1)*sizeof(int),"AssembleHOperator");
+  phys->hcolrow = (int *)SunMalloc((nnz+1)*sizeof(int),"AssembleHOperator");
+  phys->hfcoef = (REAL *)SunMalloc((nnz+1)*sizeof(REAL),"AssembleHOperator");
+
+  nnz=0;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+
+    for(nf=0;nf<grid->nfaces[i];nf++) 
+      if(grid->neigh[i*grid->maxfaces+nf]!=-1) {
+        phys->hcol[nnz]=grid->neigh[i*grid->maxfaces+nf];
+        phys->hcolrow[nnz]=row[phys->hcol[nnz]];
+        phys->hedge[nnz]=grid->face[i*grid->maxfaces+nf];
+        nnz++;
+      }
+  }
+  phys->hchol=NULL;
+  phys->hchol0=NULL;
+
+  SunFree(row,grid->Nc*sizeof(int),"AssembleHOperator");
+}
+
+/*
+ * Function: HFactor
+ * Usage: HFactor(grid,phys,prop,myproc);
+ * --------------------------------------
+ * Keep the Cholesky factor of the free-surface operator used by the
+ * hprecond=2 preconditioner up to date.  The ordering and envelope are
+ * computed on the first call only.  The numerical factorization is redone
+ * only when a coefficient has changed by more than hfactortol relative to
+ * the ones it was computed from.  In between, the stale factor is still a
+ * good preconditioner and CGSolve converges in a few iterations.  With one
+ * processor and a fresh factor CG converges in a single iteration, i.e.
+ * it is a direct solve.  With more processors the couplings to other
+ * subdomains are dropped and it acts as a block-Jacobi preconditioner.
+ *
+ */
+static void HFactor(gridT *grid, physT *phys, propT *prop, int myproc) {
+  int i, iptr, nz, r, Nrows=grid->celldist[1]-grid->celldist[0], nnz=phys->hrow[Nrows], refactor=0;
+  REAL *c0;
+
+  if(!phys->hchol) {
+    phys->hchol=EnvelopeCreate(Nrows,phys->hrow,phys->hcolrow,"HFactor");
+    phys->hchol0=(REAL *)SunMalloc((Nrows+nnz)*sizeof(REAL),"HFactor");
+    if(myproc==0 && VERBOSE>2) 
+      printf("Free-surface Cholesky factor has %d entries for %d cells.\n",phys->hchol->size,Nrows);
+    refactor=1;
+  }
+
+  c0=phys->hchol0;
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1] && !refactor;iptr++) {
+    i = grid->cellp[iptr];
+    r = iptr-grid->celldist[0];
+
+    if(fabs(phys->hcoef[i]-c0[r])>prop->hfactortol*fabs(c0[r]))
+      refactor=1;
+  }
+  for(nz=0;nz<nnz && !refactor;nz++)
+    if(fabs(phys->hfcoef[nz]-c0[Nrows+nz])>prop->hfactortol*fabs(c0[Nrows+nz]))
+      refactor=1;
+
+  if(refactor) {
+    if(!EnvelopeFactor(phys->hchol,phys->hcoef,grid->cellp+grid->celldist[0],
+          phys->hrow,phys->hcolrow,phys->hfcoef)) {
+      printf("Warning...Free-surface operator is not positive definite on processor %d.  Using hprecond=1.\n",myproc);
+      prop->hprecond=1;
+      return;
+    }
+    for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) 
+      c0[iptr-grid->celldist[0]]=phys->hcoef[grid->cellp[iptr]];
+    for(nz=0;nz<nnz;nz++)
+      c0[Nrows+nz]=phys->hfcoef[nz];
+  }
+}
+
 /*
  * Function: HCoefficients
  * Usage: HCoefficients(coef,fcoef,grid,phys,prop);
  * --------------------------------------------------
  * Compute coefficients for the free-surface solver.  fcoef stores
- * coefficients at the flux faces while coef stores coefficients
- * at the cell center.  If L is the linear operator on x, then
+ * coefficients at the flux faces in the compressed-row order built by
+ * AssembleHOperator while coef stores coefficients at the cell center.  
+ * If L is the linear operator on x, then
  *
  * L(x(i)) = coef(i)*x(i) - sum(m=1:3) fcoef(ne)*x(neigh)
  * coef(i) = (Ac(i) + sum(m=1:3) tmp*D(ne)*df(ne)/dg(ne))
@@ -3251,20 +4202,19 @@ static void HPreconditioner(REAL *x, REAL *y, gridT *grid, physT *phys, propT *p
  */
 static void HCoefficients(REAL *coef, REAL *fcoef, gridT *grid, physT *phys, propT *prop) {
 
-  int i, j, iptr, jptr, ne, nf;
-  REAL tmp = prop->grav*pow(prop->theta*prop->dt,2), h0, boundary_flag;
+  int i, iptr, ne, nz, *hrow=phys->hrow;
+  REAL tmp = prop->grav*pow(prop->theta*prop->dt,2);
 
-  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++,hrow++) {
     i = grid->cellp[iptr];
 
     coef[i] = grid->Ac[i];
-    for(nf=0;nf<grid->nfaces[i];nf++) 
-      if(grid->neigh[i*grid->maxfaces+nf]!=-1) {
-        ne = grid->face[i*grid->maxfaces+nf];
+    for(nz=hrow[0];nz<hrow[1];nz++) {
+      ne = phys->hedge[nz];
 
-        fcoef[i*grid->maxfaces+nf]=tmp*phys->D[ne]*grid->df[ne]/grid->dg[ne];
-        coef[i]+=fcoef[i*grid->maxfaces+nf];
-      }
+      fcoef[nz]=tmp*phys->D[ne]*grid->df[ne]/grid->dg[ne];
+      coef[i]+=fcoef[nz];
+    }
   }
 }
 
@@ -3331,21 +4281,23 @@ static REAL InnerProduct3(REAL **x, REAL **y, gridT *grid, int myproc, int numpr
  *
  * where tmp = prop->grav*(theta*dt)^2
  *
+ * The off-diagonal terms are applied with the compressed-row structure built
+ * in AssembleHOperator, so the inner loop streams through fcoef and hcol.
+ *
  */
 static void OperatorH(REAL *x, REAL *y, REAL *coef, REAL *fcoef, gridT *grid, physT *phys, propT *prop) {
 
-  int i, j, iptr, jptr, ne, nf;
-  REAL tmp = prop->grav*pow(prop->theta*prop->dt,2), h0, boundary_flag;
+  int i, iptr, nz, *hcol=phys->hcol, *hrow=phys->hrow;
+  REAL sum;
 
-  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++,hrow++) {
     i = grid->cellp[iptr];
 
-    y[i] = coef[i]*x[i];
-    for(nf=0;nf<grid->nfaces[i];nf++) 
-      if(grid->neigh[i*grid->maxfaces+nf]!=-1)
-        y[i]-=fcoef[i*grid->maxfaces+nf]*x[grid->neigh[i*grid->maxfaces+nf]];
+    sum = coef[i]*x[i];
+    for(nz=hrow[0];nz<hrow[1];nz++)
+      sum-=fcoef[nz]*x[hcol[nz]];
+    y[i] = sum;
   }
-
 }
 
 /*
@@ -3571,7 +4523,8 @@ static void GuessQ(REAL **q, REAL **wold, REAL **w, gridT *grid, physT *phys, pr
  * Usage: Preconditioner(x,xc,coef,grid,phys,prop);
  * ------------------------------------------------
  * Multiply the vector x by the inverse of the preconditioner M with
- * xc = M^{-1} x
+ * xc = M^{-1} x, where M is the diagonal of the operator (hprecond=1) or
+ * its Cholesky factorization from HFactor (hprecond=2).
  *
  */
 static void Preconditioner(REAL **x, REAL **xc, REAL **coef, gridT *grid, physT *phys, propT *prop) {
@@ -3797,6 +4750,7 @@ static void GSSolve(gridT *grid, physT *phys, propT *prop, int myproc, int numpr
   }
   if(n==niters && myproc==0 && WARNING) 
     printf("Warning... Iteration not converging after %d steps! RES=%e\n",n,resid);
+  phys->hiters=n;
 
   for(i=0;i<grid->Nc;i++)
     if(h[i]!=h[i]) 
@@ -3851,43 +4805,73 @@ void Continuity(REAL **w, gridT *grid, physT *phys, propT *prop)
  * domain and return a warning if the mass and volume are not conserved to within
  * the tolerance CONSERVED specified in suntans.h 
  *
+ * The integrals of the other tracers that are computed in this run are placed
+ * in phys->tracermass in the order T, agec, agealpha, each sediment size
+ * class and then each passive tracer.  All of the integrals use compensated sums and are gathered
+ * with a single reduction.
+ *
  */
 void ComputeConservatives(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs,
 			  MPI_Comm comm)
 {
-  int i, iptr, k;
-  REAL mass, volume, volh, height, Ep;
-
-  if(myproc==0) phys->mass=0;
-  if(myproc==0) phys->volume=0;
-  if(myproc==0) phys->Ep=0;
-
-  // volh is the horizontal integral of h+d, whereas vol is the
-  // 3-d integral of dzz
-  mass=0;
-  volume=0;
-  volh=0;
-  Ep=0;
+  int i, iptr, k, m, n, Nsedi, Npassive, Ntracers, Nsums;
+  REAL dV, *global;
+  sumT *sums;
+
+  // Age and sediments are allocated on their first update
+  Nsedi = (prop->computeSediments && sediments) ? sediments->Nsize : 0;
+  Npassive = (prop->Ntracers>0 && tracers) ? tracers->N : 0;
+  Ntracers = (prop->gamma>0) + 2*(prop->calcage>0 && age) + Nsedi + Npassive;
+  if(Ntracers!=phys->Ntracermass) {
+    if(phys->Ntracermass)
+      SunFree(phys->tracermass,phys->Ntracermass*sizeof(REAL),"ComputeConservatives");
+    phys->tracermass = NULL;
+    if(Ntracers)
+      phys->tracermass = (REAL *)SunMalloc(Ntracers*sizeof(REAL),"ComputeConservatives");
+    phys->Ntracermass = Ntracers;
+  }
+
+  // sums holds the mass, volume, potential energy and then the tracers
+  Nsums = 3+Ntracers;
+  sums = (sumT *)SunMalloc(Nsums*sizeof(sumT),"ComputeConservatives");
+  global = (REAL *)SunMalloc(Nsums*sizeof(REAL),"ComputeConservatives");
+  for(m=0;m<Nsums;m++)
+    sums[m].sum=sums[m].c=0;
 
   for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
     i = grid->cellp[iptr];
-    height = 0;
-    volh+=grid->Ac[i]*(grid->dv[i]+phys->h[i]);
-    Ep+=0.5*prop->grav*grid->Ac[i]*(phys->h[i]+grid->dv[i])*(phys->h[i]-grid->dv[i]);
+    SumAdd(&sums[2],0.5*prop->grav*grid->Ac[i]*(phys->h[i]+grid->dv[i])*(phys->h[i]-grid->dv[i]));
     for(k=grid->ctop[i];k<grid->Nk[i];k++) {
-      height += grid->dzz[i][k];
-      volume+=grid->Ac[i]*grid->dzz[i][k];
-      mass+=phys->s[i][k]*grid->Ac[i]*grid->dzz[i][k];
+      dV = grid->Ac[i]*grid->dzz[i][k];
+      SumAdd(&sums[0],phys->s[i][k]*dV);
+      SumAdd(&sums[1],dV);
+
+      m=3;
+      if(prop->gamma>0)
+        SumAdd(&sums[m++],phys->T[i][k]*dV);
+      if(prop->calcage>0 && age) {
+        SumAdd(&sums[m++],age->agec[i][k]*dV);
+        SumAdd(&sums[m++],age->agealpha[i][k]*dV);
+      }
+      for(n=0;n<Nsedi;n++)
+        SumAdd(&sums[m++],sediments->SediC[n][i][k]*dV);
+      for(n=0;n<Npassive;n++)
+        SumAdd(&sums[m++],tracers->c[n][i][k]*dV);
     }
   }
 
-  // Comment out the volh reduce if that integral is desired.  The
-  // volume integral is used since the volh integral is useful
-  // only for debugging.
-  MPI_Reduce(&mass,&(phys->mass),1,MPI_DOUBLE,MPI_SUM,0,comm);
-  //MPI_Reduce(&volh,&(phys->volume),1,MPI_DOUBLE,MPI_SUM,0,comm);
-  MPI_Reduce(&volume,&(phys->volume),1,MPI_DOUBLE,MPI_SUM,0,comm);
-  MPI_Reduce(&Ep,&(phys->Ep),1,MPI_DOUBLE,MPI_SUM,0,comm);
+  ReduceSums(sums,global,Nsums,myproc,comm);
+
+  if(myproc==0) {
+    phys->mass = global[0];
+    phys->volume = global[1];
+    phys->Ep = global[2];
+    for(m=0;m<Ntracers;m++)
+      phys->tracermass[m] = global[3+m];
+  }
+
+  SunFree(sums,Nsums*sizeof(sumT),"ComputeConservatives");
+  SunFree(global,Nsums*sizeof(REAL),"ComputeConservatives");
 
   // Compare the quantities to the original values at the beginning of the
   // computation.  If prop->n==0 (beginning of simulation), then store the
@@ -3908,20 +4892,157 @@ void ComputeConservatives(gridT *grid, physT *phys, propT *prop, int myproc, int
   }
 }
 
+/*
+ * Function: NeedRTInterpolation
+ * Usage: if(NeedRTInterpolation(prop)) ...
+ * ----------------------------------------
+ * The nodal and tangential RT velocities are only needed for quadratic interpolation
+ * of the cell-centered velocity, which is also used for output when prettyplot is set.
+ *
+ */
+static int NeedRTInterpolation(propT *prop) {
+  return prop->interp==QUAD || prop->prettyplot;
+}
+
+/*
+ * Function: ComputeUCWeights
+ * Usage: ComputeUCWeights(grid,phys,prop);
+ * ----------------------------------------
+ * Compute the weights used to reconstruct the cell-centered velocity from the
+ * face velocities, which only depend on the grid.  See the description of
+ * ucweights, quadweights, and rt0weights in phys.h.
+ *
+ */
+static void ComputeUCWeights(gridT *grid, physT *phys, propT *prop) {
+  int n, nf, ne, in, inpc, e1, e2;
+  REAL *w, M[3], det, xt[3], yt[3], S[3];
+
+  for(n=0;n<grid->Nc;n++) {
+    w = phys->perotweights+2*n*grid->maxfaces;
+    for(nf=0;nf<grid->nfaces[n];nf++) {
+      ne = grid->face[n*grid->maxfaces+nf];
+      w[2*nf] = grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]/grid->Ac[n];
+      w[2*nf+1] = grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]/grid->Ac[n];
+    }
+
+    // The least-squares fit to u_{face} = uc n1_{face} + vc n2_{face} is
+    // (A^T A)^{-1} A^T u_{face}, where the rows of A are the face normals
+    if(prop->interp==LSQ) {
+      M[0]=M[1]=M[2]=0;
+      for(nf=0;nf<grid->nfaces[n];nf++) {
+        ne = grid->face[n*grid->maxfaces+nf];
+        M[0]+=grid->n1[ne]*grid->n1[ne];
+        M[1]+=grid->n1[ne]*grid->n2[ne];
+        M[2]+=grid->n2[ne]*grid->n2[ne];
+      }
+      det = M[0]*M[2]-M[1]*M[1];
+      w = phys->ucweights+2*n*grid->maxfaces;
+      for(nf=0;nf<grid->nfaces[n];nf++) {
+        ne = grid->face[n*grid->maxfaces+nf];
+        w[2*nf] = (M[2]*grid->n1[ne]-M[1]*grid->n2[ne])/det;
+        w[2*nf+1] = (M[0]*grid->n2[ne]-M[1]*grid->n1[ne])/det;
+      }
+    }
+  }
+
+  if(!phys->quadweights)
+    return;
+
+  // Quadratic interpolation weights at the Voronoi point (Wang et al. 2011 eq 12),
+  // where S[nf] is the normalized area of the subtriangle formed with nodes nf and nf+1.
+  for(n=0;n<grid->Nc;n++) {
+    if(grid->nfaces[n]!=3)
+      continue;
+    for(nf=0;nf<3;nf++) {
+      xt[0] = grid->xp[grid->cells[grid->maxfaces*n+nf]];
+      yt[0] = grid->yp[grid->cells[grid->maxfaces*n+nf]];
+      xt[1] = grid->xp[grid->cells[grid->maxfaces*n+(nf+1)%3]];
+      yt[1] = grid->yp[grid->cells[grid->maxfaces*n+(nf+1)%3]];
+      xt[2] = grid->xv[n];
+      yt[2] = grid->yv[n];
+      S[nf] = GetArea(xt, yt, 3)/grid->Ac[n];
+    }
+    w = phys->quadweights+6*n;
+    w[0] = (2*S[1]-1)*S[1];
+    w[1] = (2*S[2]-1)*S[2];
+    w[2] = (2*S[0]-1)*S[0];
+    w[3] = 4*S[2]*S[1];
+    w[4] = 4*S[0]*S[2];
+    w[5] = 4*S[0]*S[1];
+  }
+
+  // The RT0 nodal velocity of each cell neighbor of a node follows from the normal
+  // velocities on the two edges of the cell that share the node (Wang et al. 2011 Appendix B)
+  for(in=0;in<grid->Np;in++)
+    for(inpc=0;inpc<grid->numpcneighs[in];inpc++) {
+      e1 = grid->peneighs[in][2*inpc];
+      e2 = grid->peneighs[in][2*inpc+1];
+      det = grid->n1[e1]*grid->n2[e2] - grid->n2[e1]*grid->n1[e2];
+      w = phys->rt0weights[in]+4*inpc;
+      w[0] = grid->n2[e2]/det;
+      w[1] = -grid->n2[e1]/det;
+      w[2] = -grid->n1[e2]/det;
+      w[3] = grid->n1[e1]/det;
+    }
+}
+
+/*
+ * Function: UCFaceSum
+ * Usage: UCFaceSum(u,uc[n],vc[n],n,kstart,kend,dzf,weights,grid);
+ * ----------------------------------------------------------------
+ * Adds the sum of the face velocities of cell n times weights (ucweights or
+ * perotweights) to uc and vc
+ * for layers kstart to kend-1.  The velocities are also multiplied by dzf
+ * unless it is NULL.  Below the bottom of a face the velocity at its bottom is
+ * used when smoothbot is set.
+ *
+ */
+static void UCFaceSum(REAL **u, REAL *uc, REAL *vc, int n, int kstart, int kend, 
+    REAL **dzf, REAL *weights, gridT *grid) {
+  int k, kb, nf, ne;
+  REAL w1, w2, ub, *w = weights+2*n*grid->maxfaces;
+
+  for(nf=0;nf<grid->nfaces[n];nf++) {
+    ne = grid->face[n*grid->maxfaces+nf];
+    w1 = w[2*nf];
+    w2 = w[2*nf+1];
+    kb = kend;
+    if(grid->smoothbot && grid->Nke[ne]<kend)
+      kb = grid->Nke[ne]>kstart ? grid->Nke[ne] : kstart;
+
+    if(dzf) {
+      for(k=kstart;k<kb;k++) {
+        uc[k]+=u[ne][k]*dzf[ne][k]*w1;
+        vc[k]+=u[ne][k]*dzf[ne][k]*w2;
+      }
+      ub = kb<kend ? u[ne][grid->Nke[ne]-1]*dzf[ne][grid->Nke[ne]-1] : 0;
+    } else {
+      for(k=kstart;k<kb;k++) {
+        uc[k]+=u[ne][k]*w1;
+        vc[k]+=u[ne][k]*w2;
+      }
+      ub = kb<kend ? u[ne][grid->Nke[ne]-1] : 0;
+    }
+    for(k=kb;k<kend;k++) {
+      uc[k]+=ub*w1;
+      vc[k]+=ub*w2;
+    }
+  }
+}
+
 /*
  * Function: ComputeUCPerot
- * Usage: ComputeUCPerot(u,uc,vc,grid);
- * -------------------------------------------
+ * Usage: ComputeUCPerot(u,uc,vc,grid,phys);
+ * -----------------------------------------
  * Compute the cell-centered components of the velocity vector and place them
  * into uc and vc.  This function estimates the velocity vector with
  *
  * u = 1/Area * Sum_{faces} u_{face} normal_{face} df_{face}*d_{ef,face}
  *
  */
-static void ComputeUCPerot(REAL **u, REAL **uc, REAL **vc, gridT *grid) {
+static void ComputeUCPerot(REAL **u, REAL **uc, REAL **vc, gridT *grid, physT *phys) {
 
-  int k, n, ne, nf, iptr;
-  REAL sum;
+  int k, n, iptr;
 
   // for each computational cell (non-stage defined)
   for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
@@ -3934,58 +5055,35 @@ static void ComputeUCPerot(REAL **u, REAL **uc, REAL **vc, gridT *grid) {
       uc[n][k]=0;
       vc[n][k]=0;
     }
+
+    //top cell only - don't account for depth
+    UCFaceSum(u,uc[n],vc[n],n,grid->ctop[n],grid->ctop[n]+1,NULL,phys->ucweights,grid);
+
     // over all interior cells
+    UCFaceSum(u,uc[n],vc[n],n,grid->ctop[n]+1,grid->Nk[n],grid->dzf,phys->ucweights,grid);
     for(k=grid->ctop[n]+1;k<grid->Nk[n];k++) {
-      // over each face
-      for(nf=0;nf<grid->nfaces[n];nf++) {
-        ne = grid->face[n*grid->maxfaces+nf];
-        if(!(grid->smoothbot) || k<grid->Nke[ne]){
-          uc[n][k]+=u[ne][k]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]*grid->dzf[ne][k];
-          vc[n][k]+=u[ne][k]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]*grid->dzf[ne][k];
-        }
-        else{	
-          uc[n][k]+=u[ne][grid->Nke[ne]-1]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]*grid->dzf[ne][grid->Nke[ne]-1];
-          vc[n][k]+=u[ne][grid->Nke[ne]-1]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne]*grid->dzf[ne][grid->Nke[ne]-1];
-	}
-      }
-
       // In case of divide by zero (shouldn't happen)
       if (grid->dzz[n][k]  > DRYCELLHEIGHT) {
-          uc[n][k]/=(grid->Ac[n]*grid->dzz[n][k]);
-          vc[n][k]/=(grid->Ac[n]*grid->dzz[n][k]);
+          uc[n][k]/=grid->dzz[n][k];
+          vc[n][k]/=grid->dzz[n][k];
       } else {
           uc[n][k] = 0;
           vc[n][k] = 0;
       }
     }
-
-    //top cell only - don't account for depth
-    k=grid->ctop[n];
-    // over each face
-    for(nf=0;nf<grid->nfaces[n];nf++) {
-	ne = grid->face[n*grid->maxfaces+nf];
-	if(!(grid->smoothbot) || k<grid->Nke[ne]){
-	    uc[n][k]+=u[ne][k]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-	    vc[n][k]+=u[ne][k]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-	}
-	else{	
-	    uc[n][k]+=u[ne][grid->Nke[ne]-1]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-	    vc[n][k]+=u[ne][grid->Nke[ne]-1]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];        
-	}
-    }
-    uc[n][k]/=grid->Ac[n];
-    vc[n][k]/=grid->Ac[n];
-   
   }
 }
+
+/*
+ * Function: ComputeUCLSQ
+ * Usage: ComputeUCLSQ(u,uc,vc,grid,phys);
+ * ---------------------------------------
+ * Compute the cell-centered components of the velocity vector and place them
+ * into uc and vc with a least-squares fit to the face velocities.
+ *
+ */
 static void ComputeUCLSQ(REAL **u, REAL **uc, REAL **vc, gridT *grid, physT *phys){
-  int k, n, ne, nf, iptr;
-  REAL sum;
-  int ii,jj,kk;
-  REAL **A = phys->A;
-  REAL **AT = phys->AT;
-  REAL **Apr = phys->Apr;
-  REAL *bpr = phys->bpr;
+  int k, n, iptr;
 
   // for each computational cell (non-stage defined)
   for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
@@ -3998,66 +5096,10 @@ static void ComputeUCLSQ(REAL **u, REAL **uc, REAL **vc, gridT *grid, physT *phy
       uc[n][k]=0;
       vc[n][k]=0;
     }
-    for(nf=0;nf<grid->nfaces[n];nf++) {
-
-        ne = grid->face[n*grid->maxfaces+nf];
-	
-    	// Construct the normal array - A
-	A[nf][0] = grid->n1[ne];
-	A[nf][1] = grid->n2[ne];
-
-	// Construct A transpose
-	AT[0][nf] = A[nf][0];
-	AT[1][nf] = A[nf][1];
-    }
-
-    for(k=grid->ctop[n];k<grid->Nk[n];k++) {
-	
-	// Multiply A' = A^T*A 
-	// This can't be moved outside of this for loop because A' is
-	// modified by linsolve()
-	for(ii=0;ii<2;ii++){
-	    for(jj=0;jj<2;jj++){
-		sum=0;
-		for(nf=0;nf<grid->nfaces[n];nf++) {
-		    sum += AT[ii][nf]*A[nf][jj];
-		}
-		Apr[ii][jj]=sum;
-	    }
-	}
-    	// Compute b' = A^T * b
-	for(ii=0;ii<2;ii++){
-	    sum=0;
-	    for(nf=0;nf<grid->nfaces[n];nf++) {
-		ne = grid->face[n*grid->maxfaces+nf];
-		if(!(grid->smoothbot) || k<grid->Nke[ne]){
-		    sum += AT[ii][nf]*u[ne][k];
-		    //sum += AT[ii][nf]*u[ne][k]*grid->dzf[ne][k];
-		} else{
-		    sum += AT[ii][nf]*u[ne][grid->Nke[ne]-1];
-		    //sum += AT[ii][nf]*u[ne][grid->Nke[ne]-1]*grid->dzf[ne][grid->Nke[ne]-1];
-		}
-	    }
-	    bpr[ii]=sum;
-	}
-	// Now solve the problem (A'A)x = (A'b)
-	linsolve(Apr,bpr,2);
-       
-	uc[n][k]=bpr[0];
-	vc[n][k]=bpr[1];	
-	//if (grid->dzz[n][k]  > 1e-3) {
-	//    uc[n][k]=bpr[0]/grid->dzz[n][k];
-	//    vc[n][k]=bpr[1]/grid->dzz[n][k];
-	//}else{
-	//    uc[n][k]=0;
-	//    vc[n][k]=0;
-	//}
-    }
-
+    UCFaceSum(u,uc[n],vc[n],n,grid->ctop[n],grid->Nk[n],NULL,phys->ucweights,grid);
   }
 }
 
-
 /*
  * Function: ReadProperties
  * Usage: ReadProperties(prop,grid,myproc);
@@ -4082,6 +5124,24 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   (*prop)->gamma = MPI_GetValue(DATAFILE,"gamma","ReadProperties",myproc);
   (*prop)->kappa_T = MPI_GetValue(DATAFILE,"kappa_T","ReadProperties",myproc);
   (*prop)->kappa_TH = MPI_GetValue(DATAFILE,"kappa_TH","ReadProperties",myproc);
+  (*prop)->eos = (int)MPI_GetValue(DATAFILE,"eos","ReadProperties",myproc);
+  if((*prop)->eos<0 || (*prop)->eos>3) {
+    printf("Error in ReadProperties...eos must be 0, 1, 2, or 3 (eos=%d).\n",(*prop)->eos);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  if((*prop)->eos==2) {
+    (*prop)->eostol = MPI_GetValue(DATAFILE,"eostol","ReadProperties",myproc);
+    if((*prop)->eostol<=0) {
+      printf("Error in ReadProperties...eostol must be positive (eostol=%e).\n",(*prop)->eostol);
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if((*prop)->eos==3) {
+    (*prop)->eosSref = MPI_GetValue(DATAFILE,"eosSref","ReadProperties",myproc);
+    (*prop)->eosTref = MPI_GetValue(DATAFILE,"eosTref","ReadProperties",myproc);
+  }
   (*prop)->nu = MPI_GetValue(DATAFILE,"nu","ReadProperties",myproc);
   (*prop)->nu_H = MPI_GetValue(DATAFILE,"nu_H","ReadProperties",myproc);
   (*prop)->tau_T = MPI_GetValue(DATAFILE,"tau_T","ReadProperties",myproc);
@@ -4103,6 +5163,30 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
 
   (*prop)->ntprog = (int)MPI_GetValue(DATAFILE,"ntprog","ReadProperties",myproc);
   (*prop)->ntconserve = (int)MPI_GetValue(DATAFILE,"ntconserve","ReadProperties",myproc);
+  (*prop)->ntcheck = (int)MPI_GetValue(DATAFILE,"ntcheck","ReadProperties",myproc);
+  (*prop)->adaptdt = (int)MPI_GetValue(DATAFILE,"adaptdt","ReadProperties",myproc);
+  if((*prop)->adaptdt) {
+    (*prop)->Cadapt = MPI_GetValue(DATAFILE,"Cadapt","ReadProperties",myproc);
+    (*prop)->dtmin = MPI_GetValue(DATAFILE,"dtmin","ReadProperties",myproc);
+    (*prop)->dtmax = MPI_GetValue(DATAFILE,"dtmax","ReadProperties",myproc);
+    if((*prop)->ntcheck<=0) {
+      printf("Error in ReadProperties...adaptdt=1 requires ntcheck>0 (ntcheck=%d).\n",(*prop)->ntcheck);
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    if((*prop)->Cadapt<=0 || (*prop)->Cadapt>(*prop)->Cmax) {
+      printf("Error in ReadProperties...Cadapt must be in (0,Cmax] (Cadapt=%.2f, Cmax=%.2f).\n",
+          (*prop)->Cadapt,(*prop)->Cmax);
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    if((*prop)->dtmin<0 || ((*prop)->dtmax>0 && (*prop)->dtmax<(*prop)->dtmin)) {
+      printf("Error in ReadProperties...need 0<=dtmin<=dtmax (dtmin=%.3e, dtmax=%.3e).\n",
+          (*prop)->dtmin,(*prop)->dtmax);
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+  }
   (*prop)->nonhydrostatic = (int)MPI_GetValue(DATAFILE,"nonhydrostatic","ReadProperties",myproc);
   (*prop)->cgsolver = (int)MPI_GetValue(DATAFILE,"cgsolver","ReadProperties",myproc);
   (*prop)->maxiters = (int)MPI_GetValue(DATAFILE,"maxiters","ReadProperties",myproc);
@@ -4128,6 +5212,7 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   (*prop)->TVDsalt = MPI_GetValue(DATAFILE,"TVDsalt","ReadProperties",myproc);
   (*prop)->TVDtemp = MPI_GetValue(DATAFILE,"TVDtemp","ReadProperties",myproc);
   (*prop)->TVDturb = MPI_GetValue(DATAFILE,"TVDturb","ReadProperties",myproc);
+  (*prop)->TVDtracers = MPI_GetValue(DATAFILE,"TVDtracers","ReadProperties",myproc);
   (*prop)->stairstep = MPI_GetValue(DATAFILE,"stairstep","ReadProperties",myproc);
   (*prop)->AB = MPI_GetValue(DATAFILE,"AB","ReadProperties",myproc); //AB3
   (*prop)->TVDmomentum = MPI_GetValue(DATAFILE,"TVDmomentum","ReadProperties",myproc); 
@@ -4136,6 +5221,13 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   (*prop)->newcells = MPI_GetValue(DATAFILE,"newcells","ReadProperties",myproc); 
   (*prop)->mergeArrays = MPI_GetValue(DATAFILE,"mergeArrays","ReadProperties",myproc); 
   (*prop)->computeSediments = MPI_GetValue(DATAFILE,"computeSediments","ReadProperties",myproc); 
+  (*prop)->baroclinic = (int)MPI_GetValue(DATAFILE,"baroclinic","ReadProperties",myproc);
+  (*prop)->ntscalar = (int)MPI_GetValue(DATAFILE,"ntscalar","ReadProperties",myproc);
+  if((*prop)->ntscalar<1) {
+    printf("Error in ReadProperties...ntscalar must be at least 1 (ntscalar=%d).\n",(*prop)->ntscalar);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
 
   // When wetting and drying is desired:
   // -Do nonconservative momentum advection (conserveMomentum=0)
@@ -4150,6 +5242,12 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   
   (*prop)->calcage = MPI_GetValue(DATAFILE,"calcage","ReadProperties",myproc);
   (*prop)->agemethod = MPI_GetValue(DATAFILE,"agemethod","ReadProperties",myproc);
+  (*prop)->Ntracers = (int)MPI_GetValue(DATAFILE,"Ntracers","ReadProperties",myproc);
+  if((*prop)->Ntracers<0) {
+    printf("Error in ReadProperties...Ntracers must be nonnegative (Ntracers=%d).\n",(*prop)->Ntracers);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
   (*prop)->calcaverage = MPI_GetValue(DATAFILE,"calcaverage","ReadProperties",myproc);
   if ((*prop)->calcaverage)
       (*prop)->ntaverage = (int)MPI_GetValue(DATAFILE,"ntaverage","ReadProperties",myproc);
@@ -4164,6 +5262,7 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   (*prop)->netcdfBdy = (int)MPI_GetValue(DATAFILE,"netcdfBdy","ReadProperties",myproc);
   (*prop)->readinitialnc = (int)MPI_GetValue(DATAFILE,"readinitialnc","ReadProperties",myproc);
   (*prop)->Lsw = MPI_GetValue(DATAFILE,"Lsw","ReadProperties",myproc);
+  (*prop)->jerlov = (int)MPI_GetValue(DATAFILE,"jerlov","ReadProperties",myproc);
   (*prop)->Cda = MPI_GetValue(DATAFILE,"Cda","ReadProperties",myproc);
   (*prop)->Ce = MPI_GetValue(DATAFILE,"Ce","ReadProperties",myproc);
   (*prop)->Ch = MPI_GetValue(DATAFILE,"Ch","ReadProperties",myproc);
@@ -4186,6 +5285,14 @@ void ReadProperties(propT **prop, gridT *grid, int myproc)
   }
 
   (*prop)->hprecond = MPI_GetValue(DATAFILE,"hprecond","ReadProperties",myproc);
+  if((*prop)->hprecond==2)
+    (*prop)->hfactortol = MPI_GetValue(DATAFILE,"hfactortol","ReadProperties",myproc);
+  (*prop)->nprojection = (int)MPI_GetValue(DATAFILE,"nprojection","ReadProperties",myproc);
+  if((*prop)->nprojection<0) {
+    printf("Error in ReadProperties...nprojection must be nonnegative (nprojection=%d).\n",(*prop)->nprojection);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
 
   // addition for interpolation methods
   switch((int)MPI_GetValue(DATAFILE,"interp","ReadProperties",myproc)) {
@@ -4294,36 +5401,42 @@ static REAL UFaceFlux(int j, int k, REAL **phi, REAL **u, gridT *grid, REAL dt,
  * Usage: SetDensity(grid,phys,prop);
  * ----------------------------------
  * Sets the values of the density in the density array rho and
- * at the boundaries.
+ * at the boundaries.  The pressure, salinity, and temperature of each
+ * column are gathered into phys->a, phys->b, and phys->c and the
+ * density of the whole column is computed with EquationOfState.
  *
  */
 void SetDensity(gridT *grid, physT *phys, propT *prop) {
-  int i, j, k, jptr, ib;
-  REAL z, p;
+  int i, j, k, jptr, ib, ktop;
+  REAL z, *p=phys->a, *s=phys->b, *T=phys->c;
 
   for(i=0;i<grid->Nc;i++) {
+    ktop=grid->ctop[i];
     z=phys->h[i];
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+    for(k=ktop;k<grid->Nk[i];k++) {
       z+=0.5*grid->dz[k];
-      p=RHO0*prop->grav*z;
-      phys->rho[i][k]=StateEquation(prop,phys->s[i][k],phys->T[i][k],p);
+      p[k-ktop]=RHO0*prop->grav*z;
+      s[k-ktop]=phys->s[i][k];
+      T[k-ktop]=phys->T[i][k];
       z+=0.5*grid->dz[k];
     }
+    EquationOfState(prop,phys->rho[i]+ktop,s,T,p,grid->Nk[i]-ktop);
   }
 
   for(jptr=grid->edgedist[2];jptr<grid->edgedist[3];jptr++) {
     j=grid->edgep[jptr];
     ib=grid->grad[2*j];
 
+    ktop=grid->ctop[ib];
     z=phys->h[ib];
-    for(k=grid->ctop[ib];k<grid->Nk[ib];k++) {
+    for(k=ktop;k<grid->Nk[ib];k++) {
       z+=0.5*grid->dzz[ib][k];
-      p=RHO0*prop->grav*z;
-      phys->boundary_rho[jptr-grid->edgedist[2]][k]=
-        StateEquation(prop,phys->boundary_s[jptr-grid->edgedist[2]][k],
-            phys->boundary_T[jptr-grid->edgedist[2]][k],p);
+      p[k-ktop]=RHO0*prop->grav*z;
       z+=0.5*grid->dzz[ib][k];
     }
+    EquationOfState(prop,phys->boundary_rho[jptr-grid->edgedist[2]]+ktop,
+        phys->boundary_s[jptr-grid->edgedist[2]]+ktop,
+        phys->boundary_T[jptr-grid->edgedist[2]]+ktop,p,grid->Nk[ib]-ktop);
   }
 }
 
@@ -4454,7 +5567,7 @@ void ComputeUC(REAL **ui, REAL **vi, physT *phys, gridT *grid, int myproc, inter
       ComputeUCRT(ui, vi, phys,grid, myproc);
       break;
     case PEROT:
-      ComputeUCPerot(phys->u,ui,vi,grid);
+      ComputeUCPerot(phys->u,ui,vi,grid,phys);
       break;
     case LSQ:
       ComputeUCLSQ(phys->u,ui,vi,grid,phys);
@@ -4476,8 +5589,7 @@ void ComputeUC(REAL **ui, REAL **vi, physT *phys, gridT *grid, int myproc, inter
  */
 static void ComputeUCRT(REAL **ui, REAL **vi, physT *phys, gridT *grid, int myproc) {
 
-  int k, n, ne, nf, iptr;
-  REAL sum;
+  int k, n, iptr;
 
   // first we need to reconstruct the nodal velocities using the RT0 basis functions
   //  if(myproc==0) printf("ComputeNodalVelocity\n");
@@ -4495,150 +5607,60 @@ static void ComputeUCRT(REAL **ui, REAL **vi, physT *phys, gridT *grid, int mypr
 
     // initialize over all depths
     for(k=0;k<grid->Nk[n];k++) {
-      phys->uc[n][k]=0;
-      phys->vc[n][k]=0;
+      ui[n][k]=0;
+      vi[n][k]=0;
     }
 
-    // over the entire depth (cell depth)
-    // possible mistake here- make sure to the get the right value for the start
-    // of the loop (etop?)
-    //    if(myproc==0) printf("ComputeQuadraticInterp\n");
-    if(grid->nfaces[n]==3){
-    for(k=grid->ctop[n];k<grid->Nk[n];k++) {
+    // The other cells use the Perot weights, also when interp is LSQ
+    if(grid->nfaces[n]==3)
       // now we can compute the quadratic interpolated velocity from these results
-      ComputeQuadraticInterp(grid->xv[n], grid->yv[n], n, k, ui, 
-          vi, phys, grid, nRT2, tRT2, myproc);
-    }
-    } else {
-       // over the entire depth (cell depth)
-       for(k=grid->ctop[n];k<grid->Nk[n];k++) {
-        // over each face
-        for(nf=0;nf<grid->nfaces[n];nf++) {
-          ne = grid->face[n*grid->maxfaces+nf];
-          if(!(grid->smoothbot) || k<grid->Nke[ne]){
-            phys->uc[n][k]+=phys->u[ne][k]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-            phys->vc[n][k]+=phys->u[ne][k]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-          }
-          else{	
-            phys->uc[n][k]+=phys->u[ne][grid->Nke[ne]-1]*grid->n1[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-            phys->vc[n][k]+=phys->u[ne][grid->Nke[ne]-1]*grid->n2[ne]*grid->def[n*grid->maxfaces+nf]*grid->df[ne];
-          }
-        }
-
-        phys->uc[n][k]/=grid->Ac[n];
-        phys->vc[n][k]/=grid->Ac[n];
-      }
-    }
+      ComputeQuadraticInterp(n, ui, vi, phys, grid, tRT2);
+    else
+      UCFaceSum(phys->u,ui[n],vi[n],n,grid->ctop[n],grid->Nk[n],NULL,phys->perotweights,grid);
   } 
 }
 
 /*
  * Function: ComputeQuadraticInterp
- * Usage: ComputeQuadraticInterp(U, V, un, grid, ninterp, tinterp, myproc)
+ * Usage: ComputeQuadraticInterp(ic, uc, vc, phys, grid, tinterp)
  * -------------------------------------------
- * Compute the quadratic interpolation of the velocity based on
- * a choice for tinterp.
+ * Compute the quadratic interpolation of the velocity at the Voronoi point
+ * of triangle ic over its depth based on a choice for tinterp.
  * Two options presently exist based on choice of tinterp:
  *  1. tRT1
  *  2. tRT2
  * which are outlined in Wang et al, 2011.
  *
  */
-static void  ComputeQuadraticInterp(REAL x, REAL y, int ic, int ik, REAL **uc, 
-    REAL **vc, physT *phys, gridT *grid, interpolation ninterp, 
-    interpolation tinterp, int myproc) {
-  // this formulation considers a specific cell ic and a specific level ik
-  // for computation of uc and vc
-
-  // we need to have several pieces for this to work: 
-  // we need to be able to quickly compute the area subsets in the triangle
-  // A12, A13, A23; we need nodal velocity vectors (nRT2), and tangential
-  // velocity vectors
-  REAL points[2][grid->nfaces[ic]];
-  REAL xt[3], yt[3];
-  REAL SubArea[grid->nfaces[ic]];
-  REAL nu[grid->nfaces[ic]], nv[grid->nfaces[ic]];
-  REAL eu[grid->nfaces[ic]], ev[grid->nfaces[ic]];
-  int np[grid->nfaces[ic]], ne[grid->nfaces[ic]], nf, ie, ip;
-  const REAL TotalArea = grid->Ac[ic];
-
-  // loop over each of the faces 
-  // possible error if NUMEDGECOLUMNS != NFACES!!
-  for( nf=0; nf < grid->nfaces[ic]; nf ++) {
+static void  ComputeQuadraticInterp(int ic, REAL **uc, REAL **vc, physT *phys, gridT *grid, 
+    interpolation tinterp) {
+  int np[3], ne[3], nf, k;
+  REAL eu[3], ev[3], **tRT, *w = phys->quadweights+6*ic;
+
+  // need to have the specific cell neighbor here for tRT1!  Current implementation 
+  // is not correct.
+  tRT = tinterp == tRT1 ? phys->tRT1 : phys->tRT2;
+
+  for(nf=0; nf < 3; nf++) {
     // get the index for the vertex of the cell
     np[nf] = grid->cells[grid->maxfaces*ic + nf];
     // get the index for the cell edge
     ne[nf] = grid->face[grid->maxfaces*ic + nf];
-    //printf("np is %d, ne is %d\n",np[nf],ne[nf]);
-    // get the coordinates for the points for the vertex
-    // to compute the area of the subtriangle
-    points[0][nf] = grid->xp[np[nf]];
-    points[1][nf] = grid->yp[np[nf]];
-  }
-  // now we have the points for each node: points[x/y][nf=0,1,2]
-  // and also the edges via grid->face[NFACES*ic + nf=0,1,2] for
-  // each cell ic
-
-  // now all that remains is to store the velocities and then
-  // get A12, A13, A23 and we can 
-  // use the formula after getting the vector values for the 
-  // velocities at each of the points
-
-  for( nf=0; nf < grid->nfaces[ic]; nf++) {
-    // get the points for each vertex of the triangle
-    xt[0] = points[0][nf];
-    yt[0] = points[1][nf];
-    // wrap the next one if it goes out of bounds
-    xt[1] = points[0][(nf+1)%grid->nfaces[ic]]; 
-    yt[1] = points[1][(nf+1)%grid->nfaces[ic]];
-    // the interpolated center
-    xt[2] = x;
-    yt[2] = y;
-
-    // get the area from the points where 
-    // nf=0 => A12, nf=1 => A23, nf=2 => A13 from Wang et al 2011
-    // note that this is normalized
-    SubArea[nf] = GetArea(xt, yt, 3)/TotalArea;
-    //          printf("nf = %d Area=%e\n", nf, SubArea[nf]);
-  }
-
-  // get the nodal and edge velocities projected unto global x,y coords
-  for (nf=0; nf < grid->nfaces[ic]; nf++) {
-    // node and edge indexes
-    ip = np[nf]; ie = ne[nf];
-    // get the nodal velocity components 
-    nu[nf] = phys->nRT2u[ip][ik];
-    nv[nf] = phys->nRT2v[ip][ik];
-    // get the tangential velocity components
-    if(tinterp == tRT2) {
-      eu[nf] = phys->u[ie][ik]*grid->n1[ie] + phys->tRT2[ie][ik]*grid->n2[ie];
-      ev[nf] = phys->u[ie][ik]*grid->n2[ie] - phys->tRT2[ie][ik]*grid->n1[ie];
-    }
-    else if(tinterp == tRT1) {
-      // need to have the specific cell neighbor here!  Current implementation 
-      // is not correct.  This seems like the easiest way to make sure 
-      // that this works
-      eu[nf] = phys->u[ie][ik]*grid->n1[ie] + phys->tRT1[ie][ik]*grid->n2[ie];
-      ev[nf] = phys->u[ie][ik]*grid->n2[ie] - phys->tRT1[ie][ik]*grid->n1[ie];
-    }
-  }
-
-  // now perform interpolation from the results via Wang et al 2011 eq 12
-  uc[ic][ik] = 
-    (2*SubArea[1]-1)*SubArea[1]*nu[0] 
-    + (2*SubArea[2]-1)*SubArea[2]*nu[1]
-    + (2*SubArea[0]-1)*SubArea[0]*nu[2]
-    + 4*SubArea[2]*SubArea[1]*eu[0]
-    + 4*SubArea[0]*SubArea[2]*eu[1]
-    + 4*SubArea[0]*SubArea[1]*eu[2];
-  vc[ic][ik] = 
-    (2*SubArea[1]-1)*SubArea[1]*nv[0] 
-    + (2*SubArea[2]-1)*SubArea[2]*nv[1]
-    + (2*SubArea[0]-1)*SubArea[0]*nv[2]
-    + 4*SubArea[2]*SubArea[1]*ev[0]
-    + 4*SubArea[0]*SubArea[2]*ev[1]
-    + 4*SubArea[0]*SubArea[1]*ev[2];
+  }
+
+  for(k=grid->ctop[ic];k<grid->Nk[ic];k++) {
+    // get the tangential velocity components projected onto global x,y coords
+    for(nf=0; nf < 3; nf++) {
+      eu[nf] = phys->u[ne[nf]][k]*grid->n1[ne[nf]] + tRT[ne[nf]][k]*grid->n2[ne[nf]];
+      ev[nf] = phys->u[ne[nf]][k]*grid->n2[ne[nf]] - tRT[ne[nf]][k]*grid->n1[ne[nf]];
+    }
 
+    // now perform interpolation from the results via Wang et al 2011 eq 12
+    uc[ic][k] = w[0]*phys->nRT2u[np[0]][k] + w[1]*phys->nRT2u[np[1]][k] + w[2]*phys->nRT2u[np[2]][k]
+      + w[3]*eu[0] + w[4]*eu[1] + w[5]*eu[2];
+    vc[ic][k] = w[0]*phys->nRT2v[np[0]][k] + w[1]*phys->nRT2v[np[1]][k] + w[2]*phys->nRT2v[np[2]][k]
+      + w[3]*ev[0] + w[4]*ev[1] + w[5]*ev[2];
+  }
 }
 
 /*
@@ -4721,7 +5743,7 @@ static void ComputeNodalVelocity(physT *phys, gridT *grid, interpolation interp,
   //  int in, ink, e1, e2, cell, cp1, cp2;
   int in, ink, inpc, ie, intemp, cell, cp1, cp2,
       e1, e2, n1, n2, onode;
-  REAL tempu, tempv, Atemp, tempAu, tempAv;
+  REAL tempu, tempv, Atemp, tempAu, tempAv, *w;
 
 
   /* compute the nodal velocity for RT1 elements */
@@ -4744,8 +5766,9 @@ static void ComputeNodalVelocity(physT *phys, gridT *grid, interpolation interp,
           e2 = grid->peneighs[in][2*inpc+1];
 
           // compute the RT0 reconstructed nodal value for the edges
-          ComputeRT0Velocity(&tempu, &tempv, 
-              grid->n1[e1], grid->n2[e1], grid->n1[e2], grid->n2[e2], phys->u[e1][ink], phys->u[e2][ink]);
+          w = phys->rt0weights[in]+4*inpc;
+          tempu = w[0]*phys->u[e1][ink] + w[1]*phys->u[e2][ink];
+          tempv = w[2]*phys->u[e1][ink] + w[3]*phys->u[e2][ink];
 
           // store the computed values
           phys->nRT1u[in][ink][inpc] = tempu;
@@ -4787,22 +5810,6 @@ static void ComputeNodalVelocity(physT *phys, gridT *grid, interpolation interp,
 
 }
 
-/*
- * Function: ComputeRT0Velocity
- * Usage: ComputeRT0Velocity(REAL* tempu, REAL* tempv, int e1, int e2, physT* phys);
- * -------------------------------------------
- * Compute the nodal velocity using RT0 basis functions (Appendix B, Wang et al 2011)
- *
- */
-static void ComputeRT0Velocity(REAL *tempu, REAL *tempv, REAL e1n1, REAL e1n2, 
-    REAL e2n1, REAL e2n2, REAL Uj1, REAL Uj2) 
-{
-  const REAL det = e1n1*e2n2 - e1n2*e2n1;
-  // compute using the basis functions directly with inverted 2x2 matrix
-  *tempu = (e2n2*Uj1 - e1n2*Uj2)/det;
-  *tempv = (e1n1*Uj2 - e2n1*Uj1)/det;
-}
-
 /*
  * Function: HFaceFlux
  * Usage: HFaceFlux(j,k,phi,phys->u,grid,prop->dt,prop->nonlinear);
@@ -15,6 +15,10 @@
 #include "suntans.h"
 #include "grid.h"
 #include "fileio.h"
+#include "util.h"
+
+// A dry cell is a one-layer column whose free surface has been clipped to the bed
+#define DRYCELL(grid,phys,i) (!(phys)->active[(i)] && (grid)->ctop[(i)]==(grid)->Nk[(i)]-1)
 
 /*
  * Enumerated type definitions
@@ -63,13 +67,16 @@ typedef struct _physT {
   REAL **w;
   REAL **q;
   REAL **qc;
-  REAL **s;
-  REAL **T;
+  SREAL **s;
+  SREAL **T;
   REAL **s0;
   REAL **rho;
   REAL *h;
   REAL *hcorr;
   unsigned char *active;
+  // Computational cells that hold water, in cellp order, followed by the dry
+  // ones.  Only the first Nwetcells entries are wet; rebuilt by UpdateDZ.
+  int *wetcellp, Nwetcells, wetchanged;
 
   REAL **boundary_u;
   REAL **boundary_v;
@@ -81,15 +88,15 @@ typedef struct _physT {
   REAL *boundary_h;
   REAL *boundary_flag;
 
-  REAL **nu_tv;
-  REAL **kappa_tv;
+  SREAL **nu_tv;
+  SREAL **kappa_tv;
   REAL **nu_lax;
   REAL *tau_T;
   REAL *tau_B;
   REAL *CdT;
   REAL *CdB;
-  REAL **qT;
-  REAL **lT;
+  SREAL **qT;
+  SREAL **lT;
 
   REAL mass;
   REAL mass0;
@@ -97,6 +104,8 @@ typedef struct _physT {
   REAL volume0;
   REAL Ep;
   REAL Ep0;
+  REAL *tracermass;
+  int Ntracermass;
   REAL Ek;
   REAL Eflux1;
   REAL Eflux2;
@@ -111,6 +120,15 @@ typedef struct _physT {
   REAL *htmp3;
   REAL *hcoef;
   REAL *hfcoef;
+  // Compressed-row structure of the free-surface operator over the computational
+  // cells: row r=iptr-celldist[0] has off-diagonals hrow[r]..hrow[r+1]-1 with
+  // neighbor cell hcol (row hcolrow, or -1 if it is not a computational cell)
+  // and flux face hedge
+  int *hrow, *hcol, *hcolrow, *hedge;
+  // Cholesky factor of the operator for hprecond=2 and the coefficients
+  // (diagonal followed by off-diagonals) it was computed from
+  envelopeT *hchol;
+  REAL *hchol0;
   REAL **stmp;
   REAL **stmp2;
   REAL **stmp3;
@@ -125,6 +143,9 @@ typedef struct _physT {
   REAL **Cn_W2; //AB3
   REAL **Cn_q;
   REAL **Cn_l;
+  // Sources for lT (q^2 l or epsilon), computed together with those for qT
+  REAL **lsrc1;
+  REAL **lsrc2;
   REAL **wnew;
   REAL **wtmp;
   REAL **wtmp2;
@@ -168,11 +189,32 @@ typedef struct _physT {
   REAL *tmpvarW;
   REAL *tmpvarE;
 
-  // Least squares fit arrays
-  REAL **A;
-  REAL **Apr;
-  REAL **AT;
-  REAL *bpr;
+  // Weights that reconstruct uc and vc from the face velocities, computed once by
+  // ComputeUCWeights.  ucweights[2*(n*maxfaces+nf)+{0,1}] are the Perot weights
+  // n_{1,2} df def/Ac of face nf of cell n, or those of the least-squares fit if
+  // interp is LSQ.  perotweights are the Perot weights for the non-triangular
+  // cells of the quadratic interpolation and are the same as ucweights unless
+  // interp is LSQ.  quadweights[6*n+m] are the quadratic interpolation weights
+  // of the three nodes and three edges of triangle n at its Voronoi point, and
+  // rt0weights[in][4*inpc+m] is the inverse of the matrix of the normals of the
+  // two edges of cell neighbor inpc that meet at node in.
+  REAL *ucweights;
+  REAL *perotweights;
+  REAL *quadweights;
+  REAL **rt0weights;
+
+  // Time-averaged transport fluxes for scalar subcycling (ntscalar>1)
+  REAL **ubar, **ubar2, **wbar, **wbar2, **dzfbar, **dzzbar;
+  int *ctopbar, nsubcycle;
+  // Iterations taken by the last free-surface and pressure solves
+  int hiters, qiters;
+
+  // Previous solutions of the free-surface and nonhydrostatic pressure solvers
+  // (mutually orthogonal in the operator norm), their images under the
+  // operators and x'Ax, used for the projected initial guess (nprojection>0).
+  // Slot nhproj/nqproj holds the guess and its residual during a solve.
+  int nhproj, nqproj;
+  REAL **hproj, **hprojA, *hprojd, ***qproj, ***qprojA, *qprojd;
 
 } physT;
 
@@ -184,21 +226,23 @@ typedef struct _propT {
   REAL dt, Cmax, rtime, amp, omega, flux, timescale, theta0, theta, thetaM, 
        thetaS, thetaB, nu, nu_H, tau_T, z0T, CdT, z0B, CdB, CdW, relax, epsilon, qepsilon, resnorm, 
        dzsmall, beta, kappa_s, kappa_sH, gamma, kappa_T, kappa_TH, grav, Coriolis_f, CmaxU, CmaxW, 
-       laxWendroff_Vertical, latitude;
+       laxWendroff_Vertical, latitude, hfactortol, Cadapt, dtmin, dtmax, dtold, dtold2, rtime0,
+       eostol, eosSref, eosTref;
   int ntout, ntoutStore, ntprog, nsteps, nstart, n, ntconserve, nonhydrostatic, cgsolver, maxiters, 
       qmaxiters, hprecond, qprecond, volcheck, masscheck, nonlinear, linearFS, newcells, wetdry, sponge_distance, 
     sponge_decay, thetaramptime, readSalinity, readTemperature, turbmodel, 
-    TVD, horiTVD, vertTVD, TVDsalt, TVDtemp, TVDturb, laxWendroff, stairstep, AB, TVDmomentum, conserveMomentum,
-    mergeArrays, computeSediments;
+    TVD, horiTVD, vertTVD, TVDsalt, TVDtemp, TVDturb, TVDtracers, laxWendroff, stairstep, AB, TVDmomentum, conserveMomentum,
+    mergeArrays, computeSediments, ntscalar, baroclinic, nprojection, ntcheck, adaptdt, nrtime0, eos;
   FILE *FreeSurfaceFID, *HorizontalVelocityFID, *VerticalVelocityFID, *SalinityFID, *BGSalinityFID, 
        *InitSalinityFID, *InitTemperatureFID, *TemperatureFID, *PressureFID, *VerticalGridFID, *ConserveFID,    
        *StoreFID, *StartFID, *EddyViscosityFID, *ScalarDiffusivityFID; 
   interpolation interp; int prettyplot;
-  int metmodel,  varmodel, outputNetcdf,  metncid, netcdfBdy, netcdfBdyFileID, readinitialnc, initialNCfileID, calcage, agemethod, calcaverage;
+  int metmodel,  varmodel, outputNetcdf,  metncid, netcdfBdy, netcdfBdyFileID, readinitialnc, initialNCfileID, calcage, agemethod, Ntracers, calcaverage;
   int outputNetcdfFileID, averageNetcdfFileID;
   REAL nctime, toffSet, gmtoffset;
   int nctimectr, avgtimectr, avgctr, avgfilectr, ntaverage, nstepsperncfile, ncfilectr;
   REAL nugget, sill, range, Lsw, Cda, Ce, Ch;
+  int jerlov;
   char  starttime[15], basetime[15]; 
 } propT;
 
@@ -208,6 +252,7 @@ typedef struct _propT {
  *
  */
 void Solve(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, MPI_Comm comm);
+void PlanPhysicalMemory(gridT *grid, propT *prop, int myproc, MPI_Comm comm);
 void AllocatePhysicalVariables(gridT *grid, physT **phys, propT *prop);
 void FreePhysicalVariables(gridT *grid, physT *phys, propT *prop);
 void InitializePhysicalVariables(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm comm);
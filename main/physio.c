@@ -13,6 +13,8 @@
 #include "merge.h"
 #include "sendrecv.h"
 #include "mynetcdf.h"
+#include "util.h"
+#include "tracers.h"
 
 /************************************************************************/
 /*                                                                      */
@@ -247,16 +249,21 @@ void OpenFiles(propT *prop, int myproc)
  */
 void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, int numprocs, int blowup, MPI_Comm comm)
 {
-  int i, j, jptr, k, nwritten, arraySize, writeProc;
+  int i, j, jptr, k, n, nwritten, arraySize, writeProc;
   char str[BUFFERLENGTH], filename[BUFFERLENGTH];
   REAL *tmp = (REAL *)SunMalloc(grid->Ne*sizeof(REAL),"OutputData"), 
     *array2DPointer, **array3DPointer;
 
   if(!(prop->n%prop->ntconserve) && !blowup) {
     ComputeConservatives(grid,phys,prop,myproc,numprocs,comm);
-    if(myproc==0)
-      fprintf(prop->ConserveFID,"%e %e %e %e %e %e %e %e\n",prop->rtime,phys->mass,phys->volume,
+    if(myproc==0) {
+      fprintf(prop->ConserveFID,"%e %e %e %e %e %e %e %e",prop->rtime,phys->mass,phys->volume,
           phys->Ep-phys->Ep0,phys->Eflux1,phys->Eflux2,phys->Eflux3,phys->Eflux4);
+      // Tracer budgets (T, agec, agealpha, sediment classes) when computed
+      for(i=0;i<phys->Ntracermass;i++)
+        fprintf(prop->ConserveFID," %e",phys->tracermass[i]);
+      fprintf(prop->ConserveFID,"\n");
+    }
   }
 
   if(!(prop->n%prop->ntout) || prop->n==1+prop->nstart || blowup) {
@@ -299,11 +306,11 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
 		  "Error outputting background salinity data!\n",grid,numprocs,myproc,comm);
 
     // Salinity field
-    Write3DData(phys->s,phys->htmp,prop->mergeArrays,prop->SalinityFID,
+    Write3DData(StoredToREAL(phys->s,phys->stmp,grid),phys->htmp,prop->mergeArrays,prop->SalinityFID,
 		"Error outputting salinity data!\n",grid,numprocs,myproc,comm);
 
     // Temperature field
-    Write3DData(phys->T,phys->htmp,prop->mergeArrays,prop->TemperatureFID,
+    Write3DData(StoredToREAL(phys->T,phys->stmp,grid),phys->htmp,prop->mergeArrays,prop->TemperatureFID,
 		"Error outputting temperature data!\n",grid,numprocs,myproc,comm);
 
     // Nonhydrostatic pressure
@@ -312,9 +319,9 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
 
     if(prop->turbmodel) {
       // Eddy-viscosity
-      Write3DData(phys->nu_tv,phys->htmp,prop->mergeArrays,prop->EddyViscosityFID,
+      Write3DData(StoredToREAL(phys->nu_tv,phys->stmp,grid),phys->htmp,prop->mergeArrays,prop->EddyViscosityFID,
 		  "Error outputting eddy-viscosity data!\n",grid,numprocs,myproc,comm);
-      Write3DData(phys->kappa_tv,phys->htmp,prop->mergeArrays,prop->ScalarDiffusivityFID,
+      Write3DData(StoredToREAL(phys->kappa_tv,phys->stmp,grid),phys->htmp,prop->mergeArrays,prop->ScalarDiffusivityFID,
 		  "Error outputting scalar-diffusivity data!\n",grid,numprocs,myproc,comm);
     }
     
@@ -343,6 +350,13 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
     prop->StoreFID = MPI_FOpen(str,"w","OpenFiles",myproc);
 
     nwritten=fwrite(&(prop->n),sizeof(int),1,prop->StoreFID);
+    // With adaptdt the time is not n*dt and the AB coefficients depend on the past steps
+    if(prop->adaptdt) {
+      fwrite(&(prop->rtime),sizeof(REAL),1,prop->StoreFID);
+      fwrite(&(prop->dt),sizeof(REAL),1,prop->StoreFID);
+      fwrite(&(prop->dtold),sizeof(REAL),1,prop->StoreFID);
+      fwrite(&(prop->dtold2),sizeof(REAL),1,prop->StoreFID);
+    }
 
     fwrite(phys->h,sizeof(REAL),grid->Nc,prop->StoreFID);
     for(j=0;j<grid->Ne;j++) 
@@ -364,15 +378,19 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
       for(i=0;i<grid->Nc;i++) 
         fwrite(phys->Cn_l[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
 
+      array3DPointer=StoredToREAL(phys->qT,phys->stmp,grid);
       for(i=0;i<grid->Nc;i++) 
-        fwrite(phys->qT[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+        fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+      array3DPointer=StoredToREAL(phys->lT,phys->stmp,grid);
       for(i=0;i<grid->Nc;i++) 
-        fwrite(phys->lT[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+        fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
     }
+    array3DPointer=StoredToREAL(phys->nu_tv,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      fwrite(phys->nu_tv[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+      fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+    array3DPointer=StoredToREAL(phys->kappa_tv,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      fwrite(phys->kappa_tv[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+      fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
 
     for(j=0;j<grid->Ne;j++) 
       fwrite(phys->u[j],sizeof(REAL),grid->Nke[j],prop->StoreFID);
@@ -383,13 +401,21 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
     for(i=0;i<grid->Nc;i++) 
       fwrite(phys->qc[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
 
+    array3DPointer=StoredToREAL(phys->s,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      fwrite(phys->s[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+      fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+    array3DPointer=StoredToREAL(phys->T,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      fwrite(phys->T[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+      fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
     for(i=0;i<grid->Nc;i++) 
       fwrite(phys->s0[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
 
+    for(n=0;n<prop->Ntracers;n++) {
+      array3DPointer=StoredToREAL(tracers->c[n],phys->stmp,grid);
+      for(i=0;i<grid->Nc;i++) 
+        fwrite(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StoreFID);
+    }
+
     fclose(prop->StoreFID);
   }
 
@@ -401,12 +427,20 @@ void OutputPhysicalVariables(gridT *grid, physT *phys, propT *prop,int myproc, i
  * Usage: ReadPhysicalVariables(grid,phys,prop,myproc,comm);
  * ---------------------------------------------------------
  * This function reads in physical variables for a restart run
- * from the restart file defined by prop->StartFID.
+ * from the restart file defined by prop->StartFID.  Fields kept in
+ * storage precision are read as doubles through phys->stmp, so restart
+ * files are the same with and without FLOAT_STORAGE.
+ * With adaptdt=1 the file also holds rtime, dt, dtold and dtold2 after
+ * the step number, so it must be written and read with the same adaptdt.
+ * The concentrations of the Ntracers passive tracers are at the end of the
+ * file, so Ntracers must also be the same; the tracers are set up here
+ * rather than in Solve.
  *
  */
 void ReadPhysicalVariables(gridT *grid, physT *phys, propT *prop, int myproc, MPI_Comm comm) {
 
-  int i, j;
+  int i, j, n;
+  REAL **array3DPointer;
 
   if(VERBOSE>1 && myproc==0) printf("Reading from rstore...\n");
   //fixdzz
@@ -414,6 +448,21 @@ void ReadPhysicalVariables(gridT *grid, physT *phys, propT *prop, int myproc, MP
 
   if(fread(&(prop->nstart),sizeof(int),1,prop->StartFID) != 1)
     printf("Error reading prop->nstart\n");
+  if(prop->adaptdt) {
+    if(fread(&(prop->rtime),sizeof(REAL),1,prop->StartFID) != 1)
+      printf("Error reading prop->rtime\n");
+    if(fread(&(prop->dt),sizeof(REAL),1,prop->StartFID) != 1)
+      printf("Error reading prop->dt\n");
+    if(fread(&(prop->dtold),sizeof(REAL),1,prop->StartFID) != 1)
+      printf("Error reading prop->dtold\n");
+    if(fread(&(prop->dtold2),sizeof(REAL),1,prop->StartFID) != 1)
+      printf("Error reading prop->dtold2\n");
+    // The file is written before the step history is shifted at the end of the step
+    prop->dtold2=prop->dtold;
+    prop->dtold=prop->dt;
+    prop->rtime0=prop->rtime;
+    prop->nrtime0=prop->nstart;
+  }
 
   if(fread(phys->h,sizeof(REAL),grid->Nc,prop->StartFID) != grid->Nc)
     printf("Error reading phys->h\n");
@@ -444,19 +493,27 @@ void ReadPhysicalVariables(gridT *grid, physT *phys, propT *prop, int myproc, MP
       if(fread(phys->Cn_l[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
         printf("Error reading phys->Cn_l[i]\n");
 
+    array3DPointer=StoredToREAL(phys->qT,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      if(fread(phys->qT[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+      if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
         printf("Error reading phys->qT[i]\n");
+    REALToStored(array3DPointer,phys->qT,grid);
+    array3DPointer=StoredToREAL(phys->lT,phys->stmp,grid);
     for(i=0;i<grid->Nc;i++) 
-      if(fread(phys->lT[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+      if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
         printf("Error reading phys->lT[i]\n");
+    REALToStored(array3DPointer,phys->lT,grid);
   }
+  array3DPointer=StoredToREAL(phys->nu_tv,phys->stmp,grid);
   for(i=0;i<grid->Nc;i++) 
-    if(fread(phys->nu_tv[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+    if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->nu_tv[i]\n");
+  REALToStored(array3DPointer,phys->nu_tv,grid);
+  array3DPointer=StoredToREAL(phys->kappa_tv,phys->stmp,grid);
   for(i=0;i<grid->Nc;i++) 
-    if(fread(phys->kappa_tv[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+    if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->kappa_tv[i]\n");
+  REALToStored(array3DPointer,phys->kappa_tv,grid);
 
   for(j=0;j<grid->Ne;j++) 
     if(fread(phys->u[j],sizeof(REAL),grid->Nke[j],prop->StartFID) != grid->Nke[j])
@@ -471,15 +528,30 @@ void ReadPhysicalVariables(gridT *grid, physT *phys, propT *prop, int myproc, MP
     if(fread(phys->qc[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->qc[i]\n");
 
+  array3DPointer=StoredToREAL(phys->s,phys->stmp,grid);
   for(i=0;i<grid->Nc;i++) 
-    if(fread(phys->s[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+    if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->s[i]\n");
+  REALToStored(array3DPointer,phys->s,grid);
+  array3DPointer=StoredToREAL(phys->T,phys->stmp,grid);
   for(i=0;i<grid->Nc;i++) 
-    if(fread(phys->T[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+    if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->T[i]\n");
+  REALToStored(array3DPointer,phys->T,grid);
   for(i=0;i<grid->Nc;i++) 
     if(fread(phys->s0[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
       printf("Error reading phys->s0[i]\n");
+
+  if(prop->Ntracers>0) {
+    InitializeTracers(grid,phys,prop,myproc);
+    for(n=0;n<prop->Ntracers;n++) {
+      array3DPointer=StoredToREAL(tracers->c[n],phys->stmp,grid);
+      for(i=0;i<grid->Nc;i++) 
+        if(fread(array3DPointer[i],sizeof(REAL),grid->Nk[i],prop->StartFID) != grid->Nk[i])
+          printf("Error reading tracers->c[n][i]\n");
+      REALToStored(array3DPointer,tracers->c[n],grid);
+    }
+  }
   fclose(prop->StartFID);
 
   UpdateDZ(grid,phys,prop, 0);
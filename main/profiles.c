@@ -596,26 +596,26 @@ static void WriteAllProfileData(gridT *grid, physT *phys, propT *prop, MPI_Comm
   }
 
   if(ContainsCharacter(ProfileVariables,'s')) 
-    Write3DData(phys->s,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,SalinityProfFID,comm,numprocs,myproc);
+    Write3DData(StoredToREAL(phys->s,phys->stmp,grid),grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,SalinityProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'b') && prop->n==prop->nstart+ntoutProfs) 
     Write3DData(phys->s0,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,BGSalinityProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'T')) 
-    Write3DData(phys->T,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,TemperatureProfFID,comm,numprocs,myproc);
+    Write3DData(StoredToREAL(phys->T,phys->stmp,grid),grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,TemperatureProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'q')) 
     Write3DData(phys->q,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,PressureProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'n')) 
-    Write3DData(phys->nu_tv,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,EddyViscosityProfFID,comm,numprocs,myproc);
+    Write3DData(StoredToREAL(phys->nu_tv,phys->stmp,grid),grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,EddyViscosityProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'k')) 
-    Write3DData(phys->kappa_tv,grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,ScalarDiffusivityProfFID,comm,numprocs,myproc);
+    Write3DData(StoredToREAL(phys->kappa_tv,phys->stmp,grid),grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,ScalarDiffusivityProfFID,comm,numprocs,myproc);
 
   if(ContainsCharacter(ProfileVariables,'C')) {
     for(nosize=0;nosize<sediments->Nsize;nosize++)
-      Write3DData(sediments->SediC[nosize],grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,SediProfFID[nosize],comm,numprocs,myproc);
+      Write3DData(StoredToREAL(sediments->SediC[nosize],phys->stmp,grid),grid->Nk,NkmaxProfs,merge_tmp,merge_tmp2,SediProfFID[nosize],comm,numprocs,myproc);
   }
 }
 
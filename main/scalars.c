@@ -13,11 +13,20 @@
 #include "util.h"
 #include "tvd.h"
 #include "initialization.h"
+#include "memory.h"
+#include "sendrecv.h"
 
 #define SMALL_CONSISTENCY 1e-5
 
 REAL smin_value, smax_value;
 
+// Work space for UpdateScalarsBatch
+static REAL *hflux = NULL, *tvdwork = NULL;
+static int *bndindex = NULL;
+
+static void ScalarMatrix(REAL *a, REAL *b, REAL *c, REAL *ap, REAL *am, REAL *bd, REAL *dzz,
+			 REAL dznew, int ktop, int Nk, REAL thetadt);
+
 /*
  * Function: UpdateScalars
  * Usage: UpdateScalars(grid,phys,prop,wnew,scalar,Cn,kappa,kappaH,kappa_tv,theta);
@@ -31,9 +40,13 @@ REAL smin_value, smax_value;
  * kappaH denotes the horizontal scalar diffusivity
  * kappa_tv denotes the vertical turbulent scalar diffusivity
  *
+ * scal and kappa_tv are in storage precision (see SREAL in suntans.h).  The
+ * reconstructions read the double copy of scal in phys->stmp and the tridiagonal
+ * solve is done in place in d before the result is stored back in scal.
+ *
  */
-void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **scal, REAL **boundary_scal, REAL **Cn, 
-    REAL kappa, REAL kappaH, REAL **kappa_tv, REAL theta,
+void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **scal, REAL **boundary_scal, REAL **Cn, 
+    REAL kappa, REAL kappaH, SREAL **kappa_tv, REAL theta,
     REAL **src1, REAL **src2, REAL *Ftop, REAL *Fbot, int alpha_top, int alpha_bot,
     MPI_Comm comm, int myproc, int checkflag, int TVDscheme) 
 {
@@ -42,6 +55,7 @@ void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **sc
   REAL df, dg, Ac, dt=prop->dt, fab, *a, *b, *c, *d, *ap, *am, *bd, *uflux, dznew, mass, *sp, *temp;
   REAL smin, smax, div_local, div_da;
   int k1, k2, kmin, imin, kmax, imax, mincount, maxcount, allmincount, allmaxcount, flag;
+  int *cellp, ncells;
 
   prop->TVD = TVDscheme;
   // These are used mostly debugging to turn on/off vertical and horizontal TVD.
@@ -96,11 +110,24 @@ void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **sc
   // Compute the scalar on the vertical faces (for horiz. advection)
 
   if(prop->TVD && prop->horiTVD)
-    HorizontalFaceScalars(grid,phys,prop,scal,boundary_scal,prop->TVD,comm,myproc); 
+    HorizontalFaceScalars(grid,phys,prop,phys->stmp,boundary_scal,prop->TVD,comm,myproc); 
+
+  // With wetting and drying only the wet columns are integrated.  A dry column
+  // is a single clipped layer whose update below would set it to zero.
+  cellp = grid->cellp+grid->celldist[0];
+  ncells = grid->celldist[1]-grid->celldist[0];
+  if(prop->wetdry && prop->n>1) {
+    cellp = phys->wetcellp;
+    for(iptr=phys->Nwetcells;iptr<ncells;iptr++) {
+      i = cellp[iptr];
+      for(k=0;k<grid->Nk[i];k++)
+        scal[i][k]=0;
+    }
+    ncells = phys->Nwetcells;
+  }
 
-  //for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
-  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
-    i = grid->cellp[iptr];
+  for(iptr=0;iptr<ncells;iptr++) {
+    i = cellp[iptr];
     Ac = grid->Ac[i];
 
     if(grid->ctop[i]>=grid->ctopold[i]) {
@@ -122,7 +149,7 @@ void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **sc
       }
     else  // Compute the ap/am for TVD schemes
       GetApAm(ap,am,phys->wp,phys->wm,phys->Cp,phys->Cm,phys->rp,phys->rm,
-          wnew,grid->dzz,scal,i,grid->Nk[i],ktop,prop->dt,prop->TVD);
+          wnew,grid->dzz,phys->stmp,i,grid->Nk[i],ktop,prop->dt,prop->TVD);
 
     for(k=ktop+1;k<grid->Nk[i];k++) {
       a[k-ktop]=theta*dt*am[k];
@@ -308,9 +335,11 @@ void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **sc
     for(k=grid->ctop[i];k<=ktop;k++)
       Cn[i][k]=ap[ktop]/(1+abs(grid->ctop[i]-ktop));
 
-    if(grid->Nk[i]-ktop>1) 
-      TriSolve(a,b,c,d,&(scal[i][ktop]),grid->Nk[i]-ktop);
-    else if(prop->n>1) {
+    if(grid->Nk[i]-ktop>1) {
+      TriSolve(a,b,c,d,d,grid->Nk[i]-ktop);
+      for(k=ktop;k<grid->Nk[i];k++)
+        scal[i][k]=d[k-ktop];
+    } else if(prop->n>1) {
       if(b[0]>0 && phys->active[i])
         scal[i][ktop]=d[0]/b[0];
       else 
@@ -444,3 +473,305 @@ void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **sc
           allmincount,allmaxcount);
   }
   }
+
+/*
+ * Function: UpdateScalarsBatch
+ * Usage: UpdateScalarsBatch(grid,phys,prop,wnew,N,scal,scalold,boundary_scal,sumQC,send,recv,
+ *                           kappa,kappaH,kappa_tv,theta,comm,myproc,TVDscheme);
+ * ---------------------------------------------------------------------------------------------
+ * Update the N passive scalars scal[0..N-1] in the same way as UpdateScalars without sources,
+ * in a single pass over the columns.  The diffusion coefficients, the Courant numbers and the
+ * horizontal volume fluxes of each column are computed once for all N scalars.  With first-order
+ * upwinding the tridiagonal matrix does not depend on the scalar either, so it is factored once
+ * per column.  With the TVD schemes the limiters depend on the scalar, so each scalar has its own
+ * vertical fluxes and matrix, and the horizontal limiter sums sumQC of all of the scalars are
+ * exchanged in one message per neighbor with the send and recv buffers.  sumQC, send and recv
+ * are only used with TVD.
+ *
+ * scalold holds a copy of the scalars at the old time step, which plays the role of phys->stmp
+ * in UpdateScalars.  The boundary value of each scalar is taken from the boundary edge itself
+ * and, with TVD, type 3 edges are upwinded as without TVD.  The halo cells are not communicated.
+ *
+ */
+void UpdateScalarsBatch(gridT *grid, physT *phys, propT *prop, REAL **wnew, int N, SREAL ***scal, REAL ***scalold,
+			REAL ***boundary_scal, SREAL ***sumQC, REAL **send, REAL **recv,
+			REAL kappa, REAL kappaH, SREAL **kappa_tv, REAL theta,
+			MPI_Comm comm, int myproc, int TVDscheme)
+{
+  int i, iptr, j, jptr, k, n, nf, ktop, nk, Nz, nc1, nc2, ne, neigh, normal, iu, *cellp, ncells;
+  REAL Ac, dt=prop->dt, dznew, *a, *b, *c, *d, *ap, *am, *bd, *h, *fh, *s, *sp, *s1;
+  REAL *wpo, *wmo, *Cpo, *Cmo, u_nptheta, Qminus, r, si, sm, sf, **sumQ=phys->gradSx;
+
+  prop->TVD = TVDscheme;
+
+  for(n=0;n<N;n++)
+    for(i=0;i<grid->Nc;i++)
+      for(k=0;k<grid->Nk[i];k++)
+        scalold[n][i][k]=scal[n][i][k];
+
+  if(!hflux) {
+    hflux = (REAL *)SunMalloc(grid->maxfaces*grid->Nkmax*sizeof(REAL),"UpdateScalarsBatch");
+    tvdwork = (REAL *)SunMalloc(4*(grid->Nkmax+1)*sizeof(REAL),"UpdateScalarsBatch");
+    bndindex = (int *)SunMalloc(grid->Ne*sizeof(int),"UpdateScalarsBatch");
+    for(j=0;j<grid->Ne;j++)
+      bndindex[j]=-1;
+    for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++)
+      bndindex[grid->edgep[jptr]]=jptr-grid->edgedist[2];
+  }
+
+  ap = phys->ap;
+  am = phys->am;
+  bd = phys->bp;
+  h = phys->bm;
+  a = phys->a;
+  b = phys->b;
+  c = phys->c;
+  d = phys->d;
+  // Courant numbers of the old vertical velocity with TVD
+  wpo = tvdwork;
+  wmo = tvdwork+grid->Nkmax+1;
+  Cpo = tvdwork+2*(grid->Nkmax+1);
+  Cmo = tvdwork+3*(grid->Nkmax+1);
+
+  // Horizontal limiter sums as in HorizontalFaceScalars.  sumQ only depends on the
+  // velocity and is shared by all of the scalars.
+  if(TVDscheme) {
+    for(iptr=grid->celldist[0];iptr<grid->celldist[2];iptr++) {
+      i = grid->cellp[iptr];
+
+      for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+        sumQ[i][k]=0;
+        for(n=0;n<N;n++)
+          sumQC[n][i][k]=0;
+
+        for(nf=0;nf<grid->nfaces[i];nf++) {
+          ne = grid->face[i*grid->maxfaces+nf];
+          neigh = grid->neigh[i*grid->maxfaces+nf];
+          normal = grid->normal[i*grid->maxfaces+nf];
+
+          u_nptheta = normal*(theta*phys->u[ne][k]+(1-theta)*phys->utmp2[ne][k]);
+          Qminus = 0.5*grid->dzf[ne][k]*grid->df[ne]*fabs(u_nptheta-fabs(u_nptheta));
+          if(neigh!=-1)
+            for(n=0;n<N;n++)
+              sumQC[n][i][k]+=Qminus*(scalold[n][i][k]-scalold[n][neigh][k]);
+          sumQ[i][k]+=Qminus;
+        }
+      }
+    }
+    ISendRecvCellData3D(sumQ,grid,myproc,comm);
+    ISendRecvStoredDataBatch(sumQC,N,send,recv,grid,myproc,comm);
+  }
+
+  // With wetting and drying only the wet columns are integrated (see UpdateScalars)
+  cellp = grid->cellp+grid->celldist[0];
+  ncells = grid->celldist[1]-grid->celldist[0];
+  if(prop->wetdry && prop->n>1) {
+    cellp = phys->wetcellp;
+    for(iptr=phys->Nwetcells;iptr<ncells;iptr++) {
+      i = cellp[iptr];
+      for(n=0;n<N;n++)
+        for(k=0;k<grid->Nk[i];k++)
+          scal[n][i][k]=0;
+    }
+    ncells = phys->Nwetcells;
+  }
+
+  for(iptr=0;iptr<ncells;iptr++) {
+    i = cellp[iptr];
+    Ac = grid->Ac[i];
+    nk = grid->Nk[i];
+
+    if(grid->ctop[i]>=grid->ctopold[i]) {
+      ktop=grid->ctop[i];
+      dznew=grid->dzz[i][ktop];
+    } else {
+      ktop=grid->ctopold[i];
+      dznew=0;
+      for(k=grid->ctop[i];k<=grid->ctopold[i];k++) 
+        dznew+=grid->dzz[i][k];      
+    }
+    Nz = nk-ktop;
+
+    for(k=ktop+1;k<nk;k++)
+      bd[k]=(2.0*kappa+kappa_tv[i][k-1]+kappa_tv[i][k])/
+        (grid->dzz[i][k-1]+grid->dzz[i][k]);
+
+    if(TVDscheme) {
+      GetCourant(phys->wp,phys->wm,phys->Cp,phys->Cm,wnew,grid->dzz,i,nk,dt);
+      GetCourant(wpo,wmo,Cpo,Cmo,phys->wtmp2,grid->dzzold,i,nk,dt);
+    } else {
+      // Implicit advection and diffusion at the new time step
+      for(k=0;k<nk+1;k++) {
+        ap[k] = 0.5*(wnew[i][k]+fabs(wnew[i][k]));
+        am[k] = 0.5*(wnew[i][k]-fabs(wnew[i][k]));
+      }
+      ScalarMatrix(a,b,c,ap,am,bd,grid->dzz[i],dznew,ktop,nk,theta*dt);
+
+      // Factor the tridiagonal once for all of the scalars (as in TriSolve)
+      for(k=1;k<Nz;k++) {
+        a[k]/=b[k-1];
+        b[k]-=a[k]*c[k-1];
+      }
+
+      // Explicit advection uses the old velocity
+      for(k=0;k<nk+1;k++) {
+        ap[k] = 0.5*(phys->wtmp2[i][k]+fabs(phys->wtmp2[i][k]));
+        am[k] = 0.5*(phys->wtmp2[i][k]-fabs(phys->wtmp2[i][k]));
+      }
+    }
+
+    // Horizontal volume fluxes through each face
+    for(nf=0;nf<grid->nfaces[i];nf++) {
+      ne = grid->face[i*grid->maxfaces+nf];
+      fh = hflux+nf*grid->Nkmax;
+      for(k=0;k<grid->Nke[ne];k++)
+        fh[k] = dt*grid->df[ne]*grid->normal[i*grid->maxfaces+nf]/Ac
+          *(theta*phys->u[ne][k]+(1-theta)*phys->utmp2[ne][k])*grid->dzf[ne][k];
+    }
+
+    for(n=0;n<N;n++) {
+      s = scalold[n][i];
+
+      // Vertical fluxes limited with the old scalar
+      if(TVDscheme) {
+        GetLimiters(phys->rp,phys->rm,s,nk,ktop,TVDscheme);
+        LimitedApAm(ap,am,phys->wp,phys->wm,phys->Cp,phys->Cm,phys->rp,phys->rm,nk,ktop);
+        ScalarMatrix(a,b,c,ap,am,bd,grid->dzz[i],dznew,ktop,nk,theta*dt);
+        LimitedApAm(ap,am,wpo,wmo,Cpo,Cmo,phys->rp,phys->rm,nk,ktop);
+      }
+
+      // Old mass in each cell
+      for(k=ktop+1;k<nk;k++) 
+        d[k-ktop]=grid->dzzold[i][k]*s[k];
+      d[0]=0;
+      if(grid->ctopold[i]<=grid->ctop[i])
+        for(k=grid->ctopold[i];k<=grid->ctop[i];k++)
+          d[0]+=grid->dzzold[i][k]*s[k];
+      else
+        d[0]=grid->dzzold[i][ktop]*s[ktop];
+
+      // Explicit vertical advection and diffusion
+      for(k=ktop+1;k<nk-1;k++) 
+        d[k-ktop]-=(1-theta)*dt*(am[k]*s[k-1]+(ap[k]-am[k+1])*s[k]-ap[k+1]*s[k+1])-
+          (1-theta)*dt*(bd[k]*s[k-1]-(bd[k]+bd[k+1])*s[k]+bd[k+1]*s[k+1]);
+      if(ktop<nk-1) {
+        k=ktop;
+        d[0]-=(1-theta)*dt*(-am[k+1]*s[k]-ap[k+1]*s[k+1])-
+          (1-theta)*dt*(-bd[k+1]*s[k]+bd[k+1]*s[k+1]);
+        k=nk-1;
+        d[k-ktop]-=(1-theta)*dt*(am[k]*s[k-1]+ap[k]*s[k])-
+          (1-theta)*dt*(bd[k]*s[k-1]-bd[k]*s[k]);
+      }
+
+      // Horizontal advection
+      for(k=0;k<nk;k++)
+        h[k]=0;
+      for(nf=0;nf<grid->nfaces[i];nf++) {
+        ne = grid->face[i*grid->maxfaces+nf];
+        fh = hflux+nf*grid->Nkmax;
+        nc1 = grid->grad[2*ne];
+        nc2 = grid->grad[2*ne+1];
+
+        // Limited face values of HorizontalFaceScalars on the computational edges
+        if(TVDscheme && (grid->mark[ne]==0 || grid->mark[ne]==5)) {
+          for(k=grid->etop[ne];k<grid->Nke[ne];k++) {
+            u_nptheta = theta*phys->u[ne][k]+(1-theta)*phys->utmp2[ne][k];
+            iu = u_nptheta>0 ? nc2 : nc1;
+            si = scalold[n][iu][k];
+            sm = scalold[n][u_nptheta>0 ? nc1 : nc2][k];
+            if(sumQ[iu][k]!=0 && sm!=si)
+              r=sumQC[n][iu][k]/(sumQ[iu][k]*(sm-si));
+            else
+              r=0;
+            if(phys->utmp2[ne][k]>0)
+              sf = scalold[n][nc2][k]+0.5*Psi(r,TVDscheme)*(scalold[n][nc1][k]-scalold[n][nc2][k]);
+            else
+              sf = scalold[n][nc1][k]-0.5*Psi(r,TVDscheme)*(scalold[n][nc1][k]-scalold[n][nc2][k]);
+            h[k]+=fh[k]*sf;
+          }
+          continue;
+        }
+
+        if(nc1==-1) nc1=nc2;
+        s1=scalold[n][nc1];
+        if(nc2==-1) {
+          if(boundary_scal && (grid->mark[ne]==2 || grid->mark[ne]==3)) {
+            for(k=0;k<grid->Nke[ne];k++)
+              h[k]+=fh[k]*UpWind(phys->utmp2[ne][k],s1[k],boundary_scal[n][bndindex[ne]][k]);
+            continue;
+          }
+          sp=s1;
+        } else
+          sp=scalold[n][nc2];
+        for(k=0;k<grid->Nke[ne];k++)
+          h[k]+=fh[k]*UpWind(phys->utmp2[ne][k],s1[k],sp[k]);
+      }
+      for(k=ktop+1;k<nk;k++) 
+        d[k-ktop]-=h[k];
+      for(k=0;k<=ktop;k++) 
+        d[0]-=h[k];
+
+      if(Nz>1) {
+        // With TVD the matrix of each scalar is solved directly, otherwise it is factored
+        if(TVDscheme)
+          TriSolve(a,b,c,d,d,Nz);
+        else {
+          for(k=1;k<Nz;k++)
+            d[k]-=a[k]*d[k-1];
+          d[Nz-1]/=b[Nz-1];
+          for(k=Nz-2;k>=0;k--)
+            d[k]=(d[k]-c[k]*d[k+1])/b[k];
+        }
+        for(k=ktop;k<nk;k++)
+          scal[n][i][k]=d[k-ktop];
+      } else if(prop->n>1) {
+        if(b[0]>0 && phys->active[i])
+          scal[n][i][ktop]=d[0]/b[0];
+        else 
+          scal[n][i][ktop]=0;
+      }
+
+      for(k=0;k<grid->ctop[i];k++)
+        scal[n][i][k]=0;
+      for(k=grid->ctop[i];k<grid->ctopold[i];k++) 
+        scal[n][i][k]=scal[n][i][ktop];
+    }
+  }
+}
+
+/*
+ * Function: ScalarMatrix
+ * Usage: ScalarMatrix(a,b,c,ap,am,bd,grid->dzz[i],dznew,ktop,Nk,theta*dt);
+ * ------------------------------------------------------------------------
+ * Tridiagonal matrix of UpdateScalarsBatch for a column with implicit advective
+ * fluxes ap and am and diffusion coefficients bd, without sources and with
+ * no-flux boundaries, as in UpdateScalars.
+ *
+ */
+static void ScalarMatrix(REAL *a, REAL *b, REAL *c, REAL *ap, REAL *am, REAL *bd, REAL *dzz,
+			 REAL dznew, int ktop, int Nk, REAL thetadt)
+{
+  int k, Nz=Nk-ktop;
+
+  for(k=ktop+1;k<Nk;k++) {
+    a[k-ktop]=thetadt*am[k];
+    b[k-ktop]=dzz[k]+thetadt*(ap[k]-am[k+1]);
+    c[k-ktop]=-thetadt*ap[k+1];
+  }
+  a[0]=0;
+  b[0]=dznew-thetadt*am[ktop+1];
+  c[0]=-thetadt*ap[ktop+1];
+  b[Nz-1]+=c[Nz-1];
+
+  for(k=ktop+1;k<Nk-1;k++) {
+    a[k-ktop]-=thetadt*bd[k];
+    b[k-ktop]+=thetadt*(bd[k]+bd[k+1]);
+    c[k-ktop]-=thetadt*bd[k+1];
+  }
+  if(ktop<Nk-1) {
+    b[0]+=thetadt*bd[ktop+1];
+    c[0]-=thetadt*bd[ktop+1];
+    a[Nz-1]-=thetadt*bd[Nk-1];
+    b[Nz-1]+=thetadt*bd[Nk-1];
+  }
+}
@@ -16,9 +16,13 @@
 #include "grid.h"
 #include "phys.h"
 
-void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **scal, REAL **boundary_scal, REAL **Cn, 
-		   REAL kappa, REAL kappaH, REAL **kappa_tv, REAL theta,
+void UpdateScalars(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **scal, REAL **boundary_scal, REAL **Cn, 
+		   REAL kappa, REAL kappaH, SREAL **kappa_tv, REAL theta,
 		   REAL **src1, REAL **src2, REAL *Ftop, REAL *Fbot, int alpha_top, int alpha_bot,
 		   MPI_Comm comm, int myproc, int checkflag, int TVDscheme);
+void UpdateScalarsBatch(gridT *grid, physT *phys, propT *prop, REAL **wnew, int N, SREAL ***scal, REAL ***scalold,
+			REAL ***boundary_scal, SREAL ***sumQC, REAL **send, REAL **recv,
+			REAL kappa, REAL kappaH, SREAL **kappa_tv, REAL theta,
+			MPI_Comm comm, int myproc, int TVDscheme);
 
 #endif
@@ -43,6 +43,7 @@ void ReadSediProperties(int myproc) {
   sediments->bedComplex= MPI_GetValue(DATAFILE,"bedComplex","ReadSediProperties",myproc);
   sediments->ParabolKappa= MPI_GetValue(DATAFILE,"ParabolKappa","ReadSediProperties",myproc);
   sediments->TBMAX= MPI_GetValue(DATAFILE,"TBMAX","ReadSediProperties",myproc);
+  sediments->SediLayout= MPI_GetValue(DATAFILE,"SediLayout","ReadSediProperties",myproc);
   if(sediments->bedComplex==1){
     printf("because bedComplex==1, so set bedInterval=1 automatically");
     sediments->bedInterval=1;
@@ -62,6 +63,11 @@ void ReadSediProperties(int myproc) {
   */
   
   // condition check
+  if(sediments->SediLayout!=SEDI_CLASSES && sediments->SediLayout!=SEDI_COLUMNS){
+    printf("SediLayout = %d, but it must be %d (per fraction) or %d (per column).\n",sediments->SediLayout,SEDI_CLASSES,SEDI_COLUMNS);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
   if(sediments->readSediment==1 && sediments->Nsize>3){
     printf("Nsize = %d>1, but readSediment==1 which means Nsize==1. You should set readSediment as 0 or Nsize==1.\n",sediments->Nsize);
     MPI_Finalize();
@@ -116,6 +122,32 @@ void ReadSediProperties(int myproc) {
   //}
   sediments->Chind=MPI_GetValue(DATAFILE,"Chind","ReadSediProperties",myproc);
   sediments->Cfloc=MPI_GetValue(DATAFILE,"Cfloc","ReadSediProperties",myproc);
+  // assume ks=3*ds90
+  sediments->Ds90=MPI_GetValue(DATAFILE,"Ds90","ReadSediProperties",myproc);
+
+  // coefficients for Richarson and Zaki(1954) equation
+  sediments->Cgel=1800000;
+  sediments->wsn=2.0;
+  // coefficient for hard erosion
+  sediments->Em=1.0;
+  // coefficient for soft erosion
+  sediments->Alpha=4.2;  // 4.2 to 25.6 according to MIKE21
+}
+
+/*
+ * Function: SediOffset
+ * Usage: off = SediOffset(i,start,len,total);
+ * ----------------------------------------------------
+ * Offset of fraction i of a cell in the storage of a per-fraction
+ * sediment field.  The cell holds len values per fraction, start is the
+ * number of values per fraction in the preceding cells, and total is the
+ * number of values per fraction in all cells.
+ *
+ */
+static size_t SediOffset(int i, size_t start, int len, size_t total) {
+  if(sediments->SediLayout==SEDI_COLUMNS)
+    return sediments->Nsize*start+(size_t)i*len;
+  return i*total+start;
 }
 
 /*
@@ -123,12 +155,16 @@ void ReadSediProperties(int myproc) {
  * Usage: allocate space for sediment variables
  * ----------------------------------------------------
  * Based on the value from ReadSedimentProperties
+ * SediC, Ws and SediCbed of all the fractions are each held in one
+ * block laid out according to SediLayout, and the [fraction][cell]
+ * pointers index into it.
  *
  */
 void AllocateSediment(gridT *grid, int myproc) { 
-  int i,j,jptr,k;
+  int i,j,jptr,k,neigh,maxsend;
+  size_t Ntot, start;
 
-  sediments->SediC = (REAL ***)SunMalloc(sediments->Nsize*sizeof(REAL **), "AllocateSediVariables");
+  sediments->SediC = (SREAL ***)SunMalloc(sediments->Nsize*sizeof(SREAL **), "AllocateSediVariables");
   sediments->SediCbed = (REAL ***)SunMalloc(sediments->Nsize*sizeof(REAL **), "AllocateSediVariables");
   //sediments->Erosion = (REAL ***)SunMalloc(sediments->Nsize*sizeof(REAL *), "AllocateSediVariables");
   //sediments->Erosion_old = (REAL ***)SunMalloc(sediments->Nsize*sizeof(REAL *), "AllocateSediVariables");   
@@ -141,44 +177,66 @@ void AllocateSediment(gridT *grid, int myproc) {
     sediments->Seditb = (REAL *)SunMalloc(grid->Nc*sizeof(REAL), "AllocateSediVariables");
     sediments->Seditbmax = (REAL *)SunMalloc(grid->Nc*sizeof(REAL), "AllocateSediVariables");
   }
+
+  Ntot=0;
+  for(j=0;j<grid->Nc;j++)
+    Ntot+=grid->Nk[j];
+  sediments->SediCdata = (SREAL *)SunMalloc(sediments->Nsize*Ntot*sizeof(SREAL), "AllocateSediVariables");
+  sediments->Wsdata = (REAL *)SunMalloc(sediments->Nsize*(Ntot+grid->Nc)*sizeof(REAL), "AllocateSediVariables");
+  sediments->SediCbeddata = (REAL *)SunMalloc(sediments->Nsize*grid->Nc*sediments->Nlayer*sizeof(REAL), "AllocateSediVariables");
+
   for(i=0;i<sediments->Nsize;i++){
-    sediments->SediC[i] = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
+    sediments->SediC[i] = (SREAL **)SunMalloc(grid->Nc*sizeof(SREAL *), "AllocateSediVariables");
     sediments->SediCbed[i] = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables"); 
     sediments->Deposition[i]=(REAL *)SunMalloc(grid->Nc*sizeof(REAL), "AllocateSediVariables");
     //Deposition_old[i]=(REAL *)SunMalloc(grid->Nc*sizeof(REAL), "AllocateSediVariables");
     // boundary part  
     sediments->boundary_sediC[i] = (REAL **)SunMalloc((grid->edgedist[5]-grid->edgedist[2])*sizeof(REAL *),"AllocateSediment");
+    for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
+      k=grid->edgep[jptr];  
+      sediments->boundary_sediC[i][jptr-grid->edgedist[2]] = (REAL *)SunMalloc(grid->Nke[k]*sizeof(REAL), "AllocateSediVariables");
+    }
     sediments->Ws[i] = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
     //sediments->Erosion[i] = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
     //sediments->Erosion_old[i] = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
+    start=0;
     for(j=0;j<grid->Nc;j++){
-      sediments->SediC[i][j] = (REAL *)SunMalloc(grid->Nk[j]*sizeof(REAL), "AllocateSediVariables");
-      sediments->SediCbed[i][j] = (REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables"); 
+      sediments->SediC[i][j] = sediments->SediCdata+SediOffset(i,start,grid->Nk[j],Ntot);
+      sediments->Ws[i][j] = sediments->Wsdata+SediOffset(i,start+j,grid->Nk[j]+1,Ntot+grid->Nc);
+      sediments->SediCbed[i][j] = sediments->SediCbeddata+SediOffset(i,(size_t)j*sediments->Nlayer,sediments->Nlayer,(size_t)grid->Nc*sediments->Nlayer);
       //sediments->Erosion[i][j] = (REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables"); 
       //sediments->Erosion_old[i][j] = (REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables"); 
-      // allocate boundary value
-      for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
-        k=grid->edgep[jptr];  
-        sediments->boundary_sediC[i][jptr-grid->edgedist[2]] = (REAL *)SunMalloc(grid->Nke[k]*sizeof(REAL), "AllocateSediVariables");
-      }
-      sediments->Ws[i][j] = (REAL *)SunMalloc((grid->Nk[j]+1)*sizeof(REAL), "AllocateSediVariables"); 
+      start+=grid->Nk[j];
     }
   }
 
+  // packed transfer buffers for SediC of all the fractions (ISendRecvStoredDataBatch)
+  sediments->send = (REAL **)SunMalloc(grid->Nneighs*sizeof(REAL *), "AllocateSediVariables");
+  sediments->recv = (REAL **)SunMalloc(grid->Nneighs*sizeof(REAL *), "AllocateSediVariables");
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    maxsend=sediments->Nsize*Max(grid->total_cells_send[neigh],grid->total_cells_recv[neigh]);
+    sediments->send[neigh] = (REAL *)SunMalloc(maxsend*sizeof(REAL), "AllocateSediVariables");
+    sediments->recv[neigh] = (REAL *)SunMalloc(maxsend*sizeof(REAL), "AllocateSediVariables");
+  }
+
   //Layermass = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
   sediments->Layerthickness = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
-  sediments->SediKappa_tv = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
+  sediments->SediKappa_tv = (SREAL **)SunMalloc(grid->Nc*sizeof(SREAL *), "AllocateSediVariables");
   sediments->Wnewsedi= (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
   //sediments->Woldsedi= (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
   sediments->Erosiontotal= (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
   sediments->Erosiontotal_old= (REAL **)SunMalloc(grid->Nc*sizeof(REAL *), "AllocateSediVariables");
+  // column work space for SedimentColumns
+  sediments->Ctot = (REAL *)SunMalloc(grid->Nkmax*sizeof(REAL), "AllocateSediVariables");
+  sediments->Wsfac = (REAL *)SunMalloc((grid->Nkmax+1)*sizeof(REAL), "AllocateSediVariables");
+  sediments->Wsgfac = (REAL *)SunMalloc((grid->Nkmax+1)*sizeof(REAL), "AllocateSediVariables");
 
   for(i=0;i<grid->Nc;i++){
     //Layermass[i]=(REAL *)SunMalloc(Nlayer*sizeof(REAL), "AllocateSediVariables");
     sediments->Layerthickness[i]=(REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables");
     sediments->Erosiontotal[i] = (REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables");
     sediments->Wnewsedi[i]= (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL), "AllocateSediVariables");
-    sediments->SediKappa_tv[i]= (REAL *)SunMalloc((grid->Nk[i])*sizeof(REAL), "AllocateSediVariables");
+    sediments->SediKappa_tv[i]= (SREAL *)SunMalloc((grid->Nk[i])*sizeof(SREAL), "AllocateSediVariables");
     //Woldsedi[i]= (REAL *)SunMalloc((grid->Nk[i]+1)*sizeof(REAL), "AllocateSediVariables");
     sediments->Erosiontotal_old[i] = (REAL *)SunMalloc(sediments->Nlayer*sizeof(REAL), "AllocateSediVariables");
   }
@@ -320,11 +378,12 @@ void InitializeSediment(gridT *grid, physT *phys, propT *prop,  int myproc) {
         for(k=0;k<grid->Nk[j]+1;k++)
           sediments->Ws[i][j][k]=sediments->Ws0[i];
   } else {
-    SettlingVelocity(grid,phys,prop,myproc);
+    // roughly estimate by Stokes Law
+    for(i=0;i<sediments->Nsize;i++)
+      sediments->Ws0[i] = (sediments->Gsedi[i]-1)*prop->grav*pow(sediments->Ds[i], 2)/(18*prop->nu);
   }
-  // calculate initial Deposition & deposition
-  CalculateErosion(grid,phys,prop,myproc);
-  CalculateDeposition(grid,phys,myproc);
+  // calculate initial settling velocity, erosion & deposition
+  SedimentColumns(grid,phys,prop,myproc);
 }
 
 /*
@@ -369,13 +428,13 @@ void FreeSediment(gridT *grid, int myproc) {
   int i,j;
 
   for(i=0;i<sediments->Nsize;i++){
-    for(j=0;j<grid->Nc;j++){
-      free(sediments->SediC[i][j]);
-      free(sediments->Ws[i][j]);
-      free(sediments->SediCbed[i][j]); 
+    //for(j=0;j<grid->Nc;j++){
       //free(sediments->Erosion[i][j]);
       //free(sediments->Erosion_old[i][j]);
-    }
+    //}
+    for(j=0;j<grid->edgedist[5]-grid->edgedist[2];j++)
+      free(sediments->boundary_sediC[i][j]);
+    free(sediments->boundary_sediC[i]);
     free(sediments->SediC[i]);
     free(sediments->SediCbed[i]);
     free(sediments->Ws[i]);
@@ -386,6 +445,16 @@ void FreeSediment(gridT *grid, int myproc) {
   }
   free(sediments->SediC);
   free(sediments->SediCbed);
+  free(sediments->boundary_sediC);
+  free(sediments->SediCdata);
+  free(sediments->Wsdata);
+  free(sediments->SediCbeddata);
+  for(i=0;i<grid->Nneighs;i++){
+    free(sediments->send[i]);
+    free(sediments->recv[i]);
+  }
+  free(sediments->send);
+  free(sediments->recv);
   //free(sediments->Erosion);
   //free(sediments->Erosion_old);
   free(sediments->Ws);
@@ -407,6 +476,9 @@ void FreeSediment(gridT *grid, int myproc) {
   //free(sediments->Woldsedi);
   //free(sediments->Layermass);
   free(sediments->Layerthickness);
+  free(sediments->Ctot);
+  free(sediments->Wsfac);
+  free(sediments->Wsgfac);
   free(sediments->Ds);
   free(sediments->Ws0);
   free(sediments->Gsedi);
@@ -426,85 +498,79 @@ void FreeSediment(gridT *grid, int myproc) {
 }
 
 /*
- * Function: SettlingVelocity
- * this function still need to be tested
- * Usage: calculate flocculation and hindered settling velocity
+ * Function: SedimentColumns
+ * Usage: SedimentColumns(grid,phys,prop,myproc);
  * ----------------------------------------------------
- * Richarson and Zaki(1954) equation
- * only work when WSconstant=0
+ * Calculate the settling velocity, the erosion rate of each bed layer
+ * and the deposition of each fraction in a single pass over the columns.
+ * 
+ * Settling velocity (only when WSconstant=0): flocculation and hindered
+ * settling with the Richarson and Zaki(1954) equation, which depend on the
+ * total concentration of all fractions at each face.  The factors common to
+ * all fractions are computed once per face so that the loops over the
+ * fractions run contiguously along the column. This still needs to be tested.
+ *
+ * Erosion: for two types, hard and soft, coefficients based on Mike21.
+ *
+ * Deposition: based on settling velocity and SediConcentration, explicit at
+ * the n time step while erosion is n+1.
  *
  */
-void SettlingVelocity(gridT *grid, physT *phys, propT *prop,  int myproc) { 
-  int i,j,k;
-  REAL tmp,sum,Cgel=1800000,wsn=2.0;
-
-  // roughly estimate by Stokes Law
-  for(i=0;i<sediments->Nsize;i++)
-    sediments->Ws0[i] = (sediments->Gsedi[i]-1)*prop->grav*pow(sediments->Ds[i], 2)/(18*prop->nu);
-  // coefficient for Richarson and Zaki(1954) equation
-  //Cgel = 1800000;
-  //wsn = 2.0;
+void SedimentColumns(gridT *grid, physT *phys, propT *prop, int myproc) { 
+  int i,j,k,nk;
+  REAL tmp,sum,taub,utmp,ratio,depotmp,nettmp,erosionmax;
+  REAL *Ctot=sediments->Ctot, *Wsfac=sediments->Wsfac, *Wsgfac=sediments->Wsgfac;
 
   for(j=0;j<grid->Nc;j++){  
-    for(k=0;k<grid->Nk[j]+1;k++){   
-      sum=0;
-      if(k==0){
-        for(i=0;i<sediments->Nsize;i++)
-          sum+=sediments->SediC[i][j][k];
-      } else if(k==grid->Nk[j]){
-        for(i=0;i<sediments->Nsize;i++)
-          sum+=sediments->SediC[i][j][k-1];
-      } else {
-        for(i=0;i<sediments->Nsize;i++)
-          sum+=0.5*(sediments->SediC[i][j][k-1]+sediments->SediC[i][j][k+1]);
-      }
-      //for(i=0;i<sediments->Nsize;i++)
-      //sum+=0.5*(sediments->SediC[i][j][k-1]+sediments->SediC[i][j][k+1]);
-      for(i=0;i<sediments->Nsize;i++){
+    nk=grid->Nk[j];
+
+    // settling velocity
+    if(sediments->WSconstant==0) {
+      for(k=0;k<nk;k++)
+        Ctot[k]=0;
+      for(i=0;i<sediments->Nsize;i++)
+        for(k=0;k<nk;k++)
+          Ctot[k]+=sediments->SediC[i][j][k];
+
+      for(k=0;k<nk+1;k++){   
+        if(k==0)
+          sum=Ctot[0];
+        else if(k==nk)
+          sum=Ctot[nk-1];
+        else
+          sum=0.5*(Ctot[k-1]+Ctot[k]);
+
+        Wsfac[k]=0;
+        Wsgfac[k]=0;
         if(sum < sediments->Cfloc)
-          sediments->Ws[i][j][k] = sediments->Ws0[i];
+          Wsfac[k]=1;
         else if(sum>= sediments->Cfloc && sum < sediments->Chind)
-          sediments->Ws[i][j][k] =sediments-> Ws0[i]*sum/sediments->Gsedi[i]/1000/1000;  ///??????????
-        else if(sum>= sediments->Chind && sum < Cgel){
-          tmp = Min(1,sum/Cgel);
+          Wsgfac[k]=sum/1000/1000;  ///??????????
+        else if(sum>= sediments->Chind && sum < sediments->Cgel){
+          tmp = Min(1,sum/sediments->Cgel);
           tmp = 1-tmp;
-          sediments->Ws[i][j][k] = sediments->Ws0[i]*sediments->Chind/sediments->Gsedi[i]/1000/1000*pow(tmp,wsn);
-        } else {
-          sediments->Ws[i][j][k] = 0;
-          //sediments->SediC[i][j][k] = Cgel;
+          Wsgfac[k]=sediments->Chind/1000/1000*pow(tmp,sediments->wsn);
         }
       }
+      for(i=0;i<sediments->Nsize;i++)
+        for(k=0;k<nk+1;k++)
+          sediments->Ws[i][j][k]=sediments->Ws0[i]*(Wsfac[k]+Wsgfac[k]/sediments->Gsedi[i]);
     }
-    /*for(i=0;i<Nsize;i++){
-      sediments->Ws[i][j][grid->Nk[j]] = sediments->Ws[i][j][grid->Nk[i]-1];
-      sediments->Ws[i][j][0]=Ws[i][j][1];
-      }*/
-  }
-}
 
-/*
- * Function: CalculateErosion
- * Usage: calculate Erosion Rate for suspended sediment transport
- *        calculate Deposition for n time step
- * ----------------------------------------------------
- * for two types, hard and soft
- * coefficients based on Mike21
- */
-void CalculateErosion(gridT *grid, physT *phys, propT *prop, int myproc) { 
-  int j,k;
-  REAL taub,utmp,taubtmp1,taubtmp2,em,alpha,ratio, depotmp, nettmp, erosionmax,ds90;
-  // assume ks=3*ds90
-  ds90=MPI_GetValue(DATAFILE,"Ds90","CalculationErosion",myproc);
-  // coefficient for hard erosion
-  em=1.0;
-  // coefficient for soft erosion
-  alpha=4.2;  // 4.2 to 25.6 according to MIKE21
+    // deposition for each fraction
+    depotmp=0;
+    for(i=0;i<sediments->Nsize;i++){
+      if(nk>1)
+        sediments->Deposition[i][j]=(1.5*sediments->SediC[i][j][nk-1]-0.5*sediments->SediC[i][j][nk-2])*sediments->Ws[i][j][nk];
+      else
+        sediments->Deposition[i][j]=sediments->SediC[i][j][nk-1]*sediments->Ws[i][j][nk];
+      depotmp+=sediments->Deposition[i][j];
+    }
 
-  for(j=0;j<grid->Nc;j++){
     // calculate taub
-    //taub = prop->CdB*(1+phys->rho[j][grid->Nk[j]-1])*RHO0*(pow(phys->uc[j][grid->Nk[j]-1], 2)+pow(phys->vc[j][grid->Nk[j]-1], 2));
-    utmp=sqrt(pow(phys->uc[j][grid->Nk[j]-1], 2)+pow(phys->vc[j][grid->Nk[j]-1], 2));
-    taub=pow(log(10*0.5*grid->dzz[j][grid->Nk[j]-1]/ds90)/0.41,-2)*(1+phys->rho[j][grid->Nk[j]-1])*RHO0*pow(utmp,2);
+    //taub = prop->CdB*(1+phys->rho[j][nk-1])*RHO0*(pow(phys->uc[j][nk-1], 2)+pow(phys->vc[j][nk-1], 2));
+    utmp=sqrt(pow(phys->uc[j][nk-1], 2)+pow(phys->vc[j][nk-1], 2));
+    taub=pow(log(10*0.5*grid->dzz[j][nk-1]/sediments->Ds90)/0.41,-2)*(1+phys->rho[j][nk-1])*RHO0*pow(utmp,2);
 
     if((phys->h[j]+grid->dv[j])/grid->dv[j]<0.001)
       taub=0;
@@ -513,7 +579,8 @@ void CalculateErosion(gridT *grid, physT *phys, propT *prop, int myproc) {
     if(sediments->Seditbmax[j]<=taub)
       sediments->Seditbmax[j]=taub;
     }
-    erosionmax=0;
+
+    // erosion for each layer
     for(k=0;k<sediments->Nlayer;k++){
       erosionmax=sediments->Layerthickness[j][k]*sediments->Drydensity[k]/prop->dt;
       sediments->Erosiontotal_old[j][k]=sediments->Erosiontotal[j][k];
@@ -521,11 +588,11 @@ void CalculateErosion(gridT *grid, physT *phys, propT *prop, int myproc) {
       if(taub>sediments->Taue[k]){
         if(sediments->Softhard[k]==0){
 	  // soft erosion
-          sediments->Erosiontotal[j][k]=sediments->E0[k]*exp(alpha*(taub-sediments->Taue[k]));
+          sediments->Erosiontotal[j][k]=sediments->E0[k]*exp(sediments->Alpha*(taub-sediments->Taue[k]));
         } else {
           // hard erosion
           ratio=Max(taub/sediments->Taue[k]-1,0);
-          sediments->Erosiontotal[j][k]=sediments->E0[k]*pow(ratio,em);
+          sediments->Erosiontotal[j][k]=sediments->E0[k]*pow(ratio,sediments->Em);
         }
         if(sediments->Erosiontotal[j][k]>erosionmax)
           sediments->Erosiontotal[j][k]=erosionmax;
@@ -539,23 +606,7 @@ void CalculateErosion(gridT *grid, physT *phys, propT *prop, int myproc) {
         if(nettmp<0)
           sediments->Erosiontotal[j][k]+=nettmp;
       }
-    }
-  }
-  
-  // calculate deposition for each fraction
-  if(sediments->bedComplex==1){
-    nettmp=0;
-    for(j=0;j<grid->Nc;j++){
-      depotmp=0;
-      for(k=0;k<sediments->Nsize;k++){
-        /*if(grid->Nk[j]-1>0){
-	// here deposition is explicit n time steps while Erosion is n+1 time steps
-	sediments->Deposition[k][j]=(1.5*sediments->SediC[k][j][grid->Nk[j]-1]-0.5*sediments->SediC[k][j][grid->Nk[j]-2])*(1.5*sediments->Ws[k][j][grid->Nk[j]-1]-0.5*sediments->Ws[k][j][grid->Nk[j]-2]);
-        } else {
-	sediments->Deposition[k][j]=sediments->SediC[k][j][grid->Nk[j]-1]*sediments->Ws[k][j][grid->Nk[j]-1];
-        }*/
-        depotmp+=sediments->Deposition[k][j];
-      }
+      nettmp=0;
       if(sediments->Nlayer>1)
         nettmp=sediments->Layerthickness[j][0]*sediments->Drydensity[0]/prop->dt-sediments->Erosiontotal[j][0]+sediments->Erosiontotal[j][1]+depotmp-sediments->Consolid[1];
       if(nettmp<0)   
@@ -564,26 +615,6 @@ void CalculateErosion(gridT *grid, physT *phys, propT *prop, int myproc) {
   }
 }
 
-/*
- * Function: CalculateDeposition
- * Usage: calculate deposition
- * ----------------------------------------------------
- * based on settling velocity and SediConcentration
- */
-void CalculateDeposition(gridT *grid, physT *phys, int myproc) {
-  int j,k;
-  for(j=0;j<grid->Nc;j++){
-    for(k=0;k<sediments->Nsize;k++){
-      if(grid->Nk[j]+1-1>0){
-        // here deposition is explicit n time steps while Erosion is n+1 time steps
-        sediments->Deposition[k][j]=(1.5*sediments->SediC[k][j][grid->Nk[j]-1]-0.5*sediments->SediC[k][j][grid->Nk[j]-2])*(sediments->Ws[k][j][grid->Nk[j]]);
-      } else {
-        sediments->Deposition[k][j]=sediments->SediC[k][j][grid->Nk[j]-1]*sediments->Ws[k][j][grid->Nk[j]];
-      }
-    }
-  }
-}
-
 /*
  * Function: BedChange
  * Usage: calculate Cbed and Thickness change
@@ -599,9 +630,7 @@ void BedChange(gridT *grid, physT *phys, propT *prop, int myproc) {
   int i,j,k;
   REAL depotmp, thicktmp;
 
-  // update Deposition first
-  CalculateDeposition(grid,phys,myproc);
-
+  // Deposition is up to date from SedimentColumns
   // update thickness
   // assume sum(Cbed) is constant=Drydensity
   for(j=0;j<grid->Nc;j++){
@@ -769,7 +798,7 @@ void OutputSediment(gridT *grid, physT *phys, propT *prop,
     
     for(nosize=0;nosize<sediments->Nsize;nosize++){
       sprintf(str,"Error outputting SSC data for size class %d of %d.\n",nosize+1,sediments->Nsize);
-      Write3DData(sediments->SediC[nosize],phys->htmp,prop->mergeArrays,sediments->SedimentFID[nosize],
+      Write3DData(StoredToREAL(sediments->SediC[nosize],phys->stmp,grid),phys->htmp,prop->mergeArrays,sediments->SedimentFID[nosize],
 		  str,grid,numprocs,myproc,comm);
     }
     
@@ -831,50 +860,6 @@ void CalculateSediDiffusivity(gridT *grid, physT *phys,int Nosize,int myproc) {
   }
 }
 
-/*
- * Function: ISendRecvSediBedData3D
- * Usage: ISendRecvSediBedData3D(SediCbed or Thickness,grid,myproc,comm);
- * ----------------------------------------------------
- * This function will transfer the 3D cell data for sediment bed back and forth between
- * processors using nonblocking sends/recvs.
- *
- */
-void ISendRecvSediBedData3D(REAL **celldata, gridT *grid, int nlayer,int myproc,MPI_Comm comm) {
-  int k, n, nstart, neigh, neighproc;
-  REAL t0=Timer();
-  
-  for(neigh=0;neigh<grid->Nneighs;neigh++) {
-    neighproc = grid->myneighs[neigh];
-    
-    nstart=0;
-    for(n=0;n<grid->num_cells_send[neigh];n++) {
-      for(k=0;k<nlayer;k++) 
-        grid->send[neigh][nstart+k]=celldata[grid->cell_send[neigh][n]][k];
-      nstart+=nlayer;
-    }
-    
-    MPI_Isend((void *)(grid->send[neigh]),grid->total_cells_send[neigh],MPI_DOUBLE,neighproc,1,
-	      comm,&(grid->request[neigh])); 
-  }
-  
-  for(neigh=0;neigh<grid->Nneighs;neigh++) {
-    neighproc = grid->myneighs[neigh];
-    MPI_Irecv((void *)(grid->recv[neigh]),grid->total_cells_recv[neigh],MPI_DOUBLE,neighproc,1,
-	      comm,&(grid->request[grid->Nneighs+neigh]));
-  }
-  MPI_Waitall(2*grid->Nneighs,grid->request,grid->status);
-  
-  for(neigh=0;neigh<grid->Nneighs;neigh++) {
-    nstart=0;
-    for(n=0;n<grid->num_cells_recv[neigh];n++) {
-      for(k=0;k<nlayer;k++) 
-        celldata[grid->cell_recv[neigh][n]][k]=grid->recv[neigh][nstart+k];
-      nstart+=nlayer;
-    }
-  }
-  // t_comm+=Timer()-t0;
-}
-
 /*
  * Function: ComputeSediments
  * Usage: ComputeSediments(grid,phys,prop, myproc, numproc, blowup, comm);
@@ -897,8 +882,8 @@ void ComputeSediments(gridT *grid, physT *phys, propT *prop, int myproc, int num
     BoundarySediment(grid,phys,prop);
   }
   
-  // calculate n+theta Erosion for boundary 
-  CalculateErosion(grid,phys,prop,myproc);
+  // calculate settling velocity, deposition and n+theta Erosion for boundary 
+  SedimentColumns(grid,phys,prop,myproc);
   // calculate n+1 Sediment concentration field
   for(k=0;k<sediments->Nsize;k++){
     
@@ -910,11 +895,9 @@ void ComputeSediments(gridT *grid, physT *phys, propT *prop, int myproc, int num
     
     UpdateScalars(grid,phys,prop,sediments->Wnewsedi,sediments->SediC[k],sediments->boundary_sediC[k],phys->Cn_T,0,0,sediments->SediKappa_tv,prop->theta,phys->uold,phys->wtmp,NULL,NULL,0,0,comm,myproc,0,prop->TVDtemp);
     SedimentVerticalVelocity(grid,phys,k,-1,myproc);
-    ISendRecvCellData3D(sediments->SediC[k],grid,myproc,comm);
   }          
+  ISendRecvStoredDataBatch(sediments->SediC,sediments->Nsize,sediments->send,sediments->recv,grid,myproc,comm);
   
-  if(sediments->WSconstant==0)
-    SettlingVelocity(grid,phys,prop,myproc);
   if(prop->n%sediments->bedInterval==0 && sediments->bedInterval>0)
     BedChange(grid,phys,prop,myproc);   
   // get the boundary value for the next time step
@@ -14,9 +14,14 @@
 #include "grid.h"
 #include "phys.h"
 
+// Layout of the per-fraction sediment state (SediC, Ws, SediCbed) in memory
+#define SEDI_CLASSES 0 // each fraction contiguous: [fraction][cell][k]
+#define SEDI_COLUMNS 1 // fractions of each cell contiguous: [cell][fraction][k]
+
 typedef struct _sedimentsT {
-REAL ***SediC,// sediment concentration [fraction][cell][Nkmax]
-     ***SediCbed, // sediment concentration in bed [fraction][cell][Nlayer]
+SREAL ***SediC,// sediment concentration [fraction][cell][Nkmax]
+     **SediKappa_tv; // tubulent sediment diffusivity [cell][Nkmax]
+REAL ***SediCbed, // sediment concentration in bed [fraction][cell][Nlayer]
      ***boundary_sediC, // sediment transport boundary condition [fraction][cell][Nkmax]
      ***Ws, // settling velocity [fraction][cell][Nkmax]
      *Ws0, // constant settling velocity [fraction] -> given in sedi.dat
@@ -28,7 +33,6 @@ REAL ***SediC,// sediment concentration [fraction][cell][Nkmax]
      //***Erosion_old, //added
      //**Woldsedi, //vertical velocity for sediment particles [cell][Nkmax+1]
      **Wnewsedi, // calculated by SedimentVerticalVelocity
-     **SediKappa_tv, // tubulent sediment diffusivity [cell][Nkmax]
      **Erosiontotal, // total erosion for each cell each layer [cell][Nlayer]
      **Erosiontotal_old, // store former step [cell][Nlayer]
      //**Neterosion,  // store the net erosion in Bedinterval steps [cell][Nlayer]
@@ -46,7 +50,19 @@ REAL ***SediC,// sediment concentration [fraction][cell][Nkmax]
      *Softhard,  // the layer is soft or hard-> given in sedi.dat [Layer] 
      *Drydensity, // dry density for each layer [Nlayer]
      Chind, // concentration for hindered settling velocity
-     Cfloc; // concentration for flocuation for settling velocity
+     Cfloc, // concentration for flocuation for settling velocity
+     Cgel, // gelling concentration for hindered settling velocity
+     wsn, // exponent of Richardson and Zaki (1954) hindered settling
+     Ds90, // ds90 for the bottom roughness ks=3*ds90 in the bed stress -> given in sedi.dat
+     Em, // exponent for hard erosion
+     Alpha, // coefficient for soft erosion
+     *Ctot, // total concentration over all fractions [Nkmax]
+     *Wsfac, // factor of Ws0 in the settling velocity for all fractions [Nkmax+1]
+     *Wsgfac, // factor of Ws0/Gsedi in the settling velocity for all fractions [Nkmax+1]
+     *Wsdata, // storage for Ws
+     *SediCbeddata, // storage for SediCbed
+     **send, **recv; // packed transfer buffers for all fractions [neigh][]
+SREAL *SediCdata; // storage for SediC
 int Nlayer, // number of bed layer -> given in sedi.dat
     Nsize,  // number of fractions -> given in sedi.dat
     WSconstant, // if 1,just use constant settling velocity, 0 otherwise -> given in sedi.dat
@@ -55,6 +71,7 @@ int Nlayer, // number of bed layer -> given in sedi.dat
     bedInterval, // the interval steps to update bed change
     bedComplex,  // whether consider the possibility to flush away a whole layer
     TBMAX,       // whether to output the tb for each cell
+    SediLayout, // SEDI_CLASSES or SEDI_COLUMNS -> given in sedi.dat
     readSediment; // if 1, we will read sediment file as the IC for sediment Concentration, Now just support Nsizemax=1
   FILE *LayerthickFID, **SedimentFID, *SeditbFID, *SeditbmaxFID;
 } sedimentsT;
@@ -66,17 +83,14 @@ void ReadSediProperties(int myproc);
 void InitializeSediment(gridT *grid, physT *phys, propT *prop,int myproc);
 void AllocateSediment(gridT *grid, int myproc);
 //void SetSediment(gridT *grid, int myproc); // used by initializesediment
-void SettlingVelocity(gridT *grid, physT *phys, propT *prop, int myproc);
 void FreeSediment(gridT *grid, int myproc);
-void CalculateErosion(gridT *grid, physT *phys, propT *prop,  int myproc);
-void CalculateDeposition(gridT *grid, physT *phys, int myproc); //used by calculateerosion and Bedchange
+void SedimentColumns(gridT *grid, physT *phys, propT *prop, int myproc);
 void BedChange(gridT *grid, physT *phys, propT *prop, int myproc);
 void SedimentSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop,int Nosize, REAL theta);
 void SedimentVerticalVelocity(gridT *grid, physT *phys,int Nosize,int symbol, int myproc);
 void OpenSediFiles(propT *prop, int myproc);
 void OutputSediment(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, int blowup, MPI_Comm comm);
 void CalculateSediDiffusivity(gridT *grid, physT *phys,int Nosize,int myproc); 
-void ISendRecvSediBedData3D(REAL **celldata, gridT *grid, int nlayer, int myproc, MPI_Comm comm);
 void ComputeSediments(gridT *grid, physT *phys, propT *prop, int myproc, int numprocs, int blowup, MPI_Comm comm);
 
 #endif
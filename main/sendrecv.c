@@ -208,6 +208,107 @@ void ISendRecvCellData3D(REAL **celldata, gridT *grid, int myproc, MPI_Comm comm
   t_comm+=Timer()-t0;
 }
 
+#ifdef FLOAT_STORAGE
+/*
+ * Function: ISendRecvStoredData3D
+ * Usage: ISendRecvStoredData3D(phys->s,grid,myproc,comm);
+ * -------------------------------------------------------
+ * Same as ISendRecvCellData3D but for cell-centered fields kept in storage
+ * precision (SREAL).  The values are widened into the double transfer buffers,
+ * so the messages are the same as for ISendRecvCellData3D.  Without
+ * FLOAT_STORAGE this is a macro for ISendRecvCellData3D (see sendrecv.h).
+ *
+ */
+void ISendRecvStoredData3D(SREAL **celldata, gridT *grid, int myproc, MPI_Comm comm)
+{
+  int k, n, nstart, neigh, neighproc;
+  REAL t0=Timer();
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    neighproc = grid->myneighs[neigh];
+
+    nstart=0;
+    for(n=0;n<grid->num_cells_send[neigh];n++) {
+      for(k=0;k<grid->Nk[grid->cell_send[neigh][n]];k++) 
+        grid->send[neigh][nstart+k]=celldata[grid->cell_send[neigh][n]][k];
+      nstart+=grid->Nk[grid->cell_send[neigh][n]];
+    }
+
+    MPI_Isend((void *)(grid->send[neigh]),grid->total_cells_send[neigh],MPI_DOUBLE,neighproc,1,
+        comm,&(grid->request[neigh])); 
+  }
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    neighproc = grid->myneighs[neigh];
+    MPI_Irecv((void *)(grid->recv[neigh]),grid->total_cells_recv[neigh],MPI_DOUBLE,neighproc,1,
+        comm,&(grid->request[grid->Nneighs+neigh]));
+  }
+  MPI_Waitall(2*grid->Nneighs,grid->request,grid->status);
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    nstart=0;
+    for(n=0;n<grid->num_cells_recv[neigh];n++) {
+      for(k=0;k<grid->Nk[grid->cell_recv[neigh][n]];k++) 
+        celldata[grid->cell_recv[neigh][n]][k]=grid->recv[neigh][nstart+k];
+      nstart+=grid->Nk[grid->cell_recv[neigh][n]];
+    }
+  }
+  t_comm+=Timer()-t0;
+}
+#endif
+
+/*
+ * Function: ISendRecvStoredDataBatch
+ * Usage: ISendRecvStoredDataBatch(tracers->c,tracers->N,tracers->send,tracers->recv,grid,myproc,comm);
+ * ----------------------------------------------------------------------------------------------------
+ * Same as ISendRecvStoredData3D for the N fields celldata[0..N-1], which are
+ * packed into one message per neighbor.  send[neigh] and recv[neigh] must hold
+ * N*total_cells_send[neigh] and N*total_cells_recv[neigh] values.
+ *
+ */
+void ISendRecvStoredDataBatch(SREAL ***celldata, int N, REAL **send, REAL **recv, gridT *grid, int myproc, MPI_Comm comm)
+{
+  int k, m, n, nc, nstart, neigh, neighproc;
+  REAL t0=Timer();
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    neighproc = grid->myneighs[neigh];
+
+    nstart=0;
+    for(n=0;n<grid->num_cells_send[neigh];n++) {
+      nc=grid->cell_send[neigh][n];
+      for(m=0;m<N;m++) {
+        for(k=0;k<grid->Nk[nc];k++) 
+          send[neigh][nstart+k]=celldata[m][nc][k];
+        nstart+=grid->Nk[nc];
+      }
+    }
+
+    MPI_Isend((void *)(send[neigh]),N*grid->total_cells_send[neigh],MPI_DOUBLE,neighproc,1,
+        comm,&(grid->request[neigh])); 
+  }
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    neighproc = grid->myneighs[neigh];
+    MPI_Irecv((void *)(recv[neigh]),N*grid->total_cells_recv[neigh],MPI_DOUBLE,neighproc,1,
+        comm,&(grid->request[grid->Nneighs+neigh]));
+  }
+  MPI_Waitall(2*grid->Nneighs,grid->request,grid->status);
+
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    nstart=0;
+    for(n=0;n<grid->num_cells_recv[neigh];n++) {
+      nc=grid->cell_recv[neigh][n];
+      for(m=0;m<N;m++) {
+        for(k=0;k<grid->Nk[nc];k++) 
+          celldata[m][nc][k]=recv[neigh][nstart+k];
+        nstart+=grid->Nk[nc];
+      }
+    }
+  }
+  t_comm+=Timer()-t0;
+}
+
 /*
  * Function: ISendRecvWData
  * Usage: ISendRecvWData(grid->w,grid,myproc,comm);
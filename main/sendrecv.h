@@ -19,6 +19,12 @@ void AllocateTransferArrays(gridT **grid, int myproc, int numprocs, MPI_Comm com
 void FreeTransferArrays(gridT *grid, int myproc, int numprocs, MPI_Comm comm);
 void ISendRecvCellData2D(REAL *celldata, gridT *grid, int myproc, MPI_Comm comm);
 void ISendRecvCellData3D(REAL **celldata, gridT *grid, int myproc, MPI_Comm comm);
+#ifdef FLOAT_STORAGE
+void ISendRecvStoredData3D(SREAL **celldata, gridT *grid, int myproc, MPI_Comm comm);
+#else
+#define ISendRecvStoredData3D ISendRecvCellData3D
+#endif
+void ISendRecvStoredDataBatch(SREAL ***celldata, int N, REAL **send, REAL **recv, gridT *grid, int myproc, MPI_Comm comm);
 void ISendRecvWData(REAL **celldata, gridT *grid, int myproc, MPI_Comm comm);
 void ISendRecvEdgeData3D(REAL **edgedata, gridT *grid, int myproc, MPI_Comm comm);
 void CheckCommunicateCells(gridT *maingrid, gridT *localgrid, int myproc, MPI_Comm comm);
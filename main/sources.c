@@ -14,6 +14,36 @@
 #include "memory.h"
 #include "sendrecv.h"
 
+// Largest number of shortwave bands
+#define SWBANDS 2
+
+/*
+ * Cached shortwave attenuation.  Below the top cell the layer thicknesses only
+ * change when ctop changes, so the attenuation of band b at the bottom face of
+ * layer k>ctop is exp(-dzz[ctop]/L[b])*E[Nb*k+b], where E is the attenuation
+ * between the bottoms of the top cell and of layer k.  depth is the depth
+ * below the top cell.
+ *
+ */
+typedef struct _swcacheT {
+  int Nb;
+  REAL frac[SWBANDS], L[SWBANDS];
+  int *ctop;
+  REAL *depth;
+  REAL **E;
+} swcacheT;
+
+static swcacheT *swcache = NULL;
+
+// Fraction and extinction lengths (m) of the two bands of Jerlov water types
+// I, IA, IB, II, and III (Paulson and Simpson, 1977)
+static const REAL jerlovR[5] = {0.58, 0.62, 0.67, 0.77, 0.78};
+static const REAL jerlovL1[5] = {0.35, 0.6, 1.0, 1.5, 1.4};
+static const REAL jerlovL2[5] = {23.0, 20.0, 17.0, 14.0, 7.9};
+
+static void InitializeShortwave(gridT *grid, propT *prop, int myproc);
+static void ShortwaveSource(REAL **A, REAL *Hsw, REAL rhocp, gridT *grid, propT *prop, int myproc);
+
 void MomentumSource(REAL **usource, gridT *grid, physT *phys, propT *prop) {
   int j, jptr, nc1, nc2, k;
   REAL Coriolis_f, ubar, depth_face;
@@ -141,11 +171,11 @@ void SaltSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
 void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT *met, int myproc, MPI_Comm comm) {
  if(prop->metmodel==1){ //Wood et al., Heat Flux model
   int i, iptr, k, ktop, gc;
-  REAL z, dztop, sigma , epsilon_w, epsilon_a, dzmin_heatflux, T_0, T_00, c_p, alpha_0,
+  REAL dztop, sigma , epsilon_w, epsilon_a, dzmin_heatflux, T_0, T_00, c_p, alpha_0,
     r_LW, alpha_LW, F, e_s, e_a, alpha_E1, alpha_E2, alpha_E3, alpha_E4,
     alpha_E5, L_w;
   REAL H_LE, H_LE0, Delta_H_LE0, H_E, H_E0, Delta_H_E0, 
-    H_S, H_S0, Delta_H_S0, C_B, r_p, F_SW, r_SW, k_e;
+    H_S, H_S0, Delta_H_S0, C_B, r_p, r_SW, k_e;
   REAL fixedT = 5.0; // Temperature about which we might want to linearize, if not using previous timestep value 
   
   //
@@ -153,7 +183,7 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
   REAL R = 0.0;
   REAL RSW = 0.0;
  
-  REAL Ta , M , U2, rh ,H_SW, H_LW , lap, mslp;
+  REAL Ta , M , U2, rh , H_LW , lap, mslp;
   
   sigma = 5.67e-8;        // Boltzmann constant (W m^{-2} K^{-4})
   epsilon_w = 0.97;       // Emissivity of water
@@ -214,7 +244,6 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
     Ta = met->Tair[i];
     U2 = sqrt( pow(met->Uwind[i],2.0) + pow(met->Vwind[i],2.0) );
     met->Hsw[i] = shortwave(prop->nctime/86400.0,prop->latitude,met->cloud[i],prop->gmtoffset/24.0);
-    H_SW = met->Hsw[i];
     rh = met->RH[i]/100.0;
     //H_LW = met->Hlw[i];
     // Emissivity of air
@@ -327,40 +356,8 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
     // Make sure values beneath surface are zero
     for(k=ktop+1;k<grid->Nk[i];k++) //originally this should be ktop+1 
       A[i][k]=B[i][k]=0;
-     
-    REAL topface, botface, depth=0; //These will be used with the heat conservative scheme of solar radiation
-    REAL ksw1 = 1/prop->Lsw; //These are extinction coefficients. L1 and L2 are in met.h  
-    
-    REAL wave1, wave1term1, wave1term2, wave1term3, wave2, wave2term1, wave2term2, wave2term3; //These are the terms from the infinite reflections formula
-
-     for(k=ktop;k<grid->Nk[i];k++) //loop for calculating the local depth
-{	depth = depth + grid->dzz[i][k]; 
-}
-	//fprintf(stderr,"i = %d, Local depth = %f\n", i, depth);
-    z=0;
-    for(k=ktop;k<grid->Nk[i];k++) {
-      z-=grid->dzz[i][k]/2;
-
-      topface = z + grid->dzz[i][k]/2; //Depth of the top face of a cell from the surface
-      botface = z - grid->dzz[i][k]/2; //Depth of the bottom face of a cell from the surface
-
-      //F_SW = k_e*H_SW*(1-r_SW)*exp(k_e*z)/(RHO0*c_p);
-
-      wave1term1 = (exp(topface*ksw1) - exp(botface*ksw1))/(topface - botface);
-      wave1term2 = (1/(1-exp(-2*depth*ksw1))) * (exp(-(2*depth - topface)*ksw1) - exp(-(2*depth - botface)*ksw1))/(topface - botface);
-      wave1term3 = -(1/(1-exp(-2*depth*ksw1))) * (exp(-(2*depth + topface)*ksw1) - exp(-(2*depth + botface)*ksw1))/(topface - botface);  
-
-      wave2 = wave2term1 + wave2term2 + wave2term3;
-
-      F_SW =wave1*H_SW/(RHO0*CP_WATER);
-
-      // Set the coefficients of the sources term here
-      B[i][k] += 0;
-      A[i][k] += F_SW;
-      
-      z-=grid->dzz[i][k]/2;
-    }
   }
+  ShortwaveSource(A,met->Hsw,RHO0*CP_WATER,grid,prop,myproc);
 }else if(prop->metmodel==2 || prop->metmodel==3){ // COARE3.0 HeatFlux Algorithm or constant flux coefficients
    int i, k, ktop, iptr;
    REAL dztop;
@@ -371,11 +368,6 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
    REAL dHdT;
    REAL eps = 1e-14;
    REAL dzmin_heatflux = 0.1;  // Minimum allowable depth of top cell for computation of   
-   // shortwave constants
-   REAL ksw1; // light extinction coefficient
-   REAL depth, z, topface, botface;
-   REAL wave1, wave1term1, wave1term2, wave1term3;
-   REAL F_SW;
    REAL dT;
    
    
@@ -427,81 +419,10 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
      A[i][ktop]/=(rhocp*dztop);
      B[i][ktop]/=(rhocp*dztop);
 
-     /*******************************************************
-     // Evaluate the shortwave radiation terms and put into A
-     ********************************************************/
-     
-     //Calculate the local depth (accounts for free surface) 
-     depth=0;
-     for(k=ktop;k<grid->Nk[i];k++) 
- 	depth += grid->dzz[i][k]; 
-     
-     // Set the light extinction coefficient - ensure that thhe extinction depth is less than the water depth
-     ksw1 = 1.0 / Min(prop->Lsw, 0.5*depth);
-
-     if(ksw1!=ksw1){
-     	printf("Error NaN computed in shortwave radiation term - too shallow!\n");
-	exit(EXIT_FAILURE);
-     }
-
-     z=0.0; // Reference from the free-surface
-     for(k=ktop;k<grid->Nk[i];k++) {
-       z-=grid->dzz[i][k]/2.0;
- 
-       topface = z + grid->dzz[i][k]/2.0; //Depth of the top face of a cell from the surface
-       botface = z - grid->dzz[i][k]/2.0; //Depth of the bottom face of a cell from the surface
- 
-       // Discrete form of dQ_sw/dz
-       wave1 = (exp(topface*ksw1) - exp(botface*ksw1))/(topface - botface);
- 
-       F_SW = wave1 * met->Hsw[i] / rhocp;
-       
-       B[i][k] += 0.0;
-       A[i][k] += F_SW;
-       
-       z-=grid->dzz[i][k]/2;
-       
-     }
-     /********************************************
-      * 	Original shortwave code
-      ********************************************
-     // Evaluate the shortwave radiation terms and put into A
-     for(k=ktop;k<grid->Nk[i];k++) //loop for calculating the local depth (accounts for free surface) 
- 	depth = depth + grid->dzz[i][k]; 
-     
-     //if (depth<dztop)
-     //	printf("Warning in sources.c: Depth at cell %d = %6.10f (<%6.10f)\n",j,depth,dztop);
-     
-     // Set the light extinction coefficient - ensure that thhe extinction depth is less than the water depth
-     ksw1 = 1.0 / Min(prop->Lsw, 0.5*depth);
-
-     z=0.0;
-     for(k=ktop;k<grid->Nk[i];k++) {
-       z-=grid->dzz[i][k]/2.0;
- 
-       topface = z + grid->dzz[i][k]/2.0; //Depth of the top face of a cell from the surface
-       botface = z - grid->dzz[i][k]/2.0; //Depth of the bottom face of a cell from the surface
- 
-       wave1term1 = (exp(topface*ksw1) - exp(botface*ksw1))/(topface - botface);
-       wave1term2 = (1.0/(1.0-exp(-2.0*depth*ksw1))) * (exp(-(2.0*depth - topface)*ksw1) - exp(-(2.0*depth - botface)*ksw1))/(topface - botface);
-       wave1term3 = -(1.0/(1.0-exp(-2.0*depth*ksw1))) * (exp(-(2.0*depth + topface)*ksw1) - exp(-(2.0*depth + botface)*ksw1))/(topface - botface);  
- 
-       wave1 = wave1term1 + wave1term2 + wave1term3;
-       
-       F_SW = wave1 * met->Hsw[i] / rhocp;
-       
-       B[i][k] += 0.0;
-       A[i][k] += F_SW;
-       
-       z-=grid->dzz[i][k]/2;
-
-       //Zero for Testing
-       //B[i][k] = 0.0;
-       //A[i][k] = 0.0;
-
-     }
-     */
    }
+
+   // Evaluate the shortwave radiation terms and put into A
+   ShortwaveSource(A,met->Hsw,rhocp,grid,prop,myproc);
  }else{ //Set flux terms to zero
   int i,k,iptr;
     //for(i=0;i<grid->Nc;i++)
@@ -514,6 +435,121 @@ void HeatSource(REAL **A, REAL **B, gridT *grid, physT *phys, propT *prop, metT
  }// End if
 } // End Heatsource
 
+/*
+ * Function: InitializeShortwave
+ * Usage: InitializeShortwave(grid,prop,myproc);
+ * ---------------------------------------------
+ * Allocate the shortwave cache and set the bands, which are a single band with
+ * extinction length Lsw when jerlov=0 and the two bands of the Jerlov water
+ * type otherwise.  No column is cached until it is first used.
+ *
+ */
+static void InitializeShortwave(gridT *grid, propT *prop, int myproc) {
+  int i;
+
+  if(prop->jerlov<0 || prop->jerlov>5) {
+    if(myproc==0) printf("Error: jerlov=%d in suntans.dat must be between 0 and 5.\n",prop->jerlov);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  swcache = (swcacheT *)SunMalloc(sizeof(swcacheT),"InitializeShortwave");
+  if(prop->jerlov==0) {
+    swcache->Nb = 1;
+    swcache->frac[0] = 1.0;
+    swcache->L[0] = prop->Lsw;
+  } else {
+    swcache->Nb = 2;
+    swcache->frac[0] = jerlovR[prop->jerlov-1];
+    swcache->frac[1] = 1.0-jerlovR[prop->jerlov-1];
+    swcache->L[0] = jerlovL1[prop->jerlov-1];
+    swcache->L[1] = jerlovL2[prop->jerlov-1];
+  }
+
+  swcache->ctop = (int *)SunMalloc(grid->Nc*sizeof(int),"InitializeShortwave");
+  swcache->depth = (REAL *)SunMalloc(grid->Nc*sizeof(REAL),"InitializeShortwave");
+  swcache->E = (REAL **)SunMalloc(grid->Nc*sizeof(REAL *),"InitializeShortwave");
+  for(i=0;i<grid->Nc;i++) {
+    swcache->ctop[i] = -1;
+    swcache->depth[i] = 0;
+    swcache->E[i] = (REAL *)SunMalloc(swcache->Nb*grid->Nk[i]*sizeof(REAL),"InitializeShortwave");
+  }
+}
+
+/*
+ * Function: ShortwaveSource
+ * Usage: ShortwaveSource(A,Hsw,rhocp,grid,prop,myproc);
+ * -----------------------------------------------------
+ * Add the divergence of the penetrating shortwave flux Hsw/rhocp to A.  Each
+ * band is absorbed as exp(z/L) with z the distance from the free surface,
+ * where L is limited to half of the water depth as before.  The attenuation
+ * below the top cell is cached when the column's ctop changes, so that
+ * each column needs one exp per band unless L is limited by the depth.
+ *
+ */
+static void ShortwaveSource(REAL **A, REAL *Hsw, REAL rhocp, gridT *grid, propT *prop, int myproc) {
+  int i, iptr, k, b, ktop, Nb, cached[SWBANDS];
+  REAL depth, dztop, z, wave, *E, ksw[SWBANDS], etop[SWBANDS], ebot[SWBANDS], stop[SWBANDS];
+
+  if(!swcache)
+    InitializeShortwave(grid,prop,myproc);
+  Nb = swcache->Nb;
+
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i = grid->cellp[iptr];
+    ktop = grid->ctop[i];
+    dztop = grid->dzz[i][ktop];
+    E = swcache->E[i];
+
+    // Recompute the attenuation below the top cell if ctop has changed
+    if(swcache->ctop[i]!=ktop) {
+      depth = 0;
+      for(k=ktop+1;k<grid->Nk[i];k++) {
+        depth += grid->dzz[i][k];
+        for(b=0;b<Nb;b++)
+          E[Nb*k+b] = exp(-depth/swcache->L[b]);
+      }
+      swcache->depth[i] = depth;
+      swcache->ctop[i] = ktop;
+    }
+
+    // Set the light extinction coefficient - ensure that the extinction depth is less than the water depth
+    depth = dztop+swcache->depth[i];
+    for(b=0;b<Nb;b++) {
+      cached[b] = (swcache->L[b]<=0.5*depth);
+      ksw[b] = 1.0/Min(swcache->L[b],0.5*depth);
+      stop[b] = exp(-dztop*ksw[b]);
+    }
+
+    if(ksw[0]!=ksw[0]){
+      printf("Error NaN computed in shortwave radiation term - too shallow!\n");
+      exit(EXIT_FAILURE);
+    }
+
+    z=-dztop; // Reference from the free-surface
+    for(k=ktop;k<grid->Nk[i];k++) {
+      for(b=0;b<Nb;b++) {
+        if(k==ktop) {
+          etop[b] = 1.0;
+          ebot[b] = stop[b];
+        } else {
+          etop[b] = ebot[b];
+          ebot[b] = cached[b] ? stop[b]*E[Nb*k+b] : exp(z*ksw[b]);
+        }
+      }
+
+      // Discrete form of dQ_sw/dz
+      wave = 0;
+      for(b=0;b<Nb;b++)
+        wave += swcache->frac[b]*(etop[b]-ebot[b]);
+      A[i][k] += wave/grid->dzz[i][k] * Hsw[i] / rhocp;
+
+      if(k+1<grid->Nk[i])
+        z-=grid->dzz[i][k+1];
+    }
+  }
+}
+
 /*
  * Function: InitSponge
  * Usage: InitSponge(grid,myproc);
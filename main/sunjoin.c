@@ -12,6 +12,7 @@
 #include "phys.h"
 #include "report.h"
 #include "mynetcdf.h"
+#include "util.h"
 
  
 void JoinNetcdf(propT *prop, gridT *grid, physT *phys, metT *met);
@@ -79,6 +80,7 @@ void JoinNetcdf(propT *prop, gridT *grid, physT *phys, metT *met){
     char *basefile;
     size_t start1[1], count1[1];
     int blowup=0;
+    REAL **tmp3d;
 
     // Step 1: Open all of the netcdf files
     for(myproc=0;myproc<NUMPROCS;myproc++){
@@ -178,12 +180,20 @@ void JoinNetcdf(propT *prop, gridT *grid, physT *phys, metT *met){
 	   read_cell_3D(ncid[myproc], Nc[myproc], n, "uc", ptr, grid, phys->uc, myproc);
 	   read_cell_3D(ncid[myproc], Nc[myproc], n, "vc", ptr, grid, phys->vc, myproc);
 	   read_cell_3Dw(ncid[myproc], Nc[myproc], n, "w", ptr, grid, phys->w, myproc);
-	   read_cell_3D(ncid[myproc], Nc[myproc], n, "nu_v", ptr, grid, phys->nu_tv, myproc);
+	   tmp3d=StoredToREAL(phys->nu_tv,phys->stmp,grid);
+	   read_cell_3D(ncid[myproc], Nc[myproc], n, "nu_v", ptr, grid, tmp3d, myproc);
+	   REALToStored(tmp3d,phys->nu_tv,grid);
 	   read_cell_3D(ncid[myproc], Nc[myproc], n, "dzz", ptr, grid, grid->dzz, myproc);
-	   if(prop->beta>0)
-	       read_cell_3D(ncid[myproc], Nc[myproc], n, "salt", ptr, grid, phys->s, myproc);
-	   if(prop->gamma>0)
-	       read_cell_3D(ncid[myproc], Nc[myproc], n, "temp", ptr, grid, phys->T, myproc);
+	   if(prop->beta>0) {
+	       tmp3d=StoredToREAL(phys->s,phys->stmp,grid);
+	       read_cell_3D(ncid[myproc], Nc[myproc], n, "salt", ptr, grid, tmp3d, myproc);
+	       REALToStored(tmp3d,phys->s,grid);
+	   }
+	   if(prop->gamma>0) {
+	       tmp3d=StoredToREAL(phys->T,phys->stmp,grid);
+	       read_cell_3D(ncid[myproc], Nc[myproc], n, "temp", ptr, grid, tmp3d, myproc);
+	       REALToStored(tmp3d,phys->T,grid);
+	   }
 	   if( (prop->gamma>0) || (prop->beta>0) )
 	       read_cell_3D(ncid[myproc], Nc[myproc], n, "rho", ptr, grid, phys->rho, myproc);
 	   read_edge_3D(ncid[myproc], Ne[myproc], n, "dzf", ptr, grid, grid->dzf, myproc);
@@ -23,6 +23,7 @@
 #include "phys.h"
 #include "physio.h"
 #include "report.h"
+#include "eos.h"
 
 int main(int argc, char *argv[])
 {
@@ -47,7 +48,9 @@ int main(int argc, char *argv[])
     ReadProperties(&prop,grid,myproc);
     // give space and initialize dzf(edge) dzz(center) dzzold(center)
     InitializeVerticalGrid(&grid,myproc);
+    PlanPhysicalMemory(grid,prop,myproc,comm);
     AllocatePhysicalVariables(grid,&phys,prop);
+    InitializeEOS(grid,prop,myproc);
     AllocateTransferArrays(&grid,myproc,numprocs,comm);
     OpenFiles(prop,myproc);
     if(RESTART)
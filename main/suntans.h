@@ -17,6 +17,16 @@
 
 // number of faces (for triangle)
 #define REAL double
+// Storage type of the large tracer and diffusivity arrays.  Arithmetic is
+// always done in REAL; uncomment FLOAT_STORAGE to hold them in single
+// precision and halve their memory traffic.  The examples include this file,
+// so they must be rebuilt along with the main code after changing it.
+//#define FLOAT_STORAGE
+#ifdef FLOAT_STORAGE
+#define SREAL float
+#else
+#define SREAL REAL
+#endif
 #define BUFFERLENGTH 256
 #define NUMEDGECOLUMNS 3
 #define BREAK printf("%d\n",*((int *)0));
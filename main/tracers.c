@@ -0,0 +1,217 @@
+/*
+ * All functions related to the transport of user-defined passive tracers
+ * ----------------------------------------------------
+ * prop->Ntracers tracers are set up in SetTracers with RegisterTracer.  Each
+ * tracer has its own initial, boundary and source functions and flags for the
+ * output and the averages.  The concentrations of all the tracers are held
+ * in one block and are transported together with UpdateScalarsBatch.
+ *
+ */
+#include "tracers.h"
+#include "memory.h"
+#include "sendrecv.h"
+#include "scalars.h"
+
+/*
+ * Private functions
+ */
+static void SetTracers(propT *prop);
+static void AllocateTracerVariables(gridT *grid, propT *prop, tracersT *tracers);
+static REAL ZeroTracer(REAL x, REAL y, REAL z, int n);
+static void ZeroTracerBoundary(REAL **boundary_c, int n, gridT *grid, physT *phys, propT *prop);
+
+/*
+ * Function: SetTracers()
+ * ---------------------------------------
+ * Set up the user-defined tracers with RegisterTracer.  Tracers that are not
+ * registered here are called tracerN with N=1,...,Ntracers, start from zero,
+ * have a zero concentration at the open boundaries, no source, and are written
+ * to the output and average files.
+ *
+ */
+static void SetTracers(propT *prop){
+
+  // For example, a dye released at the surface with its own boundary and source
+  // functions that is not averaged:
+  // RegisterTracer(0,"dye",ReturnDye,DyeBoundary,DyeSource,1,0);
+
+}//End function
+
+/*
+ * Function: RegisterTracer()
+ * ---------------------------------------
+ * Set the name, functions and output flags of tracer n.  A NULL initial
+ * or boundary function uses zero and a NULL source function adds no source.
+ *
+ */
+void RegisterTracer(int n, char *name, tracerInitialFunction initial, tracerBoundaryFunction boundary,
+		    tracerSourceFunction source, int output, int average){
+
+  if(n<0 || n>=tracers->N) {
+    printf("Error in RegisterTracer: tracer %d (%s) is not between 0 and Ntracers-1=%d.\n",n,name,tracers->N-1);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  strncpy(tracers->tracer[n].name,name,BUFFERLENGTH-1);
+  tracers->tracer[n].name[BUFFERLENGTH-1]='\0';
+  tracers->tracer[n].initial = initial ? initial : ZeroTracer;
+  tracers->tracer[n].boundary = boundary ? boundary : ZeroTracerBoundary;
+  tracers->tracer[n].source = source;
+  tracers->tracer[n].output = output;
+  tracers->tracer[n].average = average;
+}//End function
+
+/*
+ * Function: AllocateTracerVariables()
+ * ---------------------------------------
+ * Allocate memory to the tracer arrays.  c, cold and sumQC of all the tracers
+ * are each held in one block, each tracer contiguous.
+ *
+ */
+static void AllocateTracerVariables(gridT *grid, propT *prop, tracersT *tracers){
+
+  int i,j,jptr,n,neigh,maxsend,N=tracers->N,Nc=grid->Nc;
+  size_t N3c=0, start;
+
+  for(i=0;i<Nc;i++)
+    N3c+=grid->Nk[i];
+
+  tracers->cdata = (SREAL *)SunMalloc(N*N3c*sizeof(SREAL),"AllocateTracerVariables");
+  tracers->colddata = (REAL *)SunMalloc(N*N3c*sizeof(REAL),"AllocateTracerVariables");
+  tracers->sumQCdata = NULL;
+  if(prop->TVDtracers)
+    tracers->sumQCdata = (SREAL *)SunMalloc(N*N3c*sizeof(SREAL),"AllocateTracerVariables");
+  tracers->c = (SREAL ***)SunMalloc(N*sizeof(SREAL **),"AllocateTracerVariables");
+  tracers->cold = (REAL ***)SunMalloc(N*sizeof(REAL **),"AllocateTracerVariables");
+  tracers->sumQC = NULL;
+  if(prop->TVDtracers)
+    tracers->sumQC = (SREAL ***)SunMalloc(N*sizeof(SREAL **),"AllocateTracerVariables");
+  tracers->boundary_c = (REAL ***)SunMalloc(N*sizeof(REAL **),"AllocateTracerVariables");
+  for(n=0;n<N;n++) {
+    tracers->c[n] = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateTracerVariables");
+    tracers->cold[n] = (REAL **)SunMalloc(Nc*sizeof(REAL *),"AllocateTracerVariables");
+    if(prop->TVDtracers)
+      tracers->sumQC[n] = (SREAL **)SunMalloc(Nc*sizeof(SREAL *),"AllocateTracerVariables");
+    start=0;
+    for(i=0;i<Nc;i++) {
+      tracers->c[n][i] = tracers->cdata+n*N3c+start;
+      tracers->cold[n][i] = tracers->colddata+n*N3c+start;
+      if(prop->TVDtracers)
+        tracers->sumQC[n][i] = tracers->sumQCdata+n*N3c+start;
+      start+=grid->Nk[i];
+    }
+
+    // allocate boundary variables over vertical layers
+    tracers->boundary_c[n] = (REAL **)SunMalloc((grid->edgedist[5]-grid->edgedist[2])*sizeof(REAL *),"AllocateTracerVariables");
+    for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
+      j=grid->edgep[jptr];
+      tracers->boundary_c[n][jptr-grid->edgedist[2]] = (REAL *)SunMalloc(grid->Nke[j]*sizeof(REAL),"AllocateTracerVariables");
+    }
+  }
+
+  // The limiter sums are only set in the wet layers but all of them are communicated
+  if(prop->TVDtracers)
+    for(start=0;start<N*N3c;start++)
+      tracers->sumQCdata[start]=0;
+
+  // packed transfer buffers for all of the tracers (or their limiter sums)
+  tracers->send = (REAL **)SunMalloc(grid->Nneighs*sizeof(REAL *),"AllocateTracerVariables");
+  tracers->recv = (REAL **)SunMalloc(grid->Nneighs*sizeof(REAL *),"AllocateTracerVariables");
+  for(neigh=0;neigh<grid->Nneighs;neigh++) {
+    maxsend = N*Max(grid->total_cells_send[neigh],grid->total_cells_recv[neigh]);
+    tracers->send[neigh] = (REAL *)SunMalloc(maxsend*sizeof(REAL),"AllocateTracerVariables");
+    tracers->recv[neigh] = (REAL *)SunMalloc(maxsend*sizeof(REAL),"AllocateTracerVariables");
+  }
+}//End Function
+
+/*
+ * Function: InitializeTracers()
+ * ---------------------------------------
+ * Set up the (global) tracer structure and the initial concentrations.
+ * This must be called before the output and average files are initialized.
+ *
+ */
+void InitializeTracers(gridT *grid, physT *phys, propT *prop, int myproc){
+
+  int i,k,n;
+  REAL z;
+  char str[BUFFERLENGTH];
+
+  tracers = (tracersT *)SunMalloc(sizeof(tracersT),"InitializeTracers");
+  tracers->N = prop->Ntracers;
+  tracers->tracer = (tracerT *)SunMalloc(tracers->N*sizeof(tracerT),"InitializeTracers");
+  for(n=0;n<tracers->N;n++) {
+    sprintf(str,"tracer%d",n+1);
+    RegisterTracer(n,str,NULL,NULL,NULL,1,1);
+  }
+  SetTracers(prop);
+
+  AllocateTracerVariables(grid,prop,tracers);
+
+  for(n=0;n<tracers->N;n++)
+    for(i=0;i<grid->Nc;i++) {
+      for(k=0;k<grid->ctop[i];k++)
+        tracers->c[n][i][k]=0;
+      z=phys->h[i];
+      for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+        z-=grid->dzz[i][k]/2;
+        tracers->c[n][i][k]=tracers->tracer[n].initial(grid->xv[i],grid->yv[i],z,n);
+        z-=grid->dzz[i][k]/2;
+      }
+    }
+
+  if(myproc==0 && VERBOSE>1)
+    printf("Initialized %d passive tracers.\n",tracers->N);
+}//End function
+
+/*
+ * Function: ZeroTracer()
+ * ---------------------------------------
+ * Default initial concentration of a tracer.
+ *
+ */
+static REAL ZeroTracer(REAL x, REAL y, REAL z, int n){
+  return 0;
+}
+
+/*
+ * Function: ZeroTracerBoundary()
+ * ---------------------------------------
+ * Default boundary concentration of a tracer.
+ *
+ */
+static void ZeroTracerBoundary(REAL **boundary_c, int n, gridT *grid, physT *phys, propT *prop){
+  int j, jptr, k;
+
+  for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
+    j = grid->edgep[jptr];
+    for(k=0;k<grid->Nke[j];k++)
+      boundary_c[jptr-grid->edgedist[2]][k]=0;
+  }
+}
+
+/*
+ * Function: UpdateTracers()
+ * ---------------------------------------
+ * Update the concentrations of all of the tracers with a single call to
+ * UpdateScalarsBatch with the advection scheme TVDtracers, apply the sources,
+ * and communicate all of the tracers in one message per neighbor.
+ *
+ */
+void UpdateTracers(gridT *grid, physT *phys, propT *prop, MPI_Comm comm, int myproc){
+  int n;
+
+  for(n=0;n<tracers->N;n++)
+    tracers->tracer[n].boundary(tracers->boundary_c[n],n,grid,phys,prop);
+
+  UpdateScalarsBatch(grid,phys,prop,phys->wnew,tracers->N,tracers->c,tracers->cold,tracers->boundary_c,
+      tracers->sumQC,tracers->send,tracers->recv,prop->kappa_s,prop->kappa_sH,phys->kappa_tv,prop->theta,
+      comm,myproc,prop->TVDtracers);
+
+  for(n=0;n<tracers->N;n++)
+    if(tracers->tracer[n].source)
+      tracers->tracer[n].source(tracers->c[n],n,grid,phys,prop);
+
+  ISendRecvStoredDataBatch(tracers->c,tracers->N,tracers->send,tracers->recv,grid,myproc,comm);
+}
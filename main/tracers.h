@@ -0,0 +1,57 @@
+/*
+ * Passive tracer related header file
+ */
+#ifndef _tracers_h
+#define _tracers_h
+
+#include "phys.h"
+#include "grid.h"
+
+/*
+ * Callbacks of a tracer, n is the index of the tracer.
+ *   initial: returns the initial concentration at x, y, z
+ *   boundary: sets the concentration on the type 2 and 3 boundary edges
+ *             in boundary_c[jptr-grid->edgedist[2]][k]
+ *   source: modifies the concentration c after it has been transported
+ */
+typedef REAL (*tracerInitialFunction)(REAL x, REAL y, REAL z, int n);
+typedef void (*tracerBoundaryFunction)(REAL **boundary_c, int n, gridT *grid, physT *phys, propT *prop);
+typedef void (*tracerSourceFunction)(SREAL **c, int n, gridT *grid, physT *phys, propT *prop);
+
+typedef struct _tracerT {
+  char name[BUFFERLENGTH];
+  int output;  // write to the output netcdf file
+  int average; // average and write to the average netcdf file
+  tracerInitialFunction initial;
+  tracerBoundaryFunction boundary;
+  tracerSourceFunction source;
+} tracerT;
+
+// Tracer structure
+typedef struct _tracersT {
+  int N;
+  tracerT *tracer;
+
+  SREAL ***c;    // concentration [tracer][cell][Nk]
+  SREAL *cdata;  // storage for c
+  REAL ***cold;  // concentration at the old time step [tracer][cell][Nk]
+  REAL *colddata; // storage for cold
+  REAL ***boundary_c; // [tracer][boundary edge][Nke]
+  SREAL ***sumQC; // TVD limiter sums of UpdateScalarsBatch [tracer][cell][Nk], only with TVDtracers
+  SREAL *sumQCdata; // storage for sumQC
+
+  REAL **send, **recv; // packed transfer buffers for all tracers [neigh][]
+} tracersT;
+
+//Make the tracers struct global
+tracersT *tracers;
+
+/*
+ * Public function declarations.
+ *
+ */
+void RegisterTracer(int n, char *name, tracerInitialFunction initial, tracerBoundaryFunction boundary,
+		    tracerSourceFunction source, int output, int average);
+void InitializeTracers(gridT *grid, physT *phys, propT *prop, int myproc);
+void UpdateTracers(gridT *grid, physT *phys, propT *prop, MPI_Comm comm, int myproc);
+#endif
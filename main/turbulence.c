@@ -3,7 +3,7 @@
  * Author: Oliver B. Fringer
  * Institution: Stanford University
  * --------------------------------
- * Contains the Mellor-Yamada level 2.5 turbulence model.
+ * Contains the Mellor-Yamada level 2.5 and k-epsilon turbulence models.
  *
  * Copyright (C) 2005-2006 The Board of Trustees of the Leland Stanford Junior 
  * University. All Rights Reserved.
@@ -19,27 +19,45 @@
 #include "boundaries.h"
 #include "scalars.h"
 
-// Local function
-static void StabilityFunctions(REAL *Sm, REAL *Sh, REAL Gh, REAL A1, REAL A2, REAL B1, REAL B2, REAL C1);
+// k-epsilon constants (Rodi 1987; Burchard and Baumert 1995).  The minimum values
+// of k and epsilon give an eddy viscosity of order 1e-9 m^2 s^-1 (Umlauf et al. 2005).
+#define CMU 0.09
+#define SIGMAK 1.0
+#define SIGMAE 1.3
+#define CEPS1 1.44
+#define CEPS2 1.92
+#define CEPS3PLUS 1.0
+#define CEPS3MINUS -0.4
+#define KMIN 1e-10
+#define EPSMIN 1e-12
+
+// Local functions
+static void ColumnGradients(gridT *grid, physT *phys, int i, REAL *dudz, REAL *dvdz, REAL *drdz);
+static void FaceDragAverages(gridT *grid, physT *phys, int i, REAL *CdAvgT, REAL *CdAvgB, REAL *tauAvgT);
+static void BuoyancyFrequency(gridT *grid, physT *phys, propT *prop, int i, REAL *N);
+static void SetTurbulenceBoundary(gridT *grid, physT *phys, SREAL **phi);
+static void StabilityConstants(REAL *Sc, REAL A1, REAL A2, REAL B1, REAL B2, REAL C1);
+static inline void StabilityFunctions(REAL *Sm, REAL *Sh, REAL Gh, const REAL *Sc);
 
 /*
  * Function: my25
  * Usage: my25(grid,phys,prop,wnew,phys->qT,phys->lT,phys->Cn_q,phys->Cn_l,phys->nu_tv,phys->kappa_tv);
  * -----------------------------------------------------------------------------------------------
  * Computes the eddy viscosity and scalar diffusivity via the MY25 closure.  Advection of the turbulent
- * quantities q^2 and q^2l is included with the use of UpdateScalars
+ * quantities q^2 and q^2l is included with the use of UpdateScalars.  The sources for q^2 and
+ * q^2l are computed in a single pass over each column, with those for q^2l stored in
+ * phys->lsrc1 and phys->lsrc2 until the q^2 solve is done.
  *
  */
-void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l, REAL **Cn_q, REAL **Cn_l, 
-	  REAL **nuT, REAL **kappaT, MPI_Comm comm, int myproc) {
-  int i, ib, j, iptr, jptr, k, nf, nc1, nc2, ne;
-  REAL thetaQ=1, CdAvgT, CdAvgB, *dudz, *dvdz, *drdz, z, *N, *Gh, tauAvgT;
-  REAL A1, A2, B1, B2, C1, E1, E2, E3, Sq, Sm, Sh;
+void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **q, SREAL **l, REAL **Cn_q, REAL **Cn_l, 
+	  SREAL **nuT, SREAL **kappaT, MPI_Comm comm, int myproc) {
+  int i, iptr, k, skipdry;
+  REAL thetaQ=1, CdAvgT, CdAvgB, *dudz, *dvdz, *drdz, z, *N, Gh, tauAvgT;
+  REAL A1, A2, B1, B2, C1, E1, E2, E3, Sq, Sm, Sh, Sc[7], B123;
 
   N = dudz = phys->a;
   dvdz = phys->b;
   drdz = phys->c;
-  Gh = phys->d;
 
   // Specification of constants
   A1 = 0.92;
@@ -51,104 +69,70 @@ void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l
   E2 = 1.33;
   E3 = 0.25;
   Sq = 0.2;
+  B123 = pow(B1,2.0/3.0);
+  StabilityConstants(Sc,A1,A2,B1,B2,C1);
   
-  // First solve for q^2 and store its old value in stmp3
+  // Dry columns are zeroed by UpdateScalars, so their sources are not needed.
+  // q and l are still squared there since the wet neighbors advect them.
+  skipdry = prop->wetdry && prop->n>1;
+
+  // Sources for q^2 and q^2 l, with the old value of q in stmp3
   for(i=0;i<grid->Nc;i++) {
 
-    // dudz, dvdz, and drdz store gradients at k-1/2
-    for(k=grid->ctop[i]+1;k<grid->Nk[i];k++) {
-      dudz[k]=2.0*(phys->uc[i][k-1]-phys->uc[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
-      dvdz[k]=2.0*(phys->vc[i][k-1]-phys->vc[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
-      drdz[k]=2.0*(phys->rho[i][k-1]-phys->rho[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
+    if(skipdry && DRYCELL(grid,phys,i)) {
+      for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+        phys->stmp3[i][k]=q[i][k];
+        q[i][k]*=q[i][k];
+        l[i][k]*=pow(phys->stmp3[i][k],2);
+      }
+      continue;
     }
-    dudz[grid->ctop[i]]=dudz[grid->ctop[i]+1];
-    dvdz[grid->ctop[i]]=dvdz[grid->ctop[i]+1];
-    drdz[grid->ctop[i]]=drdz[grid->ctop[i]+1];
-    dudz[grid->Nk[i]]=dudz[grid->Nk[i]-1];
-    dvdz[grid->Nk[i]]=dvdz[grid->Nk[i]-1];
-    drdz[grid->Nk[i]]=drdz[grid->Nk[i]-1];
-    
+
+    // dudz, dvdz, and drdz store gradients at k-1/2
+    ColumnGradients(grid,phys,i,dudz,dvdz,drdz);
+
     // uold will store src1 for q^2, which is the 2q/B1 l term
     // wtmp will store src2 for q^2, which is the 2 (Ps+Pb) term
+    // lsrc1 will store src1 for q^2 l, which is the q/B1 l*(1+E2(l/kz)^2+E3(l/k(H-z))^2) term
+    // lsrc2 will store src2 for q^2 l, which is the l E1 (Ps+Pb) term
+    // kappaT will store the diffusion coefficient for q^2 and q^2 l
+    // q will store q^2 and l will store q^2 l
+    z = phys->h[i];
     for(k=grid->ctop[i];k<grid->Nk[i];k++) {
       phys->uold[i][k]=2.0*q[i][k]/B1/(l[i][k]+SMALL);
       phys->wtmp[i][k]=2.0*fabs((prop->nu+nuT[i][k])*(pow(0.5*(dudz[k]+dudz[k+1]),2)+pow(0.5*(dvdz[k]+dvdz[k+1]),2))+
       				prop->grav*(prop->kappa_s+kappaT[i][k])*0.5*(drdz[k]+drdz[k+1]));
-    }
-
-    // kappaT will store the diffusion coefficient for q^2
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) 
       kappaT[i][k]=q[i][k]*l[i][k]*Sq;
 
-    // q will store q^2 and stmp3 will store the old value of q
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+      z-=grid->dzz[i][k]/2;
+      phys->lsrc1[i][k]=phys->uold[i][k]*
+        (0.5*(1+E2*pow(l[i][k]/KAPPA_VK/(z-phys->h[i]),2)+E3*pow(l[i][k]/KAPPA_VK/(grid->dv[i]+z),2)));
+      phys->lsrc2[i][k]=phys->wtmp[i][k]*(0.5*l[i][k]*E1);
+      z-=grid->dzz[i][k]/2;
+
       phys->stmp3[i][k]=q[i][k];
       q[i][k]*=q[i][k];
+      l[i][k]*=pow(phys->stmp3[i][k],2);
     }
 
     // htmp will store the value at the top boundary for q^2
     // hold will store it at the bottom boundary
-    // The drag coefficient is the average of the coefficients on the cell faces
-    CdAvgT=0;
-    CdAvgB=0;
-    tauAvgT=0;
-    for(nf=0;nf<grid->nfaces[i];nf++) {
-      ne = grid->face[i*grid->maxfaces+nf];
-      CdAvgT+=phys->CdT[ne]/3;
-      CdAvgB+=phys->CdB[ne]/3;
-      tauAvgT+=fabs(phys->tau_T[ne])/3;
-    }
-    phys->htmp[i]=pow(B1,2.0/3.0)*(CdAvgT*(pow(phys->uc[i][grid->ctop[i]],2)+pow(phys->vc[i][grid->ctop[i]],2))+
+    FaceDragAverages(grid,phys,i,&CdAvgT,&CdAvgB,&tauAvgT);
+    phys->htmp[i]=B123*(CdAvgT*(pow(phys->uc[i][grid->ctop[i]],2)+pow(phys->vc[i][grid->ctop[i]],2))+
 				   tauAvgT);
-    phys->hold[i]=pow(B1,2.0/3.0)*CdAvgB*(pow(phys->uc[i][grid->Nk[i]-1],2)+pow(phys->vc[i][grid->Nk[i]-1],2));
+    phys->hold[i]=B123*CdAvgB*(pow(phys->uc[i][grid->Nk[i]-1],2)+pow(phys->vc[i][grid->Nk[i]-1],2));
   }
-  // Specify turbulence at boundaries for use in updatescalars.  Assume that all incoming turbulence is zero and let outgoing
-  // turbulence flow outward.
-  for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
-    j = grid->edgep[jptr];
-    ib = grid->grad[2*j];
-    
-    for(k=grid->ctop[ib];k<grid->Nk[ib];k++) 
-      phys->boundary_tmp[jptr-grid->edgedist[2]][k]=q[ib][k];
-  }    
+  SetTurbulenceBoundary(grid,phys,q);
   UpdateScalars(grid,phys,prop,wnew,q,phys->boundary_tmp,phys->Cn_q,0,0,kappaT,thetaQ,phys->uold,phys->wtmp,
 		phys->htmp,phys->hold,1,1,comm,myproc,0,prop->TVDturb);
 
-  // q now contains q^2
-  for(i=0;i<grid->Nc;i++) {
-
-    // uold will store src1 for q^2 l, which is the q/B1 l*(1+E2(l/kz)^2+E3(l/k(H-z))^2) term
-    // wtmp will store src2 for q^2 l, which is the l E1 (Ps+Pb) term
-    z = phys->h[i];
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
-      z-=grid->dzz[i][k]/2;
-      phys->uold[i][k]*=0.5*(1+E2*pow(l[i][k]/KAPPA_VK/(z-phys->h[i]),2)+E3*pow(l[i][k]/KAPPA_VK/(grid->dv[i]+z),2));
-      phys->wtmp[i][k]*=0.5*l[i][k]*E1;
-      z-=grid->dzz[i][k]/2;
-    }
-
-    // kappaT already stores q l Sq from before
-    // l will store q^2 l 
-    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
-      l[i][k]*=pow(phys->stmp3[i][k],2);
-    }
-
-    // htmp will store the value at the top boundary for q^2 l
-    // hold will store it at the bottom boundary (both are 0)
-    phys->htmp[i]=0;
-    phys->hold[i]=0;
-  }
+  // The values of q^2 l at the top and bottom boundaries are 0
+  for(i=0;i<grid->Nc;i++)
+    phys->htmp[i]=phys->hold[i]=0;
 
-  // Specify turbulence at boundaries for use in updatescalars.  Assume that all incoming turbulence is zero and let outgoing
-  // turbulence flow outward.
-  for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
-    j = grid->edgep[jptr];
-    ib = grid->grad[2*j];
-    
-    for(k=grid->ctop[ib];k<grid->Nk[ib];k++) 
-      phys->boundary_tmp[jptr-grid->edgedist[2]][k]=l[ib][k];
-  }
-  UpdateScalars(grid,phys,prop,wnew,l,phys->boundary_tmp,phys->Cn_l,0,0,kappaT,thetaQ,phys->uold,phys->wtmp,
+  // kappaT still stores q l Sq from before
+  SetTurbulenceBoundary(grid,phys,l);
+  UpdateScalars(grid,phys,prop,wnew,l,phys->boundary_tmp,phys->Cn_l,0,0,kappaT,thetaQ,phys->lsrc1,phys->lsrc2,
 		phys->htmp,phys->hold,1,1,comm,myproc,0,prop->TVDturb);
 
   // Set l to a background value if it gets too small.
@@ -161,8 +145,8 @@ void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l
   }
 
   // Send/Recv q and l data to neighboring processors
-  ISendRecvCellData3D(q,grid,myproc,comm);
-  ISendRecvCellData3D(l,grid,myproc,comm);
+  ISendRecvStoredData3D(q,grid,myproc,comm);
+  ISendRecvStoredData3D(l,grid,myproc,comm);
 
   // l stores q^2 l
   // q stores q^2
@@ -170,15 +154,7 @@ void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l
   // and then set the values of nuT and kappaT
   for(i=0;i<grid->Nc;i++) {
 
-    for(k=grid->ctop[i]+1;k<grid->Nk[i];k++) {
-      drdz[k]=-2.0*prop->grav*(phys->rho[i][k-1]-phys->rho[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
-      if(drdz[k]<0) drdz[k]=0;
-      N[k]=sqrt(drdz[k]);
-    }
-    if(grid->ctop[i]<grid->Nk[i]-1)
-      N[grid->ctop[i]]=N[grid->ctop[i]+1];
-    else
-      N[grid->ctop[i]]=0;
+    BuoyancyFrequency(grid,phys,prop,i,N);
 
     for(k=grid->ctop[i];k<grid->Nk[i];k++) {
       if(l[i][k]<0) l[i][k]=0;
@@ -186,8 +162,8 @@ void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l
       l[i][k]=l[i][k]/(q[i][k]+SMALL);
       q[i][k]=sqrt(q[i][k]);
       l[i][k]=Min(0.53*q[i][k]/(N[k]+SMALL),l[i][k]);
-      Gh[k]=-pow(N[k]*l[i][k]/(q[i][k]+SMALL),2);
-      StabilityFunctions(&Sm,&Sh,Gh[k],A1,A2,B1,B2,C1);
+      Gh=-pow(N[k]*l[i][k]/(q[i][k]+SMALL),2);
+      StabilityFunctions(&Sm,&Sh,Gh,Sc);
 
       nuT[i][k]=Sm*q[i][k]*l[i][k];
       kappaT[i][k]=Sh*q[i][k]*l[i][k];
@@ -197,17 +173,239 @@ void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l
   }
 }
 
+/*
+ * Function: keps
+ * Usage: keps(grid,phys,prop,wnew,phys->qT,phys->lT,phys->Cn_q,phys->Cn_l,phys->nu_tv,phys->kappa_tv);
+ * -----------------------------------------------------------------------------------------------
+ * Computes the eddy viscosity and scalar diffusivity with the standard k-epsilon closure, which
+ * is the generic length scale model with p=3, m=3/2, n=-1 (Umlauf and Burchard 2003).  The turbulent
+ * kinetic energy k is stored in q and the dissipation epsilon in l, and both are advected and
+ * diffused with UpdateScalars as in my25.  Sinks and negative buoyancy production are treated
+ * implicitly so that k and epsilon remain positive.  The stability function is the constant
+ * CMU and the turbulent Prandtl number is 1.  The length scale is limited by 0.53 sqrt(2k)/N
+ * as in my25 (Galperin et al. 1988).  Dirichlet values at the top and bottom are given by
+ * the law of the wall using the friction velocity from the drag and the wind stress.
+ *
+ */
+void keps(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **q, SREAL **l, REAL **Cn_q, REAL **Cn_l, 
+	  SREAL **nuT, SREAL **kappaT, MPI_Comm comm, int myproc) {
+  int i, iptr, k, skipdry;
+  REAL thetaQ=1, CdAvgT, CdAvgB, *dudz, *dvdz, *drdz, *N, tauAvgT, ustarT, ustarB;
+  REAL S2, N2, Ps, Pb, prod, epsmin, cde=pow(CMU,0.75);
+
+  N = dudz = phys->a;
+  dvdz = phys->b;
+  drdz = phys->c;
+
+  skipdry = prop->wetdry && prop->n>1;
+
+  // uold and wtmp will store src1 and src2 for k, and lsrc1 and lsrc2 will store those
+  // for epsilon.  kappaT will store the diffusion coefficient for k.
+  for(i=0;i<grid->Nc;i++) {
+
+    if(skipdry && DRYCELL(grid,phys,i))
+      continue;
+
+    ColumnGradients(grid,phys,i,dudz,dvdz,drdz);
+
+    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+      if(q[i][k]<KMIN) q[i][k]=KMIN;
+      if(l[i][k]<EPSMIN) l[i][k]=EPSMIN;
+
+      // Shear and buoyancy production at the cell center
+      S2=pow(0.5*(dudz[k]+dudz[k+1]),2)+pow(0.5*(dvdz[k]+dvdz[k+1]),2);
+      N2=-prop->grav*0.5*(drdz[k]+drdz[k+1]);
+      Ps=(prop->nu+nuT[i][k])*S2;
+      Pb=-(prop->kappa_s+kappaT[i][k])*N2;
+
+      phys->uold[i][k]=(l[i][k]+(Pb<0?-Pb:0))/q[i][k];
+      phys->wtmp[i][k]=Ps+(Pb>0?Pb:0);
+
+      prod=CEPS1*Ps+(Pb>0?CEPS3PLUS:CEPS3MINUS)*Pb;
+      phys->lsrc1[i][k]=(CEPS2*l[i][k]+(prod<0?-prod:0))/q[i][k];
+      phys->lsrc2[i][k]=(prod>0?prod:0)*l[i][k]/q[i][k];
+
+      kappaT[i][k]=nuT[i][k]/SIGMAK;
+    }
+
+    // htmp and hold store k at the top and bottom boundaries
+    FaceDragAverages(grid,phys,i,&CdAvgT,&CdAvgB,&tauAvgT);
+    ustarT=sqrt(CdAvgT*(pow(phys->uc[i][grid->ctop[i]],2)+pow(phys->vc[i][grid->ctop[i]],2))+tauAvgT);
+    ustarB=sqrt(CdAvgB*(pow(phys->uc[i][grid->Nk[i]-1],2)+pow(phys->vc[i][grid->Nk[i]-1],2)));
+    phys->htmp[i]=Max(ustarT*ustarT/sqrt(CMU),KMIN);
+    phys->hold[i]=Max(ustarB*ustarB/sqrt(CMU),KMIN);
+  }
+  SetTurbulenceBoundary(grid,phys,q);
+  UpdateScalars(grid,phys,prop,wnew,q,phys->boundary_tmp,phys->Cn_q,0,0,kappaT,thetaQ,phys->uold,phys->wtmp,
+		phys->htmp,phys->hold,1,1,comm,myproc,0,prop->TVDturb);
+
+  // htmp and hold store epsilon at the top and bottom boundaries, evaluated at the
+  // centers of the top and bottom cells.  kappaT stores the diffusion coefficient for epsilon.
+  for(i=0;i<grid->Nc;i++) {
+    if(skipdry && DRYCELL(grid,phys,i))
+      continue;
+
+    FaceDragAverages(grid,phys,i,&CdAvgT,&CdAvgB,&tauAvgT);
+    ustarT=sqrt(CdAvgT*(pow(phys->uc[i][grid->ctop[i]],2)+pow(phys->vc[i][grid->ctop[i]],2))+tauAvgT);
+    ustarB=sqrt(CdAvgB*(pow(phys->uc[i][grid->Nk[i]-1],2)+pow(phys->vc[i][grid->Nk[i]-1],2)));
+    phys->htmp[i]=Max(pow(ustarT,3)/(KAPPA_VK*0.5*grid->dzz[i][grid->ctop[i]]+SMALL),EPSMIN);
+    phys->hold[i]=Max(pow(ustarB,3)/(KAPPA_VK*0.5*grid->dzz[i][grid->Nk[i]-1]+SMALL),EPSMIN);
+
+    for(k=grid->ctop[i];k<grid->Nk[i];k++)
+      kappaT[i][k]=nuT[i][k]/SIGMAE;
+  }
+  SetTurbulenceBoundary(grid,phys,l);
+  UpdateScalars(grid,phys,prop,wnew,l,phys->boundary_tmp,phys->Cn_l,0,0,kappaT,thetaQ,phys->lsrc1,phys->lsrc2,
+		phys->htmp,phys->hold,1,1,comm,myproc,0,prop->TVDturb);
+
+  for(iptr=grid->celldist[0];iptr<grid->celldist[1];iptr++) {
+    i=grid->cellp[iptr];
+    
+    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+      if(q[i][k]<KMIN) q[i][k]=KMIN;
+      if(l[i][k]<EPSMIN) l[i][k]=EPSMIN;
+    }
+  }
+
+  ISendRecvStoredData3D(q,grid,myproc,comm);
+  ISendRecvStoredData3D(l,grid,myproc,comm);
+
+  // Limit the length scale in stratified flow and set nuT and kappaT
+  for(i=0;i<grid->Nc;i++) {
+
+    BuoyancyFrequency(grid,phys,prop,i,N);
+
+    for(k=grid->ctop[i];k<grid->Nk[i];k++) {
+      if(q[i][k]<KMIN) q[i][k]=KMIN;
+      epsmin=cde*q[i][k]*N[k]/(0.53*sqrt(2.0));
+      if(l[i][k]<epsmin) l[i][k]=epsmin;
+      if(l[i][k]<EPSMIN) l[i][k]=EPSMIN;
+
+      nuT[i][k]=CMU*q[i][k]*q[i][k]/l[i][k];
+      kappaT[i][k]=nuT[i][k];
+    }
+    for(k=0;k<grid->ctop[i];k++)
+      nuT[i][k]=kappaT[i][k]=l[i][k]=q[i][k]=0;
+  }
+}
+
+/*
+ * Function: ColumnGradients
+ * Usage: ColumnGradients(grid,phys,i,dudz,dvdz,drdz);
+ * ---------------------------------------------------
+ * Places the vertical gradients of uc, vc, and rho at the faces k-1/2 of column i into
+ * dudz, dvdz, and drdz.  The values at the top and bottom faces are extrapolated from
+ * the nearest interior face.
+ *
+ */
+static void ColumnGradients(gridT *grid, physT *phys, int i, REAL *dudz, REAL *dvdz, REAL *drdz) {
+  int k;
+
+  for(k=grid->ctop[i]+1;k<grid->Nk[i];k++) {
+    dudz[k]=2.0*(phys->uc[i][k-1]-phys->uc[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
+    dvdz[k]=2.0*(phys->vc[i][k-1]-phys->vc[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
+    drdz[k]=2.0*(phys->rho[i][k-1]-phys->rho[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
+  }
+  dudz[grid->ctop[i]]=dudz[grid->ctop[i]+1];
+  dvdz[grid->ctop[i]]=dvdz[grid->ctop[i]+1];
+  drdz[grid->ctop[i]]=drdz[grid->ctop[i]+1];
+  dudz[grid->Nk[i]]=dudz[grid->Nk[i]-1];
+  dvdz[grid->Nk[i]]=dvdz[grid->Nk[i]-1];
+  drdz[grid->Nk[i]]=drdz[grid->Nk[i]-1];
+}
+
+/*
+ * Function: FaceDragAverages
+ * Usage: FaceDragAverages(grid,phys,i,&CdAvgT,&CdAvgB,&tauAvgT);
+ * --------------------------------------------------------------
+ * The drag coefficients and the magnitude of the wind stress at cell i are the
+ * averages of those on its faces.
+ *
+ */
+static void FaceDragAverages(gridT *grid, physT *phys, int i, REAL *CdAvgT, REAL *CdAvgB, REAL *tauAvgT) {
+  int nf, ne;
+
+  *CdAvgT=0;
+  *CdAvgB=0;
+  *tauAvgT=0;
+  for(nf=0;nf<grid->nfaces[i];nf++) {
+    ne = grid->face[i*grid->maxfaces+nf];
+    *CdAvgT+=phys->CdT[ne]/3;
+    *CdAvgB+=phys->CdB[ne]/3;
+    *tauAvgT+=fabs(phys->tau_T[ne])/3;
+  }
+}
+
+/*
+ * Function: BuoyancyFrequency
+ * Usage: BuoyancyFrequency(grid,phys,prop,i,N);
+ * ---------------------------------------------
+ * Places the buoyancy frequency at the faces k-1/2 of column i into N, which is
+ * zero in unstable regions.  The value at ctop is taken from the face below it.
+ *
+ */
+static void BuoyancyFrequency(gridT *grid, physT *phys, propT *prop, int i, REAL *N) {
+  int k;
+  REAL N2;
+
+  for(k=grid->ctop[i]+1;k<grid->Nk[i];k++) {
+    N2=-2.0*prop->grav*(phys->rho[i][k-1]-phys->rho[i][k])/(grid->dzz[i][k-1]+grid->dzz[i][k]);
+    if(N2<0) N2=0;
+    N[k]=sqrt(N2);
+  }
+  if(grid->ctop[i]<grid->Nk[i]-1)
+    N[grid->ctop[i]]=N[grid->ctop[i]+1];
+  else
+    N[grid->ctop[i]]=0;
+}
+
+/*
+ * Function: SetTurbulenceBoundary
+ * Usage: SetTurbulenceBoundary(grid,phys,q);
+ * ------------------------------------------
+ * Specify turbulence at boundaries for use in updatescalars.  Assume that all incoming turbulence
+ * is zero and let outgoing turbulence flow outward.
+ *
+ */
+static void SetTurbulenceBoundary(gridT *grid, physT *phys, SREAL **phi) {
+  int j, jptr, ib, k;
+
+  for(jptr=grid->edgedist[2];jptr<grid->edgedist[5];jptr++) {
+    j = grid->edgep[jptr];
+    ib = grid->grad[2*j];
+    
+    for(k=grid->ctop[ib];k<grid->Nk[ib];k++) 
+      phys->boundary_tmp[jptr-grid->edgedist[2]][k]=phi[ib][k];
+  }    
+}
+
+/*
+ * Function: StabilityConstants
+ * Usage: StabilityConstants(Sc,A1,A2,B1,B2,C1);
+ * ---------------------------------------------
+ * Computes the parts of the stability functions that do not depend on Gh
+ * so that they are not recomputed in every cell.
+ *
+ */
+static void StabilityConstants(REAL *Sc, REAL A1, REAL A2, REAL B1, REAL B2, REAL C1) {
+  Sc[0] = pow(B1,-1.0/3.0);
+  Sc[1] = A1*A2;
+  Sc[2] = (B2-3*A2)*(1-6*A1/B1)-3*C1*(B2+6*A1);
+  Sc[3] = 3*A2;
+  Sc[4] = 6*A1+B2;
+  Sc[5] = 9*A1*A2;
+  Sc[6] = A2*(1-6*A1/B1);
+}
+
 /*
  * Function: Stability Functions
- * Usage:  StabilityFunctions(&Sm,&Sh,b[k],A1,A2,B1,B2,C1);
- * --------------------------------------------------------
+ * Usage:  StabilityFunctions(&Sm,&Sh,Gh,Sc);
+ * -------------------------------------------
  * Computes the Stability functions of Blumberg et al. (1992) and 
- * places them into Sm and Sh.
+ * places them into Sm and Sh.  Sc contains the constants from StabilityConstants.
  *
  */
-static void StabilityFunctions(REAL *Sm, REAL *Sh, REAL Gh, REAL A1, REAL A2, REAL B1, REAL B2, REAL C1) {
-  *Sm = (pow(B1,-1.0/3.0)-A1*A2*Gh*((B2-3*A2)*(1-6*A1/B1)-3*C1*(B2+6*A1)))/
-    ((1-3*A2*Gh*(6*A1+B2))*(1-9*A1*A2*Gh));
-  *Sh = A2*(1-6*A1/B1)/(1-3*A2*Gh*(6*A1+B2));
+static inline void StabilityFunctions(REAL *Sm, REAL *Sh, REAL Gh, const REAL *Sc) {
+  *Sm = (Sc[0]-Sc[1]*Gh*Sc[2])/((1-Sc[3]*Gh*Sc[4])*(1-Sc[5]*Gh));
+  *Sh = Sc[6]/(1-Sc[3]*Gh*Sc[4]);
 }
-
@@ -18,6 +18,7 @@
 // Background length scale
 #define LBACKGROUND 1e-12
 
-void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, REAL **q, REAL **l, REAL **Cn_q, REAL **Cn_l, REAL **nuT, REAL **kappaT, MPI_Comm comm, int myproc);
+void my25(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **q, SREAL **l, REAL **Cn_q, REAL **Cn_l, SREAL **nuT, SREAL **kappaT, MPI_Comm comm, int myproc);
+void keps(gridT *grid, physT *phys, propT *prop, REAL **wnew, SREAL **q, SREAL **l, REAL **Cn_q, REAL **Cn_l, SREAL **nuT, SREAL **kappaT, MPI_Comm comm, int myproc);
 //void my25(gridT *grid, physT *phys, propT *prop, REAL **q, REAL **l, REAL **Cn_q, REAL **Cn_l, REAL **nuT, REAL **kappaT, MPI_Comm comm, int myproc) ;
 #endif
@@ -20,9 +20,6 @@
 // To prevent denominators from going to zero.
 #define EPS 1e-12
 
-// Local function
-static REAL Psi(REAL r, int TVD);
-
 /*
  * Function: HorizontalFaceScalars
  * Usage: HorizontalFaceScalars(grid, phys, boundary_scal);
@@ -127,7 +124,7 @@ void HorizontalFaceScalars(gridT *grid, physT *phys, propT *prop, REAL **scal, R
  * TVD=1  first-order upwind,    TVD=2  Lax-Wendroff
  * TVD=3  Superbee,              TVD=4  Van Leer  
  */
-static REAL Psi(REAL r, int TVD){
+REAL Psi(REAL r, int TVD){
   switch(TVD) {
   case 1:
     return 0;
@@ -160,6 +157,22 @@ static REAL Psi(REAL r, int TVD){
  */
 void GetApAm(REAL *ap, REAL *am, REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL *rp, REAL *rm,
 	     REAL **w, REAL **dzz, REAL **scal, int i, int Nk, int ktop, REAL dt, int TVD) {
+
+  GetCourant(wp,wm,Cp,Cm,w,dzz,i,Nk,dt);
+  GetLimiters(rp,rm,scal[i],Nk,ktop,TVD);
+  LimitedApAm(ap,am,wp,wm,Cp,Cm,rp,rm,Nk,ktop);
+}
+
+/*
+ * Function: GetCourant
+ * Usage:  GetCourant(wp,wm,Cp,Cm,w,dzz,i,Nk,dt);
+ * ----------------------------------------------
+ * Split the vertical velocity in column i into its upward and downward parts
+ * wp and wm and compute their Courant numbers Cp and Cm.  These do not depend
+ * on the scalar.
+ *
+ */
+void GetCourant(REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL **w, REAL **dzz, int i, int Nk, REAL dt) {
   int k;
 
   // Implicit vertical advection terms
@@ -176,32 +189,62 @@ void GetApAm(REAL *ap, REAL *am, REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL *r
   k=Nk;
   Cp[k] = wp[k]*dt/dzz[i][k-1];
   Cm[k] = wm[k]*dt/dzz[i][k-1];
+}
 
+/*
+ * Function: GetLimiters
+ * Usage:  GetLimiters(rp,rm,scal[i],Nk,ktop,TVD);
+ * -----------------------------------------------
+ * Compute the upwind gradient ratios of the scalar column s and return the
+ * limiter Psi of each in rp[k-ktop] and rm[k-ktop] for k=ktop+1,...,Nk.
+ *
+ */
+void GetLimiters(REAL *rp, REAL *rm, REAL *s, int Nk, int ktop, int TVD) {
+  int k;
 
   // Compute the upwind gradient ratios r
   for(k=ktop+2;k<Nk-1;k++) {
-    rp[k-ktop] = (scal[i][k]-scal[i][k+1]+EPS) / (scal[i][k-1]-scal[i][k]+EPS);
-    rm[k-ktop] = (scal[i][k-2]-scal[i][k-1]+EPS) / (scal[i][k-1]-scal[i][k]+EPS);
+    rp[k-ktop] = (s[k]-s[k+1]+EPS) / (s[k-1]-s[k]+EPS);
+    rm[k-ktop] = (s[k-2]-s[k-1]+EPS) / (s[k-1]-s[k]+EPS);
   }
 
-  rp[1]= (scal[i][ktop+1]-scal[i][ktop+2]+EPS) / (scal[i][ktop]-scal[i][ktop+1]+EPS);
-  rm[1]= EPS / (scal[i][ktop]-scal[i][ktop+1]+EPS);
+  rp[1]= (s[ktop+1]-s[ktop+2]+EPS) / (s[ktop]-s[ktop+1]+EPS);
+  rm[1]= EPS / (s[ktop]-s[ktop+1]+EPS);
 
   k=Nk-1;
-  rp[k-ktop]=EPS / (scal[i][k-1]-scal[i][k]+EPS);
-  rm[k-ktop]=(scal[i][k-2]-scal[i][k-1]+EPS) / (scal[i][k-1]-scal[i][k]+EPS);
+  rp[k-ktop]=EPS / (s[k-1]-s[k]+EPS);
+  rm[k-ktop]=(s[k-2]-s[k-1]+EPS) / (s[k-1]-s[k]+EPS);
 
   k=Nk;
   rp[k-ktop]=1;
-  rm[k-ktop]=(scal[i][k-2]-scal[i][k-1]+EPS) / EPS;
+  rm[k-ktop]=(s[k-2]-s[k-1]+EPS) / EPS;
 
   for(k=ktop+1;k<Nk+1;k++) {
-    am[k]= 0.5*wp[k]*Psi(rp[k-ktop], TVD)*(1-Cp[k]) 
-             + wm[k]*(1-0.5*Psi(rm[k-ktop], TVD)*(1+Cm[k]));
-    ap[k]= wp[k]*(1-0.5*Psi(rp[k-ktop],TVD)*(1-Cp[k])) 
-             + 0.5*wm[k]*Psi(rm[k-ktop],TVD)*(1+Cm[k]);
+    rp[k-ktop] = Psi(rp[k-ktop],TVD);
+    rm[k-ktop] = Psi(rm[k-ktop],TVD);
   }
 }
+
+/*
+ * Function: LimitedApAm
+ * Usage:  LimitedApAm(ap,am,wp,wm,Cp,Cm,psip,psim,Nk,ktop);
+ * ---------------------------------------------------------
+ * Combine the velocities and Courant numbers from GetCourant with the limiters
+ * from GetLimiters into the vertical advective fluxes ap and am.
+ *
+ */
+void LimitedApAm(REAL *ap, REAL *am, REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL *psip, REAL *psim,
+		 int Nk, int ktop) {
+  int k;
+
+  for(k=ktop+1;k<Nk+1;k++) {
+    am[k]= 0.5*wp[k]*psip[k-ktop]*(1-Cp[k]) 
+             + wm[k]*(1-0.5*psim[k-ktop]*(1+Cm[k]));
+    ap[k]= wp[k]*(1-0.5*psip[k-ktop]*(1-Cp[k])) 
+             + 0.5*wm[k]*psim[k-ktop]*(1+Cm[k]);
+  }
+}
+
 /*
  * Function: HorizontalFaceU
  * Usage: HorizontalFaceScalars(uc, grid, phys, boundary_scal);
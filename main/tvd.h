@@ -28,6 +28,11 @@ void HorizontalFaceScalars(gridT *grid, physT *phys, propT *prop, REAL **scal, R
 			   MPI_Comm comm, int myproc); 
 void GetApAm(REAL *ap, REAL *am, REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL *rp, REAL *rm,
 	     REAL **w, REAL **dzz, REAL **scal, int i, int Nk, int ktop, REAL dt, int TVD);
+void GetCourant(REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL **w, REAL **dzz, int i, int Nk, REAL dt);
+void GetLimiters(REAL *rp, REAL *rm, REAL *s, int Nk, int ktop, int TVD);
+void LimitedApAm(REAL *ap, REAL *am, REAL *wp, REAL *wm, REAL *Cp, REAL *Cm, REAL *psip, REAL *psim,
+		 int Nk, int ktop);
+REAL Psi(REAL r, int TVD);
 void HorizontalFaceU(REAL **uc, gridT *grid, physT *phys, propT *prop, int TVDscheme,
 			   MPI_Comm comm, int myproc); 
 #endif
@@ -6,6 +6,9 @@
  * Contains functions that define and implement the equation of state for
  * the density from the salinity, temperature, and pressure.
  *
+ * Setting eos=1 in suntans.dat uses this equation of state (see eos.c)
+ * without replacing state.c.
+ *
  * Copyright (C) 2005-2006 The Board of Trustees of the Leland Stanford Junior 
  * University. All Rights Reserved.
  *
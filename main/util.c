@@ -12,6 +12,12 @@
 #include<math.h>
 #include "grid.h"
 #include "util.h"
+#include "memory.h"
+
+#define EMPTYKEY -1
+#define MAXCURSORSTEPS 4
+
+static int HashIndex(hashT *hash, int key);
 
 void Sort(int *a, int *v, int N)
 {
@@ -239,6 +245,47 @@ void Copy(REAL **from, REAL **to, gridT *grid) {
       to[i][k]=from[i][k];
 }
 
+/*
+ * Function: StoredToREAL
+ * Usage: s = StoredToREAL(phys->s,phys->stmp,grid);
+ * -------------------------------------------------
+ * Returns a double-precision view of the cell-centered field x, which is kept
+ * in storage precision (SREAL).  With FLOAT_STORAGE the values are widened
+ * into tmp and tmp is returned, otherwise x is returned as is.
+ *
+ */
+REAL **StoredToREAL(SREAL **x, REAL **tmp, gridT *grid) {
+#ifdef FLOAT_STORAGE
+  int i, k;
+
+  for(i=0;i<grid->Nc;i++)
+    for(k=0;k<grid->Nk[i];k++)
+      tmp[i][k]=x[i][k];
+  return tmp;
+#else
+  return x;
+#endif
+}
+
+/*
+ * Function: REALToStored
+ * Usage: REALToStored(StoredToREAL(phys->s,phys->stmp,grid),phys->s,grid);
+ * ------------------------------------------------------------------------
+ * Stores the double-precision field x obtained from StoredToREAL back into
+ * the storage-precision field y.  Without FLOAT_STORAGE x and y are the same
+ * array and nothing is done.
+ *
+ */
+void REALToStored(REAL **x, SREAL **y, gridT *grid) {
+#ifdef FLOAT_STORAGE
+  int i, k;
+
+  for(i=0;i<grid->Nc;i++)
+    for(k=0;k<grid->Nk[i];k++)
+      y[i][k]=x[i][k];
+#endif
+}
+
 REAL Min(REAL x, REAL y) {
   if(x<y)
     return x;
@@ -347,6 +394,106 @@ REAL QuadInterp(REAL x, REAL x0, REAL x1, REAL x2, REAL y0, REAL y1, REAL y2){
 
 }//End Function
 
+/*
+* Function: QuadWeights()
+* -----------------------
+* Returns the Lagrange weights w[0..2] used by QuadInterp so that the
+* interpolated value is y0*w[0] + y1*w[1] + y2*w[2].  Use this when the same
+* times are used to interpolate many values.
+*/ 
+void QuadWeights(REAL x, REAL x0, REAL x1, REAL x2, REAL *w){
+
+    w[0] = (x-x1) * (x-x2) / ( (x0-x1)*(x0-x2) );
+    w[1] = (x-x0) * (x-x2) / ( (x1-x0)*(x1-x2) );
+    w[2] = (x-x0) * (x-x1) / ( (x2-x0)*(x2-x1) );
+
+}//End Function
+
+/*
+* Function: SearchTime()
+* ----------------------
+* Returns the index of the first record in time[lo..hi-1] that is >= t, or hi
+* if there is none, by bisection.  time must be increasing.
+*/ 
+int SearchTime(REAL t, REAL *time, int lo, int hi){
+    int mid;
+
+    while(lo<hi) {
+      mid = lo+(hi-lo)/2;
+      if(time[mid]<t)
+	lo = mid+1;
+      else
+	hi = mid;
+    }
+    return lo;
+}//End Function
+
+/*
+* Function: InitTimeCursor()
+* --------------------------
+* Resets a time cursor so that the next search starts from scratch.
+*/ 
+void InitTimeCursor(timecursorT *cursor){
+    cursor->rec = -1;
+    cursor->w[0] = cursor->w[1] = cursor->w[2] = 0;
+}//End Function
+
+/*
+* Function: TimeCursorSearch()
+* ----------------------------
+* Returns the index of the first record in time[0..nt-1] that is >= t, or nt if
+* there is none (the same result as a linear scan from the start).  The search
+* starts from the record found by the previous call and steps forward, so it is
+* O(1) when t advances by less than a few records between calls and falls back
+* to bisection otherwise.
+*/ 
+int TimeCursorSearch(timecursorT *cursor, REAL t, REAL *time, int nt){
+    int j = cursor->rec, n;
+
+    if(j<0 || j>nt || (j>0 && time[j-1]>=t))
+      j = SearchTime(t,time,0,nt);
+    else {
+      for(n=0;n<MAXCURSORSTEPS && j<nt && time[j]<t;n++)
+	j++;
+      if(j<nt && time[j]<t)
+	j = SearchTime(t,time,j,nt);
+    }
+
+    cursor->rec = j;
+    return j;
+}//End Function
+
+/*
+* Function: TimeCursorWeights()
+* -----------------------------
+* Stores the quadratic interpolation weights at time t for the three records
+* at times t0, t1 and t2 in cursor->w.
+*/ 
+void TimeCursorWeights(timecursorT *cursor, REAL t, REAL t0, REAL t1, REAL t2){
+    QuadWeights(t,t0,t1,t2,cursor->w);
+}//End Function
+
+/*
+* Function: TimeInterp()
+* ----------------------
+* Interpolates N contiguous forcing values in time with the weights w from
+* QuadWeights, y[i] = y0[i]*w[0] + y1[i]*w[1] + y2[i]*w[2], and limits the
+* result to [ymin,ymax].  Pass -INFTY and INFTY for a field without bounds.
+*/ 
+void TimeInterp(REAL *y, REAL *y0, REAL *y1, REAL *y2, REAL *w, int N, REAL ymin, REAL ymax){
+    int i;
+    REAL w0=w[0], w1=w[1], w2=w[2];
+
+    for(i=0;i<N;i++)
+      y[i] = y0[i]*w0 + y1[i]*w1 + y2[i]*w2;
+
+    if(ymin>-INFTY || ymax<INFTY)
+      for(i=0;i<N;i++) {
+	if(y[i]<ymin) y[i]=ymin;
+	if(y[i]>ymax) y[i]=ymax;
+      }
+}//End Function
+
 /* Function getToffSet()
  * ------------------
  * Returns the time offset in days between two time strings - starttime and basetime
@@ -426,5 +573,359 @@ void linsolve(REAL **A, REAL *b, int N){
   }  
 } // End of linsolve
 
+/*
+ * Function: HashCreate
+ * Usage: map = HashCreate(N,"Function");
+ * --------------------------------------
+ * Allocate an empty hash table that can hold at least N keys.  The
+ * table size is the next power of two at least twice N so that the
+ * probe sequences stay short.
+ *
+ */
+hashT *HashCreate(int N, char *function) {
+  int i;
+  hashT *hash = (hashT *)SunMalloc(sizeof(hashT),function);
+
+  hash->size=2;
+  while(hash->size<2*N)
+    hash->size*=2;
+
+  hash->key = (int *)SunMalloc(hash->size*sizeof(int),function);
+  hash->val = (int *)SunMalloc(hash->size*sizeof(int),function);
+  for(i=0;i<hash->size;i++) {
+    hash->key[i]=EMPTYKEY;
+    hash->val[i]=-1;
+  }
+  return hash;
+}
+
+/*
+ * Function: HashIndex
+ * Usage: i = HashIndex(hash,key);
+ * -------------------------------
+ * Returns the slot that holds key, or the empty slot where it would
+ * be inserted, using linear probing from a multiplicative hash.
+ *
+ */
+static int HashIndex(hashT *hash, int key) {
+  unsigned h = (unsigned)key*2654435761u;
+  int i = (int)((h^(h>>16))&(unsigned)(hash->size-1));
+
+  while(hash->key[i]!=EMPTYKEY && hash->key[i]!=key)
+    i=(i+1)&(hash->size-1);
+  return i;
+}
+
+/*
+ * Function: HashInsert
+ * Usage: HashInsert(hash,key,val);
+ * --------------------------------
+ * Maps key to val, replacing the existing value if key is already present.
+ * The table is not resized so no more than the N keys given to HashCreate
+ * should be inserted.
+ *
+ */
+void HashInsert(hashT *hash, int key, int val) {
+  int i = HashIndex(hash,key);
+
+  hash->key[i]=key;
+  hash->val[i]=val;
+}
+
+/*
+ * Function: HashLookup
+ * Usage: val = HashLookup(hash,key);
+ * ----------------------------------
+ * Returns the value stored for key, or -1 if key is not in the table.
+ *
+ */
+int HashLookup(hashT *hash, int key) {
+  return hash->val[HashIndex(hash,key)];
+}
+
+/*
+ * Function: HashFree
+ * Usage: HashFree(hash,"Function");
+ * ---------------------------------
+ * Free the space associated with a hash table.
+ *
+ */
+void HashFree(hashT *hash, char *function) {
+  SunFree(hash->key,hash->size*sizeof(int),function);
+  SunFree(hash->val,hash->size*sizeof(int),function);
+  SunFree(hash,sizeof(hashT),function);
+}
+
+/*
+ * Function: RCMLevels
+ * Usage: last = RCMLevels(N,rowptr,col,degree,start,level,queue);
+ * ----------------------------------------------------------------
+ * Breadth-first search from start over the unnumbered (level=-1) nodes
+ * of the component.  Returns the node of smallest degree in the last
+ * level and resets level to -1 for the nodes that were visited.
+ *
+ */
+static int RCMLevels(int N, int *rowptr, int *col, int *degree, int start, int *level, int *queue) {
+  int i, j, nz, head=0, tail=0, last=start;
+
+  queue[tail++]=start;
+  level[start]=0;
+  while(head<tail) {
+    i=queue[head++];
+    if(level[i]>level[last] || (level[i]==level[last] && degree[i]<degree[last]))
+      last=i;
+    for(nz=rowptr[i];nz<rowptr[i+1];nz++) {
+      j=col[nz];
+      if(j>=0 && level[j]==-1) {
+        level[j]=level[i]+1;
+        queue[tail++]=j;
+      }
+    }
+  }
+  for(i=0;i<tail;i++)
+    level[queue[i]]=-1;
+
+  return last;
+}
 
+/*
+ * Function: EnvelopeCreate
+ * Usage: env = EnvelopeCreate(N,rowptr,col,"Function");
+ * -----------------------------------------------------
+ * Symbolic factorization of the N x N symmetric matrix whose off-diagonal
+ * entries in row i are in col[rowptr[i]..rowptr[i+1]-1] (entries with col<0
+ * are ignored).  The rows are ordered with reverse Cuthill-McKee starting
+ * each connected component from a pseudo-peripheral node, which keeps
+ * the envelope and hence the fill small, and the envelope of L is
+ * allocated.  The numerical factorization is done by EnvelopeFactor.
+ *
+ */
+envelopeT *EnvelopeCreate(int N, int *rowptr, int *col, char *function) {
+  int i, j, k, m, p, nz, n, next, head, tail, *degree, *level, *queue;
+  envelopeT *env = (envelopeT *)SunMalloc(sizeof(envelopeT),function);
+
+  env->N=N;
+  env->perm = (int *)SunMalloc(N*sizeof(int),function);
+  env->iperm = (int *)SunMalloc(N*sizeof(int),function);
+  env->first = (int *)SunMalloc(N*sizeof(int),function);
+  env->start = (int *)SunMalloc((N+1)*sizeof(int),function);
+  env->work = (REAL *)SunMalloc(N*sizeof(REAL),function);
+  degree = (int *)SunMalloc(N*sizeof(int),function);
+  level = (int *)SunMalloc(N*sizeof(int),function);
+  queue = (int *)SunMalloc(N*sizeof(int),function);
 
+  for(i=0;i<N;i++) {
+    degree[i]=0;
+    for(nz=rowptr[i];nz<rowptr[i+1];nz++)
+      if(col[nz]>=0)
+        degree[i]++;
+    level[i]=-1;
+    env->iperm[i]=-1;
+  }
+
+  // Cuthill-McKee numbering, one connected component at a time
+  n=0;
+  for(m=0;m<N;m++) {
+    if(env->iperm[m]!=-1)
+      continue;
+    next=RCMLevels(N,rowptr,col,degree,m,level,queue);
+    next=RCMLevels(N,rowptr,col,degree,next,level,queue);
+
+    head=n;
+    tail=n;
+    env->perm[tail++]=next;
+    env->iperm[next]=0;
+    while(head<tail) {
+      i=env->perm[head++];
+      p=tail;
+      for(nz=rowptr[i];nz<rowptr[i+1];nz++) {
+        j=col[nz];
+        if(j>=0 && env->iperm[j]==-1) {
+          env->iperm[j]=0;
+          // Insert neighbors in order of increasing degree
+          for(k=tail;k>p && degree[env->perm[k-1]]>degree[j];k--)
+            env->perm[k]=env->perm[k-1];
+          env->perm[k]=j;
+          tail++;
+        }
+      }
+    }
+    n=tail;
+  }
+
+  // Reverse the ordering
+  for(p=0;p<N/2;p++) {
+    i=env->perm[p];
+    env->perm[p]=env->perm[N-1-p];
+    env->perm[N-1-p]=i;
+  }
+  for(p=0;p<N;p++)
+    env->iperm[env->perm[p]]=p;
+
+  // Envelope of the lower triangle in the new ordering
+  env->start[0]=0;
+  for(p=0;p<N;p++) {
+    i=env->perm[p];
+    env->first[p]=p;
+    for(nz=rowptr[i];nz<rowptr[i+1];nz++)
+      if(col[nz]>=0 && env->iperm[col[nz]]<env->first[p])
+        env->first[p]=env->iperm[col[nz]];
+    env->start[p+1]=env->start[p]+p-env->first[p]+1;
+  }
+  env->size=env->start[N];
+  env->L = (REAL *)SunMalloc(env->size*sizeof(REAL),function);
+
+  SunFree(degree,N*sizeof(int),function);
+  SunFree(level,N*sizeof(int),function);
+  SunFree(queue,N*sizeof(int),function);
+
+  return env;
+}
+
+/*
+ * Function: EnvelopeFactor
+ * Usage: status = EnvelopeFactor(env,diag,index,rowptr,col,val);
+ * --------------------------------------------------------------
+ * Numerical Cholesky factorization of the matrix with diagonal
+ * diag[index[i]] (diag[i] if index is NULL) and off-diagonal entries
+ * A(i,col[nz]) = -val[nz], using the structure from EnvelopeCreate.
+ * Returns 0 if the matrix is not positive definite and 1 otherwise.
+ *
+ */
+int EnvelopeFactor(envelopeT *env, REAL *diag, int *index, int *rowptr, int *col, REAL *val) {
+  int i, k, p, q, kmin, nz, op, oq;
+  REAL sum, *L=env->L;
+
+  for(k=0;k<env->size;k++)
+    L[k]=0;
+
+  for(p=0;p<env->N;p++) {
+    i=env->perm[p];
+    op=env->start[p]-env->first[p];
+    L[op+p]=index ? diag[index[i]] : diag[i];
+    for(nz=rowptr[i];nz<rowptr[i+1];nz++)
+      if(col[nz]>=0 && (q=env->iperm[col[nz]])<p)
+        L[op+q]=-val[nz];
+  }
+
+  for(p=0;p<env->N;p++) {
+    op=env->start[p]-env->first[p];
+    for(q=env->first[p];q<p;q++) {
+      oq=env->start[q]-env->first[q];
+      kmin=env->first[p]>env->first[q] ? env->first[p] : env->first[q];
+      sum=L[op+q];
+      for(k=kmin;k<q;k++)
+        sum-=L[op+k]*L[oq+k];
+      L[op+q]=sum/L[oq+q];
+    }
+    sum=L[op+p];
+    for(k=env->first[p];k<p;k++)
+      sum-=L[op+k]*L[op+k];
+    if(sum<=0)
+      return 0;
+    L[op+p]=sqrt(sum);
+  }
+  return 1;
+}
+
+/*
+ * Function: EnvelopeSolve
+ * Usage: EnvelopeSolve(env,b,x,index);
+ * ------------------------------------
+ * Solve L L^T x = b by forward and back substitution, where b and x are
+ * accessed as b[index[i]] and x[index[i]] (b[i] and x[i] if index is NULL).
+ * b and x may be the same array.
+ *
+ */
+void EnvelopeSolve(envelopeT *env, REAL *b, REAL *x, int *index) {
+  int i, k, p, op;
+  REAL sum, *L=env->L, *y=env->work;
+
+  for(p=0;p<env->N;p++) {
+    i=env->perm[p];
+    y[p]=index ? b[index[i]] : b[i];
+  }
+
+  for(p=0;p<env->N;p++) {
+    op=env->start[p]-env->first[p];
+    sum=y[p];
+    for(k=env->first[p];k<p;k++)
+      sum-=L[op+k]*y[k];
+    y[p]=sum/L[op+p];
+  }
+
+  for(p=env->N-1;p>=0;p--) {
+    op=env->start[p]-env->first[p];
+    y[p]/=L[op+p];
+    for(k=env->first[p];k<p;k++)
+      y[k]-=L[op+k]*y[p];
+  }
+
+  for(p=0;p<env->N;p++) {
+    i=env->perm[p];
+    if(index)
+      x[index[i]]=y[p];
+    else
+      x[i]=y[p];
+  }
+}
+
+/*
+ * Function: EnvelopeFree
+ * Usage: EnvelopeFree(env,"Function");
+ * ------------------------------------
+ * Free the space associated with an envelope factorization.
+ *
+ */
+void EnvelopeFree(envelopeT *env, char *function) {
+  SunFree(env->perm,env->N*sizeof(int),function);
+  SunFree(env->iperm,env->N*sizeof(int),function);
+  SunFree(env->first,env->N*sizeof(int),function);
+  SunFree(env->start,(env->N+1)*sizeof(int),function);
+  SunFree(env->work,env->N*sizeof(REAL),function);
+  SunFree(env->L,env->size*sizeof(REAL),function);
+  SunFree(env,sizeof(envelopeT),function);
+}
+
+/*
+ * Function: SumAdd
+ * Usage: SumAdd(&sums[0],Ac*dz*s);
+ * --------------------------------
+ * Add x to the compensated (Kahan) sum s.  s->c holds the negative of the
+ * low-order bits lost from s->sum and must start at zero along with s->sum.
+ *
+ */
+void SumAdd(sumT *s, REAL x) {
+  REAL y = x-s->c, t = s->sum+y;
+
+  s->c = (t-s->sum)-y;
+  s->sum = t;
+}
+
+/*
+ * Function: ReduceSums
+ * Usage: ReduceSums(sums,global,N,myproc,comm);
+ * ---------------------------------------------
+ * Sum the N compensated sums over all processors with a single MPI_Reduce
+ * and place the totals in global on processor 0.  The high and low parts of
+ * each sum are reduced separately so the compensation is not lost in the
+ * reduction.
+ *
+ */
+void ReduceSums(sumT *sums, REAL *global, int N, int myproc, MPI_Comm comm) {
+  int n;
+  REAL *buf = (REAL *)SunMalloc(4*N*sizeof(REAL),"ReduceSums");
+
+  for(n=0;n<N;n++) {
+    buf[n]=sums[n].sum;
+    buf[N+n]=-sums[n].c;
+  }
+
+  MPI_Reduce(buf,buf+2*N,2*N,MPI_DOUBLE,MPI_SUM,0,comm);
+
+  if(myproc==0)
+    for(n=0;n<N;n++)
+      global[n]=buf[2*N+n]+buf[3*N+n];
+
+  SunFree(buf,4*N*sizeof(REAL),"ReduceSums");
+}
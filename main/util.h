@@ -21,6 +21,37 @@ enum Type
   INT
 };
 
+// Open-addressing hash table that maps non-negative integer keys
+// (e.g. global cell or edge indices) to integer values
+typedef struct _hashT {
+  int size;
+  int *key;
+  int *val;
+} hashT;
+
+// Cursor into an increasing vector of forcing times.  It remembers the
+// record found by the last search along with the quadratic interpolation
+// weights for the current time.
+typedef struct _timecursorT {
+  int rec;
+  REAL w[3];
+} timecursorT;
+
+// Envelope (profile) Cholesky factor L of a sparse symmetric positive-definite
+// matrix whose rows are permuted with reverse Cuthill-McKee.  Row p of L holds
+// columns first[p]..p starting at L[start[p]].
+typedef struct _envelopeT {
+  int N, size;
+  int *perm, *iperm, *first, *start;
+  REAL *L, *work;
+} envelopeT;
+
+// Compensated (Kahan) sum for global integrals, see SumAdd and ReduceSums
+typedef struct _sumT {
+  REAL sum;
+  REAL c;
+} sumT;
+
 void Sort(int *a, int *v, int N);
 void ReOrderIntArray(int *a, int *order, int *tmp, int N, int Num, int *nfaces, int *grad, int maxfaces);
 void ReOrderRealArray(REAL *a, int *order, REAL *tmp, int N, int Num, int *nfaces, int *grad, int maxfaces);
@@ -32,6 +63,8 @@ void TriSolve(REAL *a, REAL *b, REAL *c, REAL *d, REAL *u, int N);
 int IsNan(REAL x);
 REAL UpWind(REAL u, REAL dz1, REAL dz2);
 void Copy(REAL **from, REAL **to, gridT *grid);
+REAL **StoredToREAL(SREAL **x, REAL **tmp, gridT *grid);
+void REALToStored(REAL **x, SREAL **y, gridT *grid);
 REAL Max(REAL x1, REAL x2);
 REAL Min(REAL x, REAL y);
 void ComputeGradient(REAL **gradient, REAL **phi, gridT *grid, int direction);
@@ -39,6 +72,22 @@ void PrintVectorToFile(enum Type etype, void *Vector, int M, char *filename, int
 int max(int a, int b);
 int SharedListValue(int *list1, int *list2, int listsize);
 REAL QuadInterp(REAL x, REAL x0, REAL x1, REAL x2, REAL y0, REAL y1, REAL y2);
+void QuadWeights(REAL x, REAL x0, REAL x1, REAL x2, REAL *w);
+int SearchTime(REAL t, REAL *time, int lo, int hi);
+void InitTimeCursor(timecursorT *cursor);
+int TimeCursorSearch(timecursorT *cursor, REAL t, REAL *time, int nt);
+void TimeCursorWeights(timecursorT *cursor, REAL t, REAL t0, REAL t1, REAL t2);
+void TimeInterp(REAL *y, REAL *y0, REAL *y1, REAL *y2, REAL *w, int N, REAL ymin, REAL ymax);
 REAL getToffSet(char starttime[15], char basetime[15]);
 void linsolve(REAL **A, REAL *b, int N);
+hashT *HashCreate(int N, char *function);
+void HashInsert(hashT *hash, int key, int val);
+int HashLookup(hashT *hash, int key);
+void HashFree(hashT *hash, char *function);
+envelopeT *EnvelopeCreate(int N, int *rowptr, int *col, char *function);
+int EnvelopeFactor(envelopeT *env, REAL *diag, int *index, int *rowptr, int *col, REAL *val);
+void EnvelopeSolve(envelopeT *env, REAL *b, REAL *x, int *index);
+void EnvelopeFree(envelopeT *env, char *function);
+void SumAdd(sumT *s, REAL x);
+void ReduceSums(sumT *sums, REAL *global, int N, int myproc, MPI_Comm comm);
 #endif